@@ -0,0 +1,97 @@
+/* <base/histogram.cc>
+
+   Implements <base/histogram.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <base/histogram.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace Base;
+
+constexpr size_t THistogram::BucketCount;
+
+void THistogram::Push(double val) {
+  assert(this);
+  size_t bucket = 0;
+  if (val >= 1) {
+    int exp;
+    frexp(val, &exp);
+    bucket = min(static_cast<size_t>(exp), BucketCount - 1);
+  }
+  ++Buckets[bucket];
+  ++Count;
+}
+
+void THistogram::Add(const THistogram &that) {
+  assert(this);
+  assert(&that);
+  for (size_t bucket = 0; bucket < BucketCount; ++bucket) {
+    Buckets[bucket] += that.Buckets[bucket];
+  }
+  Count += that.Count;
+}
+
+double THistogram::GetBucketLimit(size_t bucket) {
+  assert(bucket < BucketCount);
+  return ldexp(1.0, static_cast<int>(bucket));
+}
+
+double THistogram::GetPercentile(double percentile) const {
+  assert(this);
+  if (!Count) {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(ceil(static_cast<double>(Count) * min(max(percentile, 0.0), 100.0) / 100.0));
+  size_t seen = 0;
+  for (size_t bucket = 0; bucket < BucketCount; ++bucket) {
+    seen += Buckets[bucket];
+    if (seen && seen >= rank) {
+      return GetBucketLimit(bucket);
+    }
+  }
+  return GetBucketLimit(BucketCount - 1);
+}
+
+void THistogram::Reset() {
+  assert(this);
+  Count = 0;
+  fill(Buckets, Buckets + BucketCount, 0);
+}
+
+ostream &Base::operator<<(ostream &strm, const THistogram &that) {
+  assert(&strm);
+  assert(&that);
+  strm << "(count: " << that.GetCount();
+  if (that.GetCount()) {
+    strm << ", p50: " << that.GetPercentile(50) << ", p99: " << that.GetPercentile(99) << ", [";
+    bool is_first = true;
+    for (size_t bucket = 0; bucket < THistogram::BucketCount; ++bucket) {
+      size_t count = that.GetBucketCount(bucket);
+      if (count) {
+        if (!is_first) {
+          strm << ", ";
+        }
+        strm << '<' << THistogram::GetBucketLimit(bucket) << ": " << count;
+        is_first = false;
+      }
+    }
+    strm << ']';
+  }
+  return strm << ')';
+}
@@ -0,0 +1,84 @@
+/* <base/histogram.h>
+
+   Count a series of non-negative values into power-of-two buckets.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <ostream>
+
+namespace Base {
+
+  /* Count a series of non-negative values into power-of-two buckets.
+     Bucket 0 holds values less than 1 and bucket i holds values in [2^(i-1), 2^i).  The last bucket also holds anything
+     too big for the others.  Percentiles are therefore only good to within a factor of two, but pushing is cheap and
+     the histogram doesn't store the individual values. */
+  class THistogram {
+    public:
+
+    /* The number of buckets. */
+    static constexpr size_t BucketCount = 48;
+
+    /* Start out empty. */
+    THistogram() {
+      Reset();
+    }
+
+    /* Push a value into the histogram.  Negative values count as zero. */
+    void Push(double val);
+
+    /* Add the values counted by that histogram to ours. */
+    void Add(const THistogram &that);
+
+    /* The number of times Push() has been called. */
+    size_t GetCount() const {
+      assert(this);
+      return Count;
+    }
+
+    /* The number of values which fell into the given bucket. */
+    size_t GetBucketCount(size_t bucket) const {
+      assert(this);
+      assert(bucket < BucketCount);
+      return Buckets[bucket];
+    }
+
+    /* The exclusive upper limit of the values in the given bucket. */
+    static double GetBucketLimit(size_t bucket);
+
+    /* The upper limit of the bucket in which the given percentile (0 to 100) of the values fall, or zero if we're
+       empty. */
+    double GetPercentile(double percentile) const;
+
+    /* Go back to being empty. */
+    void Reset();
+
+    private:
+
+    /* The number of times Push() has been called. */
+    size_t Count;
+
+    /* The number of values in each bucket. */
+    size_t Buckets[BucketCount];
+
+  };  // THistogram
+
+  /* Write a string like this (count: a, p50: b, p99: c, [<d: e, <f: g, ...]), listing only non-empty buckets. */
+  std::ostream &operator<<(std::ostream &strm, const THistogram &that);
+
+}  // Base
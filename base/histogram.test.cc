@@ -0,0 +1,86 @@
+/* <base/histogram.test.cc>
+
+   Unit test for <base/histogram.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <base/histogram.h>
+
+#include <sstream>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace Base;
+
+FIXTURE(Buckets) {
+  THistogram hist;
+  hist.Push(-3);
+  hist.Push(0.5);
+  hist.Push(1);
+  hist.Push(3);
+  hist.Push(4);
+  hist.Push(1e300);
+  EXPECT_EQ(hist.GetCount(), 6u);
+  EXPECT_EQ(hist.GetBucketCount(0), 2u);
+  EXPECT_EQ(hist.GetBucketCount(1), 1u);
+  EXPECT_EQ(hist.GetBucketCount(2), 1u);
+  EXPECT_EQ(hist.GetBucketCount(3), 1u);
+  EXPECT_EQ(hist.GetBucketCount(THistogram::BucketCount - 1), 1u);
+  EXPECT_EQ(THistogram::GetBucketLimit(0), 1.0);
+  EXPECT_EQ(THistogram::GetBucketLimit(3), 8.0);
+}
+
+FIXTURE(Percentiles) {
+  THistogram hist;
+  EXPECT_EQ(hist.GetPercentile(50), 0.0);
+  for (int i = 0; i < 99; ++i) {
+    hist.Push(10);
+  }
+  hist.Push(1000);
+  EXPECT_EQ(hist.GetPercentile(0), 16.0);
+  EXPECT_EQ(hist.GetPercentile(50), 16.0);
+  EXPECT_EQ(hist.GetPercentile(99), 16.0);
+  EXPECT_EQ(hist.GetPercentile(100), 1024.0);
+}
+
+FIXTURE(Add) {
+  THistogram lhs, rhs;
+  lhs.Push(3);
+  rhs.Push(3);
+  rhs.Push(100);
+  lhs.Add(rhs);
+  EXPECT_EQ(lhs.GetCount(), 3u);
+  EXPECT_EQ(lhs.GetBucketCount(2), 2u);
+  EXPECT_EQ(lhs.GetBucketCount(7), 1u);
+  EXPECT_EQ(rhs.GetCount(), 2u);
+}
+
+FIXTURE(Write) {
+  THistogram hist;
+  ostringstream strm;
+  strm << hist;
+  EXPECT_EQ(strm.str(), "(count: 0)");
+  hist.Push(3);
+  hist.Push(3);
+  hist.Push(100);
+  strm.str("");
+  strm << hist;
+  EXPECT_EQ(strm.str(), "(count: 3, p50: 4, p99: 128, [<4: 2, <128: 1])");
+  hist.Reset();
+  strm.str("");
+  strm << hist;
+  EXPECT_EQ(strm.str(), "(count: 0)");
+}
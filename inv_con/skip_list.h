@@ -0,0 +1,584 @@
+/* <inv_con/skip_list.h>
+
+   Classes for maintaining an invasive, ordered skip list.
+
+   This has the same interface as <inv_con/ordered_list.h>, so a collection can switch between the two by changing
+   its typedefs.  The difference is that each membership carries a tower of links, which makes insertion and seeking
+   O(log n) rather than O(n).  Every level of the tower is double-linked, so removal is O(log n) too and never has to
+   look at keys; that matters to members whose keys stop being comparable once they start tearing down.  Level zero
+   is a plain double-linked list, so cursors walk a skip list exactly as they walk an ordered list.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <base/class_traits.h>
+#include <base/no_default_case.h>
+#include <inv_con/cursor.h>
+
+namespace InvCon {
+
+  /* Classes for maintaining an invasive, ordered skip list. */
+  namespace SkipList {
+
+    /* The tallest tower a membership can have.  Towers grow with probability 1/4 per level, so this keeps searches
+       logarithmic up to roughly 4^MaxLevel members. */
+    static const size_t MaxLevel = 12;
+
+    /* Forward declarations of base classes. */
+    template <typename TCollector, typename TMember, typename TKey>
+    class TCollection;
+    template <typename TMember, typename TCollector, typename TKey>
+    class TMembership;
+
+    /* Forward declarations of final classes. */
+    namespace Impl {
+      template <typename TCollector, typename TMember, typename TKey>
+      class TCollection;
+      template <typename TMember, typename TCollector, typename TKey>
+      class TMembership;
+    }
+
+    /* The 'one' side of the one-to-many. */
+    template <typename TCollector, typename TMember, typename TKey>
+    class TCollection {
+      NO_COPY(TCollection);
+      public:
+
+      /* Our corresponding 'many' class. */
+      typedef TMembership<TMember, TCollector, TKey> TTypedMembership;
+
+      /* The final version of this class. */
+      typedef Impl::TCollection<TCollector, TMember, TKey> TImpl;
+
+      /* Our cursor class. */
+      typedef InvCon::Impl::TCursor<TCollector, TCollection, TMember, TTypedMembership> TCursor;
+
+      /* The collector which owns us.  Never null. */
+      TCollector *GetCollector() const {
+        assert(this);
+        return Collector;
+      }
+
+      /* The first member of the collection,
+         or null if the collection is empty. */
+      TMember *TryGetFirstMember() const {
+        assert(this);
+        return Head[0] ? Head[0]->Member : 0;
+      }
+
+      /* The first member of the collection which matches the given key,
+         or null if the collection contains no match. */
+      TMember *TryGetFirstMember(const TKey &key) const {
+        assert(this);
+        TTypedMembership *membership = TryGetFirstMembership(key);
+        return membership ? membership->GetMember() : 0;
+      }
+
+      /* The first membership of the collection,
+         or null if the collection is empty. */
+      TTypedMembership *TryGetFirstMembership() const {
+        assert(this);
+        return Head[0];
+      }
+
+      /* The first membership of the collection which matches the given key,
+         or null if the collection contains no match. */
+      TTypedMembership *TryGetFirstMembership(const TKey &key) const {
+        assert(this);
+        TTypedMembership *membership = TryGetFirstMembershipNotBefore([&key](const TKey &that) { return that < key; });
+        return (membership && !(key < membership->Key)) ? membership : 0;
+      }
+
+      /* The first membership whose key is not before the point described by the given predicate,
+         or null if every membership is before it.
+         The predicate takes a key and returns true iff. that key comes before the point.  It must be true for some
+         prefix of the collection (possibly empty) and false for the rest, which means it can be used to seek on a
+         partial key, without having to construct a complete one. */
+      template <typename TIsBefore>
+      TTypedMembership *TryGetFirstMembershipNotBefore(const TIsBefore &is_before) const {
+        assert(this);
+        TTypedMembership *prev_membership = 0;
+        for (size_t level = Level; level; --level) {
+          TTypedMembership *next_membership = prev_membership ? prev_membership->GetLink(level - 1).Forward : Head[level - 1];
+          while (next_membership && is_before(next_membership->Key)) {
+            prev_membership = next_membership;
+            next_membership = next_membership->GetLink(level - 1).Forward;
+          }
+        }
+        return prev_membership ? prev_membership->Bottom.Forward : Head[0];
+      }
+
+      /* The last member of the collection,
+         or null if the collection is empty. */
+      TMember *TryGetLastMember() const {
+        assert(this);
+        return LastMembership ? LastMembership->Member : 0;
+      }
+
+      /* The last member of the collection which matches the given key,
+         or null if the collection contains no match. */
+      TMember *TryGetLastMember(const TKey &key) const {
+        assert(this);
+        TTypedMembership *membership = TryGetLastMembership(key);
+        return membership ? membership->GetMember() : 0;
+      }
+
+      /* The last membership of the collection,
+         or null if the collection is empty. */
+      TTypedMembership *TryGetLastMembership() const {
+        assert(this);
+        return LastMembership;
+      }
+
+      /* The last membership of the collection which matches the given key,
+         or null if the collection contains no match. */
+      TTypedMembership *TryGetLastMembership(const TKey &key) const {
+        assert(this);
+        TTypedMembership *membership = TryGetFirstMembershipNotBefore([&key](const TKey &that) { return !(key < that); });
+        membership = membership ? membership->Bottom.Backward : LastMembership;
+        return (membership && !(membership->Key < key)) ? membership : 0;
+      }
+
+      /* True iff. there are no members in the collection. */
+      bool IsEmpty() const {
+        assert(this);
+        return Head[0] == 0;
+      }
+
+      protected:
+
+      /* Pass in a non-null pointer to the collector which owns us. */
+      TCollection(TCollector *collector)
+          : Collector(collector), LastMembership(0), Level(1), Seed(0x9E3779B9) {
+        assert(collector);
+        for (size_t level = 0; level < MaxLevel; ++level) {
+          Head[level] = 0;
+        }
+      }
+
+      /* Remove each member from the collection upon destruction. */
+      virtual ~TCollection() {
+        assert(this);
+        RemoveEachMember();
+      }
+
+      /* Delete each member. */
+      void DeleteEachMember() {
+        assert(this);
+        while (Head[0]) {
+          TMember *member = Head[0]->Member;
+          Head[0]->Remove();
+          delete member;
+        }
+      }
+
+      /* Insert the given membership at the correct position.
+         If the membership is already at the correct position, do nothing.
+         If the membership in a different collection, remove it from that collection before inserting. */
+      void Insert(TTypedMembership *membership) {
+        assert(this);
+        assert(membership);
+        membership->Insert(this);
+      }
+
+      /* Same as Insert().  The ordered list distinguishes between searching from the front and from the back; we
+         search from the top, so both directions cost the same. */
+      void ReverseInsert(TTypedMembership *membership) {
+        assert(this);
+        assert(membership);
+        membership->ReverseInsert(this);
+      }
+
+      /* Remove each member from the collection but don't delete them. */
+      void RemoveEachMember() {
+        assert(this);
+        while (Head[0]) {
+          Head[0]->Remove();
+        }
+      }
+
+      private:
+
+      /* The height of the tower for a newly linked membership.
+         Raises our level if the new tower is taller than any we have. */
+      size_t NewHeight() {
+        assert(this);
+        /* xorshift32; we only need the levels to be unpredictable w.r.t. the keys, not w.r.t. an adversary. */
+        Seed ^= Seed << 13;
+        Seed ^= Seed >> 17;
+        Seed ^= Seed << 5;
+        size_t height = 1;
+        for (uint32_t bits = Seed; height < MaxLevel && (bits & 3) == 0; bits >>= 2) {
+          ++height;
+        }
+        if (height > Level) {
+          Level = height;
+        }
+        return height;
+      }
+
+      /* Lower our level past any empty levels at the top. */
+      void ShrinkLevel() {
+        assert(this);
+        while (Level > 1 && !Head[Level - 1]) {
+          --Level;
+        }
+      }
+
+      /* See accessor. */
+      TCollector *const Collector;
+
+      /* The first membership at each level of the list. */
+      TTypedMembership *Head[MaxLevel];
+
+      /* See accessor. */
+      TTypedMembership *LastMembership;
+
+      /* The number of levels currently in use.  Always at least 1. */
+      size_t Level;
+
+      /* The state of the generator from which we draw tower heights. */
+      uint32_t Seed;
+
+      /* For Collector, Head, LastMembership, Level, NewHeight(), and ShrinkLevel(). */
+      friend class TMembership<TMember, TCollector, TKey>;
+
+    };  // TCollection<TCollector, TMember>
+
+    /* The 'many' side of the one-to-many. */
+    template <typename TMember, typename TCollector, typename TKey>
+    class TMembership {
+      NO_COPY(TMembership);
+      public:
+
+      /* Our corresponding 'one' class. */
+      typedef TCollection<TCollector, TMember, TKey> TTypedCollection;
+
+      /* The final version of this class. */
+      typedef Impl::TMembership<TMember, TCollector, TKey> TImpl;
+
+      /* Get our key. */
+      const TKey &GetKey() const {
+        assert(this);
+        return Key;
+      }
+
+      /* The member which owns us.  Never null. */
+      TMember *GetMember() const {
+        assert(this);
+        return Member;
+      }
+
+      /* The collection we're in, if any. */
+      TTypedCollection *TryGetCollection() const {
+        assert(this);
+        return Collection;
+      }
+
+      /* The collector whose collection we're in, if any. */
+      TCollector *TryGetCollector() const {
+        assert(this);
+        return Collection ? Collection->Collector : 0;
+      }
+
+      /* The member before us in our collection.
+         A null here means either we're first in our collection or we're not in a collection. */
+      TMember *TryGetPrevMember() const {
+        assert(this);
+        return Bottom.Backward ? Bottom.Backward->Member : 0;
+      }
+
+      /* The membership before us in our collection.
+         A null here means either we're first in our collection or we're not in a collection. */
+      TMembership *TryGetPrevMembership() const {
+        assert(this);
+        return Bottom.Backward;
+      }
+
+      /* The member after us in our collection.
+         A null here means either we're last in our collection or we're not in a collection. */
+      TMember *TryGetNextMember() const {
+        assert(this);
+        return Bottom.Forward ? Bottom.Forward->Member : 0;
+      }
+
+      /* The membership after us in our collection.
+         A null here means either we're last in our collection or we're not in a collection. */
+      TMembership *TryGetNextMembership() const {
+        assert(this);
+        return Bottom.Forward;
+      }
+
+      protected:
+
+      /* Pass in a non-null pointer to the member which owns us. */
+      TMembership(TMember *member)
+          : Member(member) {
+        assert(member);
+        ZeroLinkage();
+      }
+
+      /* Pass in a non-null pointer to the member which owns us, a value for our key,
+         and an an optional pointer to a collection to insert into. */
+      TMembership(TMember *member, const TKey &key, TTypedCollection *collection = 0)
+          : Member(member), Key(key) {
+        assert(member);
+        ZeroLinkage();
+        if (collection) {
+          Insert(collection);
+        }
+      }
+
+      /* Pass in a non-null pointer to the member which owns us, a value for our key,
+         and a pointer to a collection to insert into. */
+      TMembership(TMember *member, const TKey &key, TTypedCollection *collection, TOrient insert_from)
+          : Member(member), Key(key) {
+        assert(member);
+        assert(collection);
+        ZeroLinkage();
+        switch (insert_from) {
+          case TOrient::Fwd: {
+            Insert(collection);
+            break;
+          }
+          case TOrient::Rev: {
+            ReverseInsert(collection);
+            break;
+          }
+        }
+      }
+
+      /* Automatically removes us from our collection (if any) before destruction. */
+      virtual ~TMembership() {
+        assert(this);
+        Remove();
+      }
+
+      /* Insert us into the given collection at the correct position, which is after any memberships with keys equal
+         to ours.
+         If we're already at that position, do nothing.
+         If we're already in a different collection, remove us from that collection before inserting. */
+      void Insert(TTypedCollection *collection) {
+        assert(this);
+        assert(collection);
+        if (Collection == collection &&
+            (!Bottom.Backward || Bottom.Backward->Key <= Key) && (!Bottom.Forward || Bottom.Forward->Key > Key)) {
+          return;
+        }
+        Remove();
+        /* Find the last membership at each level whose key is not greater than ours. */
+        TMembership *update[MaxLevel];
+        TMembership *prev_membership = 0;
+        for (size_t level = MaxLevel; level; --level) {
+          if (level <= collection->Level) {
+            TMembership *next_membership = prev_membership ? prev_membership->GetLink(level - 1).Forward : collection->Head[level - 1];
+            while (next_membership && next_membership->Key <= Key) {
+              prev_membership = next_membership;
+              next_membership = next_membership->GetLink(level - 1).Forward;
+            }
+          }
+          update[level - 1] = prev_membership;
+        }
+        /* Link in at each level of our new tower. */
+        const size_t height = collection->NewHeight();
+        Upper = (height > 1) ? new TLink[height - 1] : 0;
+        Collection = collection;
+        Height = height;
+        for (size_t level = 0; level < Height; ++level) {
+          TLink &our_link = GetLink(level);
+          TMembership *&link = update[level] ? update[level]->GetLink(level).Forward : collection->Head[level];
+          our_link.Forward = link;
+          our_link.Backward = update[level];
+          link = this;
+          if (our_link.Forward) {
+            our_link.Forward->GetLink(level).Backward = this;
+          }
+        }
+        if (!Bottom.Forward) {
+          collection->LastMembership = this;
+        }
+      }
+
+      /* Same as Insert(). */
+      void ReverseInsert(TTypedCollection *collection) {
+        assert(this);
+        Insert(collection);
+      }
+
+      /* Remove us from our collection.
+         If we're not in a collection, this function does nothing. */
+      void Remove() {
+        assert(this);
+        if (Collection) {
+          /* Unlink ourselves from each level of our tower.  This doesn't compare keys, so it's safe even if our
+             member is part way through destruction. */
+          for (size_t level = 0; level < Height; ++level) {
+            const TLink &our_link = GetLink(level);
+            (our_link.Backward ? our_link.Backward->GetLink(level).Forward : Collection->Head[level]) = our_link.Forward;
+            if (our_link.Forward) {
+              our_link.Forward->GetLink(level).Backward = our_link.Backward;
+            }
+          }
+          if (!Bottom.Forward) {
+            Collection->LastMembership = Bottom.Backward;
+          }
+          Collection->ShrinkLevel();
+          delete [] Upper;
+          ZeroLinkage();
+        }
+      }
+
+      /* Set our key, relocating us within our collection, if necessary.
+         If the new key is the same as the old, do nothing. */
+      void SetKey(const TKey &key) {
+        assert(this);
+        assert(&key);
+        if (Key != key) {
+          if (Collection) {
+            TTypedCollection *collection = Collection;
+            Remove();
+            Key = key;
+            Insert(collection);
+          } else {
+            Key = key;
+          }
+        }
+      }
+
+      private:
+
+      /* Our neighbours at one level of our tower. */
+      struct TLink {
+
+        /* The membership after us at this level. */
+        TMembership *Forward;
+
+        /* The membership before us at this level. */
+        TMembership *Backward;
+
+      };  // TLink
+
+      /* Our links at the given level, which must be below our height. */
+      TLink &GetLink(size_t level) {
+        assert(this);
+        assert(level < Height);
+        return level ? Upper[level - 1] : Bottom;
+      }
+
+      /* Reset all pointers to null.
+         This function does no unlinking or freeing so make sure we're unlinked first. */
+      void ZeroLinkage() {
+        assert(this);
+        Collection = 0;
+        Height = 0;
+        Bottom.Forward = 0;
+        Bottom.Backward = 0;
+        Upper = 0;
+      }
+
+      /* See accessor. */
+      TMember *const Member;
+
+      /* See accessor. */
+      TKey Key;
+
+      /* See accessor. */
+      TTypedCollection *Collection;
+
+      /* The number of levels in our tower.  Zero when we're not in a collection. */
+      size_t Height;
+
+      /* Our links at level 0, which every tower has. */
+      TLink Bottom;
+
+      /* Our links at levels 1 through Height - 1, or null if our tower is only one level tall.  Three towers in four
+         are, so most memberships cost only the two pointers in Bottom, rather than two per possible level. */
+      TLink *Upper;
+
+      /* For ~TMembership(), Insert(), Remove(), and Member. */
+      friend class TCollection<TCollector, TMember, TKey>;
+
+    };  // TMembership<TMember, TCollector>
+
+    /* The final versions of the 'one' and 'many' classes. */
+    namespace Impl {
+
+      /* The final 'one'. */
+      template <typename TCollector, typename TMember, typename TKey>
+      class TCollection
+          : public SkipList::TCollection<TCollector, TMember, TKey> {
+        public:
+
+        /* Our base type. */
+        typedef SkipList::TCollection<TCollector, TMember, TKey> TBase;
+
+        /* Do-little. */
+        TCollection(TCollector *collector)
+            : TBase(collector) {}
+
+        /* Do-little. */
+        virtual ~TCollection() {}
+
+        /* Make our base's protected mutators public. */
+        using TBase::DeleteEachMember;
+        using TBase::IsEmpty;
+        using TBase::Insert;
+        using TBase::ReverseInsert;
+        using TBase::RemoveEachMember;
+
+      };  // TCollection
+
+      /* The final 'many'. */
+      template <typename TMember, typename TCollector, typename TKey>
+      class TMembership
+          : public SkipList::TMembership<TMember, TCollector, TKey> {
+        public:
+
+        /* Our base type. */
+        typedef SkipList::TMembership<TMember, TCollector, TKey> TBase;
+
+        /* Do-little. */
+        TMembership(TMember *member)
+            : TBase(member) {}
+
+        /* Do-little. */
+        TMembership(TMember *member, const TKey &key, typename TBase::TTypedCollection *collection = 0)
+            : TBase(member, key, collection) {}
+
+        /* Do-little. */
+        TMembership(TMember *member, const TKey &key, TOrient insert_from, typename TBase::TTypedCollection *collection)
+            : TBase(member, key, collection, insert_from) {}
+
+        /* Do-little. */
+        virtual ~TMembership() {}
+
+        /* Make our base's protected mutators public. */
+        using TBase::Insert;
+        using TBase::ReverseInsert;
+        using TBase::Remove;
+        using TBase::SetKey;
+
+      };  // TMembership
+
+    }  // Impl
+
+  }  // SkipList
+
+}  // InvCon
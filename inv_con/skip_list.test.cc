@@ -0,0 +1,295 @@
+/* <inv_con/skip_list.test.cc>
+
+   Unit test for <inv_con/skip_list.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <inv_con/skip_list.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <base/class_traits.h>
+#include <test/kit.h>
+
+using namespace std;
+
+class TTeam;
+class TPlayer;
+
+class TTeam {
+  NO_COPY(TTeam);
+  public:
+
+  typedef InvCon::SkipList::TCollection<TTeam, TPlayer, int> TPlayerCollection;
+
+  TTeam()
+      : PlayerCollection(this) {}
+
+  ~TTeam() {
+    assert(this);
+    PlayerCollection.DeleteEachMember();
+  }
+
+  TPlayerCollection *GetPlayerCollection() const {
+    assert(this);
+    return &PlayerCollection;
+  }
+
+  void RemoveEachMember() {
+    PlayerCollection.RemoveEachMember();
+  }
+
+  private:
+
+  mutable TPlayerCollection::TImpl PlayerCollection;
+
+};  // TTeam
+
+class TPlayer {
+  NO_COPY(TPlayer);
+  public:
+
+  typedef InvCon::SkipList::TMembership<TPlayer, TTeam, int> TTeamMembership;
+
+  TPlayer(TTeam *team, int number)
+      : TeamMembership(this, number, team->GetPlayerCollection()) {}
+
+  TPlayer(int number) : TeamMembership(this, number) {}
+
+  int GetNumber() const {
+    assert(this);
+    return TeamMembership.GetKey();
+  }
+
+  void ReverseInsert(TTeam *team) {
+    assert(this);
+    TeamMembership.ReverseInsert(team->GetPlayerCollection());
+  }
+
+  void Remove() {
+    assert(this);
+    TeamMembership.Remove();
+  }
+
+  void SetKey(int key) {
+    assert(this);
+    TeamMembership.SetKey(key);
+  }
+
+  TTeamMembership *GetTeamMembership() {
+    assert(this);
+    return &TeamMembership;
+  }
+
+  private:
+
+  TTeamMembership::TImpl TeamMembership;
+
+};  // TPlayer
+
+/* True iff. the team, walked in both directions, holds exactly the given numbers. */
+static bool HasNumbers(const TTeam &team, vector<int> expected) {
+  sort(expected.begin(), expected.end());
+  vector<int> actual;
+  for (TTeam::TPlayerCollection::TCursor csr(team.GetPlayerCollection()); csr; ++csr) {
+    actual.push_back(csr->GetNumber());
+  }
+  if (actual != expected) {
+    return false;
+  }
+  actual.clear();
+  for (TTeam::TPlayerCollection::TCursor csr(team.GetPlayerCollection(), InvCon::Rev); csr; ++csr) {
+    actual.push_back(csr->GetNumber());
+  }
+  reverse(actual.begin(), actual.end());
+  return actual == expected;
+}
+
+FIXTURE(Typical) {
+  static const size_t player_count = 5;
+  static int number_array[player_count] = { 103, 101, 105, 104, 102 };
+  TTeam team;
+  for (size_t i = 0; i < player_count; ++i) {
+    new TPlayer(&team, number_array[i]);
+  }
+  EXPECT_TRUE(HasNumbers(team, vector<int>(number_array, number_array + player_count)));
+  for (int i = 101; i <= 105; ++i) {
+    TPlayer *p = team.GetPlayerCollection()->TryGetFirstMember(i);
+    EXPECT_EQ(p->GetNumber(), i);
+    p = team.GetPlayerCollection()->TryGetLastMember(i);
+    EXPECT_EQ(p->GetNumber(), i);
+  }
+  EXPECT_FALSE(team.GetPlayerCollection()->TryGetFirstMember(100));
+  EXPECT_FALSE(team.GetPlayerCollection()->TryGetFirstMember(106));
+  EXPECT_FALSE(team.GetPlayerCollection()->TryGetLastMember (106));
+}
+
+FIXTURE(DuplicateKeys) {
+  TTeam team;
+  TPlayer *player1 = new TPlayer(&team, 101);
+  TPlayer *player2 = new TPlayer(&team, 101);
+  TPlayer *player3 = new TPlayer(&team, 101);
+  /* Equal keys keep their insertion order. */
+  EXPECT_EQ(team.GetPlayerCollection()->TryGetFirstMember(101), player1);
+  EXPECT_EQ(team.GetPlayerCollection()->TryGetLastMember(101), player3);
+  EXPECT_EQ(player1->GetTeamMembership()->TryGetNextMember(), player2);
+  player2->Remove();
+  EXPECT_EQ(player1->GetTeamMembership()->TryGetNextMember(), player3);
+  EXPECT_EQ(player3->GetTeamMembership()->TryGetPrevMember(), player1);
+  player1->Remove();
+  EXPECT_EQ(team.GetPlayerCollection()->TryGetFirstMember(), player3);
+  delete player1;
+  delete player2;
+}
+
+FIXTURE(FirstNotBefore) {
+  TTeam team;
+  for (int i = 0; i < 1000; i += 10) {
+    new TPlayer(&team, i);
+  }
+  auto *collection = team.GetPlayerCollection();
+  for (int i = 0; i <= 990; ++i) {
+    auto *membership = collection->TryGetFirstMembershipNotBefore([i](int key) { return key < i; });
+    if (EXPECT_TRUE(membership)) {
+      EXPECT_EQ(membership->GetKey(), (i + 9) / 10 * 10);
+    }
+  }
+  EXPECT_FALSE(collection->TryGetFirstMembershipNotBefore([](int key) { return key < 1000; }));
+  EXPECT_EQ(collection->TryGetFirstMembershipNotBefore([](int) { return false; }), collection->TryGetFirstMembership());
+}
+
+FIXTURE(SetKey) {
+  TTeam team;
+  TPlayer *player1 = new TPlayer(&team, 101);
+  TPlayer *player2 = new TPlayer(&team, 102);
+  TPlayer *player3 = new TPlayer(&team, 103);
+  player1->SetKey(103);
+  player2->SetKey(101);
+  player3->SetKey(102);
+  EXPECT_EQ(team.GetPlayerCollection()->TryGetFirstMember(), player2);
+  EXPECT_EQ(team.GetPlayerCollection()->TryGetLastMember(), player1);
+  EXPECT_TRUE(HasNumbers(team, { 101, 102, 103 }));
+  player3->Remove();
+  EXPECT_FALSE(player3->GetTeamMembership()->TryGetCollection());
+  player3->SetKey(100);
+  EXPECT_TRUE(HasNumbers(team, { 101, 103 }));
+  player3->ReverseInsert(&team);
+  EXPECT_TRUE(HasNumbers(team, { 100, 101, 103 }));
+  team.RemoveEachMember();
+  EXPECT_TRUE(team.GetPlayerCollection()->IsEmpty());
+  delete player1;
+  delete player2;
+  delete player3;
+}
+
+FIXTURE(Random) {
+  mt19937 engine(42);
+  uniform_int_distribution<int> number(0, 999);
+  TTeam team;
+  vector<TPlayer *> players;
+  vector<int> numbers;
+  for (int i = 0; i < 20000; ++i) {
+    if (players.empty() || engine() % 3) {
+      int n = number(engine);
+      players.push_back(new TPlayer(&team, n));
+      numbers.push_back(n);
+    } else {
+      size_t pos = engine() % players.size();
+      delete players[pos];
+      players[pos] = players.back();
+      players.pop_back();
+      numbers[pos] = numbers.back();
+      numbers.pop_back();
+    }
+  }
+  EXPECT_TRUE(HasNumbers(team, numbers));
+}
+
+/* A key which counts how often it's compared. */
+static size_t CompareCount = 0;
+
+class TCountedKey {
+  public:
+
+  TCountedKey(int val = 0) : Val(val) {}
+
+  bool operator!=(const TCountedKey &that) const { ++CompareCount; return Val != that.Val; }
+  bool operator<(const TCountedKey &that) const { ++CompareCount; return Val < that.Val; }
+  bool operator<=(const TCountedKey &that) const { ++CompareCount; return Val <= that.Val; }
+  bool operator>(const TCountedKey &that) const { ++CompareCount; return Val > that.Val; }
+
+  private:
+
+  int Val;
+
+};  // TCountedKey
+
+class TBag;
+
+class TMarble {
+  NO_COPY(TMarble);
+  public:
+
+  typedef InvCon::SkipList::TMembership<TMarble, TBag, TCountedKey> TBagMembership;
+
+  TMarble(int val) : BagMembership(this, val) {}
+
+  TBagMembership::TImpl BagMembership;
+
+};  // TMarble
+
+class TBag {
+  NO_COPY(TBag);
+  public:
+
+  typedef InvCon::SkipList::TCollection<TBag, TMarble, TCountedKey> TMarbleCollection;
+
+  TBag() : MarbleCollection(this) {}
+
+  mutable TMarbleCollection::TImpl MarbleCollection;
+
+};  // TBag
+
+FIXTURE(RemoveWithoutCompare) {
+  mt19937 engine(7);
+  TBag bag;
+  vector<unique_ptr<TMarble>> marbles;
+  for (int i = 0; i < 10000; ++i) {
+    marbles.emplace_back(new TMarble(static_cast<int>(engine() % 100)));
+    marbles.back()->BagMembership.Insert(&bag.MarbleCollection);
+  }
+  shuffle(marbles.begin(), marbles.end(), engine);
+  CompareCount = 0;
+  marbles.clear();
+  EXPECT_EQ(CompareCount, 0UL);
+  EXPECT_TRUE(bag.MarbleCollection.IsEmpty());
+}
+
+FIXTURE(ReverseInsert) {
+  int num_iter = 1000000;
+  TTeam team;
+  for (int i = 0; i < num_iter; ++i) {
+    TPlayer *player = new TPlayer(i);
+    player->ReverseInsert(&team);
+  }
+  int seen = 0UL;
+  for (TTeam::TPlayerCollection::TCursor csr(team.GetPlayerCollection()); csr; ++csr) {
+    EXPECT_EQ(csr->GetNumber(), seen++);
+  }
+  EXPECT_EQ(seen, num_iter);
+}
@@ -156,7 +156,8 @@ namespace Io {
       assert(&that);
       Write(that.size());
       for (const typename TThat::value_type &val: that) {
-        Write(val);
+        /* stream the value, like ReadPushableContainer() does, so types with their own inserters work too */
+        *this << val;
       }
     }
 
@@ -121,6 +121,12 @@ shared_ptr<Rpc::TFuture<TMethodResult>> TClient::Try(const TUuid &pov_id, const
   return Write<TMethodResult>(ServerRpc::Try, pov_id, fq_name, closure);
 }
 
+shared_ptr<Rpc::TFuture<vector<TMethodResult>>> TClient::TryBatch(
+    const TUuid &pov_id, const vector<string> &fq_name, const vector<TClosure> &closures, bool atomic) {
+  assert(this);
+  return Write<vector<TMethodResult>>(ServerRpc::TryBatch, pov_id, fq_name, closures, atomic);
+}
+
 shared_ptr<Rpc::TFuture<void>> TClient::BeginImport() {
   assert(this);
   return Write<void>(ServerRpc::BeginImport);
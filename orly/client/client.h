@@ -87,6 +87,11 @@ namespace Orly {
       /* TODO */
       std::shared_ptr<Rpc::TFuture<TMethodResult>> Try(const Base::TUuid &pov_id, const std::vector<std::string> &fq_name, const TClosure &closure);
 
+      /* Like Try(), but runs many closures in one round trip and returns their results in order.  If atomic, their
+         effects commit together or not at all.  See ServerRpc::TryBatch in <orly/protocol.h>. */
+      std::shared_ptr<Rpc::TFuture<std::vector<TMethodResult>>> TryBatch(
+          const Base::TUuid &pov_id, const std::vector<std::string> &fq_name, const std::vector<TClosure> &closures, bool atomic = false);
+
       /* TODO */
       std::shared_ptr<Rpc::TFuture<void>> BeginImport();
 
@@ -0,0 +1,171 @@
+/* <orly/client/program/try_batch_bench.cc>
+
+   Measures how many method calls per second a client gets out of a server by batch size, from one call per Try
+   round trip up to a thousand per TryBatch.
+
+   Start a server with the package installed, then run something like:
+
+      try_batch_bench --package=my/pkg --method=do_it
+
+   The method is called with no arguments against a fresh private pov.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <base/cmd.h>
+#include <base/log.h>
+#include <base/split.h>
+#include <base/uuid.h>
+#include <orly/client/client.h>
+#include <orly/closure.h>
+#include <orly/protocol.h>
+#include <socket/address.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Base;
+using namespace Socket;
+using namespace Orly;
+
+namespace {
+
+  /* Command-line arguments. */
+  class TBenchCmd final
+      : public TLog::TCmd {
+    public:
+
+    /* Construct with defaults. */
+    TBenchCmd()
+        : ServerAddress(TAddress::IPv4Loopback, DefaultPortNumber), NumCalls(10000), Atomic(false) {}
+
+    /* Construct from argc/argv. */
+    TBenchCmd(int argc, char *argv[])
+        : TBenchCmd() {
+      Parse(argc, argv, TMeta());
+    }
+
+    /* The address where the Orly server can be found. */
+    TAddress ServerAddress;
+
+    /* The package to call into, with its name parts separated by slashes. */
+    string Package;
+
+    /* The method to call. */
+    string Method;
+
+    /* The number of calls to make at each batch size. */
+    size_t NumCalls;
+
+    /* If true, each batch runs in one transaction. */
+    bool Atomic;
+
+    private:
+
+    /* Our meta-type. */
+    class TMeta final
+        : public TLog::TCmd::TMeta {
+      public:
+
+      /* Registers our fields. */
+      TMeta()
+          : TLog::TCmd::TMeta("Measure Try and TryBatch calls per second.") {
+        Param(&TBenchCmd::ServerAddress, "server_address", Optional, "server_address\0sa\0", "The address where the Orly server can be found.");
+        Param(&TBenchCmd::Package, "package", Required, "package\0p\0", "The package to call into, as name/name/...");
+        Param(&TBenchCmd::Method, "method", Required, "method\0m\0", "The method to call.");
+        Param(&TBenchCmd::NumCalls, "num_calls", Optional, "num_calls\0n\0", "The number of calls to make at each batch size.");
+        Param(&TBenchCmd::Atomic, "atomic", Optional, "atomic\0", "Run each batch in one transaction.");
+      }
+
+    };  // TBenchCmd::TMeta
+
+  };  // TBenchCmd
+
+  /* A client which ignores notifications. */
+  class TBenchClient final
+      : public Client::TClient {
+    public:
+
+    /* Connect to the server with a new session. */
+    TBenchClient(const TAddress &server_address)
+        : Client::TClient(server_address, TOpt<TUuid>(), seconds(60)) {}
+
+    private:
+
+    /* Ignored. */
+    virtual void OnPovFailed(const TUuid &) override {}
+
+    /* Ignored. */
+    virtual void OnUpdateAccepted(const TUuid &, const TUuid &) override {}
+
+    /* Ignored. */
+    virtual void OnUpdateReplicated(const TUuid &, const TUuid &) override {}
+
+    /* Ignored. */
+    virtual void OnUpdateDurable(const TUuid &, const TUuid &) override {}
+
+    /* Ignored. */
+    virtual void OnUpdateSemiDurable(const TUuid &, const TUuid &) override {}
+
+  };  // TBenchClient
+
+  /* Make num_calls calls, batch_size at a time, and return the number of calls per second. */
+  double Bench(
+      TBenchClient &client, const TUuid &pov_id, const vector<string> &fq_name, const TClosure &closure,
+      size_t batch_size, size_t num_calls, bool atomic) {
+    const vector<TClosure> closures(batch_size, closure);
+    const size_t num_batches = max(num_calls / batch_size, 1UL);
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < num_batches; ++i) {
+      if (batch_size == 1) {
+        client.Try(pov_id, fq_name, closure)->Sync();
+      } else {
+        client.TryBatch(pov_id, fq_name, closures, atomic)->Sync();
+      }
+    }
+    return (num_batches * batch_size) / duration_cast<duration<double>>(steady_clock::now() - start).count();
+  }
+
+}
+
+int main(int argc, char *argv[]) {
+  int result;
+  try {
+    TBenchCmd cmd(argc, argv);
+    TLog log(cmd);
+    vector<string> fq_name;
+    Split("/", cmd.Package, fq_name);
+    const TClosure closure(cmd.Method);
+    TBenchClient client(cmd.ServerAddress);
+    const TUuid pov_id = **client.NewFastPrivatePov(TOpt<TUuid>());
+    cout << setw(10) << "batch" << setw(16) << "calls / s" << endl;
+    for (size_t batch_size: { 1UL, 10UL, 100UL, 1000UL }) {
+      cout
+          << setw(10) << batch_size << setw(16) << fixed << setprecision(0)
+          << Bench(client, pov_id, fq_name, closure, batch_size, cmd.NumCalls, cmd.Atomic) << endl;
+    }
+    result = EXIT_SUCCESS;
+  } catch (const exception &ex) {
+    cerr << "error: " << ex.what() << endl;
+    result = EXIT_FAILURE;
+  }
+  return result;
+}
@@ -28,48 +28,86 @@ using namespace Orly::Durable;
 void TManager::Clean() {
   assert(this);
   TSem sem;
-  /* extra */ {
-    lock_guard<mutex> lock(Mutex);
-    auto now = TDeadline::clock::now();
-    while (!ClosedObjs.empty()) {
-      auto iter = ClosedObjs.begin();
-      if (iter->first.first > now) {
-        break;
+  auto now = TDeadline::clock::now();
+  for (TShard &shard: Shards) {
+    auto lock = shard.Lock();
+    for (TObj *cached_obj: shard.Clock) {
+      if (cached_obj && *(cached_obj->GetDeadline()) <= now) {
+        DestroyObj(cached_obj);
       }
-      TObj *cached_obj = iter->second;
-      ClosedObjs.erase(iter);
-      DestroyObj(cached_obj);
     }
-    CleanDisk(now, &sem);
   }
+  CleanDisk(now, &sem);
   sem.Pop();
 }
 
 TManager::TManager(size_t max_cache_size)
-    : MaxCacheSize(max_cache_size) {}
+    : MaxCacheSize(max_cache_size) {
+  const size_t slots_per_shard = (max_cache_size + NumShards - 1) / NumShards;
+  for (TShard &shard: Shards) {
+    shard.Clock.resize(slots_per_shard, nullptr);
+    shard.FreeSlots.reserve(slots_per_shard);
+    for (size_t i = slots_per_shard; i; --i) {
+      shard.FreeSlots.push_back(i - 1);
+    }
+    shard.Hand = 0;
+    shard.NumHits = 0;
+    shard.NumMisses = 0;
+    shard.NumEvictions = 0;
+    shard.NumContentions = 0;
+  }
+}
 
 TManager::~TManager() {
   assert(this);
-  for (const auto &item: OpenableObjs) {
-    /* If this assertion fails, it means there is at least one ptr still alive someplace. */
-    assert(item.second->PtrCount == 0);
-    delete item.second;
+  for (TShard &shard: Shards) {
+    for (const auto &item: shard.OpenableObjs) {
+      /* If this assertion fails, it means there is at least one ptr still alive someplace. */
+      assert(item.second->PtrCount == 0);
+      delete item.second;
+    }
   }
 }
 
 void TManager::Clear() {
-  for (const auto &item: OpenableObjs) {
-    /* If this assertion fails, it means there is at least one ptr still alive someplace. */
-    assert(item.second->PtrCount == 0);
-    delete item.second;
+  for (TShard &shard: Shards) {
+    auto lock = shard.Lock();
+    for (const auto &item: shard.OpenableObjs) {
+      /* If this assertion fails, it means there is at least one ptr still alive someplace. */
+      assert(item.second->PtrCount == 0);
+      delete item.second;
+    }
+    shard.OpenableObjs.clear();
+    shard.FreeSlots.clear();
+    for (size_t i = shard.Clock.size(); i; --i) {
+      shard.Clock[i - 1] = nullptr;
+      shard.FreeSlots.push_back(i - 1);
+    }
+  }
+}
+
+void TManager::TakeCacheStats(TCacheStats &out) {
+  assert(this);
+  assert(&out);
+  out.NumHits = 0UL;
+  out.NumMisses = 0UL;
+  out.NumEvictions = 0UL;
+  out.NumContentions = 0UL;
+  for (TShard &shard: Shards) {
+    out.NumHits += shard.NumHits.exchange(0UL);
+    out.NumMisses += shard.NumMisses.exchange(0UL);
+    out.NumEvictions += shard.NumEvictions.exchange(0UL);
+    out.NumContentions += shard.NumContentions.exchange(0UL);
   }
-  OpenableObjs.clear();
 }
 
 void TManager::DestroyObj(TObj *obj) noexcept {
   assert(this);
   assert(obj);
-  size_t erased_from_openable = OpenableObjs.erase(obj->GetId());
+  if (obj->ClockSlot != NoSlot) {
+    UncacheObj(obj);
+  }
+  size_t erased_from_openable = obj->Shard->OpenableObjs.erase(obj->GetId());
   assert(erased_from_openable == 1);
   delete obj;
 }
@@ -77,22 +115,30 @@ void TManager::DestroyObj(TObj *obj) noexcept {
 bool TManager::TryCacheObj(TObj *obj) noexcept {
   assert(this);
   assert(obj);
+  assert(obj->ClockSlot == NoSlot);
+  TShard &shard = *(obj->Shard);
   bool success = false;
-  if (MaxCacheSize) {
+  if (!shard.Clock.empty()) {
     try {
       /* The object is entering the cache.  It should have no sem right now, but it will need one later. */
       assert(!(obj->Sem));
       obj->Sem = new TSem;
-      /* Discard objects from the cache until there's room for the new object.
-         Start with the object with the soonest deadline and work forward. */
-      while (ClosedObjs.size() >= MaxCacheSize) {
-        auto iter = ClosedObjs.begin();
-        TObj *cached_obj = iter->second;
-        ClosedObjs.erase(iter);
-        DestroyObj(cached_obj);
+      /* If every slot is taken, sweep the hand around until it finds an object which hasn't been opened since the hand
+         last came by.  Every object we pass loses its second chance, so this takes at most two turns of the clock. */
+      while (shard.FreeSlots.empty()) {
+        TObj *cached_obj = shard.Clock[shard.Hand];
+        shard.Hand = (shard.Hand + 1) % shard.Clock.size();
+        assert(cached_obj);
+        if (cached_obj->Referenced) {
+          cached_obj->Referenced = false;
+        } else {
+          DestroyObj(cached_obj);
+          shard.NumEvictions.fetch_add(1UL, memory_order_relaxed);
+        }
       }
-      /* Insert this object into the cache in order of its deadline. */
-      ClosedObjs.insert(make_pair(make_pair(*(obj->GetDeadline()), obj->GetId()), obj));
+      obj->ClockSlot = shard.FreeSlots.back();
+      shard.FreeSlots.pop_back();
+      shard.Clock[obj->ClockSlot] = obj;
       success = true;
     } catch (const exception &ex) {
       obj->Log(LOG_INFO, "caching", ex);
@@ -101,6 +147,34 @@ bool TManager::TryCacheObj(TObj *obj) noexcept {
   return success;
 }
 
+void TManager::UncacheObj(TObj *obj) noexcept {
+  assert(this);
+  assert(obj);
+  assert(obj->ClockSlot != NoSlot);
+  TShard &shard = *(obj->Shard);
+  assert(shard.Clock[obj->ClockSlot] == obj);
+  shard.Clock[obj->ClockSlot] = nullptr;
+  /* We reserved room for every slot up front, so this doesn't allocate. */
+  shard.FreeSlots.push_back(obj->ClockSlot);
+  obj->ClockSlot = NoSlot;
+}
+
+TBlob TManager::Serialize(const TObj *obj) {
+  assert(obj);
+  /* Most objects fit in a single chunk of this size.  Serialization never yields, so every chunk we draw from the pool
+     is back in it before we return, and the pool never crosses threads. */
+  static thread_local shared_ptr<TPool> pool = make_shared<TPool>(TPool::TArgs(4096));
+  auto blob = make_shared<string>();
+  /* extra */ {
+    auto recorder = make_shared<TRecorder>();
+    TBinaryOutputOnlyStream strm(recorder, pool);
+    obj->Write(strm);
+    strm.Flush();
+    recorder->CopyOut(*blob);
+  }
+  return blob;
+}
+
 const char *TObj::GetKind() const noexcept {
   return "<partially open>";
 }
@@ -133,13 +207,13 @@ void TObj::Write(TBinaryOutputStream &strm) const {
 }
 
 TObj::TObj(TManager *manager, const TId &id, const TTtl &ttl)
-    : Manager(manager), Id(id), PtrCount(0), OnDisk(false), Ttl(ttl) {
+    : Manager(manager), Id(id), Shard(&manager->GetShard(id)), ClockSlot(TManager::NoSlot), Referenced(false), PtrCount(0), OnDisk(false), Ttl(ttl) {
   assert(manager);
   Sem = new TSem;
 }
 
 TObj::TObj(TManager *manager, const TId &id, Io::TBinaryInputStream &strm)
-    : Manager(manager), Id(id), PtrCount(0), OnDisk(true) {
+    : Manager(manager), Id(id), Shard(&manager->GetShard(id)), ClockSlot(TManager::NoSlot), Referenced(false), PtrCount(0), OnDisk(true) {
   assert(manager);
   assert(&strm);
   Sem = new TSem;
@@ -162,7 +236,7 @@ bool TObj::ForEachDependentPtr(const function<bool (TAnyPtr &)> &) noexcept {
 
 void TObj::OnPtrAcquire() noexcept {
   assert(this);
-  lock_guard<mutex> lock(Manager->Mutex);
+  auto lock = Shard->Lock();
   PtrCount += 1;
   assert(PtrCount > 0);
 }
@@ -174,7 +248,7 @@ void TObj::OnPtrRelease() noexcept {
   TSem *sem = nullptr;
   unordered_set<TObj *> dependent_objs;
   /* extra */ {
-    lock_guard<mutex> lock(Manager->Mutex);
+    auto lock = Shard->Lock();
     --PtrCount;
     if (!PtrCount) {
       /* We're transitioning from open to closed.  We should not yet have a deadline but we should have a sem available. */
@@ -187,15 +261,7 @@ void TObj::OnPtrRelease() noexcept {
         /* We have a non-zero time-to-live, so establish a deadline and save the object. */
         Deadline = TDeadline::clock::now() + Ttl;
         try {
-          string blob;
-          /* extra */ {
-            auto recorder = make_shared<TRecorder>();
-            TBinaryOutputOnlyStream strm(recorder);
-            Write(strm);
-            strm.Flush();
-            recorder->CopyOut(blob);
-          }
-          Manager->Save(Id, *Deadline, Ttl, blob, sem);
+          Manager->Save(Id, *Deadline, Ttl, TManager::Serialize(this), sem);
           OnDisk = true;
           async = true;
         } catch (const exception &ex) {
@@ -235,7 +301,7 @@ void TObj::OnPtrRelease() noexcept {
         Manager->DestroyObj(this);
       }
     }
-  }  // end of mutex lock; after this scope closes, 'this' may be a bad pointer
+  }  // end of shard lock; after this scope closes, 'this' may be a bad pointer
   /* Release any dependents we found. */
   for (auto obj: dependent_objs) {
     obj->OnPtrRelease();
@@ -18,14 +18,17 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <exception>
 #include <functional>
-#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <base/class_traits.h>
 #include <base/event_semaphore.h>
@@ -64,6 +67,10 @@ namespace Orly {
     /* We use instances of this type when waiting for the disk to act. */
     using TSem = Base::TEventSemaphore;
 
+    /* The serialized form of an object.  It never changes once made, so the layers below the manager share it rather
+       than copy it. */
+    using TBlob = std::shared_ptr<const std::string>;
+
     /* Used to disambiguate the private constructors of TPtr<>. */
     enum TNew { New };
     enum TOld { Old };
@@ -194,6 +201,23 @@ namespace Orly {
       NO_COPY(TManager);
       public:
 
+      /* A snapshot of the counters of the cache.  See TakeCacheStats(). */
+      struct TCacheStats {
+
+        /* Opens which found the object already in memory, open or closed. */
+        size_t NumHits;
+
+        /* Opens which had to go to disk for the object. */
+        size_t NumMisses;
+
+        /* Closed objects which were destroyed to make room for another. */
+        size_t NumEvictions;
+
+        /* Shard locks which were already held by another thread when we went to take them. */
+        size_t NumContentions;
+
+      };  // TCacheStats
+
       /* Evict and destroy all objects whose deadlines have passed.
          This will affect the cache as well as the disk. */
       void Clean();
@@ -231,9 +255,13 @@ namespace Orly {
       /* TODO */
       virtual void RunLayerCleaner() = 0;
 
+      /* Sum up the cache counters across all shards and reset them. */
+      void TakeCacheStats(TCacheStats &out);
+
       protected:
 
-      /* The cache size is the maximum number of closed objects we will keep in memory. */
+      /* The cache size is the maximum number of closed objects we will keep in memory.
+         It is split evenly between the shards, rounding up. */
       TManager(size_t max_cache_size);
 
       /* Destroy all our objects on the way out. */
@@ -241,61 +269,111 @@ namespace Orly {
 
       /* Override to search the disk for an object with the given id.
          If found, return true; else, return false.
-         Assume that the mutex has already been obtained. */
+         Assume that the shard holding the id is locked.  Other shards may call concurrently, so be thread-safe. */
       virtual bool CanLoad(const TId &id) = 0;
 
       /* Override to erase from disk all objects which have a deadline <= the given time.
-         Assume that the mutex has already been obtained.
+         No shard is locked, so be thread-safe.
          When the task is complete, push the semaphore.  Do not delete the semaphore. */
       virtual void CleanDisk(const TDeadline &now, TSem *sem) = 0;
 
       /* Override to erase the given object from disk.
          If the object does not exist, there is a logic error in the program or a disk failure.
-         Assume that the mutex has already been obtained.
+         Assume that the shard holding the id is locked.  Other shards may call concurrently, so be thread-safe.
          When the task is complete, push the semaphore.  Do not delete the semaphore. */
       virtual void Delete(const TId &id, TSem *sem) = 0;
 
       /* Override to save the given object to disk.
-         Assume that the mutex has already been obtained.
+         Assume that the shard holding the id is locked.  Other shards may call concurrently, so be thread-safe.
          When the task is complete, push the semaphore.  Do not delete the semaphore. */
-      virtual void Save(const TId &id, const TDeadline &deadline, const TTtl &ttl, const std::string &blob, TSem *sem) = 0;
+      virtual void Save(const TId &id, const TDeadline &deadline, const TTtl &ttl, const TBlob &blob, TSem *sem) = 0;
 
       /* Override to search the disk for an object with the given id.
          If found, return the object's blob (via out-parameter) and return true; else, ignore the out-parameter and return false.
-         Assume that the mutex has already been obtained. */
-      virtual bool TryLoad(const TId &id, std::string &blob) = 0;
+         Assume that the shard holding the id is locked.  Other shards may call concurrently, so be thread-safe. */
+      virtual bool TryLoad(const TId &id, TBlob &blob) = 0;
 
       private:
 
-      /* Evict the given object from the set of openable objects, then destroy the object.
+      /* The number of shards over which we spread our objects.  Each shard has its own lock, so threads opening
+         different objects rarely wait on each other. */
+      static const size_t NumShards = 16;
+
+      /* A slot in the clock which isn't holding an object. */
+      static const size_t NoSlot = static_cast<size_t>(-1);
+
+      /* The objects whose ids hash to one shard, and the lock which covers them. */
+      struct TShard {
+
+        /* Take the lock, counting it if we had to wait. */
+        std::unique_lock<std::mutex> Lock() {
+          assert(this);
+          std::unique_lock<std::mutex> lock(Mutex, std::try_to_lock);
+          if (!lock.owns_lock()) {
+            NumContentions.fetch_add(1UL, std::memory_order_relaxed);
+            lock.lock();
+          }
+          return lock;
+        }
+
+        /* Covers everything in the shard, as well as TObj::PtrCount, TObj::Deadline, TObj::ClockSlot and
+           TObj::Referenced of each object in the shard. */
+        std::mutex Mutex;
+
+        /* The objects currently open as well as those which are closed but cached.
+           These are objects which can be found by the Open() function.
+           A closed object (that is, one with a PtrCount of zero) in this container also has a slot in the clock. */
+        std::unordered_map<TId, TObj *> OpenableObjs;
+
+        /* The closed objects we're keeping in memory, each in its own slot, or null for empty slots.
+           The size of this vector is fixed at construction and is the most closed objects the shard will hold. */
+        std::vector<TObj *> Clock;
+
+        /* The indices of the null slots in the clock. */
+        std::vector<size_t> FreeSlots;
+
+        /* The next slot the clock will consider when it needs to evict. */
+        size_t Hand;
+
+        /* See TCacheStats. */
+        std::atomic_size_t NumHits, NumMisses, NumEvictions, NumContentions;
+
+      };  // TShard
+
+      /* The shard in which we keep the object with the given id. */
+      TShard &GetShard(const TId &id) {
+        assert(this);
+        return Shards[std::hash<TId>()(id) % NumShards];
+      }
+
+      /* Serialize the given object into a new blob.
+         We stream through small chunks drawn from a pool kept by the calling thread, then copy them once into a blob of
+         exactly the right size. */
+      static TBlob Serialize(const TObj *obj);
+
+      /* Evict the given object from the set of openable objects and from the clock, then destroy the object.
          NOTE 1: The object pointer passed to this function WILL BE BAD by the time this function returns.
-         NOTE 2: This function assumes that the mutex has already been obtained. */
+         NOTE 2: This function assumes that the object's shard is locked. */
       void DestroyObj(TObj *obj) noexcept;
 
-      /* If we're caching, insert the given object into the set of closed objects.
-         Discard enough old objects to make room.
+      /* If we're caching, give the given object a slot in its shard's clock.
+         If the clock is full, sweep it, giving a second chance to objects which have been opened since the hand last
+         passed them and evicting the first one which hasn't.
          Return true iff. the object is successfully cached.
-         This function assumes that the mutex has already been obtained. */
+         This function assumes that the object's shard is locked. */
       bool TryCacheObj(TObj *obj) noexcept;
 
-      /* The maximum number of objects to keep in ClosedObjs. */
-      size_t MaxCacheSize;
-
-      /* Covers OpenableObj, ClosedObjs, and all instances of TObj::PtrCount. */
-      std::mutex Mutex;
+      /* Take the given closed object out of its shard's clock, because it's being opened again.
+         This function assumes that the object's shard is locked. */
+      void UncacheObj(TObj *obj) noexcept;
 
-      /* All the objects currently open as well as those which are closed but cached.
-         These are objects which can be found by the Open() function.
-         If a closed object (that is, one with a PtrCount of zero) is in this container, it will also be in ClosedObjs. */
-      std::unordered_map<TId, TObj *> OpenableObjs;
+      /* The maximum number of closed objects to keep in memory, across all shards. */
+      size_t MaxCacheSize;
 
-      /* All the objects currently closed but still cached.
-         They are in order by their deadlines, soonest deadlines first.
-         The size of this container will never exceed MaxCacheSize.
-         All of the objects in this container have a PtrCount of zero and also appear in OpenableObjs. */
-      std::map<std::pair<TDeadline, TId>, TObj *> ClosedObjs;
+      /* See TShard. */
+      TShard Shards[NumShards];
 
-      /* For do-stuff-to-obj functions and the mutex. */
+      /* For do-stuff-to-obj functions and the shards. */
       friend class TObj;
 
       /* for saving replicated durables. */
@@ -408,6 +486,15 @@ namespace Orly {
       /* See accessor. */
       TId Id;
 
+      /* The shard of our manager in which we live. */
+      TManager::TShard *Shard;
+
+      /* Our slot in the shard's clock, or NoSlot if we're open or not cached. */
+      size_t ClockSlot;
+
+      /* True iff. we've been opened since the clock's hand last passed us. */
+      bool Referenced;
+
       /* The number of pointers currently sharing this durable object.
          If this count is greater than zero, it means the durable object is open.
          If this count is zero, it means the durable object is closed but being held in cache. */
@@ -429,7 +516,7 @@ namespace Orly {
       template <typename>
       friend class TPtr;
 
-      /* For ~TObj() & Deadline. */
+      /* For ~TObj(), Deadline and the clock. */
       friend class TManager;
 
     };  // TObj
@@ -568,10 +655,11 @@ namespace Orly {
     template <typename TSomeObj, typename... TArgs>
     TPtr<TSomeObj> TManager::New(const TId &id, const TTtl &ttl, TArgs &&... args) {
       assert(this);
-      /* Lock the manager and create the requested slot among the openable objects.
+      /* Lock the id's shard and create the requested slot among its openable objects.
          If the slot already exists, throw. */
-      std::lock_guard<std::mutex> lock(Mutex);
-      auto iter = OpenableObjs.insert(std::pair<TId, TObj *>(id, nullptr)).first;
+      TShard &shard = GetShard(id);
+      auto lock = shard.Lock();
+      auto iter = shard.OpenableObjs.insert(std::pair<TId, TObj *>(id, nullptr)).first;
       TObj *&openable_obj = iter->second;
       if (openable_obj) {
         THROW_ERROR(TAlreadyExists) << "in cache" << Base::EndOfPart << "id = " << id;
@@ -587,16 +675,8 @@ namespace Orly {
         if (ttl.count() > 0) {
           /* save the object so it gets replicated if it has a non-zero ttl */ {
             TDeadline deadline = TDeadline::clock::now() + ttl;
-            std::string blob;
-            /* extra */ {
-              auto recorder = std::make_shared<Io::TRecorder>();
-              Io::TBinaryOutputOnlyStream strm(recorder);
-              some_obj->Write(strm);
-              strm.Flush();
-              recorder->CopyOut(blob);
-            }
             TSem sem;
-            Save(id, deadline, ttl, blob, &sem);
+            Save(id, deadline, ttl, Serialize(some_obj), &sem);
           }
         }
 
@@ -605,7 +685,7 @@ namespace Orly {
       } catch (...) {
         /* We already had the object on disk or the object's constructor failed.
            Either way, we need to dispose of the slot we made before continuing to handle the error. */
-        OpenableObjs.erase(iter);
+        shard.OpenableObjs.erase(iter);
         throw;
       }
     }
@@ -613,36 +693,40 @@ namespace Orly {
     template <typename TSomeObj>
     TPtr<TSomeObj> TManager::Open(const TId &id) {
       assert(this);
-      /* Lock the manager and find/create the requested slot among the openable objects. */
-      std::lock_guard<std::mutex> lock(Mutex);
-      auto iter = OpenableObjs.insert(std::pair<TId, TObj *>(id, nullptr)).first;
+      /* Lock the id's shard and find/create the requested slot among its openable objects.
+         No other shard is involved, so opens of objects in different shards don't wait on each other. */
+      TShard &shard = GetShard(id);
+      auto lock = shard.Lock();
+      auto iter = shard.OpenableObjs.insert(std::pair<TId, TObj *>(id, nullptr)).first;
       TObj *&openable_obj = iter->second;
       if (openable_obj) {
         /* We found an object with the given id. */
         TPtr<TSomeObj> ptr(openable_obj, Orly::Durable::Old);
-        const auto &deadline = openable_obj->GetDeadline();
-        if (deadline) {
-          /* The object is being re-opened from a closed state, so remove it from the set of closed objects. */
-          size_t erased_from_closed = ClosedObjs.erase(std::make_pair(*deadline, id));
-          assert(erased_from_closed == 1);
+        shard.NumHits.fetch_add(1UL, std::memory_order_relaxed);
+        openable_obj->Referenced = true;
+        if (openable_obj->GetDeadline()) {
+          /* The object is being re-opened from a closed state, so take it out of the clock. */
+          UncacheObj(openable_obj);
           openable_obj->Deadline.Reset();
         }
         return ptr;
       }
+      shard.NumMisses.fetch_add(1UL, std::memory_order_relaxed);
       try {
         /* Load the object from disk and keep it in the openable set. */
-        std::string blob;
+        TBlob blob;
         if (!TryLoad(id, blob)) {
           THROW_ERROR(TDoesntExist) << "id = " << id;
         }
-        Io::TBinaryInputOnlyStream strm(std::make_shared<Io::TPlayer>(std::make_shared<Io::TRecorder>(blob)));
+        /* The recorder refers to the blob rather than copying it, and we hold the blob until the object is built. */
+        Io::TBinaryInputOnlyStream strm(std::make_shared<Io::TPlayer>(std::make_shared<Io::TRecorder>(*blob)));
         TSomeObj *some_obj = new TSomeObj(this, id, strm);
         openable_obj = some_obj;
         return TPtr<TSomeObj>(some_obj, Orly::Durable::New);
       } catch (...) {
         /* We could not find the object on disk or the object's constructor failed.
            Either way, we need to dispose of the slot we made before continuing to handle the error. */
-        OpenableObjs.erase(iter);
+        shard.OpenableObjs.erase(iter);
         throw;
       }
     }
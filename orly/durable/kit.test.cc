@@ -191,6 +191,8 @@ FIXTURE(CleaningWithoutCache) {
   TestCleaning(false);
 }
 
+static const size_t NumIds = 100UL;
+
 static mutex Mutex;
 static condition_variable Cv;
 static bool Go = false;
@@ -248,3 +250,43 @@ FIXTURE(ThunderingHerdWithPartialCache) {
 FIXTURE(ThunderingHerdWithoutCache) {
   TestThunderingHerd(0, 5, 100, 1000);
 }
+
+FIXTURE(CacheStats) {
+  /* enough room that no shard fills up, however the ids happen to hash */
+  TTestManager manager(NumIds * NumIds);
+  vector<TId> ids;
+  for (size_t i = 0; i < NumIds; ++i) {
+    ids.push_back(manager.New<TFile>(TId::Best, TTtl(999), i)->GetId());
+  }
+  TManager::TCacheStats stats;
+  manager.TakeCacheStats(stats);
+  EXPECT_EQ(stats.NumHits, 0UL);
+  EXPECT_EQ(stats.NumMisses, 0UL);
+  /* each open is a hit, and the counters reset when taken */
+  for (size_t i = 0; i < NumIds; ++i) {
+    EXPECT_EQ(manager.Open<TFile>(ids[i])->GetVal(), static_cast<int>(i));
+  }
+  manager.TakeCacheStats(stats);
+  EXPECT_EQ(stats.NumHits, NumIds);
+  EXPECT_EQ(stats.NumMisses, 0UL);
+  EXPECT_EQ(stats.NumEvictions, 0UL);
+  manager.TakeCacheStats(stats);
+  EXPECT_EQ(stats.NumHits, 0UL);
+}
+
+FIXTURE(CacheEviction) {
+  TTestManager manager(1);
+  vector<TId> ids;
+  for (size_t i = 0; i < NumIds; ++i) {
+    ids.push_back(manager.New<TFile>(TId::Best, TTtl(999), i)->GetId());
+  }
+  /* each shard holds one closed object, so whatever got pushed out has to come back from disk intact */
+  for (size_t i = 0; i < NumIds; ++i) {
+    EXPECT_EQ(manager.Open<TFile>(ids[i])->GetVal(), static_cast<int>(i));
+  }
+  TManager::TCacheStats stats;
+  manager.TakeCacheStats(stats);
+  EXPECT_EQ(stats.NumHits + stats.NumMisses, NumIds);
+  EXPECT_TRUE(stats.NumMisses > 0UL);
+  EXPECT_TRUE(stats.NumEvictions > 0UL);
+}
@@ -0,0 +1,100 @@
+/* <orly/durable/kit.test.manual.cc>
+
+   Benchmarks concurrent opens of cached objects in <orly/durable/kit.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/durable/kit.h>
+
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <orly/durable/test_manager.h>
+#include <test/kit.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Io;
+using namespace Orly::Durable;
+
+class TSession final
+    : public TObj {
+  public:
+
+  TSession(TManager *manager, const TId &id, const TTtl &ttl)
+      : TObj(manager, id, ttl) {}
+
+  TSession(TManager *manager, const TId &id, TBinaryInputStream &strm)
+      : TObj(manager, id, strm) {}
+
+  virtual const char *GetKind() const noexcept {
+    return "session";
+  }
+
+  private:
+
+  virtual ~TSession() {}
+
+};
+
+static const size_t NumHotIds = 1000UL;
+static const size_t NumOpensPerThread = 200000UL;
+
+/* Have the given number of threads each open and close random hot objects NumOpensPerThread times.  We hold every hot
+   object open for the duration, the way a busy server holds its hot sessions, so every open is a hit and no close
+   goes to disk; what's left is the cost of finding the object and counting the pointer. */
+static void BenchOpen(size_t num_threads) {
+  TTestManager manager(NumHotIds);
+  vector<TId> ids;
+  vector<TPtr<TSession>> hot;
+  for (size_t i = 0; i < NumHotIds; ++i) {
+    hot.push_back(manager.New<TSession>(TId::Twister, TTtl(999)));
+    ids.push_back(hot.back()->GetId());
+  }
+  TManager::TCacheStats stats;
+  manager.TakeCacheStats(stats);
+  vector<thread> workers;
+  const auto start = steady_clock::now();
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers.push_back(thread([&manager, &ids, i]() {
+      mt19937_64 engine(i);
+      uniform_int_distribution<size_t> pick(0UL, ids.size() - 1UL);
+      for (size_t j = 0; j < NumOpensPerThread; ++j) {
+        manager.Open<TSession>(ids[pick(engine)]);
+      }
+    }));
+  }
+  for (auto &worker: workers) {
+    worker.join();
+  }
+  const double secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  manager.TakeCacheStats(stats);
+  const size_t num_opens = num_threads * NumOpensPerThread;
+  EXPECT_EQ(stats.NumHits, num_opens);
+  hot.clear();
+  cout << "threads = " << num_threads
+       << ", opens / s = " << static_cast<size_t>(num_opens / secs)
+       << ", hit ratio = " << (static_cast<double>(stats.NumHits) / num_opens)
+       << ", contentions / open = " << (static_cast<double>(stats.NumContentions) / num_opens) << endl;
+}
+
+FIXTURE(ConcurrentOpen) {
+  cout << endl;
+  for (size_t num_threads : { 1UL, 2UL, 4UL, 8UL, 16UL }) {
+    BenchOpen(num_threads);
+  }
+}
@@ -18,6 +18,8 @@
 
 #pragma once
 
+#include <mutex>
+
 #include <orly/durable/kit.h>
 
 namespace Orly {
@@ -38,6 +40,7 @@ namespace Orly {
       /* TODO */
       virtual bool CanLoad(const TId &id) override {
         assert(this);
+        std::lock_guard<std::mutex> lock(Mutex);
         return BlobById.find(id) != BlobById.end();
       }
 
@@ -49,7 +52,8 @@ namespace Orly {
         assert(this);
         assert(&now);
         assert(sem);
-        std::unordered_map<TId, std::pair<TDeadline, std::string>> temp;
+        std::lock_guard<std::mutex> lock(Mutex);
+        std::unordered_map<TId, std::pair<TDeadline, TBlob>> temp;
         for (const auto &item: BlobById) {
           if (item.second.first > now) {
             temp.insert(item);
@@ -63,23 +67,26 @@ namespace Orly {
       virtual void Delete(const TId &id, TSem *sem) override {
         assert(this);
         assert(sem);
+        std::lock_guard<std::mutex> lock(Mutex);
         auto erased_count = BlobById.erase(id);
         assert(erased_count == 1);
         sem->Push();
       }
 
       /* TODO */
-      virtual void Save(const TId &id, const TDeadline &deadline, const TTtl &/*ttl*/, const std::string &blob, TSem *sem) override {
+      virtual void Save(const TId &id, const TDeadline &deadline, const TTtl &/*ttl*/, const TBlob &blob, TSem *sem) override {
         assert(this);
         assert(sem);
+        std::lock_guard<std::mutex> lock(Mutex);
         BlobById[id] = std::make_pair(deadline, blob);
         sem->Push();
       }
 
       /* TODO */
-      virtual bool TryLoad(const TId &id, std::string &blob) override {
+      virtual bool TryLoad(const TId &id, TBlob &blob) override {
         assert(this);
         assert(&blob);
+        std::lock_guard<std::mutex> lock(Mutex);
         auto iter = BlobById.find(id);
         bool success = (iter != BlobById.end());
         if (success) {
@@ -90,8 +97,11 @@ namespace Orly {
 
       private:
 
+      /* Covers BlobById.  Objects in different shards of the cache reach us concurrently. */
+      std::mutex Mutex;
+
       /* TODO */
-      std::unordered_map<TId, std::pair<TDeadline, std::string>> BlobById;
+      std::unordered_map<TId, std::pair<TDeadline, TBlob>> BlobById;
 
     };  //TTestManager
 
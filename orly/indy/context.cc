@@ -28,7 +28,7 @@ using namespace Orly::Indy;
 auto KeyCursorCollector = Fiber::MakeFiberLocal<TContext::TKeyCursorCollector>();
 
 TContext::TContext(const Indy::L0::TManager::TPtr<TRepo> &private_repo, Atom::TCore::TExtensibleArena *arena)
-    : TContextBase(arena), WalkerCount(0UL) {
+    : TContextBase(arena), WalkerCount(0UL), ProbeCount(0UL) {
   assert(KeyCursorCollector->KeyCursorCollection.IsEmpty());
   Indy::L0::TManager::TPtr<L0::TManager::TRepo> cur_repo = private_repo;
   RepoTree.push_back(make_pair(private_repo, make_unique<TRepo::TView>(private_repo)));
@@ -38,6 +38,16 @@ TContext::TContext(const Indy::L0::TManager::TPtr<TRepo> &private_repo, Atom::TC
   }
 }
 
+TContext::TContext(const TContext &that, Atom::TCore::TExtensibleArena *arena)
+    : TContextBase(arena), WalkerCount(0UL), ProbeCount(0UL) {
+  assert(&that);
+  assert(KeyCursorCollector->KeyCursorCollection.IsEmpty());
+  RepoTree.reserve(that.RepoTree.size());
+  for (const auto &iter : that.RepoTree) {
+    RepoTree.push_back(make_pair(iter.first, make_unique<TRepo::TView>(iter.second.get())));
+  }
+}
+
 TContext::~TContext() {
   assert(KeyCursorCollector->KeyCursorCollection.IsEmpty());
 }
@@ -54,13 +64,12 @@ Indy::TKey TContext::operator[](const Indy::TIndexKey &index_key) {
       return Indy::TKey(cur_item.Op, cur_item.OpArena);
     }
   }
-  /* no dice. we're going to have to make a new walker. This suggests someone is reading an explicit
+  /* no dice. we're going to have to look it up. This suggests someone is reading an explicit
      key (as opposed to one generated by the "keys" expression), or we've manipulated / collected keys
      to the point where the cursor has advanced past what we're trying to read. */
-  ++WalkerCount;
-  TPresentWalker walker(this, RepoTree, index_key);
-  if (walker) {
-    const Indy::TPresentWalker::TItem &item = *walker;
+  Indy::TPresentWalker::TItem item;
+  unique_ptr<Indy::TPresentWalker> walker;
+  if (FindNewest(index_key, item, walker)) {
     return Indy::TKey(Atom::TCore(GetArena(), alloca(Sabot::State::GetMaxStateSize()), item.OpArena, item.Op), GetArena());
   }
   /* We return an empty var here because in the case of an optional type being returned, the result is "empty" not a throw.
@@ -69,9 +78,70 @@ Indy::TKey TContext::operator[](const Indy::TIndexKey &index_key) {
 }
 
 bool TContext::Exists(const Indy::TIndexKey &key) {
-  ++WalkerCount;
-  TPresentWalker walker(this, RepoTree, key);
-  return static_cast<bool>(walker);
+  Indy::TPresentWalker::TItem item;
+  unique_ptr<Indy::TPresentWalker> walker;
+  return FindNewest(key, item, walker);
+}
+
+bool TContext::FindNewest(const Indy::TIndexKey &key,
+                          Indy::TPresentWalker::TItem &out_item,
+                          unique_ptr<Indy::TPresentWalker> &out_walker) {
+  assert(this);
+  /* Like the merge in TPresentWalker, the version with the highest sequence number wins, so each repo gets probed.
+     Within a repo, FindNewest() stops as soon as no older layer could do better. */
+  bool found = false;
+  PresentWalkConsTimer.Start();
+  for (const auto &iter : RepoTree) {
+    Indy::TPresentWalker::TItem item;
+    unique_ptr<Indy::TPresentWalker> walker;
+    if (iter.first->FindNewest(iter.second, key, item, walker, ProbeCount) &&
+        (!found || item.SequenceNumber > out_item.SequenceNumber)) {
+      found = true;
+      out_item = item;
+      out_walker = move(walker);
+    }
+  }
+  PresentWalkConsTimer.Stop();
+  return found && !out_item.Op.IsTombstone();
+}
+
+TContext::TSnapshot TContext::GetSnapshot() const {
+  assert(this);
+  TSnapshot snapshot;
+  for (const auto &iter : RepoTree) {
+    snapshot.emplace(iter.first->GetId(), iter.second->GetNextId());
+  }
+  return snapshot;
+}
+
+bool TContext::ForEachKeyWrittenSince(const TSnapshot &snapshot, const function<bool (const Indy::TIndexKey &)> &cb) const {
+  assert(this);
+  assert(cb);
+  vector<TSequenceNumber> froms;
+  froms.reserve(RepoTree.size());
+  for (const auto &iter : RepoTree) {
+    auto pos = snapshot.find(iter.first->GetId());
+    if (pos == snapshot.end()) {
+      return false;
+    }
+    froms.push_back(pos->second);
+  }
+  auto from = froms.begin();
+  for (const auto &iter : RepoTree) {
+    const auto &view = iter.second;
+    /* most of the time nothing has been written since, so don't bother building a walker */
+    if (view->GetUpper() && *view->GetUpper() >= *from) {
+      for (auto walker = iter.first->NewUpdateWalker(view, *from, view->GetUpper()); *walker; ++*walker) {
+        for (const auto &entry : (**walker).EntryVec) {
+          if (!cb(entry.first)) {
+            return true;
+          }
+        }
+      }
+    }
+    ++from;
+  }
+  return true;
 }
 
 TContext::TPresentWalker::TPresentWalker(TContext *ctx, const TRepoTree &repo_tree, const TIndexKey &key)
@@ -222,4 +292,73 @@ void TContext::TKeyCursor::Refresh() const {
       Valid = false;
     }
   }
-}
\ No newline at end of file
+}
+
+Indy::TKey TIndyContext::TReadMemo::operator[](const Indy::TIndexKey &key) {
+  assert(this);
+  auto iter = ValueByKey.find(key);
+  if (iter != ValueByKey.end()) {
+    ++HitCount;
+    if (!iter->second.GetArena()) {
+      ++AbsentHitCount;
+    }
+    return iter->second;
+  }
+  ++MissCount;
+  Indy::TKey val = DataContext[key];
+  /* a value read off one of the context's key cursors lives in the cursor's walker, so keep a copy of our own */
+  if (val.GetArena() && val.GetArena() != Arena) {
+    val = Indy::TKey(Arena, alloca(Sabot::State::GetMaxStateSize()), val);
+  }
+  Present.erase(key);
+  ValueByKey.emplace(Keep(key), val);
+  return val;
+}
+
+bool TIndyContext::TReadMemo::Exists(const Indy::TIndexKey &key) {
+  assert(this);
+  auto iter = ValueByKey.find(key);
+  if (iter != ValueByKey.end()) {
+    ++HitCount;
+    if (!iter->second.GetArena()) {
+      ++AbsentHitCount;
+      return false;
+    }
+    return true;
+  }
+  if (Present.count(key)) {
+    ++HitCount;
+    return true;
+  }
+  ++MissCount;
+  if (DataContext.Exists(key)) {
+    Present.insert(Keep(key));
+    return true;
+  }
+  ValueByKey.emplace(Keep(key), Indy::TKey(Atom::TCore(), nullptr));
+  return false;
+}
+
+void TIndyContext::ForEachRead(
+    const function<void (const Indy::TIndexKey &)> &on_key,
+    const function<void (const Indy::TIndexKey &)> &on_pattern,
+    const function<void (const Indy::TIndexKey &, const Indy::TIndexKey &)> &on_range) const {
+  assert(this);
+  for (const auto &item : Memo.ValueByKey) {
+    on_key(item.first);
+  }
+  for (const auto &key : Memo.Present) {
+    on_key(key);
+  }
+  for (const auto &pattern : ReadPatterns) {
+    on_pattern(pattern);
+  }
+  for (const auto &range : ReadRanges) {
+    on_range(range.first, range.second);
+  }
+}
+
+Indy::TIndexKey TIndyContext::TReadMemo::Keep(const Indy::TIndexKey &key) const {
+  assert(this);
+  return Indy::TIndexKey(key.GetIndexId(), Indy::TKey(Arena, alloca(Sabot::State::GetMaxStateSize()), key.GetKey()));
+}
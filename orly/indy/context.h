@@ -18,6 +18,9 @@
 
 #pragma once
 
+#include <functional>
+#include <map>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <base/chrono.h>
@@ -167,6 +170,10 @@ namespace Orly {
       /* TODO */
       TContext(const Indy::L0::TManager::TPtr<TRepo> &private_repo, Atom::TCore::TExtensibleArena *arena);
 
+      /* A context over the same repos which sees exactly what the given one does, but has its own arena and counts.
+         Contexts aren't safe to share between fibers; this is how several fibers read the same snapshot. */
+      TContext(const TContext &that, Atom::TCore::TExtensibleArena *arena);
+
       /* TODO */
       virtual ~TContext();
 
@@ -176,18 +183,37 @@ namespace Orly {
       /* TODO */
       virtual bool Exists(const Indy::TIndexKey &key) override;
 
-      /* TODO */
+      /* The number of walkers merged over the whole repo tree, one per key cursor.  Point lookups don't build these;
+         see GetProbeCount(). */
       inline size_t GetWalkerCount() const {
         assert(this);
         return WalkerCount;
       }
 
+      /* The number of data layers probed by point lookups (operator[] and Exists()). */
+      inline size_t GetProbeCount() const {
+        assert(this);
+        return ProbeCount;
+      }
+
       /* TODO */
       const Base::TTimer &GetPresentWalkConsTimer() const {
         assert(this);
         return PresentWalkConsTimer;
       }
 
+      /* For each repo in the tree, by repo id, the sequence number its next update was going to get when we took our
+         view of it.  Anything a repo holds at or past that number was written after we took our views. */
+      using TSnapshot = std::map<Base::TUuid, TSequenceNumber>;
+
+      /* See TSnapshot. */
+      TSnapshot GetSnapshot() const;
+
+      /* Call back with the key of each entry of each update we can see which is newer than the given snapshot, stopping
+         early if the callback returns false.  Returns false, without calling back, if the snapshot is missing any repo
+         in our tree, since then we can't tell what's newer. */
+      bool ForEachKeyWrittenSince(const TSnapshot &snapshot, const std::function<bool (const Indy::TIndexKey &)> &cb) const;
+
       /* TODO */
       struct TKeyCursorCollector {
         NO_COPY(TKeyCursorCollector);
@@ -202,12 +228,21 @@ namespace Orly {
 
       private:
 
+      /* Find the newest version of the given key anywhere in the repo tree.  Returns true iff. there is one and it isn't
+         a tombstone.  The walker left in out_walker owns the version's memory. */
+      bool FindNewest(const Indy::TIndexKey &key,
+                      Indy::TPresentWalker::TItem &out_item,
+                      std::unique_ptr<Indy::TPresentWalker> &out_walker);
+
       /* TODO */
       TRepoTree RepoTree;
 
       /* TODO */
       size_t WalkerCount;
 
+      /* See GetProbeCount(). */
+      size_t ProbeCount;
+
       /* TODO */
       Base::TTimer PresentWalkConsTimer;
 
@@ -231,16 +266,16 @@ namespace Orly {
           Base::TScheduler *scheduler,
           Rt::TOpt<Base::Chrono::TTimePnt> now,
           Rt::TOpt<uint32_t> seed)
-          : Orly::Package::TContext(user_id, session_id, arena, scheduler, now, seed), DataContext(context) {}
+          : Orly::Package::TContext(user_id, session_id, arena, scheduler, now, seed), DataContext(context), Memo(context) {}
 
-      /* TODO */
+      /* Reads come through the memo, which passes anything it hasn't seen on to the data context. */
       virtual Orly::TContextBase &GetFlux() override{
-        return DataContext;
+        return Memo;
       }
 
       /* TODO */
       virtual TKeyCursor *NewKeyCursor(TContextBase *context, const Indy::TIndexKey &pattern) const override {
-        auto data_context = dynamic_cast<Indy::TContext *>(context);
+        auto data_context = GetDataContext(context);
 
         /*
         void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
@@ -248,12 +283,13 @@ namespace Orly {
         pattern.GetState(state_alloc)->Accept(Sabot::TStateDumper(std::cout));
         std::cout << ")" << std::endl;
         */
+        ReadPatterns.push_back(Memo.Keep(pattern));
         return new Indy::TContext::TKeyCursor(data_context, pattern);
       }
 
       /* TODO */
       virtual TKeyCursor *NewKeyCursor(TContextBase *context, const Indy::TIndexKey &from, const Indy::TIndexKey &to) const override {
-        auto data_context = dynamic_cast<Indy::TContext *>(context);
+        auto data_context = GetDataContext(context);
 
         /*
         void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
@@ -261,14 +297,102 @@ namespace Orly {
         pattern.GetState(state_alloc)->Accept(Sabot::TStateDumper(std::cout));
         std::cout << ")" << std::endl;
         */
+        ReadRanges.emplace_back(Memo.Keep(from), Memo.Keep(to));
         return new Indy::TContext::TKeyCursor(data_context, from, to);
       }
 
+      /* The number of reads (operator[] or Exists()) answered from the memo without going to the data context. */
+      inline size_t GetMemoHitCount() const {
+        assert(this);
+        return Memo.HitCount;
+      }
+
+      /* The number of those hits which were for keys we already knew weren't there. */
+      inline size_t GetMemoAbsentHitCount() const {
+        assert(this);
+        return Memo.AbsentHitCount;
+      }
+
+      /* The number of reads (operator[] or Exists()) the memo couldn't answer, and so passed on to the data context. */
+      inline size_t GetMemoMissCount() const {
+        assert(this);
+        return Memo.MissCount;
+      }
+
+      /* The number of distinct keys, patterns and ranges the evaluation has read so far. */
+      size_t GetReadCount() const {
+        assert(this);
+        return Memo.ValueByKey.size() + Memo.Present.size() + ReadPatterns.size() + ReadRanges.size();
+      }
+
+      /* Call back with each key the evaluation read (whether or not it was there), each pattern it walked with a key
+         cursor, and the ends of each range it walked. */
+      void ForEachRead(
+          const std::function<void (const Indy::TIndexKey &)> &on_key,
+          const std::function<void (const Indy::TIndexKey &)> &on_pattern,
+          const std::function<void (const Indy::TIndexKey &, const Indy::TIndexKey &)> &on_range) const;
+
       private:
 
+      /* Remembers what each key read during the evaluation resolved to, including keys which turned out not to be
+         there, so reading the same key again doesn't go back down through every layer.
+
+         The data context reads from views it took when it was constructed, and the evaluation's own effects are held
+         aside in the package context until the method returns, so nothing the evaluation does can change what a key
+         reads as.  That makes the memo good for as long as the evaluation; it's thrown away with it. */
+      class TReadMemo
+          : public TContextBase {
+        NO_COPY(TReadMemo);
+        public:
+
+        /* Reads through to the given context and remembers the results in its arena. */
+        TReadMemo(Indy::TContext &context)
+            : TContextBase(context.GetArena()), DataContext(context), HitCount(0UL), AbsentHitCount(0UL), MissCount(0UL) {}
+
+        /* See TContextBase. */
+        virtual Indy::TKey operator[](const Indy::TIndexKey &key) override;
+
+        /* See TContextBase. */
+        virtual bool Exists(const Indy::TIndexKey &key) override;
+
+        private:
+
+        /* Copy the key into our arena, so it can outlive the caller's. */
+        Indy::TIndexKey Keep(const Indy::TIndexKey &key) const;
+
+        /* The context we read through to. */
+        Indy::TContext &DataContext;
+
+        /* The keys we've read, each mapped to its value, or to an empty key (null arena) if it wasn't there. */
+        std::unordered_map<Indy::TIndexKey, Indy::TKey> ValueByKey;
+
+        /* Keys Exists() found to be there but which haven't been read yet. */
+        std::unordered_set<Indy::TIndexKey> Present;
+
+        /* See TIndyContext::GetMemoHitCount(), GetMemoAbsentHitCount() and GetMemoMissCount(). */
+        size_t HitCount, AbsentHitCount, MissCount;
+
+        /* For the counters. */
+        friend class TIndyContext;
+
+      };  // TReadMemo
+
+      /* The data context behind the given flux context, which is either our memo or the data context itself. */
+      Indy::TContext *GetDataContext(TContextBase *context) const {
+        assert(this);
+        return (context == &Memo) ? &DataContext : dynamic_cast<Indy::TContext *>(context);
+      }
+
       /* TODO */
       Indy::TContext &DataContext;
 
+      /* See TReadMemo. */
+      TReadMemo Memo;
+
+      /* The patterns and ranges handed to NewKeyCursor(), copied into the memo's arena.  See ForEachRead(). */
+      mutable std::vector<Indy::TIndexKey> ReadPatterns;
+      mutable std::vector<std::pair<Indy::TIndexKey, Indy::TIndexKey>> ReadRanges;
+
     };  // TIndyContext
 
     /********************
@@ -68,6 +68,8 @@ Base::TSigmaCalc Orly::Server::TSession::TServer::TryWriteCallTimerCalc;
 Base::TSigmaCalc Orly::Server::TSession::TServer::TryWalkerConsTimerCalc;
 Base::TSigmaCalc Orly::Server::TSession::TServer::TryFetchCountCalc;
 Base::TSigmaCalc Orly::Server::TSession::TServer::TryHashHitCountCalc;
+Base::TSigmaCalc Orly::Server::TSession::TServer::TryMemoHitCountCalc;
+Base::TSigmaCalc Orly::Server::TSession::TServer::TryMemoMissCountCalc;
 Base::TSigmaCalc Orly::Server::TSession::TServer::TryWriteSyncHitCalc;
 Base::TSigmaCalc Orly::Server::TSession::TServer::TryWriteSyncTimeCalc;
 Base::TSigmaCalc Orly::Server::TSession::TServer::TryReadSyncHitCalc;
@@ -0,0 +1,110 @@
+/* <orly/indy/disk/arena_chunk.cc>
+
+   Implements <orly/indy/disk/arena_chunk.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/arena_chunk.h>
+
+using namespace std;
+using namespace Orly::Indy::Disk;
+
+constexpr size_t TArenaChunkCache::DefaultMaxBytes;
+
+constexpr size_t TArenaChunkCache::NumShards;
+
+TArenaChunkCache TArenaChunkCache::Cache;
+
+size_t TArenaChunkCache::NewArenaId() {
+  static atomic<size_t> next_arena_id(0UL);
+  return next_arena_id.fetch_add(1UL, memory_order_relaxed);
+}
+
+TArenaChunkCache::TArenaChunkCache(size_t max_bytes)
+    : MaxBytes(max_bytes) {}
+
+TArenaChunkCache::~TArenaChunkCache() {
+  assert(this);
+  for (auto &shard : Shards) {
+    shard.Trim(0UL);
+  }
+}
+
+size_t TArenaChunkCache::GetNumBytes() const {
+  assert(this);
+  size_t num_bytes = 0UL;
+  for (auto &shard : Shards) {
+    lock_guard<mutex> lock(shard.Mutex);
+    num_bytes += shard.NumBytes;
+  }
+  return num_bytes;
+}
+
+void TArenaChunkCache::SetMaxBytes(size_t max_bytes) {
+  assert(this);
+  MaxBytes = max_bytes;
+  for (auto &shard : Shards) {
+    lock_guard<mutex> lock(shard.Mutex);
+    shard.Trim(max_bytes / NumShards);
+  }
+}
+
+const TArenaChunkCache::TChunk *TArenaChunkCache::TryGet(size_t arena_id, size_t chunk) {
+  assert(this);
+  const TKey key(arena_id, chunk);
+  TShard &shard = GetShard(key);
+  lock_guard<mutex> lock(shard.Mutex);
+  auto pos = shard.ChunkByKey.find(key);
+  if (pos == shard.ChunkByKey.end()) {
+    return nullptr;
+  }
+  shard.LruList.splice(shard.LruList.begin(), shard.LruList, pos->second);
+  const TChunk *data = pos->second->second;
+  data->Pin();
+  return data;
+}
+
+void TArenaChunkCache::Keep(size_t arena_id, size_t chunk, const TChunk *data) {
+  assert(this);
+  assert(data);
+  const TKey key(arena_id, chunk);
+  TShard &shard = GetShard(key);
+  const size_t max_shard_bytes = MaxBytes / NumShards;
+  /* a chunk bigger than our share of the budget would only push everything else out on its way through */
+  if (data->GetSize() > max_shard_bytes) {
+    return;
+  }
+  lock_guard<mutex> lock(shard.Mutex);
+  if (shard.ChunkByKey.find(key) != shard.ChunkByKey.end()) {
+    return;
+  }
+  shard.Trim(max_shard_bytes - data->GetSize());
+  data->Pin();
+  shard.LruList.emplace_front(key, data);
+  shard.ChunkByKey.emplace(key, shard.LruList.begin());
+  shard.NumBytes += data->GetSize();
+}
+
+void TArenaChunkCache::TShard::Trim(size_t max_bytes) {
+  assert(this);
+  while (NumBytes > max_bytes) {
+    assert(!LruList.empty());
+    const TChunk *data = LruList.back().second;
+    ChunkByKey.erase(LruList.back().first);
+    LruList.pop_back();
+    NumBytes -= data->GetSize();
+    data->Unpin();
+  }
+}
@@ -0,0 +1,378 @@
+/* <orly/indy/disk/arena_chunk.h>
+
+   Compressed data file arenas.
+
+   When a data file is written with a codec other than none, each of its arenas is cut into chunks of (at most)
+   ArenaChunkSize raw bytes and each chunk is compressed on its own.  A chunk which doesn't get smaller is stored as it
+   is.  The chunks are followed by a chunk table, which holds a (raw offset, disk offset) pair for the start of each
+   chunk and a closing pair for the end of the last one.  Both offsets are relative to the start of the arena.  A chunk is
+   stored raw exactly when its disk size equals its raw size.
+
+   Notes are still addressed by their offset in the raw arena, so nothing which refers to a note changes.  Readers find
+   the chunk holding a note by searching the table, which the file keeps in memory.  Recently decompressed chunks are kept
+   in a cache shared by every arena in the process (see TArenaChunkCache).
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <cassert>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <base/class_traits.h>
+#include <orly/indy/disk/out_stream.h>
+#include <orly/indy/disk/util/codec.h>
+#include <orly/indy/disk/util/engine.h>
+
+namespace Orly {
+
+  namespace Indy {
+
+    namespace Disk {
+
+      /* The most raw bytes we put in one chunk.  Only writers care; readers go by the chunk table. */
+      static constexpr size_t ArenaChunkSize = 16384UL;
+
+      /* (raw offset, disk offset) of the start of each chunk, closed by the end of the last one. */
+      typedef std::vector<std::pair<size_t, size_t>> TArenaChunkVec;
+
+      /* The most recently used decompressed chunks of every compressed arena in the process, up to a budget in bytes.
+         The chunks are spread over shards by (arena, chunk number), each with its own lock and an equal share of the
+         budget, so readers of different chunks seldom contend.  Thread safe. */
+      class TArenaChunkCache {
+        NO_COPY(TArenaChunkCache);
+        public:
+
+        /* A decompressed chunk.  It counts its own references, so a reader can pin one with a bare pointer (such as
+           the void * a note is acquired with) and no allocation. */
+        class TChunk {
+          NO_COPY(TChunk);
+          public:
+
+          /* A chunk holding the given bytes, with one reference, which belongs to the caller. */
+          static const TChunk *New(std::string &&data) {
+            return new TChunk(std::move(data));
+          }
+
+          /* The raw bytes of the chunk. */
+          const char *GetData() const {
+            assert(this);
+            return Data.data();
+          }
+
+          /* The number of raw bytes in the chunk. */
+          size_t GetSize() const {
+            assert(this);
+            return Data.size();
+          }
+
+          /* Take another reference. */
+          void Pin() const {
+            assert(this);
+            RefCount.fetch_add(1UL, std::memory_order_relaxed);
+          }
+
+          /* Give up a reference, deleting the chunk if it was the last one. */
+          void Unpin() const {
+            assert(this);
+            if (RefCount.fetch_sub(1UL, std::memory_order_acq_rel) == 1UL) {
+              delete this;
+            }
+          }
+
+          private:
+
+          /* See New(). */
+          TChunk(std::string &&data)
+              : RefCount(1UL), Data(std::move(data)) {}
+
+          /* Only Unpin() gets rid of us. */
+          ~TChunk() {}
+
+          /* The number of references to us. */
+          mutable std::atomic<size_t> RefCount;
+
+          /* See accessors. */
+          const std::string Data;
+
+        };  // TChunk
+
+        /* The budget of the cache everyone uses, until the server sets it. */
+        static constexpr size_t DefaultMaxBytes = 64UL * 1024UL * 1024UL;
+
+        /* The number of shards we split the chunks over. */
+        static constexpr size_t NumShards = 16UL;
+
+        /* The cache every arena reader uses. */
+        static TArenaChunkCache Cache;
+
+        /* A number no arena in this process has had before, to key its chunks with.  A file gets a new one each time
+           it's opened, so chunks of a file which has gone away just age out. */
+        static size_t NewArenaId();
+
+        /* Start out empty. */
+        TArenaChunkCache(size_t max_bytes = DefaultMaxBytes);
+
+        /* Let go of the chunks we hold.  Readers keep the ones they've pinned. */
+        ~TArenaChunkCache();
+
+        /* The most bytes of chunks we keep. */
+        size_t GetMaxBytes() const {
+          assert(this);
+          return MaxBytes;
+        }
+
+        /* The number of bytes of chunks we're keeping now. */
+        size_t GetNumBytes() const;
+
+        /* Change the budget, evicting chunks as needed to get under it. */
+        void SetMaxBytes(size_t max_bytes);
+
+        /* The given chunk of the given arena, pinned for the caller, or null if we don't have it. */
+        const TChunk *TryGet(size_t arena_id, size_t chunk);
+
+        /* Keep the given chunk, evicting the least recently used chunks of its shard until it's back within its share
+           of the budget.  If two readers race to load the same chunk, the first one to get here wins.  Either way, the
+           caller's reference stays the caller's. */
+        void Keep(size_t arena_id, size_t chunk, const TChunk *data);
+
+        private:
+
+        /* (arena id, chunk number). */
+        typedef std::pair<size_t, size_t> TKey;
+
+        /* Hashes a TKey. */
+        struct THash {
+          size_t operator()(const TKey &key) const {
+            return std::hash<size_t>()(key.first * 0x9E3779B97F4A7C15UL ^ key.second);
+          }
+        };
+
+        /* (key, chunk), most recently used first. */
+        typedef std::list<std::pair<TKey, const TChunk *>> TLruList;
+
+        /* A slice of the cache with a lock of its own. */
+        struct TShard {
+
+          /* Drop least recently used chunks until we hold no more than the given number of bytes.  Call with Mutex held. */
+          void Trim(size_t max_bytes);
+
+          /* Covers the members below. */
+          mutable std::mutex Mutex;
+
+          /* See TLruList. */
+          TLruList LruList;
+
+          /* Our position in LruList, by key. */
+          std::unordered_map<TKey, TLruList::iterator, THash> ChunkByKey;
+
+          /* The total size of the chunks in LruList. */
+          size_t NumBytes = 0UL;
+
+        };  // TShard
+
+        /* The shard the given chunk goes in.  Neighbouring chunks of an arena go in different shards. */
+        TShard &GetShard(const TKey &key) {
+          assert(this);
+          return Shards[(key.first + key.second) % NumShards];
+        }
+
+        /* See accessor. */
+        std::atomic<size_t> MaxBytes;
+
+        /* See TShard. */
+        TShard Shards[NumShards];
+
+      };  // TArenaChunkCache
+
+      /* An out stream which compresses the notes written to it in chunks.  Notes must be written with
+         Write(const void *, size_t); the typed writes bypass the chunking.  With the none codec, this is just the stream
+         it derives from. */
+      template <size_t PageSize, size_t BlockSize, size_t PhysicalBlockSize, Util::TBufKind BufKind>
+      class TArenaOutStream
+          : public TOutStream<PageSize, BlockSize, PhysicalBlockSize, BufKind> {
+        NO_COPY(TArenaOutStream);
+        public:
+
+        /* Our base. */
+        typedef TOutStream<PageSize, BlockSize, PhysicalBlockSize, BufKind> TSuper;
+
+        /* See TOutStream.  The arena starts at the given byte offset. */
+        TArenaOutStream(const Base::TCodeLocation &code_location /* DEBUG */,
+                        uint8_t util_src,
+                        Util::TVolumeManager *vol_man,
+                        size_t byte_offset,
+                        Indy::Util::TBlockVec &block_vec,
+                        std::unordered_map<size_t, std::shared_ptr<const TBufBlock>> &block_collision_map,
+                        TCompletionTrigger &completion_trigger,
+                        DiskPriority priority,
+                        bool do_cache,
+                        #ifndef NDEBUG
+                        std::unordered_set<size_t> &written_to_set,
+                        #endif
+                        const Util::TCodec *codec)
+            : TSuper(code_location,
+                     util_src,
+                     vol_man,
+                     byte_offset,
+                     block_vec,
+                     block_collision_map,
+                     completion_trigger,
+                     priority,
+                     do_cache
+                     #ifndef NDEBUG
+                     ,written_to_set
+                     #endif
+                     ),
+              Codec(codec),
+              ArenaByteOffset(byte_offset),
+              BlockVec(block_vec) {
+          assert(codec);
+          if (IsCompressed()) {
+            ChunkVec.emplace_back(0UL, 0UL);
+            Raw.reserve(ArenaChunkSize);
+          }
+        }
+
+        using TSuper::Write;
+
+        /* Buffer the bytes, writing out each chunk as it fills. */
+        virtual void Write(const void *buf, size_t len) override {
+          assert(this);
+          if (!IsCompressed()) {
+            TSuper::Write(buf, len);
+            return;
+          }
+          const char *ptr = reinterpret_cast<const char *>(buf);
+          while (len) {
+            const size_t do_now = std::min(ArenaChunkSize - Raw.size(), len);
+            Raw.append(ptr, do_now);
+            ptr += do_now;
+            len -= do_now;
+            if (Raw.size() == ArenaChunkSize) {
+              CloseChunk();
+            }
+          }
+        }
+
+        /* Compress and write out whatever is buffered as a chunk of its own, so everything written so far can be read
+           back once the stream is synced. */
+        void CloseChunk() {
+          assert(this);
+          if (Raw.empty()) {
+            return;
+          }
+          Compressed.resize(Codec->GetMaxCompressedSize(Raw.size()));
+          size_t disk_size = Codec->Compress(Raw.data(), Raw.size(), &Compressed[0]);
+          const char *out = Compressed.data();
+          if (disk_size >= Raw.size()) {
+            disk_size = Raw.size();
+            out = Raw.data();
+          }
+          TSuper::Write(out, disk_size);
+          ChunkVec.emplace_back(ChunkVec.back().first + Raw.size(), ChunkVec.back().second + disk_size);
+          Raw.clear();
+        }
+
+        /* Close the last chunk and write out the chunk table, reserving more blocks for it if need be.  Returns the
+           table's byte offset in the file; 0 if we aren't compressing. */
+        size_t Finish(Util::TEngine *engine, Util::TVolume::TDesc::TStorageSpeed storage_speed) {
+          assert(this);
+          assert(engine);
+          if (!IsCompressed()) {
+            return 0UL;
+          }
+          CloseChunk();
+          const size_t chunk_table_offset = this->GetOffset();
+          const size_t end_of_table = chunk_table_offset + (ChunkVec.size() * sizeof(size_t) * 2UL);
+          const size_t blocks_required = ((end_of_table - 1UL) / BlockSize) + 1UL;
+          if (blocks_required > BlockVec.Size()) {
+            engine->AppendReserveBlocks(storage_speed, blocks_required - BlockVec.Size(), BlockVec);
+          }
+          /* The typed writes fall back on our Write() when they straddle a page, so write the table as raw bytes. */
+          for (const auto &chunk : ChunkVec) {
+            const size_t entry[2] = { chunk.first, chunk.second };
+            TSuper::Write(entry, sizeof(entry));
+          }
+          return chunk_table_offset;
+        }
+
+        /* The codec we compress with. */
+        const Util::TCodec *GetCodec() const {
+          assert(this);
+          return Codec;
+        }
+
+        /* The chunks we've written out so far, closed by the end of the last one.  Empty if we aren't compressing. */
+        const TArenaChunkVec &GetChunkVec() const {
+          assert(this);
+          return ChunkVec;
+        }
+
+        /* The number of chunks we've written out so far. */
+        size_t GetNumChunks() const {
+          assert(this);
+          return ChunkVec.empty() ? 0UL : ChunkVec.size() - 1UL;
+        }
+
+        /* The number of bytes the arena takes on disk so far, not counting the chunk table. */
+        size_t GetNumDiskBytes() const {
+          assert(this);
+          return IsCompressed() ? ChunkVec.back().second : this->GetOffset() - ArenaByteOffset;
+        }
+
+        private:
+
+        /* True unless we're using the none codec. */
+        bool IsCompressed() const {
+          assert(this);
+          return Codec->GetKind() != Util::TCodecKind::None;
+        }
+
+        /* See accessor. */
+        const Util::TCodec *Codec;
+
+        /* Where the arena starts in the file. */
+        size_t ArenaByteOffset;
+
+        /* The blocks of the file we're writing. */
+        Indy::Util::TBlockVec &BlockVec;
+
+        /* See accessor. */
+        TArenaChunkVec ChunkVec;
+
+        /* The raw bytes of the chunk we're filling. */
+        std::string Raw;
+
+        /* Scratch space for compressing a chunk. */
+        std::string Compressed;
+
+      };  // TArenaOutStream
+
+    }  // Disk
+
+  }  // Indy
+
+}  // Orly
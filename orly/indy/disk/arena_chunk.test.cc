@@ -0,0 +1,84 @@
+/* <orly/indy/disk/arena_chunk.test.cc>
+
+   Unit test for <orly/indy/disk/arena_chunk.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/arena_chunk.h>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace Orly::Indy::Disk;
+
+/* A chunk of the given size, filled with the given byte. */
+static const TArenaChunkCache::TChunk *MakeChunk(size_t size, char c) {
+  return TArenaChunkCache::TChunk::New(string(size, c));
+}
+
+FIXTURE(Typical) {
+  TArenaChunkCache cache(TArenaChunkCache::NumShards * 1024UL);
+  const size_t arena_id = TArenaChunkCache::NewArenaId();
+  EXPECT_NE(TArenaChunkCache::NewArenaId(), arena_id);
+  EXPECT_FALSE(cache.TryGet(arena_id, 0UL));
+  const TArenaChunkCache::TChunk *chunk = MakeChunk(1000UL, 'a');
+  cache.Keep(arena_id, 0UL, chunk);
+  EXPECT_EQ(cache.GetNumBytes(), 1000UL);
+  /* someone else got there first, so this one isn't kept */
+  const TArenaChunkCache::TChunk *other = MakeChunk(1000UL, 'b');
+  cache.Keep(arena_id, 0UL, other);
+  other->Unpin();
+  EXPECT_EQ(cache.GetNumBytes(), 1000UL);
+  const TArenaChunkCache::TChunk *found = cache.TryGet(arena_id, 0UL);
+  EXPECT_TRUE(found == chunk);
+  EXPECT_EQ(found->GetData()[0], 'a');
+  found->Unpin();
+  chunk->Unpin();
+  /* same chunk number, different arena */
+  EXPECT_FALSE(cache.TryGet(arena_id + 1UL, 0UL));
+}
+
+FIXTURE(Budget) {
+  /* room for one 1000 byte chunk per shard */
+  TArenaChunkCache cache(TArenaChunkCache::NumShards * 1024UL);
+  const size_t arena_id = TArenaChunkCache::NewArenaId();
+  /* chunks 0 and NumShards share a shard, so keeping the second pushes out the first */
+  const TArenaChunkCache::TChunk *first = MakeChunk(1000UL, 'a');
+  cache.Keep(arena_id, 0UL, first);
+  const TArenaChunkCache::TChunk *second = MakeChunk(1000UL, 'b');
+  cache.Keep(arena_id, TArenaChunkCache::NumShards, second);
+  second->Unpin();
+  EXPECT_EQ(cache.GetNumBytes(), 1000UL);
+  EXPECT_FALSE(cache.TryGet(arena_id, 0UL));
+  /* our pin keeps the evicted chunk alive */
+  EXPECT_EQ(first->GetData()[999], 'a');
+  first->Unpin();
+  /* neighbouring chunks land in different shards, so they all fit */
+  for (size_t i = 1; i < TArenaChunkCache::NumShards; ++i) {
+    const TArenaChunkCache::TChunk *chunk = MakeChunk(1000UL, 'c');
+    cache.Keep(arena_id, i, chunk);
+    chunk->Unpin();
+  }
+  EXPECT_EQ(cache.GetNumBytes(), TArenaChunkCache::NumShards * 1000UL);
+  /* a chunk bigger than a shard's share isn't kept at all */
+  const TArenaChunkCache::TChunk *big = MakeChunk(2000UL, 'd');
+  cache.Keep(arena_id, 1000UL, big);
+  big->Unpin();
+  EXPECT_FALSE(cache.TryGet(arena_id, 1000UL));
+  /* shrinking the budget evicts */
+  cache.SetMaxBytes(0UL);
+  EXPECT_EQ(cache.GetNumBytes(), 0UL);
+  EXPECT_EQ(cache.GetMaxBytes(), 0UL);
+}
@@ -18,9 +18,11 @@
 
 #include <orly/indy/disk/data_file.h>
 
+#include <orly/indy/disk/arena_chunk.h>
 #include <orly/indy/disk/in_file.h>
 #include <orly/indy/disk/indy_util_reporter.h>
 #include <orly/indy/disk/read_file.h>
+#include <orly/indy/disk/util/bloom_filter.h>
 #include <orly/indy/disk/util/hash_util.h>
 
 using namespace std;
@@ -162,6 +164,8 @@ class TIndexFile
         MaxArenaBytes(0UL),
         NumArenaNotes(0UL),
         NumArenaBytes(0UL),
+        ArenaChunkTableOffset(0UL),
+        NumArenaChunks(0UL),
         MainArenaRemapIndex(main_arena_remap_index),
         NumCurKeys(0UL),
         NumHistKeys(0UL),
@@ -172,6 +176,11 @@ class TIndexFile
         #ifndef NDEBUG
         WrittenBlockSet(written_block_set),
         #endif
+        HashIndexVersion(engine->GetHashIndexVersion()),
+        ByteOffsetOfKeyFences(0UL),
+        ByteOffsetOfBloomFilter(0UL),
+        NumBloomFilterBits(0UL),
+        NumBloomFilterProbes(0UL),
         UpdateCollector(nullptr) {
     KeyRemapper = std::bind(&TIndexFile::RemapKey, this, std::placeholders::_1);
     ValRemapper = std::bind(&TIndexFile::RemapVal, this, std::placeholders::_1);
@@ -203,6 +212,14 @@ class TIndexFile
       meta_stream << NumHistKeys;  // # History Keys
       meta_stream << ByteOffsetOfKeyIndex;  // Current Key Offset
       meta_stream << NumHashTables;  // # of hash indexes (n)
+      meta_stream << ByteOffsetOfBloomFilter;  // Offset of bloom filter
+      meta_stream << NumBloomFilterBits;  // # bloom filter bits
+      meta_stream << NumBloomFilterProbes;  // # bloom filter probes
+      meta_stream << HashIndexVersion;  // Hash index version
+      meta_stream << ByteOffsetOfKeyFences;  // Offset of key fences
+      meta_stream << FenceVec.size();  // # key fences
+      meta_stream << ArenaChunkTableOffset;  // Offset of arena chunk table
+      meta_stream << NumArenaChunks;  // # arena chunks
 
       #if 0
       stringstream ss;
@@ -215,11 +232,13 @@ class TIndexFile
       ss << "\tNumHistKeys = " << NumHistKeys << std::endl;
       ss << "\tByteOffsetOfKeyIndex = " << ByteOffsetOfKeyIndex << std::endl;
       ss << "\tNumHashTables = " << NumHashTables << std::endl;
+      ss << "\tNumBloomFilterBits = " << NumBloomFilterBits << std::endl;
+      ss << "\tHashIndexVersion = " << HashIndexVersion << std::endl;
       std::cout << ss.str();
       #endif
 
-      for (const auto &hash_table : NumHashFieldsByOffset) {
-        meta_stream << hash_table.first << hash_table.second;
+      for (size_t i = 0; i < NumHashTables; ++i) {
+        meta_stream << NumHashFieldsByOffset[i].first << NumHashFieldsByOffset[i].second << ByteOffsetOfHashEntriesVec[i];
       }
       for (const auto &offset : ArenaTypeBoundaryOffsetVec) {
         meta_stream << offset;
@@ -245,7 +264,7 @@ class TIndexFile
     KeyTrigger.Wait();
   }
 
-  void ConstructArena(TDataFile::TBlockVec &block_vec);
+  void ConstructArena(TDataFile::TBlockVec &block_vec, const Disk::Util::TCodec *codec);
 
   void PrepKeyRange(TDataFile::TUpdateCollector *update_collector, TDataFile::TBlockVec *block_vec);
 
@@ -293,6 +312,8 @@ class TIndexFile
   size_t ArenaByteOffset;
   size_t NumArenaNotes;
   size_t NumArenaBytes;
+  size_t ArenaChunkTableOffset;
+  size_t NumArenaChunks;
   TDataFile::TRemapIndex &MainArenaRemapIndex;
   TDataFile::TTypeBoundaryOffsetVec ArenaTypeBoundaryOffsetVec;
 
@@ -321,6 +342,22 @@ class TIndexFile
 
   std::vector<std::pair<size_t, size_t>> NumHashFieldsByOffset;
 
+  /* For a bucketed hash index, where its (core, offset) entries start; 0 for a linear probe index. */
+  std::vector<size_t> ByteOffsetOfHashEntriesVec;
+
+  /* The format of our hash indexes. */
+  size_t HashIndexVersion;
+
+  /* The position and (remapped) core of the first key entry to start in each logical block of the key index.  These
+     get written after the bloom filter. */
+  std::vector<std::pair<size_t, Atom::TCore>> FenceVec;
+  size_t ByteOffsetOfKeyFences;
+
+  /* The bloom filter over every hashed key (and key prefix) follows the hash tables. */
+  size_t ByteOffsetOfBloomFilter;
+  size_t NumBloomFilterBits;
+  size_t NumBloomFilterProbes;
+
   TDataFile::TUpdateCollector *UpdateCollector;
 
   /*
@@ -332,8 +369,14 @@ class TIndexFile
      # History Keys
      Current Key Offset
      # of hash indexes (n)
-
-     (n) (size_t) -> (size_t) hash index offset -> num hash fields pairings
+     Offset of bloom filter
+     # bloom filter bits
+     # bloom filter probes
+     Hash index version
+     Offset of key fences
+     # key fences
+
+     (n) (size_t, size_t, size_t) hash index offset, num hash fields, offset of bucketed entries triples
   */
   static const size_t NumMetaFields = TData::NumIndexMetaFields;
 
@@ -378,8 +421,11 @@ size_t MakeArena(Disk::Util::TEngine *engine,
                  #endif
                  TDataFile::TTypeBoundaryOffsetVec &type_boundary_vec,
                  size_t max_total_note_bytes,
+                 const Disk::Util::TCodec *codec,
                  size_t &num_note_out,
-                 size_t &num_bytes_out);
+                 size_t &num_bytes_out,
+                 size_t &chunk_table_offset_out,
+                 size_t &num_chunks_out);
 
 void TIndexFile::EmplaceOrderedNotes(TOrderedNoteIndex &note_index, TSuprena *arena, size_t &total_bytes, TCore::TOffset offset) {
   const TCore::TNote *const note = reinterpret_cast<const TCore::TNote *>(offset);
@@ -401,7 +447,7 @@ void TIndexFile::PrepKeyRange(TDataFile::TUpdateCollector *update_collector, TDa
   for (size_t i = 0; i < num_tuple_fields; ++i) {
     HashCollectorVec.emplace_back(new THashCollector(HERE, Source::DataFileHashIndex, TempFileConsolThresh, StorageSpeed, Engine, true));
   }
-  const size_t bytes_of_metadata = (TData::NumMetaFields * sizeof(size_t)) + (NumHashTables * sizeof(size_t) * 2UL) + (ArenaTypeBoundaryOffsetVec.size() * sizeof(size_t));
+  const size_t bytes_of_metadata = (TData::NumIndexMetaFields * sizeof(size_t)) + (NumHashTables * sizeof(size_t) * TData::NumHashIndexMetaFields) + (ArenaTypeBoundaryOffsetVec.size() * sizeof(size_t));
   if (bytes_of_metadata >= Disk::Util::LogicalBlockSize) {
     throw std::runtime_error("Index metadata >= 1 block");
   }
@@ -448,7 +494,7 @@ Atom::TCore::TOffset TIndexFile::RemapVal(Atom::TCore::TOffset offset) {
   return pos->NewKey;
 }
 
-void TIndexFile::ConstructArena(TDataFile::TBlockVec &block_vec) {
+void TIndexFile::ConstructArena(TDataFile::TBlockVec &block_vec, const Disk::Util::TCodec *codec) {
   ArenaByteOffset = MakeArena(Engine,
                               StorageSpeed,
                               Priority,
@@ -460,8 +506,11 @@ void TIndexFile::ConstructArena(TDataFile::TBlockVec &block_vec) {
                               #endif
                               ArenaTypeBoundaryOffsetVec,
                               MaxArenaBytes,
+                              codec,
                               NumArenaNotes,
-                              NumArenaBytes);
+                              NumArenaBytes,
+                              ArenaChunkTableOffset,
+                              NumArenaChunks);
 }
 
 void TIndexFile::PushKey(TUpdate::TEntry *entry) {
@@ -513,6 +562,10 @@ void TIndexFile::PushKey(TUpdate::TEntry *entry) {
     CurArena = key.GetArena();
     key_core.Remap(KeyRemapper);
     val_core.Remap(ValRemapper);
+    /* the first key to start in a new block becomes that block's fence */
+    if (FenceVec.empty() || CurKeyOffset / Disk::Util::LogicalBlockSize != (ByteOffsetOfKeyIndex + FenceVec.back().first * TDataFile::KeyEntrySize) / Disk::Util::LogicalBlockSize) {
+      FenceVec.emplace_back(NumCurKeys - 1UL, key_core);
+    }
     stream.Write(&key_core, sizeof(key_core));
     stream.Write(&val_core, sizeof(val_core));
 
@@ -584,15 +637,52 @@ void TIndexFile::FlushHashes() {
   size_t total_bytes_required = 0UL;
   unordered_map<size_t, shared_ptr<const TBufBlock>> collision_map {};
   size_t hash_index_byte_offset = BlockVec->Size() * Disk::Util::LogicalBlockSize;
+  size_t num_hashed_keys = 0UL;
+  for (const auto &collection : HashCollectorVec) {
+    num_hashed_keys += collection->GetSize();
+  }
+  Disk::Util::TBloomFilter bloom_filter(num_hashed_keys, Engine->GetBloomFilterBitsPerKey());
+  /* a bucketed index has to be sorted by home bucket before we know how many overflow buckets it needs */
+  std::vector<std::unique_ptr<THashCollector>> bucketed_collector_vec;
+  std::vector<size_t> num_buckets_vec;
   for (const auto &collection : HashCollectorVec) {
     /* collision at beginning of this hash index */
     auto ret = collision_map.insert(make_pair((hash_index_byte_offset + total_bytes_required) / Disk::Util::LogicalBlockSize, nullptr));
     if (ret.second) { // fresh insert
       ret.first->second = std::shared_ptr<const TBufBlock>(new TBufBlock());
     }
-    size_t num_hash_fields = Disk::Util::SuggestHashSize(collection->GetSize());
-    NumHashFieldsByOffset.emplace_back(hash_index_byte_offset + total_bytes_required, num_hash_fields);
-    total_bytes_required += num_hash_fields * TDataFile::HashEntrySize;
+    if (HashIndexVersion == Disk::Util::BucketedHashIndex) {
+      const size_t num_home_buckets = Disk::Util::SuggestNumHashBuckets(collection->GetSize());
+      bucketed_collector_vec.emplace_back(new THashCollector(HERE, Source::DataFileHashIndex, TempFileConsolThresh, StorageSpeed, Engine, true));
+      THashCollector *bucketed_collector = bucketed_collector_vec.back().get();
+      for (THashCollector::TCursor orig_csr(collection.get(), 32UL); orig_csr; ++orig_csr) {
+        const THashObj &obj = *orig_csr;
+        bucketed_collector->Emplace(obj.Core, Disk::Util::GetHomeBucket(obj.Hash, num_home_buckets), obj.Offset);
+        bloom_filter.Add(obj.Hash);
+      }
+      size_t num_buckets;
+      /* count the overflow buckets */ {
+        THashCollector::TCursor count_csr(bucketed_collector, 32UL);
+        num_buckets = Disk::Util::CountHashBuckets(count_csr, num_home_buckets);
+      }
+      num_buckets_vec.push_back(num_buckets);
+      const size_t byte_offset_of_entries = hash_index_byte_offset + total_bytes_required + num_buckets * sizeof(Disk::Util::THashBucket);
+      NumHashFieldsByOffset.emplace_back(hash_index_byte_offset + total_bytes_required, num_home_buckets);
+      ByteOffsetOfHashEntriesVec.push_back(byte_offset_of_entries);
+      total_bytes_required += Disk::Util::GetBucketedHashIndexSize(num_buckets, collection->GetSize(), TDataFile::HashEntrySize);
+      /* the buckets and the entries are written by separate streams, so they may collide with each other */
+      if (byte_offset_of_entries % Disk::Util::LogicalBlockSize != 0) {
+        ret = collision_map.insert(make_pair(byte_offset_of_entries / Disk::Util::LogicalBlockSize, nullptr));
+        if (ret.second) { // fresh insert
+          ret.first->second = std::shared_ptr<const TBufBlock>(new TBufBlock());
+        }
+      }
+    } else {
+      size_t num_hash_fields = Disk::Util::SuggestHashSize(collection->GetSize());
+      NumHashFieldsByOffset.emplace_back(hash_index_byte_offset + total_bytes_required, num_hash_fields);
+      ByteOffsetOfHashEntriesVec.push_back(0UL);
+      total_bytes_required += num_hash_fields * TDataFile::HashEntrySize;
+    }
     /* collision at end of this hash index (if the block doesn't get filled completely) */
     if ((hash_index_byte_offset + total_bytes_required) % Disk::Util::LogicalBlockSize != 0) {
       ret = collision_map.insert(make_pair((hash_index_byte_offset + total_bytes_required) / Disk::Util::LogicalBlockSize, nullptr));
@@ -602,17 +692,78 @@ void TIndexFile::FlushHashes() {
     }
   }
   assert(NumHashFieldsByOffset.size() == NumHashTables);
+  /* lay out the bloom filter right after the last hash index */
+  ByteOffsetOfBloomFilter = hash_index_byte_offset + total_bytes_required;
+  if (bloom_filter.IsEnabled()) {
+    total_bytes_required += bloom_filter.GetNumBytes();
+    /* collision at end of the bloom filter (if the block doesn't get filled completely) */
+    if ((hash_index_byte_offset + total_bytes_required) % Disk::Util::LogicalBlockSize != 0) {
+      auto ret = collision_map.insert(make_pair((hash_index_byte_offset + total_bytes_required) / Disk::Util::LogicalBlockSize, nullptr));
+      if (ret.second) { // fresh insert
+        ret.first->second = std::shared_ptr<const TBufBlock>(new TBufBlock());
+      }
+    }
+  }
+  /* and the key fences after that */
+  ByteOffsetOfKeyFences = hash_index_byte_offset + total_bytes_required;
+  if (!FenceVec.empty()) {
+    total_bytes_required += FenceVec.size() * TData::KeyFenceSize;
+    /* collision at end of the key fences (if the block doesn't get filled completely) */
+    if ((hash_index_byte_offset + total_bytes_required) % Disk::Util::LogicalBlockSize != 0) {
+      auto ret = collision_map.insert(std::make_pair((hash_index_byte_offset + total_bytes_required) / Disk::Util::LogicalBlockSize, nullptr));
+      if (ret.second) { // fresh insert
+        ret.first->second = std::shared_ptr<const TBufBlock>(new TBufBlock());
+      }
+    }
+  }
   size_t max_blocks_required = ceil(static_cast<double>(total_bytes_required) / Disk::Util::LogicalBlockSize);
 
   Engine->AppendReserveBlocks(StorageSpeed, max_blocks_required, *BlockVec);
   TCompletionTrigger completion_trigger;
-  for (const auto &collection : HashCollectorVec) {
+  for (size_t idx = 0; idx < HashCollectorVec.size(); ++idx) {
+    const auto &collection = HashCollectorVec[idx];
+    if (HashIndexVersion == Disk::Util::BucketedHashIndex) {
+      const size_t num_buckets = num_buckets_vec[idx];
+      assert(hash_index_byte_offset == NumHashFieldsByOffset[idx].first);
+      THashCollector::TCursor hash_csr(bucketed_collector_vec[idx].get(), 32UL);
+      TDataFile::TDataOutStream bucket_stream(HERE,
+                                              Source::DataFileHashIndex,
+                                              Engine->GetVolMan(),
+                                              hash_index_byte_offset,
+                                              *BlockVec,
+                                              collision_map,
+                                              completion_trigger,
+                                              Priority,
+                                              true
+                                              #ifndef NDEBUG
+                                              ,WrittenBlockSet
+                                              #endif
+                                              );
+      TDataFile::TDataOutStream entry_stream(HERE,
+                                             Source::DataFileHashIndex,
+                                             Engine->GetVolMan(),
+                                             ByteOffsetOfHashEntriesVec[idx],
+                                             *BlockVec,
+                                             collision_map,
+                                             completion_trigger,
+                                             Priority,
+                                             true
+                                             #ifndef NDEBUG
+                                             ,WrittenBlockSet
+                                             #endif
+                                             );
+      Disk::Util::WriteBucketedHashIndex(hash_csr, num_buckets, bucket_stream, entry_stream);
+      FileSize = entry_stream.GetOffset();
+      hash_index_byte_offset += Disk::Util::GetBucketedHashIndexSize(num_buckets, collection->GetSize(), TDataFile::HashEntrySize);
+      continue;
+    }
     size_t num_hash_fields = Disk::Util::SuggestHashSize(collection->GetSize());
     /* make a new index with the hashes modded by the hash field size */
     THashCollector modded_hash_collector(HERE, Source::DataFileHashIndex, TempFileConsolThresh, StorageSpeed, Engine, true);
     for (THashCollector::TCursor orig_csr(collection.get(), 32UL); orig_csr; ++orig_csr) {
       const THashObj &obj = *orig_csr;
       modded_hash_collector.Emplace(obj.Core, obj.Hash % num_hash_fields, obj.Offset);
+      bloom_filter.Add(obj.Hash);
     }
     THashCollector::TCursor hash_csr(&modded_hash_collector, 32UL);
     /* do the first pass over the hash map */ {
@@ -732,6 +883,49 @@ void TIndexFile::FlushHashes() {
     }
     hash_index_byte_offset += num_hash_fields * TDataFile::HashEntrySize;
   }
+  /* write the bloom filter */
+  if (bloom_filter.IsEnabled()) {
+    assert(hash_index_byte_offset == ByteOffsetOfBloomFilter);
+    TDataFile::TDataOutStream stream(HERE,
+                                     Source::DataFileBloomFilter,
+                                     Engine->GetVolMan(),
+                                     ByteOffsetOfBloomFilter,
+                                     *BlockVec,
+                                     collision_map,
+                                     completion_trigger,
+                                     Priority,
+                                     true
+                                     #ifndef NDEBUG
+                                     ,WrittenBlockSet
+                                     #endif
+                                     );
+    stream.Write(bloom_filter.GetData(), bloom_filter.GetNumBytes());
+    FileSize = stream.GetOffset();
+  }
+  NumBloomFilterBits = bloom_filter.GetNumBits();
+  NumBloomFilterProbes = bloom_filter.GetNumProbes();
+  /* write the key fences */
+  if (!FenceVec.empty()) {
+    TDataFile::TDataOutStream stream(HERE,
+                                     Source::DataFileKeyFence,
+                                     Engine->GetVolMan(),
+                                     ByteOffsetOfKeyFences,
+                                     *BlockVec,
+                                     collision_map,
+                                     completion_trigger,
+                                     Priority,
+                                     true
+                                     #ifndef NDEBUG
+                                     ,WrittenBlockSet
+                                     #endif
+                                     );
+    for (const auto &fence : FenceVec) {
+      stream << fence.first;
+      stream.Write(&fence.second, sizeof(TCore));
+    }
+    FileSize = stream.GetOffset();
+  }
+  bucketed_collector_vec.clear();
   /* flush collision blocks */ {
     for (auto iter : collision_map) {
       assert(iter.first < BlockVec->Size());
@@ -769,6 +963,8 @@ TDataFile::TDataFile(Util::TEngine *engine,
       TempFileConsolThresh(temp_file_consol_thresh),
       UpdateCollector(HERE, Source::DataFileUpdateIndex, TempFileConsolThresh, StorageSpeed, Engine, true) {
   assert(this);
+  /* every arena in the file is compressed the same way, so read the setting once. */
+  const Util::TCodec *const codec = Engine->GetDataFileCodec();
   try {
     auto main_arena_note_index = make_unique<TIndexFile::TOrderedNoteIndex>(
         HERE, Source::DataFileNoteIndex, TempFileConsolThresh, StorageSpeed, Engine, true);
@@ -865,12 +1061,14 @@ TDataFile::TDataFile(Util::TEngine *engine,
     for (const auto &iter : index_map) {
       TIndexFile &index_file = *iter.second;
       if (index_file.MaxArenaBytes) {
-        index_file.ConstructArena(BlockVec);
+        index_file.ConstructArena(BlockVec, codec);
       }
     }
     /* write out the main arena */
     size_t num_main_arena_notes = 0UL;
     size_t num_main_arena_bytes = 0UL;
+    size_t main_arena_chunk_table_offset = 0UL;
+    size_t num_main_arena_chunks = 0UL;
     if (main_arena_max_bytes) {
       MainArenaByteOffset = MakeArena(Engine,
                                       StorageSpeed,
@@ -883,8 +1081,11 @@ TDataFile::TDataFile(Util::TEngine *engine,
                                       #endif
                                       MainArenaTypeBoundaryOffsetVec,
                                       main_arena_max_bytes,
+                                      codec,
                                       num_main_arena_notes,
-                                      num_main_arena_bytes);
+                                      num_main_arena_bytes,
+                                      main_arena_chunk_table_offset,
+                                      num_main_arena_chunks);
     }
     /* write the in-order key indexes */ {
       Base::TOpt<Base::TUuid> prev_index_id;
@@ -1042,6 +1243,7 @@ TDataFile::TDataFile(Util::TEngine *engine,
     size_t num_meta_blocks = 0UL;
     /* compute / write out the meta-data */ {
       /*
+        meta version
         # of blocks
         # of meta-blocks (n)
         # of #block / block_id pairings (number of sequential blocks starting at) (m)
@@ -1051,6 +1253,9 @@ TDataFile::TDataFile(Util::TEngine *engine,
         # of arena bytes
         offset of main arena
         offset of update index
+        arena codec
+        offset of main arena chunk table
+        # of main arena chunks
 
         n (size_t) metablock block_id(s)
         m (size_t) -> (size_t) #block -> starting_block_id pairings
@@ -1093,6 +1298,7 @@ TDataFile::TDataFile(Util::TEngine *engine,
                             ,WrittenBlockSet
                             #endif
                             );
+      stream << TData::GetMetaVersionWord();  // meta version
       stream << BlockVec.Size();  // # of blocks
       stream << num_meta_blocks;  // # of meta-blocks
       stream << num_sequential_block_pairings;  // # of #block / block_id pairings
@@ -1103,6 +1309,9 @@ TDataFile::TDataFile(Util::TEngine *engine,
       stream << MainArenaTypeBoundaryOffsetVec.size();  // # of arena type boundaries
       stream << MainArenaByteOffset;  // byte offset of main arena
       stream << byte_offset_of_update_entries;  // offset of update index
+      stream << static_cast<size_t>(codec->GetKind());  // arena codec
+      stream << main_arena_chunk_table_offset;  // offset of main arena chunk table
+      stream << num_main_arena_chunks;  // # of main arena chunks
       assert((stream.GetOffset() - start_of_meta_data) / sizeof(size_t) == TData::NumMetaFields);
 
       assert(stream.GetOffset() == start_of_meta_data + (TData::NumMetaFields * sizeof(size_t)));
@@ -1198,8 +1407,11 @@ size_t MakeArena(Disk::Util::TEngine *engine,
                  #endif
                  TDataFile::TTypeBoundaryOffsetVec &type_boundary_vec,
                  size_t max_total_note_bytes,
+                 const Disk::Util::TCodec *codec,
                  size_t &num_notes_out,
-                 size_t &num_bytes_out) {
+                 size_t &num_bytes_out,
+                 size_t &chunk_table_offset_out,
+                 size_t &num_chunks_out) {
   assert(remap_index.empty());
   Atom::TCore::TArena *cur_arena = nullptr;
   auto remapper = [&remap_index, &cur_arena](TCore::TOffset off) {
@@ -1228,20 +1440,22 @@ size_t MakeArena(Disk::Util::TEngine *engine,
 
   TCompletionTrigger completion_trigger;
   unordered_map<size_t, shared_ptr<const TBufBlock>> arena_collision_map {};
+  size_t end_of_stream;
   /* arena stream life time */ {
-    TDataFile::TDataOutStream arena_stream(HERE,
-                                           Source::DataFileArena,
-                                           engine->GetVolMan(),
-                                           arena_byte_offset,
-                                           block_vec,
-                                           arena_collision_map,
-                                           completion_trigger,
-                                           priority,
-                                           true
-                                           #ifndef NDEBUG
-                                           ,written_block_set
-                                           #endif
-                                           );
+    TArenaOutStream<Disk::Util::LogicalPageSize, Disk::Util::LogicalBlockSize, Disk::Util::PhysicalBlockSize, Disk::Util::PageCheckedBlock>
+        arena_stream(HERE,
+                     Source::DataFileArena,
+                     engine->GetVolMan(),
+                     arena_byte_offset,
+                     block_vec,
+                     arena_collision_map,
+                     completion_trigger,
+                     priority,
+                     true,
+                     #ifndef NDEBUG
+                     written_block_set,
+                     #endif
+                     codec);
     type_boundary_vec.push_back(cur_disk_offset);
 
     void *lhs_type_alloc = alloca(Sabot::Type::GetMaxTypeSize() * 2);
@@ -1302,13 +1516,15 @@ size_t MakeArena(Disk::Util::TEngine *engine,
       temp_note = nullptr;
       throw;
     }
+    chunk_table_offset_out = arena_stream.Finish(engine, storage_speed);
+    num_chunks_out = arena_stream.GetNumChunks();
+    end_of_stream = arena_stream.GetOffset();
   }  // done arena stream
   num_bytes_out = cur_disk_offset;
   /* wait for the arena to flush */ {
     completion_trigger.Wait();
   }
   /* now that we know exactly how many bytes we actually used, we can shrink the block vec to free the unused blocks. */
-  const size_t end_of_stream = arena_byte_offset + num_bytes_out;
   const size_t actual_blocks_required = ((end_of_stream - 1UL) / Disk::Util::LogicalBlockSize) + 1UL;
 
   const size_t num_to_remove = block_vec.Size() - actual_blocks_required;
@@ -154,6 +154,9 @@ FIXTURE(Deep) {
       EXPECT_TRUE(int_str_decint_decstr_idx_file.FindInHash(TKey(make_tuple(1L, string("Orly"), TDesc<int64_t>(1L), TDesc<string>("short")), &arena, state_alloc), out_offset, in_stream, &int_str_decint_decstr_idx_arena));
       EXPECT_TRUE(int_str_decint_decstr_idx_file.FindInHash(TKey(make_tuple(1L, string("Orly"), TDesc<int64_t>(1L), TDesc<string>("This string should be too long to fit in a core")), &arena, state_alloc), out_offset, in_stream, &int_str_decint_decstr_idx_arena));
       EXPECT_TRUE(int_str_int_str_idx_file.FindInHash(TKey(make_tuple(1L, string("Orly"), 1L, string("short")), &arena, state_alloc), out_offset, in_stream, &int_str_int_str_idx_arena));
+      EXPECT_TRUE(int_str_decint_decstr_idx_file.GetBloomFilter().IsEnabled());
+      EXPECT_TRUE(int_str_int_str_idx_file.GetBloomFilter().IsEnabled());
+      EXPECT_FALSE(int_str_int_str_idx_file.FindInHash(TKey(make_tuple(1L, string("Orly"), 1L, string("missing")), &arena, state_alloc), out_offset, in_stream, &int_str_int_str_idx_arena));
       /* check the <[int64_t, string, desc<int64_t>, desc<string>]> index */ {
         //TReader::TIndexFile idx_file(&reader, int_str_decint_decstr_idx, RealTime);
         std::vector<std::pair<TKey, TKey>> expected_vec;
@@ -327,3 +330,203 @@ FIXTURE(History) {
     cond.notify_one();
   });
 }
+
+FIXTURE(HashIndexVersions) {
+  Fiber::TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &) {
+    const TScheduler::TPolicy scheduler_policy(4, 10, milliseconds(10));
+    void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+    TScheduler scheduler;
+    scheduler.SetPolicy(scheduler_policy);
+
+    Sim::TMemEngine mem_engine(&scheduler,
+                               256 /* disk space: 256MB */,
+                               256 /* slow disk space: 256MB */,
+                               16384 /* page cache slots: 64MB */,
+                               1 /* num page lru */,
+                               1024 /* block cache slots: 64MB */,
+                               1 /* num block lru */);
+    const int64_t num_keys = 5000L;
+    size_t data_gen_id = 0;
+    for (size_t version : {LinearProbeHashIndex, BucketedHashIndex}) {
+      mem_engine.GetEngine()->SetHashIndexVersion(version);
+      Base::TUuid file_id(TUuid::Best);
+      TSequenceNumber seq_num = 0U;
+      TUuid int_int_idx(TUuid::Twister);
+      TMockMem mem_layer;
+      for (int64_t i = 0; i < num_keys; ++i) {
+        Insert(mem_layer, ++seq_num, int_int_idx, i, i, i * 3L);
+      }
+      ++data_gen_id;
+      TDataFile data_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, &mem_layer, file_id, data_gen_id, 20UL, 0U, Medium);
+      TReader reader(HERE, mem_engine.GetEngine(), file_id, data_gen_id);
+      TReader::TIndexFile idx_file(&reader, int_int_idx, RealTime);
+      TReader::TArena idx_arena(&idx_file, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TStream<Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::PhysicalBlockSize, Orly::Indy::Disk::Util::PageCheckedBlock, 0UL> in_stream(HERE, Source::PresentWalk, RealTime, &reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), 0);
+      EXPECT_EQ(idx_file.GetHashIndexVersion(), version);
+      size_t found = 0UL, found_prefix = 0UL, false_hits = 0UL;
+      for (int64_t i = 0; i < num_keys; ++i) {
+        TSuprena arena;
+        size_t out_offset;
+        found += idx_file.FindInHash(TKey(make_tuple(i, i * 3L), &arena, state_alloc), out_offset, in_stream, &idx_arena) ? 1UL : 0UL;
+        found_prefix += idx_file.FindInHash(TKey(make_tuple(i, Native::TFree<int64_t>()), &arena, state_alloc), out_offset, in_stream, &idx_arena) ? 1UL : 0UL;
+        false_hits += idx_file.FindInHash(TKey(make_tuple(i, i * 3L + 1L), &arena, state_alloc), out_offset, in_stream, &idx_arena) ? 1UL : 0UL;
+      }
+      EXPECT_EQ(found, static_cast<size_t>(num_keys));
+      EXPECT_EQ(found_prefix, static_cast<size_t>(num_keys));
+      EXPECT_EQ(false_hits, 0UL);
+    }
+    GracefullShutdown();
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
+
+FIXTURE(KeyFences) {
+  Fiber::TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &) {
+    const TScheduler::TPolicy scheduler_policy(4, 10, milliseconds(10));
+    void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+    TScheduler scheduler;
+    scheduler.SetPolicy(scheduler_policy);
+
+    Sim::TMemEngine mem_engine(&scheduler,
+                               256 /* disk space: 256MB */,
+                               256 /* slow disk space: 256MB */,
+                               16384 /* page cache slots: 64MB */,
+                               1 /* num page lru */,
+                               1024 /* block cache slots: 64MB */,
+                               1 /* num block lru */);
+    const int64_t num_keys = 5000L;
+    Base::TUuid file_id(TUuid::Best);
+    TSequenceNumber seq_num = 0U;
+    TUuid int_idx(TUuid::Twister);
+    TMockMem mem_layer;
+    for (int64_t i = 0; i < num_keys; ++i) {
+      Insert(mem_layer, ++seq_num, int_idx, i, i * 2L);
+    }
+    size_t data_gen_id = 1;
+    TDataFile data_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, &mem_layer, file_id, data_gen_id, 20UL, 0U, Medium);
+    TReader reader(HERE, mem_engine.GetEngine(), file_id, data_gen_id);
+    TReader::TIndexFile idx_file(&reader, int_idx, RealTime);
+    TReader::TArena idx_arena(&idx_file, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+    TStream<Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::PhysicalBlockSize, Orly::Indy::Disk::Util::PageCheckedBlock, 0UL> in_stream(HERE, Source::PresentWalk, RealTime, &reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), 0);
+    /* 5000 key entries span many logical blocks, so we should have more than one fence */
+    EXPECT_GT(idx_file.GetNumKeyFences(), 1UL);
+    size_t agreed = 0UL;
+    for (int64_t val = -1L; val <= num_keys * 2L; ++val) {
+      TSuprena arena;
+      TKey key(make_tuple(val), &arena, state_alloc);
+      size_t fenced_offset = 0UL, unfenced_offset = 0UL;
+      bool fenced = idx_file.BinaryLowerBoundOnKey(key, fenced_offset, in_stream, &idx_arena, true);
+      bool unfenced = idx_file.BinaryLowerBoundOnKey(key, unfenced_offset, in_stream, &idx_arena, false);
+      agreed += (fenced == unfenced && (!fenced || fenced_offset == unfenced_offset)) ? 1UL : 0UL;
+    }
+    EXPECT_EQ(agreed, static_cast<size_t>(num_keys * 2L + 2L));
+    GracefullShutdown();
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
+
+FIXTURE(BaselineMeta) {
+  Fiber::TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &) {
+    const TScheduler::TPolicy scheduler_policy(4, 10, milliseconds(10));
+    TScheduler scheduler;
+    scheduler.SetPolicy(scheduler_policy);
+
+    Sim::TMemEngine mem_engine(&scheduler,
+                               256 /* disk space: 256MB */,
+                               256 /* slow disk space: 256MB */,
+                               16384 /* page cache slots: 64MB */,
+                               1 /* num page lru */,
+                               1024 /* block cache slots: 64MB */,
+                               1 /* num block lru */);
+    Disk::Util::TEngine *engine = mem_engine.GetEngine();
+    const size_t data_gen_id = 1UL;
+    const size_t index_meta_offset = 1024UL;
+    Base::TUuid file_id(TUuid::Best);
+    TUuid int_int_idx(TUuid::Twister);
+    TDataFile::TBlockVec block_vec;
+    engine->AppendReserveBlocks(TVolume::TDesc::Fast, 1UL, block_vec);
+    TCompletionTrigger completion_trigger;
+    /* write a one-block file the way we did before the meta data was versioned: the file meta data, then the index
+       meta data with its hash indexes as (offset, num hash fields) pairs.  Nothing here points at keys, so it's never
+       read past the meta data. */ {
+      unordered_map<size_t, shared_ptr<const TBufBlock>> collision_map {};
+      #ifndef NDEBUG
+      unordered_set<size_t> written_block_set;
+      #endif
+      TDataFile::TDataOutStream stream(HERE,
+                                       Source::DataFileMeta,
+                                       engine->GetVolMan(),
+                                       0UL,
+                                       block_vec,
+                                       collision_map,
+                                       completion_trigger,
+                                       Medium,
+                                       true
+                                       #ifndef NDEBUG
+                                       ,written_block_set
+                                       #endif
+                                       );
+      stream << 1UL;  // # of blocks
+      stream << 1UL;  // # of meta-blocks
+      stream << 0UL;  // # of #block / block_id pairings
+      stream << 3UL;  // # of updates
+      stream << 1UL;  // # of index segments
+      stream << 0UL;  // # of arena notes
+      stream << 0UL;  // # of arena bytes
+      stream << 1UL;  // # of arena type boundaries
+      stream << 0UL;  // offset of main arena
+      stream << 0UL;  // offset of update index
+      stream << block_vec[0];  // meta block id
+      stream.Write(int_int_idx);
+      stream << index_meta_offset;
+      stream << 5UL;  // main arena type boundary
+      while (stream.GetOffset() < index_meta_offset) {
+        stream << 0UL;
+      }
+      stream << 0UL;  // Offset of Arena
+      stream << 0UL;  // # arena notes
+      stream << 8UL;  // # arena bytes
+      stream << 1UL;  // # arena type boundaries
+      stream << 4UL;  // # Current Keys
+      stream << 0UL;  // # History Keys
+      stream << 2048UL;  // Current Key Offset
+      stream << 2UL;  // # of hash indexes
+      stream << 3072UL << 11UL;  // first hash index
+      stream << 3584UL << 13UL;  // second hash index
+      stream << 7UL;  // arena type boundary
+    }
+    completion_trigger.Wait();
+    engine->InsertFile(file_id, TFileObj::TKind::DataFile, data_gen_id, block_vec[0], 0UL, Disk::Util::LogicalBlockSize, 4UL, 1U, 3U, completion_trigger);
+    completion_trigger.Wait();
+    TReader reader(HERE, engine, file_id, data_gen_id);
+    EXPECT_EQ(reader.GetMetaVersion(), TData::BaselineMetaVersion);
+    EXPECT_EQ(reader.GetNumUpdates(), 3UL);
+    EXPECT_TRUE(reader.GetArenaCodec() == TCodecKind::None);
+    EXPECT_EQ(reader.GetTypeBoundaryOffsetVec().size(), 1UL);
+    EXPECT_EQ(reader.GetTypeBoundaryOffsetVec()[0], 5UL);
+    TReader::TIndexFile idx_file(&reader, int_int_idx, RealTime);
+    EXPECT_EQ(idx_file.GetNumCurKeys(), 4UL);
+    EXPECT_EQ(idx_file.GetByteOffsetOfKeyIndex(), 2048UL);
+    EXPECT_EQ(idx_file.GetHashIndexVersion(), LinearProbeHashIndex);
+    EXPECT_FALSE(idx_file.GetBloomFilter().IsEnabled());
+    EXPECT_EQ(idx_file.GetNumKeyFences(), 0UL);
+    const auto &hash_fields = idx_file.GetNumHashFieldsByOffset();
+    if (EXPECT_EQ(hash_fields.size(), 2UL)) {
+      EXPECT_EQ(hash_fields[0].first, 3072UL);
+      EXPECT_EQ(hash_fields[0].second, 11UL);
+      EXPECT_EQ(hash_fields[1].first, 3584UL);
+      EXPECT_EQ(hash_fields[1].second, 13UL);
+    }
+    if (EXPECT_EQ(idx_file.GetTypeBoundaryOffsetVec().size(), 1UL)) {
+      EXPECT_EQ(idx_file.GetTypeBoundaryOffsetVec()[0], 7UL);
+    }
+    GracefullShutdown();
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
@@ -21,12 +21,14 @@
 #include <valgrind/callgrind.h>
 
 #include <base/scheduler.h>
+#include <base/timer.h>
 #include <base/usage_meter.h>
 #include <orly/indy/disk/disk_test.h>
 #include <orly/indy/disk/read_file.h>
 #include <orly/indy/disk/sim/mem_engine.h>
 #include <orly/indy/disk/test_file_service.h>
 #include <orly/indy/fiber/fiber_test_runner.h>
+#include <util/time.h>
 
 #include <test/kit.h>
 
@@ -122,3 +124,124 @@ FIXTURE(BigSingleIndex) {
     cond.notify_one();
   });
 }
+
+FIXTURE(HashIndexFormats) {
+  Fiber::TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &) {
+    const int64_t num_iter = 500000L;
+    const TScheduler::TPolicy scheduler_policy(4, 10, milliseconds(10));
+    TScheduler scheduler;
+    scheduler.SetPolicy(scheduler_policy);
+
+    Sim::TMemEngine mem_engine(&scheduler,
+                               1024 /* disk space: 1GB */,
+                               512 /* slow disk space: 512MB */,
+                               65536 /* page cache slots: 256MB */,
+                               1 /* num page lru */,
+                               2048 /* block cache slots: 128MB */,
+                               1 /* num block lru */);
+    /* we want to compare the hash tables themselves, so don't let the bloom filter answer the misses */
+    mem_engine.GetEngine()->SetBloomFilterBitsPerKey(0UL);
+    void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+    size_t data_gen_id = 0;
+    for (size_t version : {LinearProbeHashIndex, BucketedHashIndex}) {
+      mem_engine.GetEngine()->SetHashIndexVersion(version);
+      Base::TUuid file_id(TUuid::Best);
+      TSequenceNumber seq_num = 0U;
+      TUuid int_int_idx(TUuid::Twister);
+      TMockMem mem_layer;
+      for (int64_t i = 0; i < num_iter; ++i) {
+        Insert(mem_layer, ++seq_num, int_int_idx, i, i, i * 2L);
+      }
+      ++data_gen_id;
+      TDataFile data_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, &mem_layer, file_id, data_gen_id, 20UL, 0U, Medium);
+      TReader reader(HERE, mem_engine.GetEngine(), file_id, data_gen_id);
+      TReader::TIndexFile idx_file(&reader, int_int_idx, RealTime);
+      TReader::TArena idx_arena(&idx_file, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TStream<Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::PhysicalBlockSize, Orly::Indy::Disk::Util::PageCheckedBlock, 0UL> in_stream(HERE, Source::PresentWalk, RealTime, &reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), 0);
+      size_t out_offset;
+      size_t hit_probes = 0UL, miss_probes = 0UL, found = 0UL;
+      Base::TTimer hit_timer;
+      hit_timer.Start();
+      for (int64_t i = 0; i < num_iter; ++i) {
+        TSuprena arena;
+        found += idx_file.FindInHash(TKey(make_tuple(i, i * 2L), &arena, state_alloc), out_offset, in_stream, &idx_arena, &hit_probes) ? 1UL : 0UL;
+      }
+      hit_timer.Stop();
+      Base::TTimer miss_timer;
+      miss_timer.Start();
+      for (int64_t i = 0; i < num_iter; ++i) {
+        TSuprena arena;
+        found += idx_file.FindInHash(TKey(make_tuple(i, i * 2L + 1L), &arena, state_alloc), out_offset, in_stream, &idx_arena, &miss_probes) ? 1UL : 0UL;
+      }
+      miss_timer.Stop();
+      EXPECT_EQ(found, static_cast<size_t>(num_iter));
+      cout << endl << (version == BucketedHashIndex ? "Bucketed" : "Linear probe") << " hash index" << endl
+           << "\thit  [" << ::Util::ToSecondsDouble(hit_timer.GetTotal()) << "s]\t[" << (::Util::ToSecondsDouble(hit_timer.GetTotal()) / num_iter) << "s / key]\t["
+           << (static_cast<double>(hit_probes) / num_iter) << " probes / key]" << endl
+           << "\tmiss [" << ::Util::ToSecondsDouble(miss_timer.GetTotal()) << "s]\t[" << (::Util::ToSecondsDouble(miss_timer.GetTotal()) / num_iter) << "s / key]\t["
+           << (static_cast<double>(miss_probes) / num_iter) << " probes / key]" << endl;
+    }
+    GracefullShutdown();
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
+
+FIXTURE(KeyFenceSeeks) {
+  Fiber::TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &) {
+    const int64_t num_iter = 500000L;
+    const int64_t num_seeks = 100000L;
+    const TScheduler::TPolicy scheduler_policy(4, 10, milliseconds(10));
+    TScheduler scheduler;
+    scheduler.SetPolicy(scheduler_policy);
+
+    Sim::TMemEngine mem_engine(&scheduler,
+                               1024 /* disk space: 1GB */,
+                               512 /* slow disk space: 512MB */,
+                               65536 /* page cache slots: 256MB */,
+                               1 /* num page lru */,
+                               2048 /* block cache slots: 128MB */,
+                               1 /* num block lru */);
+    void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+    Base::TUuid file_id(TUuid::Best);
+    TSequenceNumber seq_num = 0U;
+    TUuid int_idx(TUuid::Twister);
+    TMockMem mem_layer;
+    for (int64_t i = 0; i < num_iter; ++i) {
+      Insert(mem_layer, ++seq_num, int_idx, i, i * 2L);
+    }
+    size_t data_gen_id = 1;
+    TDataFile data_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, &mem_layer, file_id, data_gen_id, 20UL, 0U, Medium);
+    TReader reader(HERE, mem_engine.GetEngine(), file_id, data_gen_id);
+    TReader::TIndexFile idx_file(&reader, int_idx, RealTime);
+    TReader::TArena idx_arena(&idx_file, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+    cout << endl << "[" << idx_file.GetNumKeyFences() << "] key fences over [" << num_iter << "] keys" << endl;
+    for (bool use_fences : {false, true}) {
+      TStream<Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::PhysicalBlockSize, Orly::Indy::Disk::Util::PageCheckedBlock, 0UL> in_stream(HERE, Source::PresentWalk, RealTime, &reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), 0);
+      size_t out_offset;
+      size_t matched = 0UL;
+      /* seek to the odd keys, which aren't in the file, so every seek has to find its lower bound */
+      const size_t start_fetch_count = in_stream.GetFetchCount();
+      Base::TTimer timer;
+      timer.Start();
+      for (int64_t i = 0; i < num_seeks; ++i) {
+        TSuprena arena;
+        const int64_t val = ((i * 7919L) % (num_iter - 1L)) * 2L + 1L;
+        if (idx_file.BinaryLowerBoundOnKey(TKey(make_tuple(val), &arena, state_alloc), out_offset, in_stream, &idx_arena, use_fences)) {
+          matched += (out_offset == idx_file.GetByteOffsetOfKeyIndex() + ((val + 1L) / 2L) * TData::KeyEntrySize) ? 1UL : 0UL;
+        }
+      }
+      timer.Stop();
+      const size_t num_fetches = in_stream.GetFetchCount() - start_fetch_count;
+      EXPECT_EQ(matched, static_cast<size_t>(num_seeks));
+      cout << (use_fences ? "With" : "Without") << " key fences" << endl
+           << "\t[" << ::Util::ToSecondsDouble(timer.GetTotal()) << "s]\t[" << (::Util::ToSecondsDouble(timer.GetTotal()) / num_seeks) << "s / seek]\t["
+           << (static_cast<double>(num_fetches) / num_seeks) << " pages / seek]" << endl;
+    }
+    GracefullShutdown();
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
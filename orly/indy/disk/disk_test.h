@@ -85,6 +85,7 @@ namespace Orly {
 
         using TReadFile::GetNumBytesOfArena;
         using TReadFile::GetNumUpdates;
+        using TReadFile::GetMetaVersion;
         using TReadFile::GetNumArenaNotes;
         using TReadFile::GetGenId;
         using TReadFile::GetTypeBoundaryOffsetVec;
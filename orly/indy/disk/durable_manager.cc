@@ -18,6 +18,8 @@
 
 #include <orly/indy/disk/durable_manager.h>
 
+#include <thread>
+
 #include <base/booster.h>
 #include <orly/indy/disk/util/hash_util.h>
 #include <util/time.h>
@@ -48,7 +50,7 @@ TDurableManager::TMapping::~TMapping() {
   EntryCollection.DeleteEachMember();
 }
 
-void TDurableManager::TMemSlushLayer::FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, std::string &serialized_form_out) const {
+void TDurableManager::TMemSlushLayer::FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, Durable::TBlob &serialized_form_out) const {
   assert(this);
   for (TEntryCollection::TCursor csr(&EntryCollection); csr; ++csr) {
     int uuid_comp = uuid_compare(csr->GetId(), id.GetRaw());
@@ -109,6 +111,7 @@ TDurableManager::TDurableManager(TScheduler *scheduler,
       WriterFrame(nullptr),
       Engine(engine),
       CurMemoryLayer(new TMemSlushLayer(this)),
+      GroupCommit(write_delay, MaxSaveBatchSize),
       SeqNum(1UL),
       NextSlushGenId(1UL),
       NextDurableByIdGenId(1UL),
@@ -207,7 +210,7 @@ void TDurableManager::RunLayerCleaner() {
 
 bool TDurableManager::CanLoad(const Durable::TId &id) {
   TSequenceNumber cur_max_seq_num = 0UL;
-  std::string serialized_form_out;
+  Durable::TBlob serialized_form_out;
   TMapping::TView view(this);
   view.GetCurLayer()->FindMax(cur_max_seq_num, id, serialized_form_out);
   for (TMapping::TEntryCollection::TCursor csr(view.GetMapping()->GetEntryCollection()); csr; ++csr) {
@@ -221,22 +224,24 @@ void TDurableManager::Delete(const Durable::TId &/*id*/, Durable::TSem */*sem*/)
   throw;
 }
 
-void TDurableManager::Save(const Durable::TId &id, const Durable::TDeadline &deadline, const Durable::TTtl &ttl, const std::string &serialized_form, Durable::TSem *sem) {
+void TDurableManager::Save(const Durable::TId &id, const Durable::TDeadline &deadline, const Durable::TTtl &ttl, const Durable::TBlob &serialized_form, Durable::TSem *sem) {
   assert(this);
-  assert(serialized_form.size() > 0);
-  if (serialized_form.size() >= UINT32_MAX) {
+  assert(serialized_form);
+  assert(serialized_form->size() > 0);
+  if (serialized_form->size() >= UINT32_MAX) {
     throw std::runtime_error("Serialized Durable size >= UINT32_MAX");
   }
   TDurableReplication *durable_replication = Manager->NewDurableReplication(id, ttl, serialized_form);
   try {
-    std::string temp = serialized_form;
     /* acquire data lock */ {
       std::lock_guard<std::mutex> data_lock(DataLock);
       TSequenceNumber new_seq_num = ++SeqNum;
       assert(CurMemoryLayer);
-      new TMemSlushLayer::TDurableEntry(CurMemoryLayer, id, deadline, std::move(temp), new_seq_num);
+      new TMemSlushLayer::TDurableEntry(CurMemoryLayer, id, deadline, serialized_form, new_seq_num);
+      GroupCommit.Arrive(PendingSaves);
       Manager->EnqueueDurable(durable_replication);
     }  // release data lock
+    PendingSavesChanged.notify_one();
     SlushSem.Push();
     //SlushCounter.Push();
     /* TODO : we should only call the sem once we've actually written to disk! */
@@ -247,7 +252,7 @@ void TDurableManager::Save(const Durable::TId &id, const Durable::TDeadline &dea
   }
 }
 
-bool TDurableManager::TryLoad(const Durable::TId &id, std::string &serialized_form_out) {
+bool TDurableManager::TryLoad(const Durable::TId &id, Durable::TBlob &serialized_form_out) {
   TSequenceNumber cur_max_seq_num = 0UL;
   TMapping::TView view(this);
   view.GetCurLayer()->FindMax(cur_max_seq_num, id, serialized_form_out);
@@ -286,10 +291,22 @@ void TDurableManager::RunWriter() {
     Disk::Util::TDiskController::TEvent::LocalEventPool = new TThreadLocalGlobalPoolManager<Disk::Util::TDiskController::TEvent>::TThreadLocalPool(Disk::Util::TDiskController::TEvent::DiskEventPoolManager.get());
   }
   Disk::Util::TVolume::TDesc::TStorageSpeed storage_speed = Disk::Util::TVolume::TDesc::TStorageSpeed::Fast;
-  TFlush next_flush(DurableWriteDelay);
+  Indy::Util::TGroupCommit::TBatch batch;
   SlushSem.Pop();
   for (;!ShutDown; SlushSem.Pop()) {
-    next_flush.WaitFor();
+    /* Wait until the group commit policy says the pending saves should go.  Each save wakes us to ask again, since it
+       may have filled the batch to MaxSaveBatchSize or otherwise brought the flush time in. */
+    /* acquire DataLayer lock */ {
+      std::unique_lock<std::mutex> data_lock(DataLock);
+      for (;;) {
+        const auto flush_time = GroupCommit.GetFlushTime(PendingSaves);
+        if (flush_time == Indy::Util::TGroupCommit::TTime::max() || flush_time <= chrono::steady_clock::now()) {
+          break;
+        }
+        /* This is a dedicated runner, so it's all right to block the thread. */
+        PendingSavesChanged.wait_until(data_lock, flush_time);
+      }
+    }  // release DataLayer lock
 
     TMemSlushLayer *old_mem_layer = nullptr;
     /* acquire DataLayer lock */ {
@@ -299,10 +316,12 @@ void TDurableManager::RunWriter() {
         old_mem_layer = CurMemoryLayer;
         AddMapping(CurMemoryLayer);
         CurMemoryLayer = new TMemSlushLayer(this);
+        batch.Swap(PendingSaves);
       }
     }  // release DataLayer lock
 
     if (old_mem_layer) {
+      const auto start = chrono::steady_clock::now();
       auto now = Durable::TDeadline::clock::now();
       size_t gen_id = ++NextDurableByIdGenId;
       TSortedByIdFile sorted_by_id_file(old_mem_layer,
@@ -336,6 +355,7 @@ void TDurableManager::RunWriter() {
           throw;
         }
       }  // release Mapping lock
+      GroupCommit.OnFlushed(batch, start);
     }
   }
   WriterFinishedSem.Push();
@@ -542,7 +562,7 @@ TDurableManager::TSortedByIdFile::TSortedByIdFile(TMemSlushLayer *mem_layer,
           out_stream << (*csr).GetSeqNum();  // seq_num
           out_stream << (*csr).GetDeadlineCount();  // deadline_count
           out_stream << (*csr).GetSerializedSize();  // size of serialized string
-          out_stream.Write((*csr).GetSerializedForm().data(), serialized_size); /* the serialized string. */
+          out_stream.Write((*csr).GetSerializedForm()->data(), serialized_size); /* the serialized string. */
           hash_sorter.Emplace(cur_id, id_hash % num_hash_fields, key_offset);
           key_offset += DurableEntrySize + serialized_size;
         }
@@ -730,7 +750,7 @@ size_t TDurableManager::TSortedInFile::FindPageIdOfByte(size_t offset) const {
   }
 }
 
-void TDurableManager::TSortedInFile::FindInHash(TSequenceNumber &cur_max_seq_num, const Durable::TId &id, std::string &serialized_form_out) const {
+void TDurableManager::TSortedInFile::FindInHash(TSequenceNumber &cur_max_seq_num, const Durable::TId &id, Durable::TBlob &serialized_form_out) const {
   assert(this);
   assert(&id);
   assert(&serialized_form_out);
@@ -761,8 +781,9 @@ void TDurableManager::TSortedInFile::FindInHash(TSequenceNumber &cur_max_seq_num
           cur_max_seq_num = cur_seq;
           InStream->Read(cur_deadline);
           InStream->Read(cur_serialized_size);
-          serialized_form_out.resize(cur_serialized_size);
-          InStream->Read(const_cast<char *>(serialized_form_out.data()), cur_serialized_size);
+          auto serialized_form = std::make_shared<std::string>(cur_serialized_size, '\0');
+          InStream->Read(&(*serialized_form)[0], cur_serialized_size);
+          serialized_form_out = std::move(serialized_form);
         }
         return;
       } else if (*reinterpret_cast<size_t *>(const_cast<unsigned char *>(cur_id)) % HashFieldSize > hash) {
@@ -793,8 +814,9 @@ void TDurableManager::TSortedInFile::FindInHash(TSequenceNumber &cur_max_seq_num
             cur_max_seq_num = cur_seq;
             InStream->Read(cur_deadline);
             InStream->Read(cur_serialized_size);
-            serialized_form_out.resize(cur_serialized_size);
-            InStream->Read(const_cast<char *>(serialized_form_out.data()), cur_serialized_size);
+            auto serialized_form = std::make_shared<std::string>(cur_serialized_size, '\0');
+            InStream->Read(&(*serialized_form)[0], cur_serialized_size);
+            serialized_form_out = std::move(serialized_form);
           }
           return;
         } else if (*reinterpret_cast<size_t *>(const_cast<unsigned char *>(cur_id)) % HashFieldSize > hash) {
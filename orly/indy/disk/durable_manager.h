@@ -19,6 +19,7 @@
 #pragma once
 
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
 
@@ -37,6 +38,7 @@
 #include <orly/indy/disk/util/index_manager.h>
 #include <orly/indy/replication.h>
 #include <orly/indy/util/block_vec.h>
+#include <orly/indy/util/group_commit.h>
 #include <orly/indy/util/lockless_pool.h>
 #include <orly/indy/util/pool.h>
 
@@ -70,7 +72,7 @@ namespace Orly {
         public:
 
         /* TODO */
-        virtual TDurableReplication *NewDurableReplication(const Durable::TId &id, const Durable::TTtl &ttl, const std::string &serialized_form) const = 0;
+        virtual TDurableReplication *NewDurableReplication(const Durable::TId &id, const Durable::TTtl &ttl, const Durable::TBlob &serialized_form) const = 0;
 
         /* TODO */
         virtual void DeleteDurableReplication(TDurableReplication *durable_replication) NO_THROW = 0;
@@ -166,14 +168,20 @@ namespace Orly {
         virtual void RunLayerCleaner() override;
 
         /* TODO */
-        virtual void Save(const Durable::TId &id, const Durable::TDeadline &deadline, const TTtl &ttl, const std::string &serialized_form, Durable::TSem *sem) override;
+        virtual void Save(const Durable::TId &id, const Durable::TDeadline &deadline, const TTtl &ttl, const Durable::TBlob &serialized_form, Durable::TSem *sem) override;
 
         /* TODO */
-        virtual bool TryLoad(const Durable::TId &id, std::string &serialized_form_out) override;
+        virtual bool TryLoad(const Durable::TId &id, Durable::TBlob &serialized_form_out) override;
 
         /* TODO */
         void RunWriter();
 
+        /* Copy out and reset the stats on how saves have been grouped into flushes. */
+        void TakeGroupCommitStats(Indy::Util::TGroupCommit::TStats &out) {
+          assert(this);
+          GroupCommit.TakeStats(out);
+        }
+
         /* TODO */
         void RunMerger();
 
@@ -455,7 +463,7 @@ namespace Orly {
           inline size_t GetStartOfHashIndex() const;
 
           /* TODO */
-          void FindInHash(TSequenceNumber &cur_max_seq_num, const Durable::TId &id, std::string &serialized_form_out) const;
+          void FindInHash(TSequenceNumber &cur_max_seq_num, const Durable::TId &id, Durable::TBlob &serialized_form_out) const;
 
           private:
 
@@ -685,7 +693,7 @@ namespace Orly {
           inline void MarkForDelete();
 
           /* TODO */
-          virtual void FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, std::string &serialized_form_out) const = 0;
+          virtual void FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, Durable::TBlob &serialized_form_out) const = 0;
 
           /* TODO */
           static void *operator new(size_t size) {
@@ -775,7 +783,7 @@ namespace Orly {
             typedef InvCon::OrderedList::TMembership<TDurableEntry, TMemSlushLayer, TDurableEntry::TKey> TSlushMembership;
 
             /* TODO */
-            inline TDurableEntry(TMemSlushLayer *mem_layer, const Base::TUuid &id, const Durable::TDeadline &deadline, std::string &&serialized_form, TSequenceNumber seq_num);
+            inline TDurableEntry(TMemSlushLayer *mem_layer, const Base::TUuid &id, const Durable::TDeadline &deadline, const Durable::TBlob &serialized_form, TSequenceNumber seq_num);
 
             /* TODO */
             inline const uuid_t &GetId() const;
@@ -790,7 +798,7 @@ namespace Orly {
             inline TSerializedSize GetSerializedSize() const;
 
             /* TODO */
-            inline const std::string &GetSerializedForm() const;
+            inline const Durable::TBlob &GetSerializedForm() const;
 
             /* TODO */
             static void *operator new(size_t size) {
@@ -810,8 +818,8 @@ namespace Orly {
             /* TODO */
             const size_t DeadlineCount;
 
-            /* TODO */
-            std::string SerializedForm;
+            /* Shared with the manager's caller and the replication queue.  Never null. */
+            const Durable::TBlob SerializedForm;
 
             /* TODO */
             static Indy::Util::TPool Pool;
@@ -847,7 +855,7 @@ namespace Orly {
           inline TEntryCollection *GetEntryCollection() const;
 
           /* TODO */
-          virtual void FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, std::string &serialized_form_out) const;
+          virtual void FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, Durable::TBlob &serialized_form_out) const;
 
           private:
 
@@ -890,7 +898,7 @@ namespace Orly {
           inline size_t GetNumDurable() const;
 
           /* TODO */
-          virtual void FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, std::string &serialized_form_out) const;
+          virtual void FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, Durable::TBlob &serialized_form_out) const;
 
           private:
 
@@ -923,6 +931,18 @@ namespace Orly {
         std::mutex DataLock;
         TMemSlushLayer *CurMemoryLayer;
 
+        /* The saves in CurMemoryLayer, waiting for the writer.  Covered by DataLock. */
+        Indy::Util::TGroupCommit::TBatch PendingSaves;
+
+        /* Decides when the writer flushes PendingSaves. */
+        Indy::Util::TGroupCommit GroupCommit;
+
+        /* Signalled by each save, so the writer can look again at when to flush.  Waited on with DataLock. */
+        std::condition_variable PendingSavesChanged;
+
+        /* Flush as soon as this many saves are pending, however busy we are. */
+        static constexpr size_t MaxSaveBatchSize = 4096UL;
+
         /* TODO */
         TSequenceNumber SeqNum;
 
@@ -1133,13 +1153,14 @@ namespace Orly {
       inline TDurableManager::TMemSlushLayer::TDurableEntry::TDurableEntry(TMemSlushLayer *mem_layer,
                                                                            const Base::TUuid &id,
                                                                            const Durable::TDeadline &deadline,
-                                                                           std::string &&serialized_form,
+                                                                           const Durable::TBlob &serialized_form,
                                                                            TSequenceNumber seq_num)
           : SlushMembership(this, TKey(id.GetRaw(), seq_num)),
-            DeadlineCount(deadline.time_since_epoch().count()) {
-        std::swap(SerializedForm, serialized_form);
+            DeadlineCount(deadline.time_since_epoch().count()),
+            SerializedForm(serialized_form) {
+        assert(serialized_form);
         ++(mem_layer->NumEntries);
-        mem_layer->TotalSerializedSize += SerializedForm.size();
+        mem_layer->TotalSerializedSize += SerializedForm->size();
         SlushMembership.Insert(mem_layer->GetEntryCollection());
       }
 
@@ -1160,10 +1181,10 @@ namespace Orly {
 
       inline TDurableManager::TSerializedSize TDurableManager::TMemSlushLayer::TDurableEntry::GetSerializedSize() const {
         assert(this);
-        return SerializedForm.size();
+        return SerializedForm->size();
       }
 
-      inline const std::string &TDurableManager::TMemSlushLayer::TDurableEntry::GetSerializedForm() const {
+      inline const Durable::TBlob &TDurableManager::TMemSlushLayer::TDurableEntry::GetSerializedForm() const {
         assert(this);
         return SerializedForm;
       }
@@ -1171,7 +1192,7 @@ namespace Orly {
       inline TDurableManager::TDiskOrderedLayer::TDiskOrderedLayer(TDurableManager *manager, Util::TEngine *engine, size_t gen_id, size_t num_durable)
           : TDurableLayer(manager), Engine(engine), GenId(gen_id), NumDurable(num_durable) {}
 
-      inline void TDurableManager::TDiskOrderedLayer::FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, std::string &serialized_form_out) const {
+      inline void TDurableManager::TDiskOrderedLayer::FindMax(TSequenceNumber &cur_max_seq, const Base::TUuid &id, Durable::TBlob &serialized_form_out) const {
         assert(this);
         TSortedInFile(Engine, RealTime, GenId).FindInHash(cur_max_seq, id, serialized_form_out);
       }
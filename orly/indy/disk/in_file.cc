@@ -23,4 +23,10 @@ using namespace Orly::Indy::Disk;
 
 static_assert(sizeof(TCore) == 24, "NullCore must be set to right number of zero'd out bytes");
 const uint8_t TData::NullCore[sizeof(TCore)] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-const TCore TData::TombstoneCore = TData::GetTombstoneCore();
\ No newline at end of file
+const TCore TData::TombstoneCore = TData::GetTombstoneCore();
+const size_t TData::BaselineMetaVersion;
+const size_t TData::BloomFilterMetaVersion;
+const size_t TData::BucketedHashMetaVersion;
+const size_t TData::KeyFenceMetaVersion;
+const size_t TData::ArenaCodecMetaVersion;
+const size_t TData::CurrentMetaVersion;
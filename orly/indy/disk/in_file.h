@@ -19,12 +19,16 @@
 #pragma once
 
 #include <cassert>
+#include <syslog.h>
+
+#include <stdexcept>
 
 #include <base/class_traits.h>
 #include <base/mini_cache.h>
 #include <orly/atom/kit2.h>
 #include <orly/atom/suprena.h>
 #include <orly/indy/disk/util/engine.h>
+#include <orly/indy/disk/util/hash_util.h>
 #include <orly/indy/sequence_number.h>
 
 namespace Orly {
@@ -47,15 +51,41 @@ namespace Orly {
         /* TODO */
         static const size_t HashEntrySize = sizeof(Atom::TCore) + sizeof(size_t);
 
+        /* A key fence is the position of the first key entry which starts in a given logical block, followed by that key.
+           Readers keep the fences in memory so that a lower bound search only has to look inside one block. */
+        static const size_t KeyFenceSize = sizeof(size_t) + sizeof(Atom::TCore);
+
         /* TODO */
         static const size_t UpdateEntrySize = sizeof(TSequenceNumber) + sizeof(Atom::TCore) + sizeof(Atom::TCore) + sizeof(size_t) + sizeof(size_t);
 
         /* TODO */
         static const size_t UpdateKeyPtrSize = sizeof(size_t);
 
-        /* TODO */
-        static const size_t NumMetaFields = 10U;
+        /* Files written before the meta data was versioned start it with their # of blocks.  Newer files start it with
+           MetaVersionTag | their meta version instead.  No file comes anywhere near 2^32 blocks, so the top half of
+           the first word tells the two apart. */
+        static const size_t MetaVersionTag = 0x4D45544100000000UL;  // "META"
+
+        /* The low half of the first meta word of a versioned file. */
+        static const size_t MetaVersionMask = 0x00000000FFFFFFFFUL;
+
+        /* The meta versions.  Each adds to the layout of the one before it; the fields below are marked with the
+           version which brought them in. */
+        static const size_t
+            BaselineMetaVersion = 0UL,  // no version word
+            BloomFilterMetaVersion = 1UL,  // the version word, bloom filters
+            BucketedHashMetaVersion = 2UL,  // hash index versions, hash index triples
+            KeyFenceMetaVersion = 3UL,  // key fences
+            ArenaCodecMetaVersion = 4UL,  // arena codec, arena chunk tables
+            CurrentMetaVersion = ArenaCodecMetaVersion;
+
+        /* The number of file meta fields in a file which predates versioning. */
+        static const size_t NumBaselineMetaFields = 10U;
+
+        /* The number of file meta fields in a file we write. */
+        static const size_t NumMetaFields = 14U;
         /*
+           0.  MetaVersionTag | meta version (v1)
            1.  # of blocks
            2.  # of meta-blocks (n)
            3.  # of #block / block_id pairings (number of sequential blocks starting at) (m)
@@ -66,11 +96,14 @@ namespace Orly {
            8.  # of arena type boundaries
            9.  offset of main arena
            10.  offset of update index
+           11.  arena codec (Util::TCodecKind) (v4)
+           12.  offset of main arena chunk table (0 if the codec is none) (v4)
+           13.  # of main arena chunks (v4)
 
         */
 
         /* TODO */
-        static const size_t NumIndexMetaFields = 8U;
+        static const size_t NumIndexMetaFields = 16U;
         /*
            Offset of Arena
            # arena notes
@@ -80,10 +113,50 @@ namespace Orly {
            # History Keys
            Current Key Offset
            # of hash indexes (n)
-
-           (n) (size_t) -> (size_t) hash index offset -> num hash fields pairings
+           Offset of bloom filter (v1)
+           # bloom filter bits (0 if the index has no filter) (v1)
+           # bloom filter probes (v1)
+           Hash index version (Util::LinearProbeHashIndex or Util::BucketedHashIndex) (v2)
+           Offset of key fences (v3)
+           # key fences (f) (v3)
+           Offset of arena chunk table (0 if the file's codec is none) (v4)
+           # arena chunks (v4)
+
+           (n) (size_t, size_t, size_t) hash index offset, num hash fields (home buckets if bucketed), offset of
+               bucketed entries (0 if linear probe) triples (v2; (offset, num hash fields) pairs before that)
         */
 
+        /* The number of size_t fields describing each hash index in the index meta data. */
+        static const size_t NumHashIndexMetaFields = 3U;
+
+        /* The first meta word of a file we write. */
+        static constexpr size_t GetMetaVersionWord() {
+          return MetaVersionTag | CurrentMetaVersion;
+        }
+
+        /* The meta version of a file, given the first word of its meta data.  Throws if the version is newer than we
+           know, which means the file was written by a newer version of the server. */
+        static size_t GetMetaVersion(size_t first_word) {
+          if ((first_word & ~MetaVersionMask) != MetaVersionTag) {
+            return BaselineMetaVersion;
+          }
+          const size_t meta_version = first_word & MetaVersionMask;
+          if (meta_version > CurrentMetaVersion) {
+            syslog(LOG_ERR, "TData::GetMetaVersion() unknown meta version [%ld]", meta_version);
+            throw std::runtime_error("unknown data file meta version");
+          }
+          return meta_version;
+        }
+
+        /* The number of file meta fields in the given version. */
+        static size_t GetNumMetaFields(size_t meta_version) {
+          if (meta_version == BaselineMetaVersion) {
+            return NumBaselineMetaFields;
+          }
+          /* the version word, then the codec fields from v4 on */
+          return meta_version < ArenaCodecMetaVersion ? NumBaselineMetaFields + 1U : NumMetaFields;
+        }
+
         /* TODO */
         static const uint8_t NullCore[sizeof(Atom::TCore)];
 
@@ -137,12 +210,13 @@ namespace Orly {
         static constexpr size_t PhysicalDataChunkSize = Util::GetPhysicalDataChunkSize<BufKind>();
         static constexpr size_t PhysicalCachePageSize = PhysicalBlockSize / (BlockSize / CachePageSize);
 
-        /* TODO */
-        TStream(const Base::TCodeLocation &code_location /* DEBUG */, uint8_t util_src, DiskPriority priority, const TInFile *file, Util::TCache<PhysicalCachePageSize> *cache, size_t byte_offset/*, bool scan_ahead_allowed = true*/)
-            : TStream(code_location, util_src, priority, file->GetFileLength(), file, cache, byte_offset/*, scan_ahead_allowed*/) {}
+        /* A stream which reads its way through the file once, and won't be back for the pages, can pass dont_cache so the
+           cache reclaims them first (see TCache::Get()). */
+        TStream(const Base::TCodeLocation &code_location /* DEBUG */, uint8_t util_src, DiskPriority priority, const TInFile *file, Util::TCache<PhysicalCachePageSize> *cache, size_t byte_offset, bool dont_cache = false/*, bool scan_ahead_allowed = true*/)
+            : TStream(code_location, util_src, priority, file->GetFileLength(), file, cache, byte_offset, dont_cache/*, scan_ahead_allowed*/) {}
 
         /* TODO */
-        TStream(const Base::TCodeLocation &code_location /* DEBUG */, uint8_t util_src, DiskPriority priority, size_t end_of_stream, const TInFile *file, Util::TCache<PhysicalCachePageSize> *cache, size_t byte_offset/*, bool scan_ahead_allowed = true*/)
+        TStream(const Base::TCodeLocation &code_location /* DEBUG */, uint8_t util_src, DiskPriority priority, size_t end_of_stream, const TInFile *file, Util::TCache<PhysicalCachePageSize> *cache, size_t byte_offset, bool dont_cache = false/*, bool scan_ahead_allowed = true*/)
             : File(file),
               Cache(cache),
               EndOfStream(end_of_stream),
@@ -153,9 +227,11 @@ namespace Orly {
               BufData(nullptr),
               FetchCount(0U),
               NumSequentialFetch(0UL),
+              ReadAheadWindow(0UL),
               PrefetchedTo(0UL),
               LastFetched(0UL),
               Priority(priority),
+              DontCache(dont_cache),
               DiskResult(Success),
               DiskErrStr(nullptr),
               CodeLocation(code_location),
@@ -179,7 +255,7 @@ namespace Orly {
           if (MaxLocalCacheSize > 0) {
             /* do-little: LocalBufCache releases cache state correctly */
           } else if (MainSlot) {
-            Cache->Release(MainSlot, LoadedPageId);
+            Cache->Release(MainSlot, LoadedPageId, Priority, DontCache);
           }
         }
 
@@ -422,7 +498,7 @@ namespace Orly {
           assert(this);
           ByteOffset = -1;
           if (MainSlot) {
-            Cache->Release(MainSlot, LoadedPageId);
+            Cache->Release(MainSlot, LoadedPageId, Priority, DontCache);
             MainSlot = nullptr;
             DataSlot = nullptr;
           }
@@ -430,26 +506,29 @@ namespace Orly {
 
         private:
 
-        /* TODO */
+        /* Keep a window of pages loading ahead of a sequential scan.  The window opens at 4 pages on the second
+           sequential fetch and doubles each time the run grows as long as the window, up to the cache's read-ahead
+           limit.  A jump anywhere else closes it again (see FetchBuf()). */
         void PrefetchNextPage(size_t offset) {
           ++NumSequentialFetch;
-          size_t num_keep_prefetched = 0UL;
-          if (NumSequentialFetch > 16) {
-            /* 17 - 32 sequential reads; keep 32 ahead */
-            num_keep_prefetched = 32UL;
-          } else if (NumSequentialFetch > 4) {
-            /* 5 - 16 sequential reads; keep 8 ahead */
-            num_keep_prefetched = 8UL;
-          } else if (NumSequentialFetch > 1) {
-            /* 2 - 4 sequential reads; keep 4 ahead */
-            num_keep_prefetched = 4UL;
+          const size_t max_read_ahead = Cache->GetMaxReadAhead();
+          if (NumSequentialFetch > 1 && max_read_ahead) {
+            if (!ReadAheadWindow) {
+              ReadAheadWindow = 4UL;
+            } else if (NumSequentialFetch >= ReadAheadWindow) {
+              ReadAheadWindow *= 2UL;
+            }
+            ReadAheadWindow = std::min(ReadAheadWindow, max_read_ahead);
           }
+          const size_t num_keep_prefetched = max_read_ahead ? ReadAheadWindow : 0UL;
           if (num_keep_prefetched > 0) {
             const size_t starting_offset = std::max(PrefetchedTo, offset / CachePageSize);
             const size_t ending_offset = std::min((offset / CachePageSize) + num_keep_prefetched, (EndOfStream - 1) / CachePageSize);
-            const size_t num_pages_to_prefetch = ending_offset - starting_offset;
-            if (num_pages_to_prefetch >= num_keep_prefetched / 2) {
+            /* the limit may have come down under us, leaving us already prefetched past the end of the window */
+            const size_t num_pages_to_prefetch = (ending_offset > starting_offset) ? ending_offset - starting_offset : 0UL;
+            if (num_pages_to_prefetch && num_pages_to_prefetch >= num_keep_prefetched / 2) {
               PrefetchedTo = ending_offset;
+              Cache->CountReadAhead(num_pages_to_prefetch);
               /* === We're using these variables to figure out how many async pages we can grab at once === */
               size_t consec_starting_page_id = -1;
               size_t consec_next_page_id = -1;
@@ -491,9 +570,13 @@ namespace Orly {
           /* if this offset_block comes sequentially after the one we were on, then we record a sequential access. */
           if (ScanAheadAllowed) {
             if ((offset / CachePageSize) == (LastFetched + 1)) {
+              if ((offset / CachePageSize) < PrefetchedTo) {
+                Cache->CountReadAheadHit();
+              }
               PrefetchNextPage(offset);
             } else {
               NumSequentialFetch = 0UL;
+              ReadAheadWindow = 0UL;
               PrefetchedTo = offset / CachePageSize;
             }
           }
@@ -505,9 +588,9 @@ namespace Orly {
               BufData = DataSlot->KnownGetData(Cache);
             } else {
               try {
-                MainSlot = Cache->Get(page_id, DataSlot);
+                MainSlot = Cache->Get(page_id, DataSlot, Priority, false, DontCache);
                 BufData = DataSlot->SyncGetData(CodeLocation, Priority, Cache, BufKind, UtilSrc, page_id, SyncTrigger);
-                LocalBufCache.Emplace(std::forward_as_tuple(page_id), std::forward_as_tuple(page_id, Cache, MainSlot, DataSlot));
+                LocalBufCache.Emplace(std::forward_as_tuple(page_id), std::forward_as_tuple(page_id, Cache, MainSlot, DataSlot, Priority, DontCache));
               } catch (const Disk::TDiskFailure &err) {
                 MainSlot = nullptr;
                 DataSlot = nullptr;
@@ -520,10 +603,10 @@ namespace Orly {
             }
           } else {
             if (MainSlot) {
-              Cache->Release(MainSlot, prev_loaded_page_id);
+              Cache->Release(MainSlot, prev_loaded_page_id, Priority, DontCache);
             }
             try {
-              MainSlot = Cache->Get(page_id, DataSlot);
+              MainSlot = Cache->Get(page_id, DataSlot, Priority, false, DontCache);
               BufData = DataSlot->SyncGetData(CodeLocation, Priority, Cache, BufKind, UtilSrc, page_id, SyncTrigger);
             } catch (const Disk::TDiskFailure &err) {
               MainSlot = nullptr;
@@ -582,19 +665,25 @@ namespace Orly {
           TSlotStruct(size_t page_id,
                       Util::TCache<PhysicalCachePageSize> *cache,
                       typename Util::TCache<PhysicalCachePageSize>::TSlot *main_slot,
-                      typename Util::TCache<PhysicalCachePageSize>::TSlot *data_slot)
+                      typename Util::TCache<PhysicalCachePageSize>::TSlot *data_slot,
+                      DiskPriority priority,
+                      bool dont_cache)
               : PageId(page_id),
                 Cache(cache),
                 MainSlot(main_slot),
-                DataSlot(data_slot) {}
+                DataSlot(data_slot),
+                Priority(priority),
+                DontCache(dont_cache) {}
           ~TSlotStruct() {
             assert(this);
-            Cache->Release(MainSlot, PageId);
+            Cache->Release(MainSlot, PageId, Priority, DontCache);
           }
           const size_t PageId;
           Util::TCache<PhysicalCachePageSize> *const Cache;
           typename Util::TCache<PhysicalCachePageSize>::TSlot *const MainSlot;
           typename Util::TCache<PhysicalCachePageSize>::TSlot *const DataSlot;
+          const DiskPriority Priority;
+          const bool DontCache;
         };
         Base::TMiniCache<MaxLocalCacheSize, size_t, TSlotStruct> LocalBufCache;
 
@@ -604,6 +693,9 @@ namespace Orly {
         /* TODO */
         size_t NumSequentialFetch;
 
+        /* The number of pages we're keeping loading ahead of us.  See PrefetchNextPage(). */
+        size_t ReadAheadWindow;
+
         /* TODO */
         size_t PrefetchedTo;
 
@@ -617,6 +709,9 @@ namespace Orly {
         /* TODO */
         DiskPriority Priority;
 
+        /* True iff we asked the cache not to keep our pages. */
+        const bool DontCache;
+
         /* TODO */
         TDiskResult DiskResult;
         const char *DiskErrStr;
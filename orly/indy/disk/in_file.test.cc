@@ -109,4 +109,74 @@ FIXTURE(Stream) {
     fin = true;
     cond.notify_one();
   });
-}
\ No newline at end of file
+}
+FIXTURE(ReadAhead) {
+  Orly::Indy::Fiber::TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Orly::Indy::Fiber::TRunner::TRunnerCons &) {
+    const TScheduler::TPolicy scheduler_policy(4, 10, milliseconds(10));
+    TScheduler scheduler;
+    scheduler.SetPolicy(scheduler_policy);
+    Sim::TMemEngine mem_engine(&scheduler,
+                               64 /* disk space: 64 MB */,
+                               16,
+                               4096 /* page cache slots: 1GB */,
+                               1 /* num page lru */,
+                               16 /* block cache slots: 1GB */,
+                               1 /* num block lru */);
+
+    const size_t num_blocks_to_write = 8UL;
+
+    Orly::Indy::Util::TBlockVec block_vec;
+    mem_engine.GetEngine()->AppendReserveBlocks(TVolume::TDesc::Fast, num_blocks_to_write, block_vec);
+    unordered_map<size_t, shared_ptr<const TBufBlock>> collision_map {};
+    TCompletionTrigger trigger;
+
+    const size_t num_to_write = (num_blocks_to_write * LogicalBlockSize) / sizeof(size_t);
+
+    /* stream data out */ {
+      std::unordered_set<size_t> written_block_set{};
+      TDataOutStream out_stream(HERE, 0UL, mem_engine.GetVolMan(), 0UL, block_vec, collision_map,
+                                trigger, RealTime, false
+                                #ifndef NDEBUG
+                                ,written_block_set
+                                #endif
+                                );
+      for (size_t i = 0; i < num_to_write; ++i) {
+        out_stream << i;
+      }
+    }
+    TMyInFile in_file(block_vec);
+    auto *page_cache = mem_engine.GetPageCache();
+    TCacheStats stats;
+    /* A sequential scan reads ahead of itself and then fetches the pages it read ahead. */ {
+      page_cache->TakeStats(stats);
+      /* scope */ {
+        TDataInStream in_stream(HERE, 0UL, RealTime, &in_file, page_cache, 0UL);
+        size_t in_val;
+        for (size_t i = 0; i < num_to_write; ++i) {
+          in_stream.Read(in_val);
+          EXPECT_EQ(in_val, i);
+        }
+      }
+      page_cache->TakeStats(stats);
+      EXPECT_LE(stats.NumReadAheadPages, num_blocks_to_write * PagesPerBlock);
+      EXPECT_LT(stats.NumReadAheadPages / 2, stats.NumReadAheadHits);
+    }
+    /* With read-ahead off, it just reads. */ {
+      page_cache->SetMaxReadAhead(0UL);
+      /* scope */ {
+        TDataInStream in_stream(HERE, 0UL, RealTime, &in_file, page_cache, 0UL);
+        size_t in_val;
+        for (size_t i = 0; i < num_to_write; ++i) {
+          in_stream.Read(in_val);
+          EXPECT_EQ(in_val, i);
+        }
+      }
+      page_cache->TakeStats(stats);
+      EXPECT_EQ(stats.NumReadAheadPages, 0UL);
+      EXPECT_EQ(stats.NumReadAheadHits, 0UL);
+    }
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
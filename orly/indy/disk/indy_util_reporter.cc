@@ -94,6 +94,9 @@ const char *TIndyUtilReporter::GetName(uint8_t source) const {
     case DataFileArena: {
       return "DataFileArena";
     }
+    case DataFileBloomFilter: {
+      return "DataFileBloomFilter";
+    }
     case DataFileHash: {
       return "DataFileHash";
     }
@@ -106,6 +109,9 @@ const char *TIndyUtilReporter::GetName(uint8_t source) const {
     case DataFileKey: {
       return "DataFileKey";
     }
+    case DataFileKeyFence: {
+      return "DataFileKeyFence";
+    }
     case DataFileMeta: {
       return "DataFileMeta";
     }
@@ -169,6 +175,9 @@ const char *TIndyUtilReporter::GetName(uint8_t source) const {
     case MergeDataFileArena: {
       return "MergeDataFileArena";
     }
+    case MergeDataFileBloomFilter: {
+      return "MergeDataFileBloomFilter";
+    }
     case MergeDataFileHash: {
       return "MergeDataFileHash";
     }
@@ -181,6 +190,9 @@ const char *TIndyUtilReporter::GetName(uint8_t source) const {
     case MergeDataFileKey: {
       return "MergeDataFileKey";
     }
+    case MergeDataFileKeyFence: {
+      return "MergeDataFileKeyFence";
+    }
     case MergeDataFileMeta: {
       return "MergeDataFileMeta";
     }
@@ -35,10 +35,12 @@ namespace Orly {
       enum Source : uint8_t {
         BlockService,
         DataFileArena,
+        DataFileBloomFilter,
         DataFileHash,
         DataFileHashIndex,
         DataFileHistory,
         DataFileKey,
+        DataFileKeyFence,
         DataFileMeta,
         DataFileNoteIndex,
         DataFileOther,
@@ -60,10 +62,12 @@ namespace Orly {
         FileService,
         FileSync,
         MergeDataFileArena,
+        MergeDataFileBloomFilter,
         MergeDataFileHash,
         MergeDataFileHashIndex,
         MergeDataFileHistory,
         MergeDataFileKey,
+        MergeDataFileKeyFence,
         MergeDataFileMeta,
         MergeDataFileOther,
         MergeDataFileRemapIndex,
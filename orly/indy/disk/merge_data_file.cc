@@ -18,6 +18,8 @@
 
 #include <orly/indy/disk/merge_data_file.h>
 
+#include <orly/indy/disk/arena_chunk.h>
+#include <orly/indy/disk/util/bloom_filter.h>
 #include <orly/indy/disk/util/hash_util.h>
 #include <orly/indy/util/block_vec.h>
 #include <orly/indy/util/min_heap.h>
@@ -52,7 +54,8 @@ class TMergeDataFileImpl {
                      TSequenceNumber /*release_up_to*/,
                      DiskPriority priority,
                      size_t max_block_cache_read_slots_allowed,
-                     size_t temp_file_consol_thresh)
+                     size_t temp_file_consol_thresh,
+                     Fiber::TRunnerPool *worker_pool)
       : Engine(engine),
         StorageSpeed(storage_speed),
         UpdateIndexStorageSpeed(TVolume::TDesc::TStorageSpeed::Slow),
@@ -65,8 +68,11 @@ class TMergeDataFileImpl {
         LowestSeq(0UL),
         HighestSeq(0UL),
         TempFileConsolThresh(temp_file_consol_thresh),
+        WorkerPool(worker_pool),
         UpdateCollector(HERE, Source::MergeDataFileUpdateIndex, TempFileConsolThresh, SorterStorageSpeed, Engine, true) {
     assert(!CanTailTombstones || gen_vec.size() == 1);
+    /* every arena in the new generation is compressed the same way, so read the setting once. */
+    const Disk::Util::TCodec *const codec = Engine->GetDataFileCodec();
     try {
       for (const auto &iter : gen_vec) {
         ReadFileVec.emplace_back(new TReader(HERE, Source::MergeDataFileScan, Engine, file_uuid, iter));
@@ -224,7 +230,8 @@ class TMergeDataFileImpl {
           TMergeIndexFile &merge_idx_file = *idx_pair.second;
           try {
             merge_idx_file.ConstructArena(merge_idx_file.TypeBoundaryOffsetVec,
-                                          merge_idx_file.MaxArenaBytes);
+                                          merge_idx_file.MaxArenaBytes,
+                                          codec);
           } catch (const std::exception &ex) {
             syslog(LOG_ERR, "MergeDataFile caught error [%s]", ex.what());
 
@@ -234,6 +241,8 @@ class TMergeDataFileImpl {
       }
       size_t num_main_arena_notes = 0UL;
       size_t num_main_arena_bytes = 0UL;
+      TArenaChunkVec main_arena_chunk_vec;
+      size_t main_arena_chunk_table_offset = 0UL;
       std::vector<std::unique_ptr<TRemapSorter>> main_remap_sorter_vec;
       try {
         /* merge the main arenas */ {
@@ -263,8 +272,11 @@ class TMergeDataFileImpl {
                                             WrittenBlockSet,
                                             #endif
                                             max_arena_bytes,
+                                            codec,
                                             num_main_arena_notes,
-                                            num_main_arena_bytes);
+                                            num_main_arena_bytes,
+                                            main_arena_chunk_vec,
+                                            main_arena_chunk_table_offset);
           }
         }
       } catch (const std::exception &ex) {
@@ -278,23 +290,12 @@ class TMergeDataFileImpl {
         for (const auto &idx : index_map) {
           TMergeIndexFile &idx_file = *idx.second;
           size_t max_key_count = 0UL;
-          const std::vector<std::unique_ptr<TDataDiskArena<true>>> &disk_arena_vec = idx_file.DiskArenaVec;
           const std::vector<std::unique_ptr<typename TReader::TIndexFile>> &source_file_vec = idx_file.SourceFileVec;
-          assert(disk_arena_vec.size() == source_file_vec.size());
-          std::vector<std::unique_ptr<typename TReader::TIndexFile::TKeyCursor>> cur_key_cursor_vec;
-          std::vector<std::unique_ptr<typename TReader::TIndexFile::THistoryKeyCursor>> hist_key_cursor_vec;
-          std::vector<size_t> history_key_cur_idx_vec(source_file_vec.size(), 0UL);
-          Orly::Indy::Util::TMinHeap<TSortedKey, size_t> min_heap(source_file_vec.size() * 2);
-          std::vector<TSortedKey> sorted_key_vec(source_file_vec.size() * 2);
-
-          std::vector<std::unique_ptr<TMergeDataFileImpl::TRemapAccessSorter>> key_access_sorter_vec;
-          std::vector<std::unique_ptr<TMergeDataFileImpl::TRemapResolvedSorter>> key_resolved_sorter_vec;
-          std::vector<std::unique_ptr<typename TMergeDataFileImpl::TRemapResolvedSorter::TCursor>> key_resolved_sorter_cursor_vec;
-          std::vector<std::unique_ptr<TMergeDataFileImpl::TRemapAccessSorter>> val_access_sorter_vec;
-          std::vector<std::unique_ptr<TMergeDataFileImpl::TRemapResolvedSorter>> val_resolved_sorter_vec;
-          std::vector<std::unique_ptr<typename TMergeDataFileImpl::TRemapResolvedSorter::TCursor>> val_resolved_sorter_cursor_vec;
+          assert(idx_file.DiskArenaVec.size() == source_file_vec.size());
           std::vector<size_t> read_file_vec_pos_by_source_pos;
           for (const auto &source_file : source_file_vec) {
+            max_key_count += source_file->GetNumCurKeys();
+            max_key_count += source_file->GetNumHistKeys();
             for (size_t i = 0; i < ReadFileVec.size(); ++i) {
               if (source_file->GetGenId() == ReadFileVec[i]->GetGenId()) {
                 read_file_vec_pos_by_source_pos.emplace_back(i);
@@ -302,262 +303,44 @@ class TMergeDataFileImpl {
               }
             }
           }
-          size_t pos = 0;
-          /* build the key access pattern */ {
-            size_t max_block_cache_read_slot_per_sub_cursor = MaxBlockCacheReadSlotsAllowed / (source_file_vec.size() * 4UL);
-            for (const auto &source_file : source_file_vec) {
-              /* current keys */ {
-                key_access_sorter_vec.push_back(make_unique<TMergeDataFileImpl::TRemapAccessSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
-                key_resolved_sorter_vec.push_back(make_unique<TMergeDataFileImpl::TRemapResolvedSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
-                val_access_sorter_vec.push_back(make_unique<TMergeDataFileImpl::TRemapAccessSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
-                val_resolved_sorter_vec.push_back(make_unique<TMergeDataFileImpl::TRemapResolvedSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
-                TMergeDataFileImpl::TRemapAccessSorter &key_access_sorter = *key_access_sorter_vec.back();
-                TMergeDataFileImpl::TRemapResolvedSorter &key_resolved_sorter = *key_resolved_sorter_vec.back();
-                TMergeDataFileImpl::TRemapSorter &key_remap_sorter = *idx_file.ArenaRemapSorterVec[pos / 2];
-                TMergeDataFileImpl::TRemapAccessSorter &val_access_sorter = *val_access_sorter_vec.back();
-                TMergeDataFileImpl::TRemapResolvedSorter &val_resolved_sorter = *val_resolved_sorter_vec.back();
-                TMergeDataFileImpl::TRemapSorter &val_remap_sorter = *main_remap_sorter_vec[read_file_vec_pos_by_source_pos[pos / 2]];
-                size_t idx = 0UL;
-                if (CanTail) {
-                  for (typename TReader::TIndexFile::TKeyCursor key_cursor(source_file.get()); key_cursor; ++key_cursor) {
-                    const typename TReader::TIndexFile::TKeyItem &item = *key_cursor;
-                    if (!CanTailTombstones || !item.Value.IsTombstone() || item.NumHistKeys > 0) {
-                      const Atom::TCore::TOffset *key_off = item.Key.TryGetOffset();
-                      if (key_off) {
-                        key_access_sorter.Emplace(++idx, *key_off);
-                      }
-                      const Atom::TCore::TOffset *val_off = item.Value.TryGetOffset();
-                      if (val_off) {
-                        val_access_sorter.Emplace(++idx, *val_off);
-                      }
-                    }
-                  }
-                } else {
-                  for (typename TReader::TIndexFile::TKeyCursor key_cursor(source_file.get()); key_cursor; ++key_cursor) {
-                    const typename TReader::TIndexFile::TKeyItem &item = *key_cursor;
-                    const Atom::TCore::TOffset *key_off = item.Key.TryGetOffset();
-                    if (key_off) {
-                      key_access_sorter.Emplace(++idx, *key_off);
-                    }
-                    const Atom::TCore::TOffset *val_off = item.Value.TryGetOffset();
-                    if (val_off) {
-                      val_access_sorter.Emplace(++idx, *val_off);
-                    }
-                  }
-                }
-                TMergeDataFileImpl::ResolveRemap(MaxBlockCacheReadSlotsAllowed, key_access_sorter, key_remap_sorter, key_resolved_sorter);
-                TMergeDataFileImpl::ResolveRemap(MaxBlockCacheReadSlotsAllowed, val_access_sorter, val_remap_sorter, val_resolved_sorter);
-                key_access_sorter_vec.back().reset(); /* reset the access sorter so we release the resources. */
-                val_access_sorter_vec.back().reset(); /* reset the access sorter so we release the resources. */
-                key_resolved_sorter_cursor_vec.push_back(std::make_unique<typename TMergeDataFileImpl::TRemapResolvedSorter::TCursor>(&key_resolved_sorter, max_block_cache_read_slot_per_sub_cursor));
-                val_resolved_sorter_cursor_vec.push_back(std::make_unique<typename TMergeDataFileImpl::TRemapResolvedSorter::TCursor>(&val_resolved_sorter, max_block_cache_read_slot_per_sub_cursor));
-              } /* finish access pattern for current keys */
-
-              ++pos;
-
-              /* history keys */ {
-                key_access_sorter_vec.push_back(make_unique<TMergeDataFileImpl::TRemapAccessSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
-                key_resolved_sorter_vec.push_back(make_unique<TMergeDataFileImpl::TRemapResolvedSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
-                val_access_sorter_vec.push_back(make_unique<TMergeDataFileImpl::TRemapAccessSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
-                val_resolved_sorter_vec.push_back(make_unique<TMergeDataFileImpl::TRemapResolvedSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
-                TMergeDataFileImpl::TRemapAccessSorter &key_access_sorter = *key_access_sorter_vec.back();
-                TMergeDataFileImpl::TRemapResolvedSorter &key_resolved_sorter = *key_resolved_sorter_vec.back();
-                TMergeDataFileImpl::TRemapSorter &key_remap_sorter = *idx_file.ArenaRemapSorterVec[pos / 2];
-                TMergeDataFileImpl::TRemapAccessSorter &val_access_sorter = *val_access_sorter_vec.back();
-                TMergeDataFileImpl::TRemapResolvedSorter &val_resolved_sorter = *val_resolved_sorter_vec.back();
-                TMergeDataFileImpl::TRemapSorter &val_remap_sorter = *main_remap_sorter_vec[read_file_vec_pos_by_source_pos[pos / 2]];
-                size_t idx = 0UL;
-                if (CanTail) {
-                  std::vector<bool> &hist_filter_vec = idx_file.HistoryKeeperFilterVec[pos / 2];
-                  assert(hist_filter_vec.size() == source_file->GetNumHistKeys());
-                  size_t cur_hist_offset = 0UL;
-                  for (typename TReader::TIndexFile::THistoryKeyCursor history_cursor(source_file.get()); history_cursor; ++history_cursor, ++cur_hist_offset) {
-                    assert(cur_hist_offset < hist_filter_vec.size());
-                    if (hist_filter_vec[cur_hist_offset]) {
-                      const typename TReader::TIndexFile::THistoryKeyItem &item = *history_cursor;
-                      const Atom::TCore::TOffset *key_off = item.Key.TryGetOffset();
-                      if (key_off) {
-                        key_access_sorter.Emplace(++idx, *key_off);
-                      }
-                      const Atom::TCore::TOffset *val_off = item.Value.TryGetOffset();
-                      if (val_off) {
-                        val_access_sorter.Emplace(++idx, *val_off);
-                      }
-                    }
-                  }
-                } else {
-                  for (typename TReader::TIndexFile::THistoryKeyCursor history_cursor(source_file.get()); history_cursor; ++history_cursor) {
-                    const typename TReader::TIndexFile::THistoryKeyItem &item = *history_cursor;
-                    const Atom::TCore::TOffset *key_off = item.Key.TryGetOffset();
-                    if (key_off) {
-                      key_access_sorter.Emplace(++idx, *key_off);
-                    }
-                    const Atom::TCore::TOffset *val_off = item.Value.TryGetOffset();
-                    if (val_off) {
-                      val_access_sorter.Emplace(++idx, *val_off);
-                    }
-                  }
-                }
-                TMergeDataFileImpl::ResolveRemap(MaxBlockCacheReadSlotsAllowed, key_access_sorter, key_remap_sorter, key_resolved_sorter);
-                TMergeDataFileImpl::ResolveRemap(MaxBlockCacheReadSlotsAllowed, val_access_sorter, val_remap_sorter, val_resolved_sorter);
-                key_access_sorter_vec.back().reset(); /* reset the access sorter so we release the resources. */
-                val_access_sorter_vec.back().reset(); /* reset the access sorter so we release the resources. */
-                key_resolved_sorter_cursor_vec.push_back(std::make_unique<typename TMergeDataFileImpl::TRemapResolvedSorter::TCursor>(&key_resolved_sorter, max_block_cache_read_slot_per_sub_cursor));
-                val_resolved_sorter_cursor_vec.push_back(std::make_unique<typename TMergeDataFileImpl::TRemapResolvedSorter::TCursor>(&val_resolved_sorter, max_block_cache_read_slot_per_sub_cursor));
-              } /* finish access pattern for history keys */
-
-              ++pos;
+          idx_file.PrepKeyRange(max_key_count, &UpdateCollector);
+          std::vector<std::unique_ptr<TKeyRange>> range_vec = SplitKeyRanges(idx_file, main_remap_sorter_vec, read_file_vec_pos_by_source_pos);
+          if (range_vec.size() == 1UL) {
+            /* one range covers the whole index, so merge it in line, straight into the index file */
+            TKeyRange &range = *range_vec.front();
+            for (const auto &disk_arena : idx_file.DiskArenaVec) {
+              range.ArenaVec.push_back(disk_arena.get());
             }
-          }
-          std::swap(idx_file.ResolvedKeySorterCursorVec, key_resolved_sorter_cursor_vec);
-          std::swap(idx_file.ResolvedValSorterCursorVec, val_resolved_sorter_cursor_vec);
-
-          pos = 0;
-          for (const auto &source_file : source_file_vec) {
-            max_key_count += source_file->GetNumCurKeys();
-            max_key_count += source_file->GetNumHistKeys();
-            cur_key_cursor_vec.emplace_back(new typename TReader::TIndexFile::TKeyCursor(source_file.get()));
-            hist_key_cursor_vec.emplace_back(new typename TReader::TIndexFile::THistoryKeyCursor(source_file.get()));
-            typename TReader::TIndexFile::TKeyCursor &cur_csr = *cur_key_cursor_vec.back();
-            if (CanTail) {
-              for (; cur_csr; ++cur_csr) {
-                const typename TReader::TIndexFile::TKeyItem &item = *cur_csr;
-                if (!CanTailTombstones || !item.Value.IsTombstone() || item.NumHistKeys > 0) {
-                  TSortedKey &k = sorted_key_vec[pos];
-                  k.Core = item.Key;
-                  k.Arena = disk_arena_vec[pos / 2].get();
-                  k.SeqNum = item.SeqNum;
-                  min_heap.Insert(k, pos);
-                  break;
-                }
-              }
-            } else {
-              if (cur_csr) {
-                const typename TReader::TIndexFile::TKeyItem &item = *cur_csr;
-                TSortedKey &k = sorted_key_vec[pos];
-                k.Core = item.Key;
-                k.Arena = disk_arena_vec[pos / 2].get();
-                k.SeqNum = item.SeqNum;
-                min_heap.Insert(k, pos);
-              }
+            ResolveKeyRange(range);
+            MergeKeyRange(range, idx_file);
+          } else {
+            /* Each range merges on a worker into its own output, which we then stitch onto the index file in key
+               order.  The ranges share the remap sorters, so those get sorted up front so that concurrent cursors
+               over them don't race on the lazy sort. */
+            for (auto &remap_sorter : idx_file.ArenaRemapSorterVec) {
+              remap_sorter->SortMem();
             }
-            ++pos;
-            typename TReader::TIndexFile::THistoryKeyCursor &hist_csr = *hist_key_cursor_vec.back();
-            if (CanTail) {
-              size_t &cur_hist_offset = history_key_cur_idx_vec[pos / 2];
-              std::vector<bool> &hist_filter_vec = idx_file.HistoryKeeperFilterVec[pos / 2];
-              for (; hist_csr; ++hist_csr, ++cur_hist_offset) {
-                assert(cur_hist_offset < hist_filter_vec.size());
-                if (hist_filter_vec[cur_hist_offset]) {
-                  const typename TReader::TIndexFile::THistoryKeyItem &item = *hist_csr;
-                  TSortedKey &k = sorted_key_vec[pos];
-                  k.Core = item.Key;
-                  k.Arena = disk_arena_vec[pos / 2].get();
-                  k.SeqNum = item.SeqNum;
-                  min_heap.Insert(k, pos);
-                  ++cur_hist_offset;
-                  break;
-                }
-              }
-            } else {
-              if (hist_csr) {
-                const typename TReader::TIndexFile::THistoryKeyItem &item = *hist_csr;
-                TSortedKey &k = sorted_key_vec[pos];
-                k.Core = item.Key;
-                k.Arena = disk_arena_vec[pos / 2].get();
-                k.SeqNum = item.SeqNum;
-                min_heap.Insert(k, pos);
-              }
+            for (auto &remap_sorter : main_remap_sorter_vec) {
+              remap_sorter->SortMem();
             }
-            ++pos;
-          }
-          idx_file.PrepKeyRange(max_key_count, &UpdateCollector);
-          Base::TOpt<TKey> last_written;
-          while (min_heap) {
-            size_t pos;
-            const TSortedKey &k = min_heap.Pop(pos);
-            if (pos % 2 == 0) { /* came from a current source */
-              typename TReader::TIndexFile::TKeyCursor &cur_csr = *cur_key_cursor_vec[pos / 2];
-              assert(cur_csr);
-              const typename TReader::TIndexFile::TKeyItem &cur_item = *cur_csr;
-              TKey cur_key(cur_item.Key, k.Arena);
-              if (!last_written || *last_written != cur_key) { /* new key */
-                idx_file.MyPos = pos;
-                Atom::TCore key_core = cur_item.Key;
-                Atom::TCore val_core = cur_item.Value;
-                key_core.Remap(idx_file.KeyRemapper);
-                val_core.Remap(idx_file.ValRemapper);
-                idx_file.PushCurKey(cur_item.SeqNum, key_core, val_core);
-                last_written = cur_key;
-              } else { /* history key */
-                idx_file.MyPos = pos;
-                Atom::TCore key_core = cur_item.Key;
-                Atom::TCore val_core = cur_item.Value;
-                key_core.Remap(idx_file.KeyRemapper);
-                val_core.Remap(idx_file.ValRemapper);
-                idx_file.PushHistKey(cur_item.SeqNum, key_core, val_core);
-              }
-              ++cur_csr;
-              if (CanTail) {
-                for (; cur_csr; ++cur_csr) {
-                  const typename TReader::TIndexFile::TKeyItem &item = *cur_csr;
-                  if (!CanTailTombstones || !item.Value.IsTombstone() || item.NumHistKeys > 0) {
-                    TSortedKey &k = sorted_key_vec[pos];
-                    k.Core = item.Key;
-                    /* the arena should already be correct k.Arena = ... */
-                    k.SeqNum = item.SeqNum;
-                    min_heap.Insert(k, pos);
-                    break;
-                  }
-                }
-              } else {
-                if (cur_csr) {
-                  const typename TReader::TIndexFile::TKeyItem &item = *cur_csr;
-                  TSortedKey &k = sorted_key_vec[pos];
-                  k.Core = item.Key;
-                  /* the arena should already be correct k.Arena = ... */
-                  k.SeqNum = item.SeqNum;
-                  min_heap.Insert(k, pos);
-                }
-              }
-            } else { /* came from a history source */
-              typename TReader::TIndexFile::THistoryKeyCursor &hist_csr = *hist_key_cursor_vec[pos / 2];
-              assert(hist_csr);
-              const typename TReader::TIndexFile::THistoryKeyItem &cur_item = *hist_csr;
-              idx_file.MyPos = pos;
-              Atom::TCore key_core = cur_item.Key;
-              Atom::TCore val_core = cur_item.Value;
-              key_core.Remap(idx_file.KeyRemapper);
-              val_core.Remap(idx_file.ValRemapper);
-              idx_file.PushHistKey(cur_item.SeqNum, key_core, val_core);
-              ++hist_csr;
-              if (CanTail) {
-                size_t &cur_hist_offset = history_key_cur_idx_vec[pos / 2];
-                std::vector<bool> &hist_filter_vec = idx_file.HistoryKeeperFilterVec[pos / 2];
-                for (; hist_csr; ++hist_csr, ++cur_hist_offset) {
-                  if (hist_filter_vec[cur_hist_offset]) {
-                    const typename TReader::TIndexFile::THistoryKeyItem &item = *hist_csr;
-                    TSortedKey &k = sorted_key_vec[pos];
-                    k.Core = item.Key;
-                    /* the arena should already be correct k.Arena = ... */
-                    k.SeqNum = item.SeqNum;
-                    min_heap.Insert(k, pos);
-                    ++cur_hist_offset;
-                    break;
-                  }
-                }
-              } else {
-                if (hist_csr) {
-                  const typename TReader::TIndexFile::THistoryKeyItem &item = *hist_csr;
-                  TSortedKey &k = sorted_key_vec[pos];
-                  k.Core = item.Key;
-                  /* the arena should already be correct k.Arena = ... */
-                  k.SeqNum = item.SeqNum;
-                  min_heap.Insert(k, pos);
-                }
-              }
+            std::vector<std::unique_ptr<TRangeOutput>> output_vec;
+            for (size_t i = 0; i < range_vec.size(); ++i) {
+              output_vec.emplace_back(new TRangeOutput(&idx_file, idx_file.NumHashTables, Engine, TempFileConsolThresh, SorterStorageSpeed));
             }
-          } /* end of min-heap */
+            Fiber::TSafeSync safe_sync;
+            std::vector<std::unique_ptr<TKeyRangeRunnable>> runnable_vec;
+            for (size_t i = 0; i < range_vec.size(); ++i) {
+              runnable_vec.emplace_back(new TKeyRangeRunnable(this, *WorkerPool, safe_sync, *range_vec[i], *output_vec[i]));
+            }
+            safe_sync.Sync();
+            for (const auto &runnable : runnable_vec) {
+              runnable->RethrowIfFailed();
+            }
+            for (const auto &output : output_vec) {
+              idx_file.AppendRange(*output);
+            }
+          }
+          range_vec.clear();
           idx_file.FlushHistory();
           /* now that we've finished writing the current + history keys, we can remove the unused blocks. */
           const size_t end_of_stream = idx_file.EndOfHistoryStream;
@@ -682,6 +465,7 @@ class TMergeDataFileImpl {
       size_t num_meta_blocks = 0UL;
       /* compute / write out the meta-data */ {
         /*
+          meta version
           # of blocks
           # of meta-blocks (n)
           # of #block / block_id pairings (number of sequential blocks starting at) (m)
@@ -691,6 +475,9 @@ class TMergeDataFileImpl {
           # of arena bytes
           offset of main arena
           offset of update index
+          arena codec
+          offset of main arena chunk table
+          # of main arena chunks
 
           n (size_t) metablock block_id(s)
           m (size_t) -> (size_t) #block -> starting_block_id pairings
@@ -734,6 +521,7 @@ class TMergeDataFileImpl {
                                               ,WrittenBlockSet
                                               #endif
                                               );
+        stream << TData::GetMetaVersionWord();  // meta version
         stream << BlockVec.Size();  // # of blocks
         stream << num_meta_blocks;  // # of meta-blocks
         stream << num_sequential_block_pairings;  // # of #block / block_id pairings
@@ -744,6 +532,9 @@ class TMergeDataFileImpl {
         stream << MainArenaTypeBoundaryOffsetVec.size();  // # of arena type boundaries
         stream << MainArenaByteOffset;  // byte offset of main arena
         stream << byte_offset_of_update_entries;  // offset of update index
+        stream << static_cast<size_t>(codec->GetKind());  // arena codec
+        stream << main_arena_chunk_table_offset;  // offset of main arena chunk table
+        stream << (main_arena_chunk_vec.empty() ? 0UL : main_arena_chunk_vec.size() - 1UL);  // # of main arena chunks
 
         /* write out the meta-block ids */
         for (size_t i = 0; i < num_meta_blocks; ++i) {
@@ -1111,12 +902,15 @@ class TMergeDataFileImpl {
     NO_COPY(TMyMergeArena);
     public:
 
-    TMyMergeArena(TEngine *engine, const TBlockVec &block_vec, size_t arena_byte_offset, size_t arena_num_notes, size_t arena_num_bytes)
+    TMyMergeArena(TEngine *engine, const TBlockVec &block_vec, size_t arena_byte_offset, size_t arena_num_notes, size_t arena_num_bytes,
+                  Disk::Util::TCodecKind codec, TArenaChunkVec &&chunk_vec)
         : Engine(engine),
           BlockVec(block_vec),
           ArenaByteOffset(arena_byte_offset),
           NumArenaNotes(arena_num_notes),
-          NumArenaBytes(arena_num_bytes) {}
+          NumArenaBytes(arena_num_bytes) {
+      SetArenaChunks(codec, std::move(chunk_vec));
+    }
 
     virtual ~TMyMergeArena() {}
 
@@ -1318,8 +1112,11 @@ class TMergeDataFileImpl {
                           std::unordered_set<size_t> &written_block_set,
                           #endif
                           size_t max_total_note_bytes,
+                          const Disk::Util::TCodec *codec,
                           size_t &num_notes_out,
-                          size_t &num_bytes_out) {
+                          size_t &num_bytes_out,
+                          TArenaChunkVec &chunk_vec_out,
+                          size_t &chunk_table_offset_out) {
     /* build a map from boundary to sorted keeper filter for each file */
     std::vector<std::map<size_t, std::unique_ptr<typename TMergeDataFileImpl<CanTail, CanTailTombstones>::TArenaKeeperSorter>>> sorted_keeper_map_vec;
     if (CanTail) {
@@ -1389,20 +1186,22 @@ class TMergeDataFileImpl {
 
     TCompletionTrigger completion_trigger;
     std::unordered_map<size_t, std::shared_ptr<const TBufBlock>> arena_collision_map {};
+    size_t end_of_stream;
     /* arena stream life-span */ {
-      TDataOutStream arena_stream(HERE,
-                                  Source::MergeDataFileArena,
-                                  engine->GetVolMan(),
-                                  arena_byte_offset,
-                                  block_vec,
-                                  arena_collision_map,
-                                  completion_trigger,
-                                  priority,
-                                  true /* do_cache */
-                                  #ifndef NDEBUG
-                                  ,written_block_set
-                                  #endif
-                                  );
+      TArenaOutStream<LogicalPageSize, LogicalBlockSize, PhysicalBlockSize, Disk::Util::PageCheckedBlock>
+          arena_stream(HERE,
+                       Source::MergeDataFileArena,
+                       engine->GetVolMan(),
+                       arena_byte_offset,
+                       block_vec,
+                       arena_collision_map,
+                       completion_trigger,
+                       priority,
+                       true /* do_cache */,
+                       #ifndef NDEBUG
+                       written_block_set,
+                       #endif
+                       codec);
       Atom::TCore::TOffset cur_disk_offset = 0UL;
 
       /* let's get some information about what types are involved... */ {
@@ -1469,6 +1268,8 @@ class TMergeDataFileImpl {
                                                   completion_trigger);
                 }
               }
+              /* the notes we've buffered have to reach the disk before we can read them back */
+              arena_stream.CloseChunk();
               try {
                 arena_stream.Sync();
               } catch (const TDiskError &err) {
@@ -1476,7 +1277,8 @@ class TMergeDataFileImpl {
                 throw;
               }
               arena_stream.MakeCurBlockCollisionBlock();
-              typename TMergeDataFileImpl<CanTail, CanTailTombstones>::TMyMergeArena my_merge_arena(engine, block_vec, arena_byte_offset, num_notes_out, num_bytes_out);
+              typename TMergeDataFileImpl<CanTail, CanTailTombstones>::TMyMergeArena my_merge_arena(
+                  engine, block_vec, arena_byte_offset, num_notes_out, num_bytes_out, codec->GetKind(), TArenaChunkVec(arena_stream.GetChunkVec()));
               TDataDiskArena<false> my_arena(&my_merge_arena, engine->GetCache<TDataDiskArena<false>::PhysicalCachePageSize>(), priority);
               MergeTypeRange(engine,
                              storage_speed,
@@ -1530,6 +1332,9 @@ class TMergeDataFileImpl {
           merge_func();
         }
       }
+      chunk_table_offset_out = arena_stream.Finish(engine, storage_speed);
+      chunk_vec_out = arena_stream.GetChunkVec();
+      end_of_stream = arena_stream.GetOffset();
     }
     /* flush last collision block */ {
       /* find the max block */
@@ -1558,7 +1363,6 @@ class TMergeDataFileImpl {
       completion_trigger.Wait();
     }
     /* now that we know exactly how many bytes we actually used, we can shrink the block vec to free the unused blocks. */
-    const size_t end_of_stream = arena_byte_offset + num_bytes_out;
     const size_t actual_blocks_required = ((end_of_stream - 1UL) / Disk::Util::LogicalBlockSize) + 1UL;
     const size_t num_to_remove = block_vec.Size() - actual_blocks_required;
     /* let's make sure that the max_block that we just flushed isn't in the section that we're freeing... that would be a logic error :-) */
@@ -1981,6 +1785,46 @@ class TMergeDataFileImpl {
 
   private:
 
+  /* Calls cb(prefix_size, prefix_core, prefix_hash) for the key and then its ever shorter prefixes, stopping at the
+     first one the key before it shares, as only the first key with a given prefix gets hashed.  seen_prefix holds the
+     prefixes of the key before, by size, and is left holding this key's.  The cores passed to cb have their hashes
+     stored in them. */
+  template <typename TCb>
+  static void ForEachNewPrefix(const Atom::TCore &key,
+                               Atom::TCore::TArena *prefix_arena,
+                               std::unordered_map<uint64_t, TKey> &seen_prefix,
+                               const TCb &cb) {
+    Atom::TCore prefix_core = key;
+    void *type_alloc = alloca(Sabot::Type::GetMaxTypeSize());
+    #ifndef NDEBUG
+    void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+    #endif
+    do {
+      const TKey prefix_key(prefix_core, prefix_arena);
+      const uint64_t prefix_size = Sabot::GetTupleSize(*Sabot::Type::TAny::TWrapper(prefix_core.GetType(prefix_arena, type_alloc)));
+      auto ret = seen_prefix.insert(std::make_pair(prefix_size, prefix_key));
+      bool is_new = ret.second;
+      if (!is_new) {
+        TKey &cur_prefix = ret.first->second;
+        if (cur_prefix != prefix_key) {
+          assert(Atom::IsLt(cur_prefix.Compare(prefix_key)));
+          cur_prefix = prefix_key;
+          is_new = true;
+        }
+      }
+      if (is_new) {
+        assert(prefix_key.GetHash() == Sabot::GetHash(*Sabot::State::TAny::TWrapper(prefix_core.NewState(prefix_arena, state_alloc))));
+        size_t prefix_hash = prefix_key.GetHash();
+        prefix_core.TrySetStoredHash(prefix_hash);
+        cb(prefix_size, prefix_core, prefix_hash);
+      } else {
+        break;
+      }
+    } while (prefix_core.TryTruncateTuple());
+  }
+
+  class TRangeOutput;
+
   /* TODO */
   class TSortedKey {
     public:
@@ -2110,6 +1954,7 @@ class TMergeDataFileImpl {
           ArenaByteOffset(0UL),
           NumArenaNotes(0UL),
           NumArenaBytes(0UL),
+          ArenaChunkTableOffset(0UL),
           MainArenaRemapIndex(main_arena_remap_index),
           BlockVec(block_vec),
           FileSize(0UL),
@@ -2121,13 +1966,16 @@ class TMergeDataFileImpl {
           ByteOffsetOfIndexMeta(0UL),
           ByteOffsetOfKeyIndex(0UL),
           FirstKey(true),
+          HashIndexVersion(engine->GetHashIndexVersion()),
+          ByteOffsetOfKeyFences(0UL),
+          ByteOffsetOfBloomFilter(0UL),
+          NumBloomFilterBits(0UL),
+          NumBloomFilterProbes(0UL),
           GenId(gen_id),
           #ifndef NDEBUG
           WrittenBlockSet(written_block_set),
           #endif
           WasPrepared(false) {
-      KeyRemapper = std::bind(&TMergeIndexFile::RemapKey, this, std::placeholders::_1);
-      ValRemapper = std::bind(&TMergeIndexFile::RemapVal, this, std::placeholders::_1);
       NumHashTables = *(ExampleKey.GetCore().TryGetElemCount());
     }
 
@@ -2159,10 +2007,17 @@ class TMergeDataFileImpl {
         meta_stream << NumHistKeys;  // # History Keys
         meta_stream << ByteOffsetOfKeyIndex;  // Current Key Offset
         meta_stream << NumHashTables;  // # of hash indexes (n)
-
-
-        for (const auto &hash_table : NumHashFieldsByOffset) {
-          meta_stream << hash_table.first << hash_table.second;
+        meta_stream << ByteOffsetOfBloomFilter;  // Offset of bloom filter
+        meta_stream << NumBloomFilterBits;  // # bloom filter bits
+        meta_stream << NumBloomFilterProbes;  // # bloom filter probes
+        meta_stream << HashIndexVersion;  // Hash index version
+        meta_stream << ByteOffsetOfKeyFences;  // Offset of key fences
+        meta_stream << FenceVec.size();  // # key fences
+        meta_stream << ArenaChunkTableOffset;  // Offset of arena chunk table
+        meta_stream << (ArenaChunkVec.empty() ? 0UL : ArenaChunkVec.size() - 1UL);  // # arena chunks
+
+        for (size_t i = 0; i < NumHashTables; ++i) {
+          meta_stream << NumHashFieldsByOffset[i].first << NumHashFieldsByOffset[i].second << ByteOffsetOfHashEntriesVec[i];
         }
         for (const auto &offset : ArenaTypeBoundaryOffsetVec) {
           meta_stream << offset;
@@ -2188,7 +2043,8 @@ class TMergeDataFileImpl {
     }
 
     void ConstructArena(const std::vector<std::vector<size_t>> &type_boundary_offset_vec,
-                        size_t max_total_note_bytes) {
+                        size_t max_total_note_bytes,
+                        const Disk::Util::TCodec *codec) {
       ArenaByteOffset = MakeArena(Engine,
                                   StorageSpeed,
                                   SorterStorageSpeed,
@@ -2205,9 +2061,14 @@ class TMergeDataFileImpl {
                                   WrittenBlockSet,
                                   #endif
                                   max_total_note_bytes,
+                                  codec,
                                   NumArenaNotes,
-                                  NumArenaBytes);
-      FileSize = ArenaByteOffset + NumArenaBytes;
+                                  NumArenaBytes,
+                                  ArenaChunkVec,
+                                  ArenaChunkTableOffset);
+      FileSize = ArenaChunkVec.empty() ? ArenaByteOffset + NumArenaBytes : ArenaChunkTableOffset + (ArenaChunkVec.size() * sizeof(size_t) * 2UL);
+      /* our own arena is read back while the keys are written, so it has to know how it was compressed. */
+      SetArenaChunks(codec->GetKind(), TArenaChunkVec(ArenaChunkVec));
       MyArena = std::make_unique<TDataDiskArena<true>>(this, Engine->GetCache<TDataDiskArena<true>::PhysicalCachePageSize>(), Priority);
     }
 
@@ -2217,7 +2078,7 @@ class TMergeDataFileImpl {
       for (size_t i = 0; i < NumHashTables; ++i) {
         HashCollectorVec.emplace_back(new THashCollector(HERE, Source::MergeDataFileHashIndex, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
       }
-      const size_t bytes_of_metadata = (TData::NumIndexMetaFields * sizeof(size_t)) + (NumHashTables * sizeof(size_t) * 2UL) + (ArenaTypeBoundaryOffsetVec.size() * sizeof(size_t));
+      const size_t bytes_of_metadata = (TData::NumIndexMetaFields * sizeof(size_t)) + (NumHashTables * sizeof(size_t) * TData::NumHashIndexMetaFields) + (ArenaTypeBoundaryOffsetVec.size() * sizeof(size_t));
       if (bytes_of_metadata >= LogicalBlockSize) {
         throw std::runtime_error("Index metadata >= 1 block");
       }
@@ -2255,52 +2116,10 @@ class TMergeDataFileImpl {
 
     void PushCurKey(TSequenceNumber seq_num, const Atom::TCore &key, const Atom::TCore &val) {
       assert(this);
-      ++NumCurKeys;
-      TDataOutStream &stream = *KeyStream;
-      if (!FirstKey) {
-        stream << NumCurHistoryElem << ByteOffsetOfCurHistory;
-        ByteOffsetOfCurHistory += NumCurHistoryElem * TData::KeyHistorySize;
-        NumCurHistoryElem = 0UL;
-      } else {
-        FirstKey = false;
-      }
-      CurKeyOffset = stream.GetOffset();
-      stream << seq_num;
-      stream.Write(&key, sizeof(key));
-      stream.Write(&val, sizeof(val));
-      assert(stream.GetOffset() <= MaxByteOffsetOfKeyStream);
-
-      Atom::TCore prefix_core = key;
-      Atom::TCore::TArena *const prefix_arena = MyArena.get();
-
-      void *type_alloc = alloca(Sabot::Type::GetMaxTypeSize());
-      #ifndef NDEBUG
-      void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
-      #endif
-      do {
-        const TKey prefix_key(prefix_core, prefix_arena);
-        const uint64_t prefix_size = Sabot::GetTupleSize(*Sabot::Type::TAny::TWrapper(prefix_core.GetType(prefix_arena, type_alloc)));
-        auto ret = SeenPrefix.insert(std::make_pair(prefix_size, prefix_key));
-        bool is_new = ret.second;
-        if (!is_new) {
-          TKey &cur_prefix = ret.first->second;
-          if (cur_prefix != prefix_key) {
-            assert(Atom::IsLt(cur_prefix.Compare(prefix_key)));
-            cur_prefix = prefix_key;
-            is_new = true;
-          }
-        }
-        if (is_new) {
-          assert(prefix_key.GetHash() == Sabot::GetHash(*Sabot::State::TAny::TWrapper(prefix_core.NewState(prefix_arena, state_alloc))));
-          size_t prefix_hash = prefix_key.GetHash();
-          prefix_core.TrySetStoredHash(prefix_hash);
-          HashCollectorVec[prefix_size - 1]->Emplace(prefix_core, prefix_hash, CurKeyOffset);
-        } else {
-          break;
-        }
-
-      } while (prefix_core.TryTruncateTuple());
-      UpdateCollector->Emplace(seq_num, CurKeyOffset, true, IndexId);
+      WriteCurKey(seq_num, key, val);
+      TMergeDataFileImpl::ForEachNewPrefix(key, MyArena.get(), SeenPrefix, [this](uint64_t prefix_size, const Atom::TCore &prefix_core, size_t prefix_hash) {
+        HashCollectorVec[prefix_size - 1]->Emplace(prefix_core, prefix_hash, CurKeyOffset);
+      });
     }
 
     void PushHistKey(TSequenceNumber seq_num, const Atom::TCore &key, const Atom::TCore &val) {
@@ -2311,6 +2130,43 @@ class TMergeDataFileImpl {
       ++NumCurHistoryElem;
     }
 
+    /* Stitch the keys of a range merged on a worker onto the end of ours.  The range numbered its keys from zero, so
+       its hash entries get moved to where its keys actually land.  It also hashed its first key without knowing the
+       key before it, so we drop any of that key's prefixes which the key before it already hashed. */
+    void AppendRange(TRangeOutput &range) {
+      assert(this);
+      const size_t first_key_offset = ByteOffsetOfKeyIndex + (NumCurKeys * TData::KeyEntrySize);
+      for (typename TRangeOutput::TKeyCollector::TCursor csr(&range.KeyCollector, MaxBlockCacheReadSlotsAllowed); csr; ++csr) {
+        const TRangeKeyObj &obj = *csr;
+        if (obj.IsCur) {
+          WriteCurKey(obj.SeqNum, obj.Key, obj.Val);
+        } else {
+          PushHistKey(obj.SeqNum, obj.Key, obj.Val);
+        }
+      }
+      for (const auto &first_hash : range.FirstKeyHashVec) {
+        auto seen = SeenPrefix.find(first_hash.first);
+        if (seen != SeenPrefix.end() && seen->second == TKey(first_hash.second.Core, MyArena.get())) {
+          break;
+        }
+        HashCollectorVec[first_hash.first - 1]->Emplace(first_hash.second.Core, first_hash.second.Hash, first_key_offset);
+      }
+      for (size_t i = 0; i < NumHashTables; ++i) {
+        for (typename THashCollector::TCursor csr(range.HashCollectorVec[i].get(), MaxBlockCacheReadSlotsAllowed); csr; ++csr) {
+          const THashObj &obj = *csr;
+          HashCollectorVec[i]->Emplace(obj.Core, obj.Hash, first_key_offset + (obj.Offset * TData::KeyEntrySize));
+        }
+      }
+      /* the next range picks up where this one's last key left off */
+      for (const auto &prefix : range.SeenPrefix) {
+        const TKey prefix_key(prefix.second.GetCore(), MyArena.get());
+        auto ret = SeenPrefix.insert(std::make_pair(prefix.first, prefix_key));
+        if (!ret.second) {
+          ret.first->second = prefix_key;
+        }
+      }
+    }
+
     void FlushHistory() {
       assert(this);
       TDataOutStream &stream = *KeyStream;
@@ -2333,15 +2189,52 @@ class TMergeDataFileImpl {
       size_t total_bytes_required = 0UL;
       std::unordered_map<size_t, std::shared_ptr<const TBufBlock>> collision_map {};
       size_t hash_index_byte_offset = BlockVec->Size() * LogicalBlockSize;
+      size_t num_hashed_keys = 0UL;
+      for (const auto &collection : HashCollectorVec) {
+        num_hashed_keys += collection->GetSize();
+      }
+      Disk::Util::TBloomFilter bloom_filter(num_hashed_keys, Engine->GetBloomFilterBitsPerKey());
+      /* a bucketed index has to be sorted by home bucket before we know how many overflow buckets it needs */
+      std::vector<std::unique_ptr<THashCollector>> bucketed_collector_vec;
+      std::vector<size_t> num_buckets_vec;
       for (const auto &collection : HashCollectorVec) {
         /* collision at beginning of this hash index */
         auto ret = collision_map.insert(std::make_pair((hash_index_byte_offset + total_bytes_required) / LogicalBlockSize, nullptr));
         if (ret.second) { // fresh insert
           ret.first->second = std::shared_ptr<const TBufBlock>(new TBufBlock());
         }
-        size_t num_hash_fields = Disk::Util::SuggestHashSize(collection->GetSize());
-        NumHashFieldsByOffset.emplace_back(hash_index_byte_offset + total_bytes_required, num_hash_fields);
-        total_bytes_required += num_hash_fields * TDataFile::HashEntrySize;
+        if (HashIndexVersion == Disk::Util::BucketedHashIndex) {
+          const size_t num_home_buckets = Disk::Util::SuggestNumHashBuckets(collection->GetSize());
+          bucketed_collector_vec.emplace_back(new THashCollector(HERE, Source::MergeDataFileHashIndex, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
+          THashCollector *bucketed_collector = bucketed_collector_vec.back().get();
+          for (typename THashCollector::TCursor orig_csr(collection.get(), MaxBlockCacheReadSlotsAllowed); orig_csr; ++orig_csr) {
+            const THashObj &obj = *orig_csr;
+            bucketed_collector->Emplace(obj.Core, Disk::Util::GetHomeBucket(obj.Hash, num_home_buckets), obj.Offset);
+            bloom_filter.Add(obj.Hash);
+          }
+          size_t num_buckets;
+          /* count the overflow buckets */ {
+            typename THashCollector::TCursor count_csr(bucketed_collector, MaxBlockCacheReadSlotsAllowed);
+            num_buckets = Disk::Util::CountHashBuckets(count_csr, num_home_buckets);
+          }
+          num_buckets_vec.push_back(num_buckets);
+          const size_t byte_offset_of_entries = hash_index_byte_offset + total_bytes_required + num_buckets * sizeof(Disk::Util::THashBucket);
+          NumHashFieldsByOffset.emplace_back(hash_index_byte_offset + total_bytes_required, num_home_buckets);
+          ByteOffsetOfHashEntriesVec.push_back(byte_offset_of_entries);
+          total_bytes_required += Disk::Util::GetBucketedHashIndexSize(num_buckets, collection->GetSize(), TData::HashEntrySize);
+          /* the buckets and the entries are written by separate streams, so they may collide with each other */
+          if (byte_offset_of_entries % LogicalBlockSize != 0) {
+            ret = collision_map.insert(std::make_pair(byte_offset_of_entries / LogicalBlockSize, nullptr));
+            if (ret.second) { // fresh insert
+              ret.first->second = std::shared_ptr<const TBufBlock>(new TBufBlock());
+            }
+          }
+        } else {
+          size_t num_hash_fields = Disk::Util::SuggestHashSize(collection->GetSize());
+          NumHashFieldsByOffset.emplace_back(hash_index_byte_offset + total_bytes_required, num_hash_fields);
+          ByteOffsetOfHashEntriesVec.push_back(0UL);
+          total_bytes_required += num_hash_fields * TDataFile::HashEntrySize;
+        }
         /* collision at end of this hash index (if the block doesn't get filled completely) */
         if ((hash_index_byte_offset + total_bytes_required) % LogicalBlockSize != 0) {
           ret = collision_map.insert(std::make_pair((hash_index_byte_offset + total_bytes_required) / LogicalBlockSize, nullptr));
@@ -2351,6 +2244,30 @@ class TMergeDataFileImpl {
         }
       }
       assert(NumHashFieldsByOffset.size() == NumHashTables);
+      /* lay out the bloom filter right after the last hash index */
+      ByteOffsetOfBloomFilter = hash_index_byte_offset + total_bytes_required;
+      if (bloom_filter.IsEnabled()) {
+        total_bytes_required += bloom_filter.GetNumBytes();
+        /* collision at end of the bloom filter (if the block doesn't get filled completely) */
+        if ((hash_index_byte_offset + total_bytes_required) % LogicalBlockSize != 0) {
+          auto ret = collision_map.insert(std::make_pair((hash_index_byte_offset + total_bytes_required) / LogicalBlockSize, nullptr));
+          if (ret.second) { // fresh insert
+            ret.first->second = std::shared_ptr<const TBufBlock>(new TBufBlock());
+          }
+        }
+      }
+      /* and the key fences after that */
+      ByteOffsetOfKeyFences = hash_index_byte_offset + total_bytes_required;
+      if (!FenceVec.empty()) {
+        total_bytes_required += FenceVec.size() * TData::KeyFenceSize;
+        /* collision at end of the key fences (if the block doesn't get filled completely) */
+        if ((hash_index_byte_offset + total_bytes_required) % LogicalBlockSize != 0) {
+          auto ret = collision_map.insert(std::make_pair((hash_index_byte_offset + total_bytes_required) / LogicalBlockSize, nullptr));
+          if (ret.second) { // fresh insert
+            ret.first->second = std::shared_ptr<const TBufBlock>(new TBufBlock());
+          }
+        }
+      }
       size_t max_blocks_required = ceil(static_cast<double>(total_bytes_required) / LogicalBlockSize);
       const size_t total_num_blocks_required = BlockVec->Size() + max_blocks_required;
       Engine->AppendReserveBlocks(StorageSpeed, max_blocks_required, *BlockVec);
@@ -2362,13 +2279,50 @@ class TMergeDataFileImpl {
       }
       #endif
       TCompletionTrigger completion_trigger;
-      for (const auto &collection : HashCollectorVec) {
+      for (size_t idx = 0; idx < HashCollectorVec.size(); ++idx) {
+        const auto &collection = HashCollectorVec[idx];
+        if (HashIndexVersion == Disk::Util::BucketedHashIndex) {
+          const size_t num_buckets = num_buckets_vec[idx];
+          assert(hash_index_byte_offset == NumHashFieldsByOffset[idx].first);
+          typename THashCollector::TCursor hash_csr(bucketed_collector_vec[idx].get(), MaxBlockCacheReadSlotsAllowed);
+          TDataOutStream bucket_stream(HERE,
+                                       Source::MergeDataFileHashIndex,
+                                       Engine->GetVolMan(),
+                                       hash_index_byte_offset,
+                                       *BlockVec,
+                                       collision_map,
+                                       completion_trigger,
+                                       Priority,
+                                       true /* do_cache */
+                                       #ifndef NDEBUG
+                                       ,WrittenBlockSet
+                                       #endif
+                                       );
+          TDataOutStream entry_stream(HERE,
+                                      Source::MergeDataFileHashIndex,
+                                      Engine->GetVolMan(),
+                                      ByteOffsetOfHashEntriesVec[idx],
+                                      *BlockVec,
+                                      collision_map,
+                                      completion_trigger,
+                                      Priority,
+                                      true /* do_cache */
+                                      #ifndef NDEBUG
+                                      ,WrittenBlockSet
+                                      #endif
+                                      );
+          Disk::Util::WriteBucketedHashIndex(hash_csr, num_buckets, bucket_stream, entry_stream);
+          FileSize = entry_stream.GetOffset();
+          hash_index_byte_offset += Disk::Util::GetBucketedHashIndexSize(num_buckets, collection->GetSize(), TData::HashEntrySize);
+          continue;
+        }
         size_t num_hash_fields = Disk::Util::SuggestHashSize(collection->GetSize());
         /* make a new index with the hashes modded by the hash field size */
         THashCollector modded_hash_collector(HERE, Source::DataFileHashIndex, TempFileConsolThresh, SorterStorageSpeed, Engine, true);
         for (typename THashCollector::TCursor orig_csr(collection.get(), MaxBlockCacheReadSlotsAllowed); orig_csr; ++orig_csr) {
           const THashObj &obj = *orig_csr;
           modded_hash_collector.Emplace(obj.Core, obj.Hash % num_hash_fields, obj.Offset);
+          bloom_filter.Add(obj.Hash);
         }
         typename THashCollector::TCursor hash_csr(&modded_hash_collector, MaxBlockCacheReadSlotsAllowed);
         /* do the first pass over the hash map */ {
@@ -2482,6 +2436,49 @@ class TMergeDataFileImpl {
         }
         hash_index_byte_offset += num_hash_fields * TDataFile::HashEntrySize;
       }
+      /* write the bloom filter */
+      if (bloom_filter.IsEnabled()) {
+        assert(hash_index_byte_offset == ByteOffsetOfBloomFilter);
+        TDataOutStream stream(HERE,
+                              Source::MergeDataFileBloomFilter,
+                              Engine->GetVolMan(),
+                              ByteOffsetOfBloomFilter,
+                              *BlockVec,
+                              collision_map,
+                              completion_trigger,
+                              Priority,
+                              true /* do_cache */
+                              #ifndef NDEBUG
+                              ,WrittenBlockSet
+                              #endif
+                              );
+        stream.Write(bloom_filter.GetData(), bloom_filter.GetNumBytes());
+        FileSize = stream.GetOffset();
+      }
+      NumBloomFilterBits = bloom_filter.GetNumBits();
+      NumBloomFilterProbes = bloom_filter.GetNumProbes();
+      /* write the key fences */
+      if (!FenceVec.empty()) {
+        TDataOutStream stream(HERE,
+                              Source::MergeDataFileKeyFence,
+                              Engine->GetVolMan(),
+                              ByteOffsetOfKeyFences,
+                              *BlockVec,
+                              collision_map,
+                              completion_trigger,
+                              Priority,
+                              true /* do_cache */
+                              #ifndef NDEBUG
+                              ,WrittenBlockSet
+                              #endif
+                              );
+        for (const auto &fence : FenceVec) {
+          stream << fence.first;
+          stream.Write(&fence.second, sizeof(Atom::TCore));
+        }
+        FileSize = stream.GetOffset();
+      }
+      bucketed_collector_vec.clear();
       /* flush collision blocks */ {
         for (auto iter : collision_map) {
           assert(iter.first < BlockVec->Size());
@@ -2524,6 +2521,30 @@ class TMergeDataFileImpl {
 
     };
 
+    /* Write a current key entry (less its hashes) and note it in the update index and the key fences. */
+    void WriteCurKey(TSequenceNumber seq_num, const Atom::TCore &key, const Atom::TCore &val) {
+      assert(this);
+      ++NumCurKeys;
+      TDataOutStream &stream = *KeyStream;
+      if (!FirstKey) {
+        stream << NumCurHistoryElem << ByteOffsetOfCurHistory;
+        ByteOffsetOfCurHistory += NumCurHistoryElem * TData::KeyHistorySize;
+        NumCurHistoryElem = 0UL;
+      } else {
+        FirstKey = false;
+      }
+      CurKeyOffset = stream.GetOffset();
+      /* the first key to start in a new block becomes that block's fence */
+      if (FenceVec.empty() || CurKeyOffset / LogicalBlockSize != (ByteOffsetOfKeyIndex + FenceVec.back().first * TData::KeyEntrySize) / LogicalBlockSize) {
+        FenceVec.emplace_back(NumCurKeys - 1UL, key);
+      }
+      stream << seq_num;
+      stream.Write(&key, sizeof(key));
+      stream.Write(&val, sizeof(val));
+      assert(stream.GetOffset() <= MaxByteOffsetOfKeyStream);
+      UpdateCollector->Emplace(seq_num, CurKeyOffset, true, IndexId);
+    }
+
     Base::TUuid IndexId;
 
     TEngine *Engine;
@@ -2539,31 +2560,11 @@ class TMergeDataFileImpl {
 
     TKey ExampleKey;
 
-    Atom::TCore::TOffset RemapKey(Atom::TCore::TOffset offset) {
-      assert(this);
-      /* TODO: should we keep the old offset to make sure we've got the right one? */
-      const TRemapResolvedObj &obj = **ResolvedKeySorterCursorVec[MyPos];
-      assert(offset == obj.OldKey);
-      Atom::TCore::TOffset ret = obj.NewKey;
-      assert(ResolvedKeySorterCursorVec[MyPos]);
-      ++(*ResolvedKeySorterCursorVec[MyPos]);
-      return ret;
-    }
-
-    Atom::TCore::TOffset RemapVal(Atom::TCore::TOffset offset) {
-      assert(this);
-      /* TODO: should we keep the old offset to make sure we've got the right one? */
-      const TRemapResolvedObj &obj = **ResolvedValSorterCursorVec[MyPos];
-      assert(offset == obj.OldKey);
-      Atom::TCore::TOffset ret = obj.NewKey;
-      assert(ResolvedValSorterCursorVec[MyPos]);
-      ++(*ResolvedValSorterCursorVec[MyPos]);
-      return ret;
-    }
-
     size_t ArenaByteOffset;
     size_t NumArenaNotes;
     size_t NumArenaBytes;
+    TArenaChunkVec ArenaChunkVec;
+    size_t ArenaChunkTableOffset;
     std::vector<std::unique_ptr<TArenaKeeperSorter>> ArenaKeeperVec;
     std::vector<std::unique_ptr<TRemapSorter>> ArenaRemapSorterVec;
     TDataFile::TTypeBoundaryOffsetVec ArenaTypeBoundaryOffsetVec;
@@ -2573,9 +2574,6 @@ class TMergeDataFileImpl {
     TBlockVec *BlockVec;
     size_t FileSize;
 
-    size_t MyPos; /* index into ResolvedKeySorterCursorVec, ResolvedValSorterCursorVec */
-    std::vector<std::unique_ptr<typename TRemapResolvedSorter::TCursor>> ResolvedKeySorterCursorVec;
-    std::vector<std::unique_ptr<typename TRemapResolvedSorter::TCursor>> ResolvedValSorterCursorVec;
     size_t NumCurKeys;
     size_t NumHistKeys;
     size_t EndOfHistoryStream;
@@ -2601,6 +2599,22 @@ class TMergeDataFileImpl {
 
     std::vector<std::pair<size_t, size_t>> NumHashFieldsByOffset;
 
+    /* For a bucketed hash index, where its (core, offset) entries start; 0 for a linear probe index. */
+    std::vector<size_t> ByteOffsetOfHashEntriesVec;
+
+    /* The format of our hash indexes. */
+    size_t HashIndexVersion;
+
+    /* The position and core of the first key entry to start in each logical block of the key index.  These get written
+       after the bloom filter. */
+    std::vector<std::pair<size_t, Atom::TCore>> FenceVec;
+    size_t ByteOffsetOfKeyFences;
+
+    /* The bloom filter over every hashed key (and key prefix) follows the hash tables. */
+    size_t ByteOffsetOfBloomFilter;
+    size_t NumBloomFilterBits;
+    size_t NumBloomFilterProbes;
+
     TUpdateCollector *UpdateCollector;
 
     size_t GenId;
@@ -2648,15 +2662,479 @@ class TMergeDataFileImpl {
       return NumArenaBytes;
     }
 
+    friend class TMergeDataFileImpl<CanTail, CanTailTombstones>;
+
+  };
+
+  /* One slice of an index's key space: the current keys numbered [CurBeginVec[i], CurEndVec[i]) and the history keys
+     numbered [HistBeginVec[i], HistEndVec[i]) of each source file i, which between them hold every version of every
+     key in the slice.  It carries what it takes to merge the slice by itself: arenas over the source files and
+     cursors over the remaps, resolved in the order in which the slice's merge will ask for them. */
+  class TKeyRange {
+    NO_COPY(TKeyRange);
     public:
 
-    std::function<Atom::TCore::TOffset(Atom::TCore::TOffset)> KeyRemapper;
+    /* The range starts out covering nothing; the caller fills in the sources and bounds. */
+    TKeyRange(size_t max_block_cache_read_slots_allowed, const std::vector<std::vector<bool>> &hist_filter_vec_vec)
+        : MaxBlockCacheReadSlotsAllowed(max_block_cache_read_slots_allowed),
+          HistFilterVecVec(hist_filter_vec_vec),
+          MyPos(0UL) {
+      KeyRemapper = std::bind(&TKeyRange::RemapKey, this, std::placeholders::_1);
+      ValRemapper = std::bind(&TKeyRange::RemapVal, this, std::placeholders::_1);
+    }
 
+    /* Our share of the block cache read slots. */
+    const size_t MaxBlockCacheReadSlotsAllowed;
+
+    /* The source files, with the remaps from their arenas to the new index arena (for keys) and the new main arena
+       (for values). */
+    std::vector<typename TReader::TIndexFile *> SourceFileVec;
+    std::vector<TRemapSorter *> KeyRemapSorterVec;
+    std::vector<TRemapSorter *> ValRemapSorterVec;
+
+    /* When tailing, which history keys of each source file we keep. */
+    const std::vector<std::vector<bool>> &HistFilterVecVec;
+
+    /* Where our slice of each source file starts and stops. */
+    std::vector<size_t> CurBeginVec;
+    std::vector<size_t> CurEndVec;
+    std::vector<size_t> HistBeginVec;
+    std::vector<size_t> HistEndVec;
+
+    /* The arenas we read the source keys through.  A range merging on a worker owns its arenas, since an arena can't
+       be shared between runners; a range merging in line borrows the index file's. */
+    std::vector<TDataDiskArena<true> *> ArenaVec;
+    std::vector<std::unique_ptr<TDataDiskArena<true>>> OwnArenaVec;
+
+    /* The resolved remaps for the current keys (even pos) and history keys (odd pos) of each source file, and cursors
+       over them. */
+    std::vector<std::unique_ptr<TRemapResolvedSorter>> KeyResolvedSorterVec;
+    std::vector<std::unique_ptr<TRemapResolvedSorter>> ValResolvedSorterVec;
+    std::vector<std::unique_ptr<typename TRemapResolvedSorter::TCursor>> KeyResolvedCursorVec;
+    std::vector<std::unique_ptr<typename TRemapResolvedSorter::TCursor>> ValResolvedCursorVec;
+
+    /* The pos of the key being remapped. */
+    size_t MyPos;
+
+    /* Remap the offsets in the key and value cores of the key at MyPos. */
+    std::function<Atom::TCore::TOffset(Atom::TCore::TOffset)> KeyRemapper;
     std::function<Atom::TCore::TOffset(Atom::TCore::TOffset)> ValRemapper;
 
-    friend class TMergeDataFileImpl<CanTail, CanTailTombstones>;
+    private:
 
-  };
+    /* See KeyRemapper. */
+    Atom::TCore::TOffset RemapKey(Atom::TCore::TOffset offset) {
+      assert(this);
+      typename TRemapResolvedSorter::TCursor &csr = *KeyResolvedCursorVec[MyPos];
+      assert(csr);
+      assert(offset == csr->OldKey);
+      Atom::TCore::TOffset ret = csr->NewKey;
+      ++csr;
+      return ret;
+    }
+
+    /* See ValRemapper. */
+    Atom::TCore::TOffset RemapVal(Atom::TCore::TOffset offset) {
+      assert(this);
+      typename TRemapResolvedSorter::TCursor &csr = *ValResolvedCursorVec[MyPos];
+      assert(csr);
+      assert(offset == csr->OldKey);
+      Atom::TCore::TOffset ret = csr->NewKey;
+      ++csr;
+      return ret;
+    }
+
+  };  // TKeyRange
+
+  /* A current or history key merged by a range, numbered in the order the range merged it. */
+  class TRangeKeyObj {
+    public:
+
+    /* Do-little. */
+    TRangeKeyObj(size_t idx, TSequenceNumber seq_num, const Atom::TCore &key, const Atom::TCore &val, bool is_cur)
+        : Idx(idx), SeqNum(seq_num), Key(key), Val(val), IsCur(is_cur) {}
+
+    /* Keys come back out in the order they went in. */
+    bool operator<(const TRangeKeyObj &that) const {
+      return Idx < that.Idx;
+    }
+
+    size_t Idx;
+    TSequenceNumber SeqNum;
+    Atom::TCore Key;
+    Atom::TCore Val;
+    bool IsCur;
+
+  };  // TRangeKeyObj
+
+  /* What a range merged on a worker hands to TMergeIndexFile::AppendRange(): its keys, in order, and the hashes of
+     their prefixes, each pointing at its key's number within the range. */
+  class TRangeOutput {
+    NO_COPY(TRangeOutput);
+    public:
+
+    /* Holds the keys until they're stitched in; spills to disk like the hash collectors do. */
+    using TKeyCollector = TIndexManager<TRangeKeyObj, Disk::Util::SortBufSize, Disk::Util::SortBufMinParallelSize>;
+
+    /* The prefix arena is opened on the runner doing the merge. */
+    TRangeOutput(TMergeIndexFile *index_file,
+                 size_t num_hash_tables,
+                 TEngine *engine,
+                 size_t temp_file_consol_thresh,
+                 TVolume::TDesc::TStorageSpeed sorter_storage_speed)
+        : IndexFile(index_file),
+          KeyCollector(HERE, Source::MergeDataFileKey, temp_file_consol_thresh, sorter_storage_speed, engine, true),
+          NumKeys(0UL),
+          NumCurKeys(0UL) {
+      for (size_t i = 0; i < num_hash_tables; ++i) {
+        HashCollectorVec.emplace_back(new typename TMergeIndexFile::THashCollector(HERE, Source::MergeDataFileHashIndex, temp_file_consol_thresh, sorter_storage_speed, engine, true));
+      }
+    }
+
+    /* Takes a current key the way TMergeIndexFile::PushCurKey() does. */
+    void PushCurKey(TSequenceNumber seq_num, const Atom::TCore &key, const Atom::TCore &val) {
+      assert(this);
+      KeyCollector.Emplace(NumKeys++, seq_num, key, val, true);
+      ++NumCurKeys;
+      TMergeDataFileImpl::ForEachNewPrefix(key, PrefixArena.get(), SeenPrefix, [this](uint64_t prefix_size, const Atom::TCore &prefix_core, size_t prefix_hash) {
+        if (NumCurKeys == 1UL) {
+          FirstKeyHashVec.emplace_back(prefix_size, typename TMergeIndexFile::THashObj(prefix_core, prefix_hash, 0UL));
+        } else {
+          HashCollectorVec[prefix_size - 1]->Emplace(prefix_core, prefix_hash, NumCurKeys - 1UL);
+        }
+      });
+    }
+
+    /* Takes a history key the way TMergeIndexFile::PushHistKey() does. */
+    void PushHistKey(TSequenceNumber seq_num, const Atom::TCore &key, const Atom::TCore &val) {
+      assert(this);
+      KeyCollector.Emplace(NumKeys++, seq_num, key, val, false);
+    }
+
+    /* The index file we're merging for. */
+    TMergeIndexFile *IndexFile;
+
+    /* Our own arena over the index file's new arena, for hashing key prefixes. */
+    std::unique_ptr<TDataDiskArena<true>> PrefixArena;
+
+    /* Our current and history keys, in order. */
+    TKeyCollector KeyCollector;
+
+    /* The prefix hashes of all but our first key, by prefix size - 1. */
+    std::vector<std::unique_ptr<typename TMergeIndexFile::THashCollector>> HashCollectorVec;
+
+    /* The prefix hashes of our first key, longest prefix first, with their prefix sizes.  Some of them may turn out to
+       be covered by the key before ours. */
+    std::vector<std::pair<uint64_t, typename TMergeIndexFile::THashObj>> FirstKeyHashVec;
+
+    /* The prefixes of our last key, by prefix size. */
+    std::unordered_map<uint64_t, TKey> SeenPrefix;
+
+    /* The number of keys, and of current keys, we've taken. */
+    size_t NumKeys;
+    size_t NumCurKeys;
+
+  };  // TRangeOutput
+
+  /* Splits the index's key space into ranges for the worker pool.  The split points are key fences of the source file
+     with the most current keys, so each range starts at the first key of one of that file's key index blocks, and we
+     never make more ranges than we have workers or fences.  Each split point is looked up in every source file to find
+     where its slice of that file starts.  Without a pool, or without fences, we return one range over everything. */
+  std::vector<std::unique_ptr<TKeyRange>> SplitKeyRanges(TMergeIndexFile &idx_file,
+                                                         const std::vector<std::unique_ptr<TRemapSorter>> &main_remap_sorter_vec,
+                                                         const std::vector<size_t> &read_file_vec_pos_by_source_pos) const {
+    assert(this);
+    const std::vector<std::unique_ptr<typename TReader::TIndexFile>> &source_file_vec = idx_file.SourceFileVec;
+    const size_t num_sources = source_file_vec.size();
+    size_t largest = 0UL;
+    for (size_t i = 1; i < num_sources; ++i) {
+      if (source_file_vec[i]->GetNumCurKeys() > source_file_vec[largest]->GetNumCurKeys()) {
+        largest = i;
+      }
+    }
+    const size_t num_fences = source_file_vec[largest]->GetNumKeyFences();
+    const size_t num_ranges = WorkerPool ? std::max(1UL, std::min(WorkerPool->GetWorkerCount(), num_fences)) : 1UL;
+    /* where each split point falls in each source file's current and history keys */
+    std::vector<std::vector<size_t>> cur_split_vec_vec(num_sources), hist_split_vec_vec(num_sources);
+    for (size_t i = 1; i < num_ranges; ++i) {
+      const TKey split_key(source_file_vec[largest]->GetKeyFence((i * num_fences) / num_ranges), idx_file.DiskArenaVec[largest].get());
+      for (size_t source = 0; source < num_sources; ++source) {
+        typename TReader::TIndexFile &source_file = *source_file_vec[source];
+        size_t cur_split = 0UL;
+        if (source_file.GetNumCurKeys()) {
+          typename TReader::TIndexFile::TInStream in_stream(HERE, Source::MergeDataFileScan, Priority, &source_file, Engine->GetCache<TReader::PhysicalCachePageSize>(), 0UL);
+          size_t offset;
+          source_file.BinaryLowerBoundOnKey(split_key, offset, in_stream, idx_file.DiskArenaVec[source].get());
+          cur_split = (offset - source_file.GetByteOffsetOfKeyIndex()) / TData::KeyEntrySize;
+        }
+        /* a file's history keys are stored in the order of the current keys they belong to */
+        size_t hist_split = source_file.GetNumHistKeys();
+        if (cur_split < source_file.GetNumCurKeys()) {
+          typename TReader::TIndexFile::TKeyCursor csr(&source_file, cur_split);
+          hist_split = (*csr).OffsetOfHistKeys / TData::KeyHistorySize;
+        }
+        cur_split_vec_vec[source].push_back(cur_split);
+        hist_split_vec_vec[source].push_back(hist_split);
+      }
+    }
+    std::vector<std::unique_ptr<TKeyRange>> range_vec;
+    for (size_t i = 0; i < num_ranges; ++i) {
+      range_vec.emplace_back(new TKeyRange(MaxBlockCacheReadSlotsAllowed / num_ranges, idx_file.HistoryKeeperFilterVec));
+      TKeyRange &range = *range_vec.back();
+      for (size_t source = 0; source < num_sources; ++source) {
+        range.SourceFileVec.push_back(source_file_vec[source].get());
+        range.KeyRemapSorterVec.push_back(idx_file.ArenaRemapSorterVec[source].get());
+        range.ValRemapSorterVec.push_back(main_remap_sorter_vec[read_file_vec_pos_by_source_pos[source]].get());
+        range.CurBeginVec.push_back(i ? cur_split_vec_vec[source][i - 1] : 0UL);
+        range.CurEndVec.push_back(i + 1 < num_ranges ? cur_split_vec_vec[source][i] : source_file_vec[source]->GetNumCurKeys());
+        range.HistBeginVec.push_back(i ? hist_split_vec_vec[source][i - 1] : 0UL);
+        range.HistEndVec.push_back(i + 1 < num_ranges ? hist_split_vec_vec[source][i] : source_file_vec[source]->GetNumHistKeys());
+      }
+    }
+    return range_vec;
+  }
+
+  /* Scans the range's slice of the current keys (even pos) or history keys (odd pos) of a source file, recording the
+     order in which key and value offsets are needed, and resolves them against the remap sorters into the range's
+     resolved sorters. */
+  void BuildAccessPattern(TKeyRange &range, size_t pos) const {
+    assert(this);
+    typename TReader::TIndexFile *source_file = range.SourceFileVec[pos / 2];
+    auto key_access_sorter = make_unique<TRemapAccessSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true);
+    auto val_access_sorter = make_unique<TRemapAccessSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true);
+    size_t idx = 0UL;
+    auto emplace = [&](const Atom::TCore &key, const Atom::TCore &val) {
+      const Atom::TCore::TOffset *key_off = key.TryGetOffset();
+      if (key_off) {
+        key_access_sorter->Emplace(++idx, *key_off);
+      }
+      const Atom::TCore::TOffset *val_off = val.TryGetOffset();
+      if (val_off) {
+        val_access_sorter->Emplace(++idx, *val_off);
+      }
+    };
+    if (pos % 2 == 0) {
+      /* current keys */
+      for (typename TReader::TIndexFile::TKeyCursor key_cursor(source_file, range.CurBeginVec[pos / 2], range.CurEndVec[pos / 2]); key_cursor; ++key_cursor) {
+        const typename TReader::TIndexFile::TKeyItem &item = *key_cursor;
+        if (!CanTailTombstones || !item.Value.IsTombstone() || item.NumHistKeys > 0) {
+          emplace(item.Key, item.Value);
+        }
+      }
+    } else {
+      /* history keys */
+      if (CanTail) {
+        const std::vector<bool> &hist_filter_vec = range.HistFilterVecVec[pos / 2];
+        assert(hist_filter_vec.size() == source_file->GetNumHistKeys());
+        size_t cur_hist_offset = range.HistBeginVec[pos / 2];
+        for (typename TReader::TIndexFile::THistoryKeyCursor history_cursor(source_file, range.HistBeginVec[pos / 2], range.HistEndVec[pos / 2]); history_cursor; ++history_cursor, ++cur_hist_offset) {
+          assert(cur_hist_offset < hist_filter_vec.size());
+          if (hist_filter_vec[cur_hist_offset]) {
+            const typename TReader::TIndexFile::THistoryKeyItem &item = *history_cursor;
+            emplace(item.Key, item.Value);
+          }
+        }
+      } else {
+        for (typename TReader::TIndexFile::THistoryKeyCursor history_cursor(source_file, range.HistBeginVec[pos / 2], range.HistEndVec[pos / 2]); history_cursor; ++history_cursor) {
+          const typename TReader::TIndexFile::THistoryKeyItem &item = *history_cursor;
+          emplace(item.Key, item.Value);
+        }
+      }
+    }
+    ResolveRemap(range.MaxBlockCacheReadSlotsAllowed, *key_access_sorter, *range.KeyRemapSorterVec[pos / 2], *range.KeyResolvedSorterVec[pos]);
+    ResolveRemap(range.MaxBlockCacheReadSlotsAllowed, *val_access_sorter, *range.ValRemapSorterVec[pos / 2], *range.ValResolvedSorterVec[pos]);
+  }
+
+  /* Builds the range's access patterns and opens its remap cursors. */
+  void ResolveKeyRange(TKeyRange &range) const {
+    assert(this);
+    const size_t num_pos = range.SourceFileVec.size() * 2UL;
+    for (size_t pos = 0; pos < num_pos; ++pos) {
+      range.KeyResolvedSorterVec.push_back(make_unique<TRemapResolvedSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
+      range.ValResolvedSorterVec.push_back(make_unique<TRemapResolvedSorter>(HERE, Source::MergeDataFileScan, TempFileConsolThresh, SorterStorageSpeed, Engine, true));
+      BuildAccessPattern(range, pos);
+    }
+    const size_t max_block_cache_read_slot_per_sub_cursor = range.MaxBlockCacheReadSlotsAllowed / (num_pos * 2UL);
+    for (size_t pos = 0; pos < num_pos; ++pos) {
+      range.KeyResolvedCursorVec.push_back(std::make_unique<typename TRemapResolvedSorter::TCursor>(range.KeyResolvedSorterVec[pos].get(), max_block_cache_read_slot_per_sub_cursor));
+      range.ValResolvedCursorVec.push_back(std::make_unique<typename TRemapResolvedSorter::TCursor>(range.ValResolvedSorterVec[pos].get(), max_block_cache_read_slot_per_sub_cursor));
+    }
+  }
+
+  /* Merges the range's current and history keys out of the source files, in key order and newest first, remaps their
+     cores into the new arenas and pushes them to the sink.  The sink is either the index file itself or, for a range
+     merged on a worker, a TRangeOutput. */
+  template <typename TSink>
+  static void MergeKeyRange(TKeyRange &range, TSink &sink) {
+    const size_t num_sources = range.SourceFileVec.size();
+    assert(range.ArenaVec.size() == num_sources);
+    std::vector<std::unique_ptr<typename TReader::TIndexFile::TKeyCursor>> cur_key_cursor_vec;
+    std::vector<std::unique_ptr<typename TReader::TIndexFile::THistoryKeyCursor>> hist_key_cursor_vec;
+    /* for each source, the number of the history key its cursor is on */
+    std::vector<size_t> history_key_cur_idx_vec(range.HistBeginVec);
+    Orly::Indy::Util::TMinHeap<TSortedKey, size_t> min_heap(num_sources * 2);
+    std::vector<TSortedKey> sorted_key_vec(num_sources * 2);
+    /* put the current key at or after the cursor for the given pos on the heap, skipping any we don't keep */
+    auto insert_cur = [&](size_t pos) {
+      typename TReader::TIndexFile::TKeyCursor &cur_csr = *cur_key_cursor_vec[pos / 2];
+      if (CanTailTombstones) {
+        for (; cur_csr && (*cur_csr).Value.IsTombstone() && (*cur_csr).NumHistKeys == 0; ++cur_csr) {}
+      }
+      if (cur_csr) {
+        const typename TReader::TIndexFile::TKeyItem &item = *cur_csr;
+        TSortedKey &k = sorted_key_vec[pos];
+        k.Core = item.Key;
+        k.Arena = range.ArenaVec[pos / 2];
+        k.SeqNum = item.SeqNum;
+        min_heap.Insert(k, pos);
+      }
+    };
+    /* likewise for history keys */
+    auto insert_hist = [&](size_t pos) {
+      typename TReader::TIndexFile::THistoryKeyCursor &hist_csr = *hist_key_cursor_vec[pos / 2];
+      if (CanTail) {
+        size_t &cur_hist_offset = history_key_cur_idx_vec[pos / 2];
+        const std::vector<bool> &hist_filter_vec = range.HistFilterVecVec[pos / 2];
+        for (; hist_csr && !hist_filter_vec[cur_hist_offset]; ++hist_csr, ++cur_hist_offset) {}
+      }
+      if (hist_csr) {
+        const typename TReader::TIndexFile::THistoryKeyItem &item = *hist_csr;
+        TSortedKey &k = sorted_key_vec[pos];
+        k.Core = item.Key;
+        k.Arena = range.ArenaVec[pos / 2];
+        k.SeqNum = item.SeqNum;
+        min_heap.Insert(k, pos);
+      }
+    };
+    for (size_t source = 0; source < num_sources; ++source) {
+      cur_key_cursor_vec.emplace_back(new typename TReader::TIndexFile::TKeyCursor(range.SourceFileVec[source], range.CurBeginVec[source], range.CurEndVec[source]));
+      hist_key_cursor_vec.emplace_back(new typename TReader::TIndexFile::THistoryKeyCursor(range.SourceFileVec[source], range.HistBeginVec[source], range.HistEndVec[source]));
+      insert_cur(source * 2);
+      insert_hist(source * 2 + 1);
+    }
+    Base::TOpt<TKey> last_written;
+    while (min_heap) {
+      size_t pos;
+      min_heap.Pop(pos);
+      range.MyPos = pos;
+      if (pos % 2 == 0) { /* came from a current source */
+        typename TReader::TIndexFile::TKeyCursor &cur_csr = *cur_key_cursor_vec[pos / 2];
+        assert(cur_csr);
+        const typename TReader::TIndexFile::TKeyItem &cur_item = *cur_csr;
+        TKey cur_key(cur_item.Key, range.ArenaVec[pos / 2]);
+        Atom::TCore key_core = cur_item.Key;
+        Atom::TCore val_core = cur_item.Value;
+        key_core.Remap(range.KeyRemapper);
+        val_core.Remap(range.ValRemapper);
+        if (!last_written || *last_written != cur_key) { /* new key */
+          sink.PushCurKey(cur_item.SeqNum, key_core, val_core);
+          last_written = cur_key;
+        } else { /* history key */
+          sink.PushHistKey(cur_item.SeqNum, key_core, val_core);
+        }
+        ++cur_csr;
+        insert_cur(pos);
+      } else { /* came from a history source */
+        typename TReader::TIndexFile::THistoryKeyCursor &hist_csr = *hist_key_cursor_vec[pos / 2];
+        assert(hist_csr);
+        const typename TReader::TIndexFile::THistoryKeyItem &cur_item = *hist_csr;
+        Atom::TCore key_core = cur_item.Key;
+        Atom::TCore val_core = cur_item.Value;
+        key_core.Remap(range.KeyRemapper);
+        val_core.Remap(range.ValRemapper);
+        sink.PushHistKey(cur_item.SeqNum, key_core, val_core);
+        ++hist_csr;
+        if (CanTail) {
+          ++history_key_cur_idx_vec[pos / 2];
+        }
+        insert_hist(pos);
+      }
+    }
+  }
+
+  /* Merges one range into its output.  Runs on a worker, so it opens its own arenas over the source files and the new
+     index arena. */
+  void RunKeyRange(TKeyRange &range, TRangeOutput &output) const {
+    assert(this);
+    for (auto *source_file : range.SourceFileVec) {
+      range.OwnArenaVec.emplace_back(new TDataDiskArena<true>(source_file, Engine->GetCache<TDataDiskArena<true>::PhysicalCachePageSize>(), Priority));
+      range.ArenaVec.push_back(range.OwnArenaVec.back().get());
+    }
+    output.PrefixArena = std::make_unique<TDataDiskArena<true>>(output.IndexFile, Engine->GetCache<TDataDiskArena<true>::PhysicalCachePageSize>(), Priority);
+    ResolveKeyRange(range);
+    MergeKeyRange(range, output);
+  }
+
+  /* Runs one RunKeyRange() call on a worker pool runner. The frame comes from, and goes back to, the frame pool of the
+     constructing thread. Any exception is held until the owner has synced. */
+  class TKeyRangeRunnable
+      : public Fiber::TRunnable {
+    NO_COPY(TKeyRangeRunnable);
+    public:
+
+    /* Schedules the range's merge right away.  The owner must sync on safe_sync before it touches the range or the
+       output again, or lets any of them (or us) go. */
+    TKeyRangeRunnable(const TMergeDataFileImpl *merge_file,
+                      Fiber::TRunnerPool &worker_pool,
+                      Fiber::TSafeSync &safe_sync,
+                      TKeyRange &range,
+                      TRangeOutput &output)
+        : MergeFile(merge_file),
+          SafeSync(safe_sync),
+          Range(range),
+          Output(output) {
+      SafeSync.WaitForMore(1UL);
+      FramePool = Fiber::TFrame::LocalFramePool;
+      Fiber::TFrame *frame = FramePool->Alloc();
+      try {
+        worker_pool.Schedule(frame, this, static_cast<Fiber::TRunnable::TFunc>(&TKeyRangeRunnable::Run));
+      } catch (...) {
+        FramePool->Free(frame);
+        throw;
+      }
+    }
+
+    /* The body of our frame: merge the range, note any failure, and tell the owner we're done. */
+    void Run() {
+      assert(this);
+      try {
+        MergeFile->RunKeyRange(Range, Output);
+      } catch (...) {
+        Error = std::current_exception();
+      }
+      /* we may be destroyed as soon as the sync completes, but our frame is still running, so the worker frees it */
+      auto *frame_pool = FramePool;
+      SafeSync.Complete();
+      Fiber::FreeMyFrame(frame_pool);
+    }
+
+    /* Call only after the sync has completed. */
+    void RethrowIfFailed() const {
+      assert(this);
+      if (Error) {
+        std::rethrow_exception(Error);
+      }
+    }
+
+    private:
+
+    /* The pool our frame came from. */
+    Base::TThreadLocalGlobalPoolManager<Fiber::TFrame, size_t, Fiber::TRunner *>::TThreadLocalPool *FramePool;
+
+    /* The merge we're doing a range of. */
+    const TMergeDataFileImpl *MergeFile;
+
+    /* Completed once the range is merged, whether or not that worked. */
+    Fiber::TSafeSync &SafeSync;
+
+    /* The range we merge, and where its keys go. */
+    TKeyRange &Range;
+    TRangeOutput &Output;
+
+    /* Whatever the merge threw, if anything. */
+    std::exception_ptr Error;
+
+  };  // TKeyRangeRunnable
 
   /* TODO */
   TEngine *Engine;
@@ -2699,6 +3177,9 @@ class TMergeDataFileImpl {
 
   size_t TempFileConsolThresh;
 
+  /* If non-null, each index's keys are split into ranges which merge on these workers instead of in line. */
+  Fiber::TRunnerPool *WorkerPool;
+
   /* TODO */
   std::vector<std::unique_ptr<TReader>> ReadFileVec;
 
@@ -2726,24 +3207,25 @@ TMergeDataFile::TMergeDataFile(Util::TEngine *engine,
                                size_t max_block_cache_read_slots_allowed,
                                size_t temp_file_consol_thresh,
                                bool can_tail,
-                               bool can_tail_tombstone) {
+                               bool can_tail_tombstone,
+                               Fiber::TRunnerPool *worker_pool) {
   if (can_tail) {
     if (can_tail_tombstone) {
-      TMergeDataFileImpl<true, true> merge_file(engine, storage_speed, file_uuid, gen_vec, file_uid, gen_id, release_up_to, priority, max_block_cache_read_slots_allowed, temp_file_consol_thresh);
+      TMergeDataFileImpl<true, true> merge_file(engine, storage_speed, file_uuid, gen_vec, file_uid, gen_id, release_up_to, priority, max_block_cache_read_slots_allowed, temp_file_consol_thresh, worker_pool);
       NumKeys = merge_file.GetNumKeys();
       LowestSeq = merge_file.GetLowestSequence();
       HighestSeq = merge_file.GetHighestSequence();
     } else {
-      TMergeDataFileImpl<true, false> merge_file(engine, storage_speed, file_uuid, gen_vec, file_uid, gen_id, release_up_to, priority, max_block_cache_read_slots_allowed, temp_file_consol_thresh);
+      TMergeDataFileImpl<true, false> merge_file(engine, storage_speed, file_uuid, gen_vec, file_uid, gen_id, release_up_to, priority, max_block_cache_read_slots_allowed, temp_file_consol_thresh, worker_pool);
       NumKeys = merge_file.GetNumKeys();
       LowestSeq = merge_file.GetLowestSequence();
       HighestSeq = merge_file.GetHighestSequence();
     }
   } else {
-    TMergeDataFileImpl<false, false> merge_file(engine, storage_speed, file_uuid, gen_vec, file_uid, gen_id, release_up_to, priority, max_block_cache_read_slots_allowed, temp_file_consol_thresh);
+    TMergeDataFileImpl<false, false> merge_file(engine, storage_speed, file_uuid, gen_vec, file_uid, gen_id, release_up_to, priority, max_block_cache_read_slots_allowed, temp_file_consol_thresh, worker_pool);
     NumKeys = merge_file.GetNumKeys();
     LowestSeq = merge_file.GetLowestSequence();
     HighestSeq = merge_file.GetHighestSequence();
     assert(!can_tail_tombstone);
   }
-}
\ No newline at end of file
+}
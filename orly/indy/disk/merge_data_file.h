@@ -24,6 +24,7 @@
 #include <orly/indy/disk/out_stream.h>
 #include <orly/indy/disk/read_file.h>
 #include <orly/indy/disk/util/index_manager.h>
+#include <orly/indy/fiber/fiber.h>
 #include <orly/indy/memory_layer.h>
 #include <orly/sabot/all.h>
 
@@ -42,7 +43,9 @@ namespace Orly {
         NO_COPY(TMergeDataFile);
         public:
 
-        /* TODO */
+        /* If a worker pool is given, each index's key space is split into ranges at the source files' key fences, the
+           ranges merge side by side on the pool's runners, and their keys get stitched back into one index.  The
+           caller must be running on a fiber with a local frame pool. */
         TMergeDataFile(Util::TEngine *engine,
                        Disk::Util::TVolume::TDesc::TStorageSpeed storage_speed,
                        const Base::TUuid &file_uuid,
@@ -54,7 +57,8 @@ namespace Orly {
                        size_t max_block_cache_read_slots_allowed,
                        size_t temp_file_consol_thresh,
                        bool can_tail,
-                       bool can_tail_tombstone);
+                       bool can_tail_tombstone,
+                       Fiber::TRunnerPool *worker_pool = nullptr);
 
         /* TODO */
         inline size_t GetNumKeys() const {
@@ -558,3 +558,187 @@ FIXTURE(JumpGrowingMainArena) {
     cond.notify_one();
   });
 }
+
+FIXTURE(WorkerPool) {
+  const size_t num_workers = 2UL;
+  TFiberTestRunner runner([num_workers](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &runner_cons) {
+    void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+    TScheduler scheduler(TScheduler::TPolicy(10, 10, milliseconds(10)));
+    TRunnerPool work_pool(runner_cons, num_workers);
+
+    Sim::TMemEngine mem_engine(&scheduler,
+                               256 /* disk space: 256MB */,
+                               256 /* slow disk space: 256MB */,
+                               16384 /* page cache slots: 64MB */,
+                               1 /* num page lru */,
+                               1024 /* block cache slots: 64MB */,
+                               1 /* num block lru */);
+
+    Base::TUuid file_id(TUuid::TimeAndMAC);
+    TSuprena arena;
+    TSequenceNumber seq_num = 0U;
+    Base::TUuid int_idx(Base::TUuid::Twister);
+    const string long_str("This string should be too long to fit in a core");
+    const int64_t num_keys = 5000L;
+    /* Data files 1, 2 and 3 share most of their keys, so the merge sees both current and history keys.  Runs of ten
+       keys share a prefix, so some runs straddle the boundary between two key ranges. */
+    for (size_t gen_id = 1UL; gen_id <= 3UL; ++gen_id) {
+      TMockMem mem_layer;
+      for (int64_t i = 0; i < num_keys; i += gen_id) {
+        Insert(mem_layer, ++seq_num, int_idx, TKey(long_str + to_string(i * gen_id), &arena, state_alloc), i / 10L, long_str + to_string(i));
+      }
+      TDataFile data_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, &mem_layer, file_id, gen_id, 20UL, 0U, RealTime);
+    }
+    /* the biggest generation spans enough key blocks to be split */ {
+      TReader reader(HERE, mem_engine.GetEngine(), file_id, 1UL);
+      TReader::TIndexFile idx_file(&reader, int_idx, RealTime);
+      EXPECT_GT(idx_file.GetNumKeyFences(), num_workers);
+    }
+    /* merge them in line into 4 and across the pool into 5 */ {
+      TMergeDataFile merge_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, file_id, vector<size_t>{1UL, 2UL, 3UL}, file_id, 4UL, 0U, Low, 16384, 20UL, false, false);
+      TMergeDataFile pool_merge_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, file_id, vector<size_t>{1UL, 2UL, 3UL}, file_id, 5UL, 0U, Low, 16384, 20UL, false, false, &work_pool);
+      EXPECT_EQ(pool_merge_file.GetNumKeys(), merge_file.GetNumKeys());
+      EXPECT_EQ(pool_merge_file.GetLowestSequence(), merge_file.GetLowestSequence());
+      EXPECT_EQ(pool_merge_file.GetHighestSequence(), merge_file.GetHighestSequence());
+    }
+    /* both merges must produce the same keys, values, history and hash index */ {
+      TReader expected_reader(HERE, mem_engine.GetEngine(), file_id, 4UL);
+      TReader::TArena expected_main_arena(&expected_reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TReader::TIndexFile expected_idx_file(&expected_reader, int_idx, RealTime);
+      TReader::TArena expected_idx_arena(&expected_idx_file, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TReader actual_reader(HERE, mem_engine.GetEngine(), file_id, 5UL);
+      TReader::TArena actual_main_arena(&actual_reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TReader::TIndexFile actual_idx_file(&actual_reader, int_idx, RealTime);
+      TReader::TArena actual_idx_arena(&actual_idx_file, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      EXPECT_EQ(actual_idx_file.GetNumCurKeys(), expected_idx_file.GetNumCurKeys());
+      EXPECT_EQ(actual_idx_file.GetNumHistKeys(), expected_idx_file.GetNumHistKeys());
+      EXPECT_EQ(actual_idx_file.GetNumKeyFences(), expected_idx_file.GetNumKeyFences());
+      size_t seen = 0UL;
+      TReader::TIndexFile::TKeyCursor actual_csr(&actual_idx_file);
+      for (TReader::TIndexFile::TKeyCursor expected_csr(&expected_idx_file); expected_csr && actual_csr; ++expected_csr, ++actual_csr, ++seen) {
+        EXPECT_EQ(TKey((*actual_csr).Key, &actual_idx_arena), TKey((*expected_csr).Key, &expected_idx_arena));
+        EXPECT_EQ(TKey((*actual_csr).Value, &actual_main_arena), TKey((*expected_csr).Value, &expected_main_arena));
+        EXPECT_EQ((*actual_csr).SeqNum, (*expected_csr).SeqNum);
+        EXPECT_EQ((*actual_csr).NumHistKeys, (*expected_csr).NumHistKeys);
+        EXPECT_EQ((*actual_csr).OffsetOfHistKeys, (*expected_csr).OffsetOfHistKeys);
+      }
+      EXPECT_EQ(seen, static_cast<size_t>(num_keys));
+      seen = 0UL;
+      TReader::TIndexFile::THistoryKeyCursor actual_hist_csr(&actual_idx_file);
+      for (TReader::TIndexFile::THistoryKeyCursor expected_hist_csr(&expected_idx_file); expected_hist_csr && actual_hist_csr; ++expected_hist_csr, ++actual_hist_csr, ++seen) {
+        EXPECT_EQ(TKey((*actual_hist_csr).Key, &actual_idx_arena), TKey((*expected_hist_csr).Key, &expected_idx_arena));
+        EXPECT_EQ(TKey((*actual_hist_csr).Value, &actual_main_arena), TKey((*expected_hist_csr).Value, &expected_main_arena));
+      }
+      EXPECT_EQ(seen, expected_idx_file.GetNumHistKeys());
+      /* every key and every prefix must hash to the same key entry; a prefix to the first key that has it */
+      TReader::TIndexFile::TInStream expected_stream(HERE, Source::PresentWalk, RealTime, &expected_reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), 0);
+      TReader::TIndexFile::TInStream actual_stream(HERE, Source::PresentWalk, RealTime, &actual_reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), 0);
+      size_t agreed = 0UL, agreed_prefix = 0UL;
+      for (int64_t i = 0; i < num_keys; ++i) {
+        TSuprena lookup_arena;
+        const TKey key(make_tuple(i / 10L, long_str + to_string(i)), &lookup_arena, state_alloc);
+        const TKey prefix(make_tuple(i / 10L, Native::TFree<string>()), &lookup_arena, state_alloc);
+        size_t expected_offset = 0UL, actual_offset = 0UL;
+        if (expected_idx_file.FindInHash(key, expected_offset, expected_stream, &expected_idx_arena) &&
+            actual_idx_file.FindInHash(key, actual_offset, actual_stream, &actual_idx_arena) &&
+            actual_offset - actual_idx_file.GetByteOffsetOfKeyIndex() == expected_offset - expected_idx_file.GetByteOffsetOfKeyIndex()) {
+          ++agreed;
+        }
+        if (expected_idx_file.FindInHash(prefix, expected_offset, expected_stream, &expected_idx_arena) &&
+            actual_idx_file.FindInHash(prefix, actual_offset, actual_stream, &actual_idx_arena) &&
+            actual_offset - actual_idx_file.GetByteOffsetOfKeyIndex() == expected_offset - expected_idx_file.GetByteOffsetOfKeyIndex() &&
+            expected_offset - expected_idx_file.GetByteOffsetOfKeyIndex() == static_cast<size_t>(i - i % 10L) * TData::KeyEntrySize) {
+          ++agreed_prefix;
+        }
+      }
+      EXPECT_EQ(agreed, static_cast<size_t>(num_keys));
+      EXPECT_EQ(agreed_prefix, static_cast<size_t>(num_keys));
+    }
+    GracefullShutdown();
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  }, num_workers);
+}
+
+FIXTURE(Codecs) {
+  TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &) {
+    void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+    TScheduler scheduler(TScheduler::TPolicy(10, 10, milliseconds(10)));
+
+    Sim::TMemEngine mem_engine(&scheduler,
+                               256 /* disk space: 256MB */,
+                               256 /* slow disk space: 256MB */,
+                               16384 /* page cache slots: 64MB */,
+                               1 /* num page lru */,
+                               1024 /* block cache slots: 64MB */,
+                               1 /* num block lru */);
+
+    TEngine *engine = mem_engine.GetEngine();
+    const TCodec *none = TCodec::Get(TCodecKind::None);
+    const TCodec *snappy = TCodec::Get(TCodecKind::Snappy);
+    Base::TUuid plain_file_id(TUuid::TimeAndMAC);
+    Base::TUuid packed_file_id(TUuid::TimeAndMAC);
+    Base::TUuid int_idx(Base::TUuid::Twister);
+    TSuprena arena;
+    const int64_t num_keys = 1000L;
+    const string long_str(200UL, 'z');
+    /* write the same generations once as they are and once compressed; the arenas are big enough to take several chunks */
+    for (const auto &file : { make_pair(plain_file_id, none), make_pair(packed_file_id, snappy) }) {
+      engine->SetDataFileCodec(file.second);
+      TSequenceNumber seq_num = 0U;
+      for (size_t gen_id = 1UL; gen_id <= 3UL; ++gen_id) {
+        TMockMem mem_layer;
+        for (int64_t i = 0; i < num_keys; i += gen_id) {
+          Insert(mem_layer, ++seq_num, int_idx, TKey(long_str + to_string(i * gen_id), &arena, state_alloc), i, long_str);
+        }
+        TDataFile data_file(engine, TVolume::TDesc::Fast, &mem_layer, file.first, gen_id, 20UL, 0U, RealTime);
+      }
+    }
+    /* merge the plain generations into a compressed one and the compressed generations into a plain one */ {
+      engine->SetDataFileCodec(snappy);
+      TMergeDataFile merge_file(engine, TVolume::TDesc::Fast, plain_file_id, vector<size_t>{1UL, 2UL, 3UL}, plain_file_id, 4UL, 0U, Low, 16384, 20UL, false, false);
+      engine->SetDataFileCodec(none);
+      TMergeDataFile packed_merge_file(engine, TVolume::TDesc::Fast, packed_file_id, vector<size_t>{1UL, 2UL, 3UL}, packed_file_id, 4UL, 0U, Low, 16384, 20UL, false, false);
+      EXPECT_EQ(packed_merge_file.GetNumKeys(), merge_file.GetNumKeys());
+    }
+    /* every generation must read back the same, whatever it was written with */
+    for (size_t gen_id = 1UL; gen_id <= 4UL; ++gen_id) {
+      TReader expected_reader(HERE, engine, plain_file_id, gen_id);
+      TReader::TArena expected_main_arena(&expected_reader, engine->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TReader::TIndexFile expected_idx_file(&expected_reader, int_idx, RealTime);
+      TReader::TArena expected_idx_arena(&expected_idx_file, engine->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TReader actual_reader(HERE, engine, packed_file_id, gen_id);
+      TReader::TArena actual_main_arena(&actual_reader, engine->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TReader::TIndexFile actual_idx_file(&actual_reader, int_idx, RealTime);
+      TReader::TArena actual_idx_arena(&actual_idx_file, engine->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      const TCodecKind expected_codec = gen_id == 4UL ? TCodecKind::Snappy : TCodecKind::None;
+      const TCodecKind actual_codec = gen_id == 4UL ? TCodecKind::None : TCodecKind::Snappy;
+      EXPECT_TRUE(expected_reader.GetArenaCodec() == expected_codec);
+      EXPECT_TRUE(expected_idx_file.GetArenaCodec() == expected_codec);
+      EXPECT_TRUE(actual_reader.GetArenaCodec() == actual_codec);
+      EXPECT_TRUE(actual_idx_file.GetArenaCodec() == actual_codec);
+      EXPECT_EQ(actual_reader.GetNumBytesOfArena(), expected_reader.GetNumBytesOfArena());
+      EXPECT_EQ(actual_idx_file.GetNumCurKeys(), expected_idx_file.GetNumCurKeys());
+      EXPECT_EQ(actual_idx_file.GetNumHistKeys(), expected_idx_file.GetNumHistKeys());
+      size_t seen = 0UL;
+      TReader::TIndexFile::TKeyCursor actual_csr(&actual_idx_file);
+      for (TReader::TIndexFile::TKeyCursor expected_csr(&expected_idx_file); expected_csr && actual_csr; ++expected_csr, ++actual_csr, ++seen) {
+        EXPECT_EQ(TKey((*actual_csr).Key, &actual_idx_arena), TKey((*expected_csr).Key, &expected_idx_arena));
+        EXPECT_EQ(TKey((*actual_csr).Value, &actual_main_arena), TKey((*expected_csr).Value, &expected_main_arena));
+      }
+      EXPECT_EQ(seen, expected_idx_file.GetNumCurKeys());
+      seen = 0UL;
+      TReader::TIndexFile::THistoryKeyCursor actual_hist_csr(&actual_idx_file);
+      for (TReader::TIndexFile::THistoryKeyCursor expected_hist_csr(&expected_idx_file); expected_hist_csr && actual_hist_csr; ++expected_hist_csr, ++actual_hist_csr, ++seen) {
+        EXPECT_EQ(TKey((*actual_hist_csr).Key, &actual_idx_arena), TKey((*expected_hist_csr).Key, &expected_idx_arena));
+        EXPECT_EQ(TKey((*actual_hist_csr).Value, &actual_main_arena), TKey((*expected_hist_csr).Value, &expected_main_arena));
+      }
+      EXPECT_EQ(seen, expected_idx_file.GetNumHistKeys());
+    }
+    GracefullShutdown();
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
@@ -284,3 +284,79 @@ FIXTURE(StressSingleIndex) {
     cond.notify_one();
   });
 }
+
+FIXTURE(Codecs) {
+  TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &) {
+    const int64_t num_iter = 400000L;
+    const int64_t num_merge_files = 4L;
+    void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+    TScheduler scheduler(TScheduler::TPolicy(4, 10, milliseconds(10)));
+
+    Sim::TMemEngine mem_engine(&scheduler,
+                               1024 /* disk space: 1GB */,
+                               512 /* slow disk space: 512MB */,
+                               65536 /* page cache slots: 256MB */,
+                               1 /* num page lru */,
+                               2048 /* block cache slots: 128MB */,
+                               1 /* num block lru */);
+    TUuid int_idx(TUuid::Twister);
+    /* values that look like real records: mostly the same text with a little that varies */
+    auto make_val = [](int64_t i) {
+      return "{ \"name\": \"customer " + to_string(i % 1000L) + "\", \"status\": \"" + (i % 3L ? "active" : "dormant") + "\", \"notes\": \"none\" }";
+    };
+    for (TCodecKind kind : { TCodecKind::None, TCodecKind::Snappy, TCodecKind::Lz4, TCodecKind::Zstd }) {
+      const TCodec *codec = TCodec::Get(kind);
+      mem_engine.GetEngine()->SetDataFileCodec(codec);
+      Base::TUuid file_id(TUuid::Best);
+      TSequenceNumber seq_num = 0U;
+      vector<size_t> data_gen_vec;
+      for (int64_t i = 0; i < num_merge_files; ++i) {
+        TSuprena arena;
+        TMockMem mem_layer;
+        for (int64_t j = i; j < num_iter; j += num_merge_files) {
+          Insert(mem_layer, ++seq_num, int_idx, TKey(make_val(j), &arena, state_alloc), j);
+        }
+        TDataFile data_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, &mem_layer, file_id, i + 1, 20UL, 0U, Medium);
+        data_gen_vec.push_back(i + 1);
+      }
+      const size_t merge_gen_id = num_merge_files + 1;
+      Base::TTimer merge_timer;
+      merge_timer.Start();
+      TMergeDataFile merge_file(mem_engine.GetEngine(), TVolume::TDesc::Fast, file_id, data_gen_vec, file_id, merge_gen_id, 0U, Low, 16384, 20UL, false, false);
+      merge_timer.Stop();
+      TReader reader(HERE, mem_engine.GetEngine(), file_id, merge_gen_id);
+      TReader::TArena main_arena(&reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TReader::TIndexFile idx_file(&reader, int_idx, RealTime);
+      TReader::TArena idx_arena(&idx_file, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), RealTime);
+      TStream<Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::LogicalBlockSize, Orly::Indy::Disk::Util::PhysicalBlockSize, Orly::Indy::Disk::Util::PageCheckedBlock, 0UL> in_stream(HERE, Source::PresentWalk, RealTime, &reader, mem_engine.GetEngine()->GetCache<TReader::PhysicalCachePageSize>(), 0);
+      /* look up keys in a scattered order and read their values */
+      size_t matched = 0UL;
+      Base::TTimer read_timer;
+      read_timer.Start();
+      for (int64_t i = 0; i < num_iter; ++i) {
+        TSuprena arena;
+        const int64_t val = (i * 7919L) % num_iter;
+        size_t out_offset;
+        if (idx_file.FindInHash(TKey(make_tuple(val), &arena, state_alloc), out_offset, in_stream, &idx_arena)) {
+          in_stream.GoTo(out_offset);
+          TReader::TIndexFile::TKeyItem item;
+          in_stream.Read(&item, sizeof(item));
+          matched += TKey(item.Value, &main_arena) == TKey(make_val(val), &arena, state_alloc) ? 1UL : 0UL;
+        }
+      }
+      read_timer.Stop();
+      EXPECT_EQ(matched, static_cast<size_t>(num_iter));
+      cout << endl << codec->GetName() << endl
+           << "\tdisk bytes [" << reader.GetFileLength() << "]\tmain arena [" << reader.GetNumBytesOfArena() << "] raw, ["
+           << reader.GetNumDiskBytesOfArena() << "] on disk" << endl
+           << "\tmerge [" << duration_cast<milliseconds>(merge_timer.GetTotal()).count() << "ms]\t["
+           << (num_iter * 1000L / max(duration_cast<milliseconds>(merge_timer.GetTotal()).count(), 1L)) << " keys / s]" << endl
+           << "\tread [" << duration_cast<milliseconds>(read_timer.GetTotal()).count() << "ms]\t["
+           << (duration_cast<nanoseconds>(read_timer.GetTotal()).count() / num_iter) << "ns / key]" << endl;
+    }
+    GracefullShutdown();
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
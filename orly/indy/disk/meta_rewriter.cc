@@ -73,7 +73,18 @@ std::pair<size_t, size_t> TMetaRewriter::RewriteMetaData(Disk::Util::TEngine *en
   size_t num_arena_type_boundaries;
   size_t main_arena_byte_offset;
   size_t byte_offset_of_update_entries;
-  in_stream.Read(block_vec_size);  // # of blocks
+  size_t arena_codec = 0UL;
+  size_t main_arena_chunk_table_offset = 0UL;
+  size_t num_main_arena_chunks = 0UL;
+  /* the index meta data is copied as it is, so the file keeps its meta version */
+  size_t first_word;
+  in_stream.Read(first_word);  // meta version, or # of blocks if the file predates versioning
+  const size_t meta_version = TData::GetMetaVersion(first_word);
+  if (meta_version == TData::BaselineMetaVersion) {
+    block_vec_size = first_word;
+  } else {
+    in_stream.Read(block_vec_size);  // # of blocks
+  }
   in_stream.Read(old_num_meta_blocks);  // # of meta-blocks
   in_stream.Read(old_num_sequential_block_pairings);  // # of #block / block_id pairings
   in_stream.Read(num_updates);  // # of updates
@@ -83,6 +94,11 @@ std::pair<size_t, size_t> TMetaRewriter::RewriteMetaData(Disk::Util::TEngine *en
   in_stream.Read(num_arena_type_boundaries);  // # of arena type boundaries
   in_stream.Read(main_arena_byte_offset);  // byte offset of main arena
   in_stream.Read(byte_offset_of_update_entries);  // offset of update index
+  if (meta_version >= TData::ArenaCodecMetaVersion) {
+    in_stream.Read(arena_codec);  // arena codec
+    in_stream.Read(main_arena_chunk_table_offset);  // offset of main arena chunk table
+    in_stream.Read(num_main_arena_chunks);  // # of main arena chunks
+  }
   std::vector<size_t> main_arena_type_boundary_offset_vec;
   const size_t to_skip = (old_num_meta_blocks * sizeof(size_t)) + (old_num_sequential_block_pairings * 2UL * sizeof(size_t));
   in_stream.Skip(to_skip); /* meta blocks + sequential block pairings */
@@ -94,7 +110,7 @@ std::pair<size_t, size_t> TMetaRewriter::RewriteMetaData(Disk::Util::TEngine *en
   block_vec_copy.Trim(old_num_meta_blocks);
   const size_t num_sequential_block_pairings = block_vec_copy.Size();
 
-  size_t bytes_required_for_meta_data = TData::NumMetaFields * sizeof(size_t);  // meta fields
+  size_t bytes_required_for_meta_data = TData::GetNumMetaFields(meta_version) * sizeof(size_t);  // meta fields
   bytes_required_for_meta_data += num_sequential_block_pairings * sizeof(size_t) * 2UL;  // num_sequential_block_pairings
   bytes_required_for_meta_data += index_map_size * (sizeof(Base::TUuid) + sizeof(size_t));  // offsets to index segment(s)
   bytes_required_for_meta_data += num_arena_type_boundaries * sizeof(size_t);  // offsets to type boundaries in arena
@@ -125,6 +141,9 @@ std::pair<size_t, size_t> TMetaRewriter::RewriteMetaData(Disk::Util::TEngine *en
                        ,written_block_set
                        #endif
                        );
+    if (meta_version != TData::BaselineMetaVersion) {
+      out << first_word;  // meta version
+    }
     out << block_vec_size - old_num_meta_blocks + num_meta_blocks;  // # of blocks
     out << num_meta_blocks;  // # of meta-blocks
     out << num_sequential_block_pairings;  // # of #block / block_id pairings
@@ -135,6 +154,11 @@ std::pair<size_t, size_t> TMetaRewriter::RewriteMetaData(Disk::Util::TEngine *en
     out << num_arena_type_boundaries;  // # of arena type boundaries
     out << main_arena_byte_offset;  // byte offset of main arena
     out << byte_offset_of_update_entries;  // offset of update index
+    if (meta_version >= TData::ArenaCodecMetaVersion) {
+      out << arena_codec;  // arena codec
+      out << main_arena_chunk_table_offset;  // offset of main arena chunk table
+      out << num_main_arena_chunks;  // # of main arena chunks
+    }
     /* write out the meta-block ids */
     for (auto meta_block_id : meta_block_vec) {
       out << meta_block_id;
@@ -21,16 +21,20 @@
 #include <cassert>
 
 #include <algorithm>
+#include <limits>
 #include <ostream>
 
 #include <base/class_traits.h>
 #include <inv_con/unordered_multimap.h>
 #include <server/daemonize.h>
 #include <orly/atom/kit2.h>
+#include <orly/indy/disk/arena_chunk.h>
 #include <orly/indy/disk/in_file.h>
 #include <orly/indy/disk/indy_util_reporter.h>
+#include <orly/indy/disk/util/bloom_filter.h>
 #include <orly/indy/disk/util/cache.h>
 #include <orly/indy/disk/util/engine.h>
+#include <orly/indy/disk/util/hash_util.h>
 #include <orly/indy/update.h>
 #include <orly/sabot/match_prefix_state.h>
 
@@ -119,14 +123,73 @@ namespace Orly {
         /* TODO */
         virtual Atom::TCore::TOffset GetNumBytesOfArena() const = 0;
 
+        /* The codec the arena was compressed with.  If none, the arena is stored raw and has no chunks. */
+        inline Util::TCodecKind GetArenaCodec() const {
+          assert(this);
+          return ArenaCodec;
+        }
+
+        /* The arena's chunks.  See <orly/indy/disk/arena_chunk.h>.  Empty if the arena is stored raw. */
+        inline const TArenaChunkVec &GetArenaChunkVec() const {
+          assert(this);
+          return ArenaChunkVec;
+        }
+
+        /* The key of the arena's chunks in the chunk cache.  See TArenaChunkCache::NewArenaId(). */
+        inline size_t GetArenaId() const {
+          assert(this);
+          return ArenaId;
+        }
+
+        /* The number of bytes the arena takes on disk, not counting its chunk table. */
+        inline size_t GetNumDiskBytesOfArena() const {
+          assert(this);
+          return ArenaChunkVec.empty() ? GetNumBytesOfArena() : ArenaChunkVec.back().second;
+        }
+
         protected:
 
         /* TODO */
-        TArenaInFile() {}
+        TArenaInFile()
+            : ArenaId(TArenaChunkCache::NewArenaId()),
+              ArenaCodec(Util::TCodecKind::None) {}
 
         /* TODO */
         virtual ~TArenaInFile() {}
 
+        /* Called by the final class once it knows how its arena was written.  Throws if we don't know the codec. */
+        void SetArenaChunks(Util::TCodecKind codec, TArenaChunkVec &&chunk_vec) {
+          assert(this);
+          Util::TCodec::Get(codec);
+          assert((codec == Util::TCodecKind::None) == chunk_vec.empty());
+          ArenaCodec = codec;
+          ArenaChunkVec = std::move(chunk_vec);
+        }
+
+        /* Read a chunk table of the given number of chunks (so one more entry than that) from the stream.  An empty
+           arena has no table at all (its offset is 0), which we treat as a table holding only the closing entry. */
+        template <typename TInStream>
+        static TArenaChunkVec ReadArenaChunkVec(TInStream &in_stream, size_t chunk_table_offset, size_t num_chunks) {
+          TArenaChunkVec chunk_vec(num_chunks + 1UL);
+          if (!chunk_table_offset) {
+            assert(!num_chunks);
+            return chunk_vec;
+          }
+          in_stream.GoTo(chunk_table_offset);
+          for (auto &chunk : chunk_vec) {
+            in_stream.Read(chunk.first);
+            in_stream.Read(chunk.second);
+          }
+          return chunk_vec;
+        }
+
+        private:
+
+        /* See accessors. */
+        const size_t ArenaId;
+        Util::TCodecKind ArenaCodec;
+        TArenaChunkVec ArenaChunkVec;
+
       };
 
       /* TODO */
@@ -264,14 +327,19 @@ namespace Orly {
               Priority(priority),
               Cache(cache),
               StartOffset(file->GetByteOffsetOfArena()),
-              Stream(HERE, Source::DiskArena, priority, StartOffset + file->GetNumBytesOfArena(), file, cache, StartOffset),
-              NumNotes(file->GetNumArenaNotes()) {
+              Stream(HERE, Source::DiskArena, priority, StartOffset + file->GetNumDiskBytesOfArena(), file, cache, StartOffset),
+              NumNotes(file->GetNumArenaNotes()),
+              CurChunkNumber(0UL),
+              CurChunk(nullptr) {
           assert(file);
         }
 
         /* TODO */
         virtual ~TDiskArena() {
           assert(this);
+          if (CurChunk) {
+            CurChunk->Unpin();
+          }
         }
 
         /* TODO */
@@ -291,6 +359,23 @@ namespace Orly {
 
         private:
 
+        /* Acquire a note from a compressed arena.  If the note lies within one chunk, we point straight into the
+           decompressed chunk and pin the chunk for the note, passing it in data2; otherwise the note is copied out of
+           its chunks into a buffer of its own and data2 is null.  ReleaseNote() undoes either one.  If the note
+           size is 0, we read it from the note itself. */
+        const Atom::TCore::TNote *AcquireCompressedNote(Atom::TCore::TOffset offset, size_t note_size, void *&data2);
+
+        /* The number of the chunk holding the given offset of the raw arena. */
+        size_t FindChunk(Atom::TCore::TOffset offset) const;
+
+        /* Copy the given range of the raw arena out of the chunks holding it. */
+        void ReadCompressed(Atom::TCore::TOffset offset, void *out, size_t len);
+
+        /* The given chunk, decompressed, from the chunk cache if it's there.  We keep the last chunk we got pinned, so
+           a run of notes in the same chunk only goes to the cache once.  The chunk is good until the next call; pin it
+           to keep it longer. */
+        const TArenaChunkCache::TChunk *GetChunk(size_t chunk);
+
         /* TODO */
         TArenaInFile *File;
 
@@ -312,6 +397,11 @@ namespace Orly {
         /* TODO */
         size_t NumNotes;
 
+        /* The last chunk GetChunk() got, which we hold a pin on, and its number.  CurChunk is null until the first
+           call. */
+        size_t CurChunkNumber;
+        const TArenaChunkCache::TChunk *CurChunk;
+
       };  // TDiskArena
 
       /* TODO */
@@ -413,6 +503,7 @@ namespace Orly {
           assert(StartingBlockOffset * BlockSize < FileLength);
           TStream<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, MaxMetaCacheSize> in_stream(CodeLocation, UtilSrc, Priority, this, Cache, StartingBlockOffset * BlockSize);
           /*
+            meta version (v1 on)
             # of blocks
             # of meta-blocks (n)
             # of #block / block_id pairings (number of sequential blocks starting at) (m)
@@ -423,8 +514,18 @@ namespace Orly {
             # of arena type boundaries
             offset of main arena
             offset of update index
+            arena codec (v4 on)
+            offset of main arena chunk table (v4 on)
+            # of main arena chunks (v4 on)
           */
-          in_stream.Read(NumBlocks);
+          size_t first_word;
+          in_stream.Read(first_word);
+          MetaVersion = TData::GetMetaVersion(first_word);
+          if (MetaVersion == TData::BaselineMetaVersion) {
+            NumBlocks = first_word;
+          } else {
+            in_stream.Read(NumBlocks);
+          }
           in_stream.Read(NumMetaBlocks);
           in_stream.Read(NumSequentialBlockPairings);
           in_stream.Read(NumUpdates);
@@ -434,6 +535,12 @@ namespace Orly {
           in_stream.Read(NumMainArenaTypeBoundaries);
           in_stream.Read(ByteOffsetOfMainArena);
           in_stream.Read(ByteOffsetOfUpdateIndex);
+          size_t arena_codec = static_cast<size_t>(Util::TCodecKind::None), main_arena_chunk_table_offset = 0UL, num_main_arena_chunks = 0UL;
+          if (MetaVersion >= TData::ArenaCodecMetaVersion) {
+            in_stream.Read(arena_codec);
+            in_stream.Read(main_arena_chunk_table_offset);
+            in_stream.Read(num_main_arena_chunks);
+          }
 
           /* meta block ids */
           size_t at_offset_block = NumBlocks - NumMetaBlocks;
@@ -452,6 +559,13 @@ namespace Orly {
             OffsetBlockByBlockId.insert(std::make_pair(at_offset_block, block_id));
             at_offset_block += num_blocks;
           }
+          /* now that we can find our blocks, read the chunk table.  The index files pick up the codec from us, so
+             settle it before we get to them. */
+          if (static_cast<Util::TCodecKind>(arena_codec) != Util::TCodecKind::None) {
+            const size_t meta_offset = in_stream.GetOffset();
+            SetArenaChunks(static_cast<Util::TCodecKind>(arena_codec), ReadArenaChunkVec(in_stream, main_arena_chunk_table_offset, num_main_arena_chunks));
+            in_stream.GoTo(meta_offset);
+          }
           /* index segment offsets */
           Base::TUuid index_id;
           size_t offset;
@@ -475,6 +589,18 @@ namespace Orly {
         /* TODO */
         virtual ~TReadFile() {}
 
+        /* The layout of our meta data; see TData. */
+        inline size_t GetMetaVersion() const {
+          assert(this);
+          return MetaVersion;
+        }
+
+        /* The number of meta fields which come before our meta block ids. */
+        inline size_t GetNumMetaFields() const {
+          assert(this);
+          return TData::GetNumMetaFields(MetaVersion);
+        }
+
         /* TODO */
         inline size_t GetNumBlocks() const {
           assert(this);
@@ -601,10 +727,10 @@ namespace Orly {
             NO_COPY(TKeyCursor);
             public:
 
-            /* TODO */
-            TKeyCursor(TIndexFile *idx_file, size_t start_num = 0UL)
+            /* Walks the current keys numbered [start_num, end_num), or to the last one if there are fewer. */
+            TKeyCursor(TIndexFile *idx_file, size_t start_num = 0UL, size_t end_num = std::numeric_limits<size_t>::max())
                 : Cur(start_num),
-                  Limit(idx_file->NumCurKeys),
+                  Limit(std::min(end_num, idx_file->NumCurKeys)),
                   InStream(idx_file->File->CodeLocation, idx_file->File->UtilSrc, idx_file->File->Priority, idx_file, idx_file->File->Cache, idx_file->ByteOffsetOfKeyIndex + (Cur * TData::KeyEntrySize)) {
               if (Cur < Limit) {
                 InStream.Read(&Item, sizeof(Item));
@@ -658,10 +784,10 @@ namespace Orly {
             NO_COPY(THistoryKeyCursor);
             public:
 
-            /* TODO */
-            THistoryKeyCursor(TIndexFile *idx_file, size_t start_num = 0UL)
+            /* Walks the history keys numbered [start_num, end_num), or to the last one if there are fewer. */
+            THistoryKeyCursor(TIndexFile *idx_file, size_t start_num = 0UL, size_t end_num = std::numeric_limits<size_t>::max())
                 : Cur(start_num),
-                  Limit(idx_file->NumHistKeys),
+                  Limit(std::min(end_num, idx_file->NumHistKeys)),
                   InStream(idx_file->File->CodeLocation,
                            idx_file->File->UtilSrc,
                            idx_file->File->Priority,
@@ -731,23 +857,73 @@ namespace Orly {
             in_stream.Read(NumHistKeys);
             in_stream.Read(ByteOffsetOfKeyIndex);
             in_stream.Read(NumHashTables);
+            /* a file which predates a field has it turned off */
+            const size_t meta_version = File->GetMetaVersion();
+            size_t byte_offset_of_bloom_filter = 0UL, num_bloom_filter_bits = 0UL, num_bloom_filter_probes = 0UL;
+            if (meta_version >= TData::BloomFilterMetaVersion) {
+              in_stream.Read(byte_offset_of_bloom_filter);
+              in_stream.Read(num_bloom_filter_bits);
+              in_stream.Read(num_bloom_filter_probes);
+            }
+            HashIndexVersion = Util::LinearProbeHashIndex;
+            if (meta_version >= TData::BucketedHashMetaVersion) {
+              in_stream.Read(HashIndexVersion);
+            }
+            size_t byte_offset_of_key_fences = 0UL, num_key_fences = 0UL;
+            if (meta_version >= TData::KeyFenceMetaVersion) {
+              in_stream.Read(byte_offset_of_key_fences);
+              in_stream.Read(num_key_fences);
+            }
+            size_t arena_chunk_table_offset = 0UL, num_arena_chunks = 0UL;
+            if (meta_version >= TData::ArenaCodecMetaVersion) {
+              in_stream.Read(arena_chunk_table_offset);
+              in_stream.Read(num_arena_chunks);
+            }
             assert(NumArenaBytes > 0UL);
+            if (HashIndexVersion != Util::LinearProbeHashIndex && HashIndexVersion != Util::BucketedHashIndex) {
+              syslog(LOG_ERR, "TReadFile::TIndexFile() unknown hash index version [%ld]", HashIndexVersion);
+              throw std::runtime_error("TReadFile::TIndexFile() unknown hash index version");
+            }
 
-            size_t offset, num_hash_fields;
+            size_t offset, num_hash_fields, entry_offset = 0UL;
             for (size_t i = 0; i < NumHashTables; ++i) {
               in_stream.Read(offset);
               in_stream.Read(num_hash_fields);
+              if (meta_version >= TData::BucketedHashMetaVersion) {
+                in_stream.Read(entry_offset);
+              }
               //std::cout << "Hash table @ [" << offset << "] has [" << num_hash_fields <<"] entries" << std::endl;
               NumHashFieldsByOffset.emplace_back(offset, num_hash_fields);
+              ByteOffsetOfHashEntriesVec.emplace_back(entry_offset);
             }
             for (size_t i = 0; i < NumArenaTypeBoundaries; ++i) {
               in_stream.Read(offset);
               ArenaTypeBoundaryByOffset.emplace_back(offset);
             }
+            if (num_bloom_filter_bits) {
+              BloomFilter.Reset(num_bloom_filter_bits, num_bloom_filter_probes);
+              in_stream.GoTo(byte_offset_of_bloom_filter);
+              in_stream.Read(BloomFilter.GetData(), BloomFilter.GetNumBytes());
+            }
+            if (num_key_fences) {
+              KeyFenceVec.reserve(num_key_fences);
+              in_stream.GoTo(byte_offset_of_key_fences);
+              size_t key_num;
+              Atom::TCore key_core;
+              for (size_t i = 0; i < num_key_fences; ++i) {
+                in_stream.Read(key_num);
+                in_stream.Read(&key_core, sizeof(Atom::TCore));
+                KeyFenceVec.emplace_back(key_num, key_core);
+              }
+            }
+            if (File->GetArenaCodec() != Util::TCodecKind::None) {
+              this->SetArenaChunks(File->GetArenaCodec(), this->ReadArenaChunkVec(in_stream, arena_chunk_table_offset, num_arena_chunks));
+            }
           }
 
-          /* TODO */
-          bool FindInHash(const TKey &key, size_t &out_offset, TInStream &in_stream, TArena *file_arena) const {
+          /* Look up the key (or key prefix) in the hash index.  If 'num_probes' is given, it is incremented once for each
+             hash slot, bucket or entry we had to read. */
+          bool FindInHash(const TKey &key, size_t &out_offset, TInStream &in_stream, TArena *file_arena, size_t *num_probes = nullptr) const {
             assert(this);
             assert(key.GetCore().IsTuple());
             const Atom::TCore &core = key.GetCore();
@@ -764,18 +940,56 @@ namespace Orly {
               const size_t byte_offset_of_hash_table = idx.first;
               const size_t num_hash_fields = idx.second;
               const size_t hash_to_look_for = key.GetHash();
-              const size_t modded_hash = hash_to_look_for % num_hash_fields;
-
+              /* the bloom filter lets us skip the hash table entirely on most misses */
+              if (!BloomFilter.MayContain(hash_to_look_for)) {
+                return false;
+              }
               void *key_state_alloc = alloca(Sabot::State::GetMaxStateSize() * 2);
               void *other_state_alloc = reinterpret_cast<uint8_t *>(key_state_alloc) + Sabot::State::GetMaxStateSize();
               Sabot::State::TAny::TWrapper key_state(core.NewState(arena, key_state_alloc));
-
-              in_stream.GoTo(byte_offset_of_hash_table + (modded_hash * TData::HashEntrySize));
               Atom::TCore cur_core;
+              if (HashIndexVersion == Util::BucketedHashIndex) {
+                /* read the home bucket and compare fingerprints; we only read an entry when its fingerprint matches */
+                const size_t byte_offset_of_entries = ByteOffsetOfHashEntriesVec[num_defined - 1];
+                const uint32_t fingerprint = Util::GetHashFingerprint(hash_to_look_for);
+                Util::THashBucket bucket;
+                for (size_t bucket_pos = Util::GetHomeBucket(hash_to_look_for, num_hash_fields); ; ++bucket_pos) {
+                  assert(byte_offset_of_hash_table + ((bucket_pos + 1UL) * sizeof(Util::THashBucket)) <= byte_offset_of_entries);
+                  in_stream.GoTo(byte_offset_of_hash_table + (bucket_pos * sizeof(Util::THashBucket)));
+                  in_stream.Read(&bucket, sizeof(Util::THashBucket));
+                  if (num_probes) {
+                    ++*num_probes;
+                  }
+                  for (size_t slot = 0; slot < Util::THashBucket::NumSlots; ++slot) {
+                    if (!bucket.Fingerprints[slot]) {
+                      return false;
+                    }
+                    if (bucket.Fingerprints[slot] == fingerprint) {
+                      in_stream.GoTo(byte_offset_of_entries + (bucket.Entries[slot] * TData::HashEntrySize));
+                      in_stream.Read(&cur_core, sizeof(Atom::TCore));
+                      in_stream.Read(out_offset);
+                      if (num_probes) {
+                        ++*num_probes;
+                      }
+                      assert(cur_core.IsTuple());
+                      if (cur_core.ForceGetStoredHash() == hash_to_look_for &&
+                          IsPrefixMatch(MatchPrefixState(*key_state, *Sabot::State::TAny::TWrapper(cur_core.NewState(file_arena, other_state_alloc))))) {
+                        return true;
+                      }
+                    }
+                  }
+                  /* the home bucket overflowed, so keep going */
+                }
+              }
+              const size_t modded_hash = hash_to_look_for % num_hash_fields;
+              in_stream.GoTo(byte_offset_of_hash_table + (modded_hash * TData::HashEntrySize));
               size_t cur_hash = 0;
               for (size_t i = modded_hash; i < num_hash_fields; ++i) {
                 in_stream.Read(&cur_core, sizeof(Atom::TCore));
                 in_stream.Read(out_offset);
+                if (num_probes) {
+                  ++*num_probes;
+                }
                 if (memcmp(&cur_core, &TData::NullCore, sizeof(Atom::TCore)) != 0) {
                   assert(cur_core.IsTuple());
                   cur_hash = cur_core.ForceGetStoredHash();
@@ -795,6 +1009,9 @@ namespace Orly {
               for (size_t i = 0; i < modded_hash; ++i) {
                 in_stream.Read(&cur_core, sizeof(Atom::TCore));
                 in_stream.Read(out_offset);
+                if (num_probes) {
+                  ++*num_probes;
+                }
                 if (memcmp(&cur_core, &TData::NullCore, sizeof(Atom::TCore)) != 0) {
                   cur_hash = cur_core.ForceGetStoredHash();
                   if (cur_hash == hash_to_look_for) {
@@ -827,8 +1044,10 @@ namespace Orly {
             }
           }
 
-          /* TODO */
-          bool BinaryLowerBoundOnKey(const TKey &key, size_t &out_offset, TInStream &in_stream, TArena *file_arena) const {
+          /* Find the first current key not less than the given key.  If we have key fences (and 'use_fences' is set), we
+             first narrow the search down to a single block using the in-memory fences, so the binary search on disk only
+             touches that block. */
+          bool BinaryLowerBoundOnKey(const TKey &key, size_t &out_offset, TInStream &in_stream, TArena *file_arena, bool use_fences = true) const {
             assert(this);
             assert(&key);
             assert(&out_offset);
@@ -837,6 +1056,17 @@ namespace Orly {
             size_t it = 0;
             size_t step;
             int64_t count = NumCurKeys;
+            if (use_fences && !KeyFenceVec.empty()) {
+              /* find the first fence not less than the key; our answer is between the fence before it and it */
+              auto fence = std::lower_bound(KeyFenceVec.begin(), KeyFenceVec.end(), key,
+                  [file_arena](const std::pair<size_t, Atom::TCore> &lhs, const TKey &rhs) {
+                    return TKey(lhs.second, file_arena) < rhs;
+                  });
+              if (fence != KeyFenceVec.begin()) {
+                first = (fence - 1)->first;
+              }
+              count = (fence != KeyFenceVec.end() ? fence->first + 1UL : NumCurKeys) - first;
+            }
             Atom::TCore core;
             while (count > 0) {
               it = first;
@@ -919,6 +1149,32 @@ namespace Orly {
             return NumHashFieldsByOffset;
           }
 
+          /* The format of this index's hash tables. */
+          inline size_t GetHashIndexVersion() const {
+            assert(this);
+            return HashIndexVersion;
+          }
+
+          /* The number of key fences we keep in memory. */
+          inline size_t GetNumKeyFences() const {
+            assert(this);
+            return KeyFenceVec.size();
+          }
+
+          /* The core of the first key to start in the nth block of the key index.  It lives in this index's arena. */
+          inline const Atom::TCore &GetKeyFence(size_t n) const {
+            assert(this);
+            assert(n < KeyFenceVec.size());
+            return KeyFenceVec[n].second;
+          }
+
+          /* The bloom filter over the keys (and key prefixes) in this index.  Disabled if the file was written without
+             one. */
+          inline const Util::TBloomFilter &GetBloomFilter() const {
+            assert(this);
+            return BloomFilter;
+          }
+
           private:
 
           /* TODO */
@@ -983,6 +1239,18 @@ namespace Orly {
           /* TODO */
           std::vector<size_t> ArenaTypeBoundaryByOffset;
 
+          /* For each bucketed hash table, where its (core, offset) entries start. */
+          std::vector<size_t> ByteOffsetOfHashEntriesVec;
+
+          /* See accessor. */
+          size_t HashIndexVersion;
+
+          /* See accessor. */
+          Util::TBloomFilter BloomFilter;
+
+          /* The position and core of the first key entry to start in each block of the key index, in key order. */
+          std::vector<std::pair<size_t, Atom::TCore>> KeyFenceVec;
+
         };  // TIndexFile
 
         /* TODO */
@@ -1006,6 +1274,9 @@ namespace Orly {
         /* TODO */
         size_t FileLength;
 
+        /* See GetMetaVersion(). */
+        size_t MetaVersion;
+
         /* TODO */
         size_t NumBlocks;
         size_t NumMetaBlocks;
@@ -1156,13 +1427,16 @@ namespace Orly {
       /*** Inline ***/
 
       template <size_t CachePageSize, size_t BlockSize, size_t PhysicalBlockSize, Util::TBufKind BufKind, size_t LocalCacheSize, bool ScanAheadAllowed>
-      inline void TDiskArena<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, LocalCacheSize, ScanAheadAllowed>::ReleaseNote(const Atom::TCore::TNote *note, Atom::TCore::TOffset offset, void *data1, void */*data2*/, void *data3) {
+      inline void TDiskArena<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, LocalCacheSize, ScanAheadAllowed>::ReleaseNote(const Atom::TCore::TNote *note, Atom::TCore::TOffset offset, void *data1, void *data2, void *data3) {
         assert(this);
         if (data1) { /* This data fit in the block, release the block. */
-          Cache->Release(reinterpret_cast<typename Util::TCache<PhysicalCachePageSize>::TSlot *>(data1), reinterpret_cast<size_t>(data3));
+          Cache->Release(reinterpret_cast<typename Util::TCache<PhysicalCachePageSize>::TSlot *>(data1), reinterpret_cast<size_t>(data3), Priority);
           //File->GetService()->ReleaseBuf(reinterpret_cast<TPageCache::TObj *>(data));
-        } else { /* the data did not fit in the block, free the buffer we allocated. */
-          assert(offset / DataChunkSize != (offset + note->GetRawSize() + sizeof(Atom::TCore::TNote)) / DataChunkSize);
+        } else if (data2) { /* This data fit in a decompressed chunk, unpin the chunk. */
+          assert(File->GetArenaCodec() != Util::TCodecKind::None);
+          reinterpret_cast<const TArenaChunkCache::TChunk *>(data2)->Unpin();
+        } else { /* the data did not fit in the block (or came from a compressed chunk), free the buffer we allocated. */
+          assert(File->GetArenaCodec() != Util::TCodecKind::None || offset / DataChunkSize != (offset + note->GetRawSize() + sizeof(Atom::TCore::TNote)) / DataChunkSize);
           free(const_cast<Atom::TCore::TNote *>(note));
         }
       }
@@ -1170,6 +1444,10 @@ namespace Orly {
       template <size_t CachePageSize, size_t BlockSize, size_t PhysicalBlockSize, Util::TBufKind BufKind, size_t LocalCacheSize, bool ScanAheadAllowed>
       inline const Atom::TCore::TNote *TDiskArena<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, LocalCacheSize, ScanAheadAllowed>::TryAcquireNote(Atom::TCore::TOffset offset, void *&data1, void *&data2, void *&data3) {
         assert(this);
+        if (File->GetArenaCodec() != Util::TCodecKind::None) {
+          data1 = nullptr;
+          return AcquireCompressedNote(offset, 0UL, data2);
+        }
         const size_t note_offset = StartOffset + offset;
         assert(note_offset < File->GetFileLength());
         Stream.GoTo(note_offset);
@@ -1188,7 +1466,7 @@ namespace Orly {
         if (note_offset / DataChunkSize == (note_offset + note_size) / DataChunkSize) {
           try {
             typename Util::TCache<PhysicalCachePageSize>::TSlot *data_slot;
-            typename Util::TCache<PhysicalCachePageSize>::TSlot *const main_slot = Cache->Get(loaded_page_id, data_slot);
+            typename Util::TCache<PhysicalCachePageSize>::TSlot *const main_slot = Cache->Get(loaded_page_id, data_slot, Priority);
             data1 = main_slot;
             data2 = data_slot;
             data3 = reinterpret_cast<void *>(loaded_page_id);
@@ -1207,6 +1485,7 @@ namespace Orly {
           return ret;
         } else {
           data1 = nullptr;
+          data2 = nullptr;
           Atom::TCore::TNote *note_ptr = nullptr;
           if ((note_ptr = reinterpret_cast<Atom::TCore::TNote *>(malloc(note_size))) == 0) {
             syslog(LOG_EMERG, "bad alloc in TDiskArena::TryAcquireNote [%ld]", note_size);
@@ -1229,6 +1508,10 @@ namespace Orly {
       template <size_t CachePageSize, size_t BlockSize, size_t PhysicalBlockSize, Util::TBufKind BufKind, size_t LocalCacheSize, bool ScanAheadAllowed>
       inline const Atom::TCore::TNote *TDiskArena<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, LocalCacheSize, ScanAheadAllowed>::TryAcquireNote(Atom::TCore::TOffset offset, const size_t note_size, void *&data1, void *&data2, void *&data3) {
         assert(this);
+        if (File->GetArenaCodec() != Util::TCodecKind::None) {
+          data1 = nullptr;
+          return AcquireCompressedNote(offset, note_size, data2);
+        }
         const size_t note_offset = StartOffset + offset;
         Stream.GoTo(note_offset);
         #ifndef NDEBUG
@@ -1248,7 +1531,7 @@ namespace Orly {
           try {
             const size_t loaded_page_id = Stream.GetLoadedPageId();
             typename Util::TCache<PhysicalCachePageSize>::TSlot *data_slot;
-            typename Util::TCache<PhysicalCachePageSize>::TSlot *const main_slot = Cache->Get(loaded_page_id, data_slot);
+            typename Util::TCache<PhysicalCachePageSize>::TSlot *const main_slot = Cache->Get(loaded_page_id, data_slot, Priority);
             data1 = main_slot;
             data2 = data_slot;
             data3 = reinterpret_cast<void *>(loaded_page_id);
@@ -1264,6 +1547,7 @@ namespace Orly {
           return ret;
         } else {
           data1 = nullptr;
+          data2 = nullptr;
           Atom::TCore::TNote *note_ptr = nullptr;
           if ((note_ptr = reinterpret_cast<Atom::TCore::TNote *>(malloc(note_size))) == 0) {
             syslog(LOG_EMERG, "bad alloc in TDiskArena::TryAcquireNote [%ld]", note_size);
@@ -1283,6 +1567,111 @@ namespace Orly {
         throw;
       }
 
+      template <size_t CachePageSize, size_t BlockSize, size_t PhysicalBlockSize, Util::TBufKind BufKind, size_t LocalCacheSize, bool ScanAheadAllowed>
+      const Atom::TCore::TNote *TDiskArena<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, LocalCacheSize, ScanAheadAllowed>::AcquireCompressedNote(Atom::TCore::TOffset offset, size_t note_size, void *&data2) {
+        assert(this);
+        const size_t chunk = FindChunk(offset);
+        const size_t offset_in_chunk = offset - File->GetArenaChunkVec()[chunk].first;
+        if (!note_size) {
+          const TArenaChunkCache::TChunk *data = GetChunk(chunk);
+          if (offset_in_chunk + sizeof(Atom::TCore::TNote) <= data->GetSize()) {
+            note_size = sizeof(Atom::TCore::TNote) + reinterpret_cast<const Atom::TCore::TNote *>(data->GetData() + offset_in_chunk)->GetRawSize();
+          } else {
+            Atom::TCore::TNote *temp_note = reinterpret_cast<Atom::TCore::TNote *>(alloca(sizeof(Atom::TCore::TNote)));
+            ReadCompressed(offset, temp_note, sizeof(Atom::TCore::TNote));
+            note_size = sizeof(Atom::TCore::TNote) + temp_note->GetRawSize();
+          }
+        }
+        /* try to just point at the decompressed chunk if the note is contiguous. */
+        const TArenaChunkCache::TChunk *data = GetChunk(chunk);
+        if (offset_in_chunk + note_size <= data->GetSize()) {
+          data->Pin();
+          data2 = const_cast<TArenaChunkCache::TChunk *>(data);
+          return reinterpret_cast<const Atom::TCore::TNote *>(data->GetData() + offset_in_chunk);
+        }
+        data2 = nullptr;
+        Atom::TCore::TNote *note_ptr = reinterpret_cast<Atom::TCore::TNote *>(malloc(note_size));
+        if (!note_ptr) {
+          syslog(LOG_EMERG, "bad alloc in TDiskArena::AcquireCompressedNote [%ld]", note_size);
+          throw std::bad_alloc();
+        }
+        try {
+          ReadCompressed(offset, note_ptr, note_size);
+        } catch (...) {
+          free(note_ptr);
+          throw;
+        }
+        return note_ptr;
+      }
+
+      template <size_t CachePageSize, size_t BlockSize, size_t PhysicalBlockSize, Util::TBufKind BufKind, size_t LocalCacheSize, bool ScanAheadAllowed>
+      size_t TDiskArena<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, LocalCacheSize, ScanAheadAllowed>::FindChunk(Atom::TCore::TOffset offset) const {
+        assert(this);
+        const TArenaChunkVec &chunk_vec = File->GetArenaChunkVec();
+        assert(chunk_vec.size() > 1UL);
+        assert(offset < chunk_vec.back().first);
+        /* the last chunk starting at or before the offset */
+        return std::upper_bound(chunk_vec.begin(), chunk_vec.end(), offset, [](size_t lhs, const std::pair<size_t, size_t> &rhs) {
+          return lhs < rhs.first;
+        }) - chunk_vec.begin() - 1UL;
+      }
+
+      template <size_t CachePageSize, size_t BlockSize, size_t PhysicalBlockSize, Util::TBufKind BufKind, size_t LocalCacheSize, bool ScanAheadAllowed>
+      void TDiskArena<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, LocalCacheSize, ScanAheadAllowed>::ReadCompressed(Atom::TCore::TOffset offset, void *out, size_t len) {
+        assert(this);
+        const TArenaChunkVec &chunk_vec = File->GetArenaChunkVec();
+        assert(offset + len <= chunk_vec.back().first);
+        size_t chunk = FindChunk(offset);
+        char *ptr = reinterpret_cast<char *>(out);
+        while (len) {
+          assert(chunk + 1UL < chunk_vec.size());
+          const TArenaChunkCache::TChunk *data = GetChunk(chunk);
+          const size_t offset_in_chunk = offset - chunk_vec[chunk].first;
+          const size_t do_now = std::min(data->GetSize() - offset_in_chunk, len);
+          memcpy(ptr, data->GetData() + offset_in_chunk, do_now);
+          ptr += do_now;
+          offset += do_now;
+          len -= do_now;
+          ++chunk;
+        }
+      }
+
+      template <size_t CachePageSize, size_t BlockSize, size_t PhysicalBlockSize, Util::TBufKind BufKind, size_t LocalCacheSize, bool ScanAheadAllowed>
+      const TArenaChunkCache::TChunk *TDiskArena<CachePageSize, BlockSize, PhysicalBlockSize, BufKind, LocalCacheSize, ScanAheadAllowed>::GetChunk(size_t chunk) {
+        assert(this);
+        if (CurChunk && CurChunkNumber == chunk) {
+          return CurChunk;
+        }
+        const TArenaChunkCache::TChunk *data = TArenaChunkCache::Cache.TryGet(File->GetArenaId(), chunk);
+        if (!data) {
+          const TArenaChunkVec &chunk_vec = File->GetArenaChunkVec();
+          const size_t raw_size = chunk_vec[chunk + 1UL].first - chunk_vec[chunk].first;
+          const size_t disk_size = chunk_vec[chunk + 1UL].second - chunk_vec[chunk].second;
+          std::string disk_data(disk_size, '\0');
+          Stream.GoTo(StartOffset + chunk_vec[chunk].second);
+          Stream.Read(&disk_data[0], disk_size);
+          if (disk_size == raw_size) {
+            data = TArenaChunkCache::TChunk::New(std::move(disk_data));
+          } else {
+            std::string raw_data(raw_size, '\0');
+            Util::TCodec::Get(File->GetArenaCodec())->Uncompress(disk_data.data(), disk_size, &raw_data[0], raw_size);
+            data = TArenaChunkCache::TChunk::New(std::move(raw_data));
+          }
+          try {
+            TArenaChunkCache::Cache.Keep(File->GetArenaId(), chunk, data);
+          } catch (...) {
+            data->Unpin();
+            throw;
+          }
+        }
+        if (CurChunk) {
+          CurChunk->Unpin();
+        }
+        CurChunkNumber = chunk;
+        CurChunk = data;
+        return data;
+      }
+
     }  // Disk
 
   }  // Indy
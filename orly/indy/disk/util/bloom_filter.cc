@@ -0,0 +1,66 @@
+/* <orly/indy/disk/util/bloom_filter.cc>
+
+   Implements <orly/indy/disk/util/bloom_filter.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/util/bloom_filter.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace Orly::Indy::Disk::Util;
+
+constexpr size_t TBloomFilter::DefaultBitsPerKey;
+
+constexpr size_t TBloomFilter::MaxNumProbes;
+
+TBloomFilter::TBloomFilter(size_t num_keys, size_t bits_per_key)
+    : NumBits(0UL), NumProbes(0UL) {
+  if (bits_per_key) {
+    /* small filters have a terrible false positive rate, so never go below a single word */
+    Reset(max(num_keys * bits_per_key, 64UL), SuggestNumProbes(bits_per_key));
+  }
+}
+
+void TBloomFilter::Reset(size_t num_bits, size_t num_probes) {
+  assert(this);
+  const size_t num_words = (num_bits + 63UL) / 64UL;
+  Words.assign(num_words, 0UL);
+  NumBits = num_words * 64UL;
+  NumProbes = num_probes;
+}
+
+size_t TBloomFilter::SuggestNumProbes(size_t bits_per_key) {
+  /* k = (m / n) ln 2 */
+  const size_t num_probes = static_cast<size_t>(round(static_cast<double>(bits_per_key) * M_LN2));
+  return min(max(num_probes, 1UL), MaxNumProbes);
+}
+
+size_t TBloomFilter::GetBitsPerKeyForRate(double false_positive_rate) {
+  assert(false_positive_rate > 0.0 && false_positive_rate < 1.0);
+  /* m / n = -ln(p) / (ln 2)^2 */
+  return static_cast<size_t>(ceil(-log(false_positive_rate) / (M_LN2 * M_LN2)));
+}
+
+double TBloomFilter::GetExpectedFalsePositiveRate(size_t bits_per_key) {
+  if (!bits_per_key) {
+    return 1.0;
+  }
+  /* p = (1 - e^(-k n / m))^k */
+  const double num_probes = SuggestNumProbes(bits_per_key);
+  return pow(1.0 - exp(-num_probes / static_cast<double>(bits_per_key)), num_probes);
+}
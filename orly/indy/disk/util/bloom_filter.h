@@ -0,0 +1,168 @@
+/* <orly/indy/disk/util/bloom_filter.h>
+
+   A compact Bloom filter over pre-computed 64-bit key hashes.  Data files write one of these per index segment so that
+   point lookups which miss a generation can be rejected without probing the on-disk hash table.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <base/class_traits.h>
+#include <orly/indy/disk/util/hash_util.h>
+
+namespace Orly {
+
+  namespace Indy {
+
+    namespace Disk {
+
+      namespace Util {
+
+        /* A fixed-size Bloom filter.  The bits are kept as an array of 64-bit words so the filter can be written to and
+           read from a data file as a single contiguous run of bytes.  A filter with no bits is considered disabled and
+           answers 'maybe' to every query. */
+        class TBloomFilter {
+          NO_COPY(TBloomFilter);
+          public:
+
+          /* The number of bits we spend per key unless told otherwise.  This gives a false positive rate of ~1%. */
+          static constexpr size_t DefaultBitsPerKey = 10UL;
+
+          /* We never probe more than this many bits per key. */
+          static constexpr size_t MaxNumProbes = 30UL;
+
+          /* A disabled filter. */
+          TBloomFilter()
+              : NumBits(0UL), NumProbes(0UL) {}
+
+          /* A filter sized to hold 'num_keys' keys at 'bits_per_key' bits each.  If 'bits_per_key' is zero, the filter is
+             disabled. */
+          TBloomFilter(size_t num_keys, size_t bits_per_key);
+
+          /* Discard the current contents and make room for exactly 'num_bits' bits (rounded up to a whole word) probed
+             'num_probes' times per key.  This is used when loading a filter back from disk; fill the bits in through
+             GetData(). */
+          void Reset(size_t num_bits, size_t num_probes);
+
+          /* Record the given key hash. */
+          void Add(size_t hash) {
+            assert(this);
+            if (NumBits) {
+              size_t h1, h2;
+              Split(hash, h1, h2);
+              for (size_t i = 0; i < NumProbes; ++i) {
+                const size_t bit = (h1 + i * h2) % NumBits;
+                Words[bit / 64UL] |= (1UL << (bit % 64UL));
+              }
+            }
+          }
+
+          /* False iff. the given key hash was definitely never added.  A disabled filter always returns true. */
+          bool MayContain(size_t hash) const {
+            assert(this);
+            if (NumBits) {
+              size_t h1, h2;
+              Split(hash, h1, h2);
+              for (size_t i = 0; i < NumProbes; ++i) {
+                const size_t bit = (h1 + i * h2) % NumBits;
+                if (!(Words[bit / 64UL] & (1UL << (bit % 64UL)))) {
+                  return false;
+                }
+              }
+            }
+            return true;
+          }
+
+          /* True iff. this filter has any bits. */
+          bool IsEnabled() const {
+            assert(this);
+            return NumBits != 0UL;
+          }
+
+          /* The raw bits of the filter. */
+          const void *GetData() const {
+            assert(this);
+            return Words.data();
+          }
+
+          /* The raw bits of the filter. */
+          void *GetData() {
+            assert(this);
+            return Words.data();
+          }
+
+          /* The number of bits in the filter.  Always a multiple of 64. */
+          size_t GetNumBits() const {
+            assert(this);
+            return NumBits;
+          }
+
+          /* The number of bytes occupied by the filter's bits. */
+          size_t GetNumBytes() const {
+            assert(this);
+            return NumBits / 8UL;
+          }
+
+          /* The number of bits probed per key. */
+          size_t GetNumProbes() const {
+            assert(this);
+            return NumProbes;
+          }
+
+          /* The number of probes which minimizes the false positive rate at the given bits per key. */
+          static size_t SuggestNumProbes(size_t bits_per_key);
+
+          /* The number of bits per key required to achieve (at most) the given false positive rate. */
+          static size_t GetBitsPerKeyForRate(double false_positive_rate);
+
+          /* The expected false positive rate at the given bits per key, using the suggested number of probes. */
+          static double GetExpectedFalsePositiveRate(size_t bits_per_key);
+
+          private:
+
+          /* Derive the two hashes used for double hashing.  The stored key hashes are not guaranteed to be well mixed, so
+             we mix each of them, seeded apart from one another and from the hash indexes' home buckets and fingerprints,
+             which mix the same key hashes unseeded.  The second hash is forced odd so that consecutive probes never
+             collapse onto the same bit. */
+          static void Split(size_t hash, size_t &h1, size_t &h2) {
+            h1 = MixHash(hash ^ FirstProbeSeed);
+            h2 = MixHash(hash ^ SecondProbeSeed) | 1UL;
+          }
+
+          /* See Split(). */
+          static constexpr size_t FirstProbeSeed = 0x9e3779b97f4a7c15UL;
+          static constexpr size_t SecondProbeSeed = 0xc2b2ae3d27d4eb4fUL;
+
+          /* The bits. */
+          std::vector<uint64_t> Words;
+
+          /* See accessors. */
+          size_t NumBits;
+          size_t NumProbes;
+
+        };  // TBloomFilter
+
+      }  // Util
+
+    }  // Disk
+
+  }  // Indy
+
+}  // Orly
@@ -0,0 +1,91 @@
+/* <orly/indy/disk/util/bloom_filter.test.cc>
+
+   Unit test for <orly/indy/disk/util/bloom_filter.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/util/bloom_filter.h>
+
+#include <cstring>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace Orly::Indy::Disk::Util;
+
+FIXTURE(Disabled) {
+  TBloomFilter filter;
+  EXPECT_FALSE(filter.IsEnabled());
+  EXPECT_EQ(filter.GetNumBytes(), 0UL);
+  EXPECT_TRUE(filter.MayContain(0UL));
+  EXPECT_TRUE(filter.MayContain(101UL));
+  TBloomFilter zero_bits(1000UL, 0UL);
+  EXPECT_FALSE(zero_bits.IsEnabled());
+  EXPECT_TRUE(zero_bits.MayContain(7UL));
+}
+
+FIXTURE(NoFalseNegatives) {
+  const size_t num_keys = 10000UL;
+  TBloomFilter filter(num_keys, TBloomFilter::DefaultBitsPerKey);
+  EXPECT_TRUE(filter.IsEnabled());
+  EXPECT_EQ(filter.GetNumBits() % 64UL, 0UL);
+  EXPECT_GE(filter.GetNumBits(), num_keys * TBloomFilter::DefaultBitsPerKey);
+  for (size_t i = 0; i < num_keys; ++i) {
+    filter.Add(i * 7919UL);
+  }
+  size_t found = 0UL;
+  for (size_t i = 0; i < num_keys; ++i) {
+    found += filter.MayContain(i * 7919UL) ? 1UL : 0UL;
+  }
+  EXPECT_EQ(found, num_keys);
+}
+
+FIXTURE(FalsePositiveRate) {
+  const size_t num_keys = 100000UL;
+  TBloomFilter filter(num_keys, TBloomFilter::DefaultBitsPerKey);
+  for (size_t i = 0; i < num_keys; ++i) {
+    filter.Add(i);
+  }
+  size_t false_positives = 0UL;
+  for (size_t i = num_keys; i < num_keys * 2UL; ++i) {
+    false_positives += filter.MayContain(i) ? 1UL : 0UL;
+  }
+  /* ~1% expected at 10 bits per key; leave plenty of slack */
+  EXPECT_LT(false_positives, num_keys / 50UL);
+}
+
+FIXTURE(Reload) {
+  const size_t num_keys = 1000UL;
+  TBloomFilter filter(num_keys, 8UL);
+  for (size_t i = 0; i < num_keys; ++i) {
+    filter.Add(i * 31UL);
+  }
+  TBloomFilter loaded;
+  loaded.Reset(filter.GetNumBits(), filter.GetNumProbes());
+  EXPECT_EQ(loaded.GetNumBytes(), filter.GetNumBytes());
+  memcpy(loaded.GetData(), filter.GetData(), filter.GetNumBytes());
+  for (size_t i = 0; i < num_keys * 2UL; ++i) {
+    EXPECT_EQ(loaded.MayContain(i * 31UL), filter.MayContain(i * 31UL));
+  }
+}
+
+FIXTURE(Sizing) {
+  EXPECT_EQ(TBloomFilter::SuggestNumProbes(10UL), 7UL);
+  EXPECT_EQ(TBloomFilter::SuggestNumProbes(1UL), 1UL);
+  EXPECT_EQ(TBloomFilter::SuggestNumProbes(1000UL), TBloomFilter::MaxNumProbes);
+  EXPECT_EQ(TBloomFilter::GetBitsPerKeyForRate(0.01), 10UL);
+  EXPECT_LT(TBloomFilter::GetExpectedFalsePositiveRate(10UL), 0.01);
+  EXPECT_EQ(TBloomFilter::GetExpectedFalsePositiveRate(0UL), 1.0);
+}
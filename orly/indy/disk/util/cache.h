@@ -21,7 +21,9 @@
 #include <sched.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <stdexcept>
 #include <iostream> /* TODO: GET RID OF */
 
@@ -41,6 +43,46 @@ namespace Orly {
 
       namespace Util {
 
+        /* The replacement policy of a TCache.
+           LRU: every released page goes to the back of a single list and the front of the list is reclaimed first.
+           SegmentedLRU: a page that gets read again while it is still cached is promoted to a protected segment, which
+                         is only reclaimed from once the unprotected (probationary) pages run out, or once the protected
+                         segment grows past its share of the cache.  A single large scan only ever churns the
+                         probationary pages, so the hot point-lookup set survives it.  Pages that have only ever been
+                         read at Low priority (merges, file syncs, etc.) are reclaimed before anything else.
+           With either policy, a reader can ask not to cache what it reads (see Get() and Release()); pages nobody else
+           has used are then reclaimed before anything else. */
+        enum class TCachePolicy {
+          LRU,
+          SegmentedLRU
+        };
+
+        /* A snapshot of the counters of a TCache.  See TCache::TakeStats(). */
+        struct TCacheStats {
+
+          /* Gets which found the page already in the cache. */
+          size_t NumHits;
+
+          /* Gets which had to give the page a new buffer. */
+          size_t NumMisses;
+
+          /* Loaded pages which were pushed out to make room for another. */
+          size_t NumEvictions;
+
+          /* Reads from disk which have been issued but haven't completed.  (This is a gauge, not a counter.) */
+          size_t NumLoadsInFlight;
+
+          /* Readers which had to wait for a page to load, and the total time they spent waiting. */
+          size_t NumWaits;
+          std::chrono::nanoseconds WaitTime;
+
+          /* Pages sequential scans asked to have read ahead of them, and fetches by those scans which landed on a page
+             they had read ahead. */
+          size_t NumReadAheadPages;
+          size_t NumReadAheadHits;
+
+        };  // TCacheStats
+
         /* TODO */
         template <size_t PageSize>
         class TCache {
@@ -66,6 +108,13 @@ namespace Orly {
           static constexpr size_t EmptySlot = -2;
           static constexpr size_t DummyStartSlot = -3;
 
+          /* Under the SegmentedLRU policy, the fraction of each LRU that protected pages may occupy before we start
+             reclaiming them ahead of probationary ones. */
+          static constexpr double ProtectedFraction = 0.8;
+
+          /* The most pages a sequential scan reads ahead of itself unless told otherwise. */
+          static constexpr size_t DefaultMaxReadAhead = 32UL;
+
           /* TODO */
           struct TSlot {
 
@@ -73,7 +122,14 @@ namespace Orly {
 
             /* TODO */
             TSlot()
-                : PageId(EmptySlot), RefCount(0UL), BufAddr(0UL), LRUMembership(this), NextSlot(nullptr), MainSlot(nullptr) {}
+                : PageId(EmptySlot), RefCount(0UL), BufAddr(0UL), LRUMembership(this), NextSlot(nullptr), MainSlot(nullptr),
+                  Referenced(false), Reused(false), Protected(false) {}
+
+            /* True iff the data for this page has finished loading (with or without error). */
+            inline bool IsLoaded() const {
+              assert(this);
+              return (std::atomic_load(&BufAddr) & HighestBit) == HighestBit;
+            }
 
             /* This function assumes the data in the cache is already loaded! */
             inline const char *KnownGetData(TCache *cache) const {
@@ -118,6 +174,7 @@ namespace Orly {
                     char *buf = cache->PageData.get() + (page_offset * PageSize);
 
                     TCompletionTrigger *trigger_ptr = &async_trigger;
+                    cache->GetStatShard().NumLoadsInFlight.fetch_add(1UL, std::memory_order_relaxed);
                     cache->VolumeManager->Read(code_location,
                                                buf_kind,
                                                util_src,
@@ -126,7 +183,8 @@ namespace Orly {
                                                PageSize,
                                                priority,
                                                async_trigger,
-                                               [this, main_slot, can_release, new_val, trigger_ptr, cache, page_id, code_location](TDiskResult result, const char *err_str) {
+                                               [this, main_slot, can_release, new_val, trigger_ptr, cache, page_id, priority, code_location](TDiskResult result, const char *err_str) {
+                      cache->GetStatShard().NumLoadsInFlight.fetch_sub(1UL, std::memory_order_relaxed);
                       if (result == TDiskResult::Success) {
                         size_t val = new_val | HighestBit;
                         std::atomic_store(&(BufAddr), val);
@@ -137,7 +195,7 @@ namespace Orly {
                         std::atomic_store(&(BufAddr), val);
                       }
                       if (can_release) {
-                        cache->Release(main_slot, page_id);
+                        cache->Release(main_slot, page_id, priority);
                       }
                     });
                     return; /* exit so we don't release twice. */
@@ -145,7 +203,7 @@ namespace Orly {
                 }
               }
               if (can_release) {
-                cache->Release(main_slot, page_id);
+                cache->Release(main_slot, page_id, priority);
               }
             }
 
@@ -158,9 +216,14 @@ namespace Orly {
                                            size_t page_id,
                                            TCompletionTrigger &trigger) const {
               assert(this);
+              bool waited = false;
+              std::chrono::steady_clock::time_point wait_start;
               for (;;) {
                 size_t val = std::atomic_load(&BufAddr);
                 if ((val & HighestBit) == HighestBit) {
+                  if (waited) {
+                    cache->RecordWait(wait_start);
+                  }
                   /* if the highest bit is set, then we can just return the buffer after checking for an error. */
                   if ((val & ThirdHighestBit) == 0) {
                     const size_t page_offset = val & All1But3HighestBits;
@@ -173,6 +236,10 @@ namespace Orly {
                   /* if the highest bit is not set, then we use the second highest bit to see if someone is already loading this data. */
                   if ((val & SecondHighestBit) == SecondHighestBit) {
                     /* second highest bit is set, someone is loading the data, we just have to wait. */
+                    if (!waited) {
+                      waited = true;
+                      wait_start = std::chrono::steady_clock::now();
+                    }
                     //std::this_thread::sleep_for(std::chrono::nanoseconds(25000));
                     /* TODO: we should try to join some form of queue of frames that will get re-activated when the frame performing the read on our
                        behalf is finished. */
@@ -189,13 +256,21 @@ namespace Orly {
                     const size_t page_offset = val & All1But3HighestBits;
                     const size_t logical_offset = page_id * PageSize;
                     char *buf = cache->PageData.get() + (page_offset * PageSize);
+                    if (!waited) {
+                      wait_start = std::chrono::steady_clock::now();
+                    }
+                    cache->GetStatShard().NumLoadsInFlight.fetch_add(1UL, std::memory_order_relaxed);
                     cache->VolumeManager->Read(code_location, buf_kind, util_src, buf, logical_offset, PageSize, priority, trigger);
                     try {
                       trigger.Wait(true);
+                      cache->GetStatShard().NumLoadsInFlight.fetch_sub(1UL, std::memory_order_relaxed);
+                      cache->RecordWait(wait_start);
                       val = new_val | HighestBit;
                       std::atomic_store(&BufAddr, val);
                       return buf;
                     } catch (const std::exception &ex) {
+                      cache->GetStatShard().NumLoadsInFlight.fetch_sub(1UL, std::memory_order_relaxed);
+                      cache->RecordWait(wait_start);
                       val = new_val | HighestBit;
                       val |= ThirdHighestBit; /* set the error bit */
                       std::atomic_store(&BufAddr, val);
@@ -222,6 +297,14 @@ namespace Orly {
             TSlot *NextSlot;
             TSlot *MainSlot;
 
+            /* Replacement state, guarded by the lock on the main slot of our chain.
+               - Referenced: a reader above Low priority, and not passing dont_cache, has used this page since it was loaded
+               - Reused: such a reader has found this page already in the cache
+               - Protected: we're currently in the protected segment of our LRU */
+            bool Referenced;
+            bool Reused;
+            bool Protected;
+
             /* TODO */
             friend class TCache;
 
@@ -237,6 +320,11 @@ namespace Orly {
                 NumLRU(num_lru),
                 SlotArray(new TSlot[NumSlots]),
                 LRUArray(new TLRU[NumLRU]),
+                MaxProtectedPerLRU(std::max(1UL, static_cast<size_t>(MaxCacheSize * ProtectedFraction) / NumLRU)),
+                Policy(TCachePolicy::LRU),
+                MaxReadAhead(DefaultMaxReadAhead),
+                NumStatShards(std::max(1L, sysconf(_SC_NPROCESSORS_CONF))),
+                StatArray(new TStatShard[NumStatShards]),
                 PageData(nullptr) {
             Base::MlockN(&SlotArray[0], NumSlots);
             Base::MlockN(&LRUArray[0], NumLRU);
@@ -262,6 +350,81 @@ namespace Orly {
             TryRemoveSlotFunc = std::bind(&TCache::TryRemoveSlot, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4);
           }
 
+          /* The memory all our pages live in, and its size in bytes.  Loads read straight into it, so the disk controller
+             may want to register it with the kernel. */
+          char *GetPageData() const {
+            assert(this);
+            return PageData.get();
+          }
+          size_t GetPageDataSize() const {
+            assert(this);
+            return PageSize * MaxCacheSize;
+          }
+
+          /* The replacement policy we're using. */
+          TCachePolicy GetPolicy() const {
+            assert(this);
+            return Policy.load(std::memory_order_relaxed);
+          }
+
+          /* Switch replacement policy.  This is safe to do while the cache is in use; pages already in the protected
+             segment simply age out of it, and readers pick the new policy up the next time they put a slot back. */
+          void SetPolicy(TCachePolicy policy) {
+            assert(this);
+            Policy.store(policy, std::memory_order_relaxed);
+          }
+
+          /* The most pages a sequential scan over this cache may read ahead of itself.  0 means no read-ahead. */
+          size_t GetMaxReadAhead() const {
+            assert(this);
+            return MaxReadAhead;
+          }
+
+          /* Change the read-ahead limit.  Scans already under way pick up the new limit the next time they read ahead. */
+          void SetMaxReadAhead(size_t max_read_ahead) {
+            assert(this);
+            MaxReadAhead = max_read_ahead;
+          }
+
+          /* Count pages a sequential scan asked to have read ahead. */
+          void CountReadAhead(size_t num_pages) {
+            assert(this);
+            GetStatShard().NumReadAheadPages.fetch_add(num_pages, std::memory_order_relaxed);
+          }
+
+          /* Count a fetch by a sequential scan which landed on a page it had read ahead. */
+          void CountReadAheadHit() {
+            assert(this);
+            GetStatShard().NumReadAheadHits.fetch_add(1UL, std::memory_order_relaxed);
+          }
+
+          /* Sum up our counters across all cpus and reset them, except for the number of loads in flight, which is a gauge. */
+          void TakeStats(TCacheStats &out) {
+            assert(this);
+            assert(&out);
+            out.NumHits = 0UL;
+            out.NumMisses = 0UL;
+            out.NumEvictions = 0UL;
+            out.NumLoadsInFlight = 0UL;
+            out.NumWaits = 0UL;
+            out.NumReadAheadPages = 0UL;
+            out.NumReadAheadHits = 0UL;
+            size_t wait_ns = 0UL;
+            for (size_t i = 0; i < NumStatShards; ++i) {
+              TStatShard &shard = StatArray[i];
+              out.NumHits += shard.NumHits.exchange(0UL);
+              out.NumMisses += shard.NumMisses.exchange(0UL);
+              out.NumEvictions += shard.NumEvictions.exchange(0UL);
+              /* loads can finish on a different cpu than they started on, so only the sum of these means anything */
+              out.NumLoadsInFlight += std::atomic_load(&shard.NumLoadsInFlight);
+              out.NumWaits += shard.NumWaits.exchange(0UL);
+              wait_ns += shard.WaitNs.exchange(0UL);
+              out.NumReadAheadPages += shard.NumReadAheadPages.exchange(0UL);
+              out.NumReadAheadHits += shard.NumReadAheadHits.exchange(0UL);
+            }
+            out.WaitTime = std::chrono::nanoseconds(wait_ns);
+          }
+
           /* STATS */
           #ifdef PERF_STATS
           inline size_t GetMaxCacheSize() const {
@@ -290,8 +453,10 @@ namespace Orly {
             _mm_prefetch(reinterpret_cast<uint8_t *>(my_slot) + sizeof(TSlot), _MM_HINT_T0);
           }
 
-          /* Returns a pointer to the main slot object. Initializes the slot if it does not exist yet. Increments the reference count on the actual slot holding our page. */
-          inline TSlot *Get(size_t page_id, TSlot *&data_slot) {
+          /* Returns a pointer to the main slot object. Initializes the slot if it does not exist yet. Increments the reference count on the actual slot holding our page.
+             The priority of the reader (and whether this is only a prefetch) decides how the page is treated by the replacement policy once it's released.
+             A reader which won't be back for the page (a one-pass scan) can pass dont_cache, and its use won't count toward keeping the page. */
+          inline TSlot *Get(size_t page_id, TSlot *&data_slot, DiskPriority priority = RealTime, bool is_prefetch = false, bool dont_cache = false) {
             assert(this);
             const size_t slot_num = page_id % NumSlots;
             TSlot &slot = SlotArray[slot_num];
@@ -316,6 +481,8 @@ namespace Orly {
                 */
                 try {
                   slot.BufAddr = NewPageBuf();
+                  ResetUse(slot, priority, is_prefetch, dont_cache);
+                  CountGet(false, is_prefetch);
                 } catch (...) {
                   /* we need to unwind. this means:
                      - transition from LockedSlot -> EmptySlot
@@ -346,12 +513,10 @@ namespace Orly {
                   const size_t prev_ref_count = slot.RefCount++;
                   assert(prev_ref_count == slot.RefCount - 1);
                   if (prev_ref_count == 0) {
-                    assert(slot.LRUMembership.TryGetCollector());
-                    #ifdef PERF_STATS
-                    --(slot.LRUMembership.TryGetCollector()->NumBufInLRU);
-                    #endif
-                    slot.LRUMembership.Remove();
+                    RemoveFromLRU(slot);
+                    RecordUse(slot, priority, is_prefetch, dont_cache);
                   }
+                  CountGet(true, is_prefetch);
                   std::atomic_store(cur_slot, val);
                   data_slot = &slot;
                   return &slot;
@@ -372,28 +537,28 @@ namespace Orly {
                       const size_t prev_ref_count = (next_slot->RefCount)++;
                       assert(prev_ref_count == (next_slot->RefCount) - 1);
                       if (prev_ref_count == 0) {
-                        assert(next_slot->LRUMembership.TryGetCollector());
-                        #ifdef PERF_STATS
-                        --(next_slot->LRUMembership.TryGetCollector()->NumBufInLRU);
-                        #endif
-                        next_slot->LRUMembership.Remove();
+                        RemoveFromLRU(*next_slot);
+                        RecordUse(*next_slot, priority, is_prefetch, dont_cache);
                       }
+                      CountGet(true, is_prefetch);
                       std::atomic_store(cur_slot, val);
                       data_slot = next_slot;
                       return &slot;
                     }
                   }
-                  /* if this main slot is empty, let's just replace it... */
-                  if (slot.RefCount == 0) {
+                  /* if this main slot is empty, let's just replace it... unless our policy wants to hold on to it. */
+                  if (slot.RefCount == 0 && CanReplaceDirectly(slot, priority, dont_cache)) {
                     /* remove the high order bits from the reclaimed page. */
-                    const size_t new_buf_addr = std::atomic_load(&slot.BufAddr) & All1But3HighestBits;
+                    const size_t old_buf_addr = std::atomic_load(&slot.BufAddr);
+                    const size_t new_buf_addr = old_buf_addr & All1But3HighestBits;
                     std::atomic_store(&slot.BufAddr, new_buf_addr);
                     ++slot.RefCount;
-                    assert(slot.LRUMembership.TryGetCollector());
-                    #ifdef PERF_STATS
-                    --(slot.LRUMembership.TryGetCollector()->NumBufInLRU);
-                    #endif
-                    slot.LRUMembership.Remove();
+                    RemoveFromLRU(slot);
+                    ResetUse(slot, priority, is_prefetch, dont_cache);
+                    CountGet(false, is_prefetch);
+                    if (old_buf_addr & HighestBit) {
+                      GetStatShard().NumEvictions.fetch_add(1UL, std::memory_order_relaxed);
+                    }
                     std::atomic_store(cur_slot, page_id);
                     data_slot = &slot;
                     return &slot;
@@ -415,6 +580,8 @@ namespace Orly {
                     new_slot->MainSlot = &slot;
                     try {
                       new_slot->BufAddr = NewPageBuf();
+                      ResetUse(*new_slot, priority, is_prefetch, dont_cache);
+                      CountGet(false, is_prefetch);
                       std::atomic_store(&(new_slot->PageId), page_id);
                       /* the following should be no-throws... */
                       ++(new_slot->RefCount);
@@ -439,8 +606,10 @@ namespace Orly {
             }
           }
 
-          /* Decrements the reference count on the given page_id for this slot. */
-          inline void Release(TSlot *slot_ptr, size_t page_id) {
+          /* Decrements the reference count on the given page_id for this slot.  If that was the last reference, the page goes
+             back into an LRU; pages read only by readers which passed dont_cache (or, under SegmentedLRU, only at Low priority)
+             go where they'll be reclaimed first. */
+          inline void Release(TSlot *slot_ptr, size_t page_id, DiskPriority priority = RealTime, bool dont_cache = false) {
             assert(this);
             assert(&SlotArray[page_id % NumSlots] == slot_ptr);
             _mm_prefetch(slot_ptr, _MM_HINT_T0);
@@ -470,12 +639,7 @@ namespace Orly {
                   const size_t new_ref_count = --slot.RefCount;
                   assert(new_ref_count == slot.RefCount);
                   if (new_ref_count == 0UL) {
-                    TLRU &lru = LRUArray[sched_getcpu() % NumLRU];
-                    assert(!slot.LRUMembership.TryGetCollector());
-                    lru.SlotCollection.Insert(&slot.LRUMembership);
-                    #ifdef PERF_STATS
-                    ++lru.NumBufInLRU;
-                    #endif
+                    InsertIntoLRU(slot, priority, dont_cache);
                   }
                   std::atomic_store(cur_slot, val);
                   return;
@@ -491,12 +655,7 @@ namespace Orly {
                       const size_t new_ref_count = --(next_slot->RefCount);
                       assert(new_ref_count == (next_slot->RefCount));
                       if (new_ref_count == 0UL) {
-                        TLRU &lru = LRUArray[sched_getcpu() % NumLRU];
-                        assert(!next_slot->LRUMembership.TryGetCollector());
-                        lru.SlotCollection.Insert(&next_slot->LRUMembership);
-                        #ifdef PERF_STATS
-                        ++lru.NumBufInLRU;
-                        #endif
+                        InsertIntoLRU(*next_slot, priority, dont_cache);
                       }
                       std::atomic_store(cur_slot, val);
                       return;
@@ -630,7 +789,7 @@ namespace Orly {
             TSlot **main_slots_ptr = main_slots;
             TSlot **data_slots_ptr = data_slots;
             for (size_t i = 0; i < num_consec_pages; ++i) {
-              main_slots[i] = Get(page_id + i, data_slots[i]);
+              main_slots[i] = Get(page_id + i, data_slots[i], priority, true /* is_prefetch */);
             }
 
             auto load_range_func = [data_slots_ptr, main_slots_ptr, page_id, cache, &async_trigger, &code_location, buf_kind, util_src, can_release, priority](size_t from_page_id, size_t num_pages) {
@@ -651,6 +810,7 @@ namespace Orly {
                 buf_array[i] = buf;
               }
               TCompletionTrigger *trigger_ptr = &async_trigger;
+              cache->GetStatShard().NumLoadsInFlight.fetch_add(num_pages, std::memory_order_relaxed);
               cache->VolumeManager->ReadV(code_location,
                                           buf_kind,
                                           util_src,
@@ -660,7 +820,8 @@ namespace Orly {
                                           PageSize * num_pages,
                                           priority,
                                           async_trigger,
-                                          [my_data_slots, my_main_slots, can_release, trigger_ptr, cache, page_id, from_page_id, num_pages, code_location](TDiskResult result, const char *err_str) {
+                                          [my_data_slots, my_main_slots, can_release, trigger_ptr, cache, page_id, from_page_id, num_pages, priority, code_location](TDiskResult result, const char *err_str) {
+                cache->GetStatShard().NumLoadsInFlight.fetch_sub(num_pages, std::memory_order_relaxed);
                 if (result == TDiskResult::Success) {
                   for (size_t i = 0; i < num_pages; ++i) {
                     TSlot *const this_data_slot = my_data_slots[i];
@@ -682,7 +843,7 @@ namespace Orly {
                   for (size_t i = 0; i < num_pages; ++i) {
                     const size_t this_page_id = from_page_id + i;
                     TSlot *const this_main_slot = my_main_slots[i];
-                    cache->Release(this_main_slot, this_page_id);
+                    cache->Release(this_main_slot, this_page_id, priority);
                   }
                 }
               });
@@ -707,7 +868,7 @@ namespace Orly {
                   consec_next_page_id = -1;
                   num_consec_to_load = 0UL;
                   if (can_release) {
-                    cache->Release(main_slots[i], page_id + i);
+                    cache->Release(main_slots[i], page_id + i, priority);
                   }
                   break;
                 } else {
@@ -721,7 +882,7 @@ namespace Orly {
                     consec_next_page_id = -1;
                     num_consec_to_load = 0UL;
                     if (can_release) {
-                      cache->Release(main_slots[i], page_id + i);
+                      cache->Release(main_slots[i], page_id + i, priority);
                     }
                     break;
                   } else {
@@ -762,15 +923,25 @@ namespace Orly {
             typedef InvCon::AtomicUnorderedList::TCollection<TLRU, TSlot> TSlotCollection;
 
             /* TODO */
-            TLRU() : SlotCollection(this)
+            TLRU() : SlotCollection(this), ProtectedCollection(this), RecycleCollection(this), NumProtected(0UL)
             #ifdef PERF_STATS
             , NumBufInLRU(0UL)
             #endif
             {}
 
-            /* TODO */
+            /* The probationary pages (or all of them, under the plain LRU policy). */
             mutable typename TSlotCollection::TImpl SlotCollection;
 
+            /* Pages that have been reused while cached (SegmentedLRU only). */
+            mutable typename TSlotCollection::TImpl ProtectedCollection;
+
+            /* Pages that nobody has used but readers which asked not to cache them (or, under SegmentedLRU, Low priority
+               readers).  These get reclaimed first. */
+            mutable typename TSlotCollection::TImpl RecycleCollection;
+
+            /* The number of slots in ProtectedCollection. */
+            std::atomic<size_t> NumProtected;
+
             /* Stats */
             #ifdef PERF_STATS
             std::atomic<size_t> NumBufInLRU;
@@ -778,6 +949,143 @@ namespace Orly {
 
           };  // TLRU
 
+          /* One cpu's share of our counters. */
+          class alignas(64) TStatShard {
+            NO_COPY(TStatShard);
+            public:
+
+            /* TODO */
+            TStatShard() : NumHits(0UL), NumMisses(0UL), NumEvictions(0UL), NumLoadsInFlight(0UL), NumWaits(0UL), WaitNs(0UL),
+                           NumReadAheadPages(0UL), NumReadAheadHits(0UL) {}
+
+            /* See TCacheStats. */
+            std::atomic<size_t> NumHits;
+            std::atomic<size_t> NumMisses;
+            std::atomic<size_t> NumEvictions;
+            std::atomic<size_t> NumLoadsInFlight;
+            std::atomic<size_t> NumWaits;
+            std::atomic<size_t> WaitNs;
+            std::atomic<size_t> NumReadAheadPages;
+            std::atomic<size_t> NumReadAheadHits;
+
+          };  // TStatShard
+
+          /* The counters of the cpu we're running on. */
+          inline TStatShard &GetStatShard() const {
+            assert(this);
+            return StatArray[sched_getcpu() % NumStatShards];
+          }
+
+          /* Count a Get() as a hit or a miss.  Prefetches aren't counted; the Get() which consumes the page is. */
+          inline void CountGet(bool is_hit, bool is_prefetch) {
+            assert(this);
+            if (!is_prefetch) {
+              TStatShard &shard = GetStatShard();
+              (is_hit ? shard.NumHits : shard.NumMisses).fetch_add(1UL, std::memory_order_relaxed);
+            }
+          }
+
+          /* Count a reader which waited, from the given time until now, for a page to load. */
+          inline void RecordWait(const std::chrono::steady_clock::time_point &wait_start) {
+            assert(this);
+            const size_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wait_start).count();
+            TStatShard &shard = GetStatShard();
+            shard.NumWaits.fetch_add(1UL, std::memory_order_relaxed);
+            shard.WaitNs.fetch_add(wait_ns, std::memory_order_relaxed);
+          }
+
+          /* True iff a get counts as a use of the page for the replacement policy. */
+          static inline bool IsUse(DiskPriority priority, bool is_prefetch, bool dont_cache) {
+            return !is_prefetch && !dont_cache && priority != Low;
+          }
+
+          /* Reset the replacement state of a slot which is being given a new page. */
+          static inline void ResetUse(TSlot &slot, DiskPriority priority, bool is_prefetch, bool dont_cache) {
+            slot.Referenced = IsUse(priority, is_prefetch, dont_cache);
+            slot.Reused = false;
+          }
+
+          /* Record another use of a page which we found sitting idle in the cache.  (Pages that are already referenced, for
+             example by the stream that an arena is reading a note through, don't count as being used again.) */
+          static inline void RecordUse(TSlot &slot, DiskPriority priority, bool is_prefetch, bool dont_cache) {
+            if (IsUse(priority, is_prefetch, dont_cache)) {
+              if (slot.Referenced) {
+                slot.Reused = true;
+              } else {
+                slot.Referenced = true;
+              }
+            }
+          }
+
+          /* True iff an idle main slot may be handed straight to a new page rather than going through NewPageBuf().  We never
+             do this to a page somebody has used when the new page is being read by a reader which passed dont_cache.  Other
+             than that, plain LRU always does it, and SegmentedLRU doesn't do it to protected pages, nor to pages used by a
+             higher priority reader when the new page is being read at Low priority. */
+          inline bool CanReplaceDirectly(const TSlot &slot, DiskPriority priority, bool dont_cache) const {
+            assert(this);
+            if (dont_cache && slot.Referenced) {
+              return false;
+            }
+            if (Policy.load(std::memory_order_relaxed) != TCachePolicy::SegmentedLRU) {
+              return true;
+            }
+            return !slot.Protected && !(slot.Referenced && priority == Low);
+          }
+
+          /* Put an unreferenced slot into the LRU of the current cpu, in the segment our policy calls for.  The caller must
+             hold the lock on the slot's main slot. */
+          inline void InsertIntoLRU(TSlot &slot, DiskPriority priority, bool dont_cache) {
+            assert(this);
+            assert(!slot.LRUMembership.TryGetCollector());
+            TLRU &lru = LRUArray[sched_getcpu() % NumLRU];
+            const bool is_segmented = Policy.load(std::memory_order_relaxed) == TCachePolicy::SegmentedLRU;
+            if (slot.Reused && is_segmented) {
+              slot.Protected = true;
+              ++lru.NumProtected;
+              lru.ProtectedCollection.Insert(&slot.LRUMembership);
+            } else if (!slot.Referenced && (dont_cache || (priority == Low && is_segmented))) {
+              lru.RecycleCollection.Insert(&slot.LRUMembership);
+            } else {
+              lru.SlotCollection.Insert(&slot.LRUMembership);
+            }
+            #ifdef PERF_STATS
+            ++lru.NumBufInLRU;
+            #endif
+          }
+
+          /* Take a slot out of whichever LRU segment it's in.  The caller must hold the lock on the slot's main slot. */
+          static inline void RemoveFromLRU(TSlot &slot) {
+            TLRU *const lru = slot.LRUMembership.TryGetCollector();
+            assert(lru);
+            #ifdef PERF_STATS
+            --(lru->NumBufInLRU);
+            #endif
+            if (slot.Protected) {
+              slot.Protected = false;
+              --(lru->NumProtected);
+            }
+            slot.LRUMembership.Remove();
+          }
+
+          /* Look for a slot we can reclaim in the given LRU.  We try the recycled pages first, then (if the protected
+             segment has outgrown its share) the protected pages, then the probationary pages, and the protected pages as
+             a last resort. */
+          inline TSlot *TryReclaimFromLRU(TLRU &lru, size_t &reclaimed_page_buf, size_t &main_slot_page_id) {
+            assert(this);
+            TSlot *slot_to_remove = nullptr;
+            lru.RecycleCollection.ForEach(TryRemoveSlotFunc, slot_to_remove, reclaimed_page_buf, main_slot_page_id);
+            if (!slot_to_remove && std::atomic_load(&lru.NumProtected) > MaxProtectedPerLRU) {
+              lru.ProtectedCollection.ForEach(TryRemoveSlotFunc, slot_to_remove, reclaimed_page_buf, main_slot_page_id);
+            }
+            if (!slot_to_remove) {
+              lru.SlotCollection.ForEach(TryRemoveSlotFunc, slot_to_remove, reclaimed_page_buf, main_slot_page_id);
+            }
+            if (!slot_to_remove) {
+              lru.ProtectedCollection.ForEach(TryRemoveSlotFunc, slot_to_remove, reclaimed_page_buf, main_slot_page_id);
+            }
+            return slot_to_remove;
+          }
+
           /* TODO */
           inline size_t NewPageBuf() {
             assert(this);
@@ -787,14 +1095,15 @@ namespace Orly {
               TLRU &lru = LRUArray[cur_lru];
               size_t reclaimed_page_buf;
               size_t main_slot_page_id;
-              TSlot *slot_to_remove = nullptr;
-              lru.SlotCollection.ForEach(TryRemoveSlotFunc, slot_to_remove, reclaimed_page_buf, main_slot_page_id);
+              TSlot *slot_to_remove = TryReclaimFromLRU(lru, reclaimed_page_buf, main_slot_page_id);
               if (likely(slot_to_remove)) {
-                assert(slot_to_remove->LRUMembership.TryGetCollector());
-                #ifdef PERF_STATS
-                --(slot_to_remove->LRUMembership.TryGetCollector()->NumBufInLRU);
-                #endif
-                slot_to_remove->LRUMembership.Remove();
+                RemoveFromLRU(*slot_to_remove);
+                /* we only count pages which actually held data; the slots we start out with don't */
+                if (reclaimed_page_buf & HighestBit) {
+                  GetStatShard().NumEvictions.fetch_add(1UL, std::memory_order_relaxed);
+                }
+                /* remove the high order bits from the reclaimed page. */
+                reclaimed_page_buf &= All1But3HighestBits;
                 if (slot_to_remove->MainSlot == nullptr) {
                   /* common case : this is a main slot */
                   std::atomic_store(&(slot_to_remove->PageId), EmptySlot);
@@ -844,8 +1153,6 @@ namespace Orly {
                   /* common case : this is a main slot */
                   if (slot.NextSlot == nullptr) {
                     out_reclaimed_page_buf = std::atomic_load(&slot.BufAddr);
-                    /* remove the high order bits from the reclaimed page. */
-                    out_reclaimed_page_buf &= All1But3HighestBits;
                     slot_to_remove = const_cast<TSlot *>(&slot);
                     return false;
                   } else {
@@ -855,9 +1162,10 @@ namespace Orly {
                       assert(slot.RefCount == 0);
                       const_cast<TSlot &>(slot).NextSlot = next_slot.NextSlot;
                       out_reclaimed_page_buf = std::atomic_load(&slot.BufAddr);
-                      /* remove the high order bits from the reclaimed page. */
-                      out_reclaimed_page_buf &= All1But3HighestBits;
                       std::atomic_store(&const_cast<TSlot &>(slot).BufAddr, std::atomic_load(&(next_slot.BufAddr)));
+                      /* the main slot takes over the next slot's page, so it takes over its history too */
+                      const_cast<TSlot &>(slot).Referenced = next_slot.Referenced;
+                      const_cast<TSlot &>(slot).Reused = next_slot.Reused;
                       main_slot_page_id = std::atomic_load(&next_slot.PageId);
                       slot_to_remove = const_cast<TSlot *>(&next_slot);
                       return false;
@@ -875,8 +1183,6 @@ namespace Orly {
                       assert(next_slot->RefCount == 0);
                       prev_slot->NextSlot = next_slot->NextSlot;
                       out_reclaimed_page_buf = std::atomic_load(&slot.BufAddr);
-                      /* remove the high order bits from the reclaimed page. */
-                      out_reclaimed_page_buf &= All1But3HighestBits;
                       slot_to_remove = const_cast<TSlot *>(&slot);
                       main_slot_page_id = val;
                       return false;
@@ -922,6 +1228,19 @@ namespace Orly {
           /* TODO */
           std::unique_ptr<TLRU[]> LRUArray;
 
+          /* The number of slots each LRU may hold in its protected segment before we reclaim from it first. */
+          const size_t MaxProtectedPerLRU;
+
+          /* See accessor.  Atomic since it may be switched while readers are consulting it. */
+          std::atomic<TCachePolicy> Policy;
+
+          /* See accessor. */
+          size_t MaxReadAhead;
+
+          /* Our counters, sharded by cpu.  See TakeStats(). */
+          const size_t NumStatShards;
+          std::unique_ptr<TStatShard[]> StatArray;
+
           /* TODO */
           std::unique_ptr<char> PageData;
 
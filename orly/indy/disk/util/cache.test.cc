@@ -60,3 +60,98 @@ FIXTURE(SingleThreadPressureLRU) {
     cache.Release(slot, page_id);
   }
 }
+
+/* Load the given page into the cache (without going to disk) and use it once more, so it counts as reused. */
+static void LoadHotPage(TCache<4096> &cache, size_t page_id) {
+  char buf[4096];
+  memset(buf, 0, sizeof(buf));
+  cache.Replace(page_id, buf);
+  TCache<4096>::TSlot *data_slot;
+  TCache<4096>::TSlot *slot = cache.Get(page_id, data_slot);
+  cache.Release(slot, page_id);
+}
+
+/* Run a scan over many more pages than the cache holds, then count how many of the hot pages are still loaded. */
+static size_t CountHotPagesAfterScan(TCache<4096> &cache, size_t cache_size, size_t num_hot, DiskPriority scan_priority, bool dont_cache = false) {
+  for (size_t i = 0; i < num_hot; ++i) {
+    LoadHotPage(cache, i);
+  }
+  for (size_t i = 0; i < cache_size * 4; ++i) {
+    const size_t page_id = num_hot + i;
+    TCache<4096>::TSlot *data_slot;
+    TCache<4096>::TSlot *slot = cache.Get(page_id, data_slot, scan_priority, false, dont_cache);
+    cache.Release(slot, page_id, scan_priority, dont_cache);
+  }
+  size_t num_loaded = 0UL;
+  for (size_t i = 0; i < num_hot; ++i) {
+    TCache<4096>::TSlot *data_slot;
+    TCache<4096>::TSlot *slot = cache.Get(i, data_slot);
+    num_loaded += data_slot->IsLoaded() ? 1UL : 0UL;
+    cache.Release(slot, i);
+  }
+  return num_loaded;
+}
+
+FIXTURE(ScanResistance) {
+  const size_t cache_size = 1024;
+  const size_t num_hot = 128;
+  const TScheduler::TPolicy scheduler_policy(4, 10, milliseconds(10));
+  TScheduler scheduler;
+  scheduler.SetPolicy(scheduler_policy);
+  Sim::TMemEngine mem_engine(&scheduler,
+                             64 /* disk space: 64 MB */,
+                             16,
+                             4096 /* page cache slots: 1GB */,
+                             1 /* num page lru */,
+                             16 /* block cache slots: 1GB */,
+                             1 /* num block lru */);
+  /* plain LRU: a scan pushes the hot pages out */ {
+    TCache<4096> cache(mem_engine.GetVolMan(), cache_size, 1UL);
+    EXPECT_TRUE(cache.GetPolicy() == TCachePolicy::LRU);
+    EXPECT_EQ(CountHotPagesAfterScan(cache, cache_size, num_hot, RealTime), 0UL);
+  }
+  /* segmented LRU: the reused pages are protected from the scan */ {
+    TCache<4096> cache(mem_engine.GetVolMan(), cache_size, 1UL);
+    cache.SetPolicy(TCachePolicy::SegmentedLRU);
+    EXPECT_EQ(CountHotPagesAfterScan(cache, cache_size, num_hot, RealTime), num_hot);
+  }
+  /* plain LRU doesn't treat low priority reads any differently */ {
+    TCache<4096> cache(mem_engine.GetVolMan(), cache_size, 1UL);
+    EXPECT_EQ(CountHotPagesAfterScan(cache, cache_size, num_hot, Low), 0UL);
+  }
+  /* plain LRU, but the scan asks not to cache its pages, so it only recycles its own */ {
+    TCache<4096> cache(mem_engine.GetVolMan(), cache_size, 1UL);
+    EXPECT_EQ(CountHotPagesAfterScan(cache, cache_size, num_hot, RealTime, true), num_hot);
+  }
+}
+
+FIXTURE(Stats) {
+  const size_t cache_size = 64;
+  const TScheduler::TPolicy scheduler_policy(4, 10, milliseconds(10));
+  TScheduler scheduler;
+  scheduler.SetPolicy(scheduler_policy);
+  Sim::TMemEngine mem_engine(&scheduler,
+                             64 /* disk space: 64 MB */,
+                             16,
+                             4096 /* page cache slots: 1GB */,
+                             1 /* num page lru */,
+                             16 /* block cache slots: 1GB */,
+                             1 /* num block lru */);
+  TCache<4096> cache(mem_engine.GetVolMan(), cache_size, 1UL);
+  /* load twice as many pages as we have room for, then read the last of them again */
+  for (size_t i = 0; i < cache_size * 2; ++i) {
+    LoadHotPage(cache, i);
+  }
+  TCacheStats stats;
+  cache.TakeStats(stats);
+  EXPECT_EQ(stats.NumMisses, cache_size * 2);
+  EXPECT_EQ(stats.NumHits, cache_size * 2);
+  EXPECT_EQ(stats.NumEvictions, cache_size);
+  EXPECT_EQ(stats.NumLoadsInFlight, 0UL);
+  EXPECT_EQ(stats.NumWaits, 0UL);
+  /* taking the stats resets them */
+  cache.TakeStats(stats);
+  EXPECT_EQ(stats.NumMisses, 0UL);
+  EXPECT_EQ(stats.NumHits, 0UL);
+  EXPECT_EQ(stats.NumEvictions, 0UL);
+}
@@ -0,0 +1,206 @@
+/* <orly/indy/disk/util/codec.cc>
+
+   Implements <orly/indy/disk/util/codec.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/util/codec.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include <syslog.h>
+
+#include <snappy.h>
+
+#include <third_party/lz4/lz4.h>
+#include <third_party/zstd/zstd.h>
+
+using namespace std;
+using namespace Orly::Indy::Disk::Util;
+
+namespace {
+
+  /* Copies the bytes as they are. */
+  class TNoneCodec final
+      : public TCodec {
+    public:
+
+    virtual TCodecKind GetKind() const override {
+      return TCodecKind::None;
+    }
+
+    virtual const char *GetName() const override {
+      return "none";
+    }
+
+    virtual size_t GetMaxCompressedSize(size_t raw_size) const override {
+      return raw_size;
+    }
+
+    virtual size_t Compress(const char *raw, size_t raw_size, char *out) const override {
+      memcpy(out, raw, raw_size);
+      return raw_size;
+    }
+
+    virtual void Uncompress(const char *compressed, size_t compressed_size, char *out, size_t raw_size) const override {
+      if (compressed_size != raw_size) {
+        throw runtime_error("uncompressed block has the wrong size");
+      }
+      memcpy(out, compressed, raw_size);
+    }
+
+  };  // TNoneCodec
+
+  /* Wraps snappy's raw (unframed) format. */
+  class TSnappyCodec final
+      : public TCodec {
+    public:
+
+    virtual TCodecKind GetKind() const override {
+      return TCodecKind::Snappy;
+    }
+
+    virtual const char *GetName() const override {
+      return "snappy";
+    }
+
+    virtual size_t GetMaxCompressedSize(size_t raw_size) const override {
+      return snappy::MaxCompressedLength(raw_size);
+    }
+
+    virtual size_t Compress(const char *raw, size_t raw_size, char *out) const override {
+      size_t compressed_size;
+      snappy::RawCompress(raw, raw_size, out, &compressed_size);
+      return compressed_size;
+    }
+
+    virtual void Uncompress(const char *compressed, size_t compressed_size, char *out, size_t raw_size) const override {
+      size_t expected_size;
+      if (!snappy::GetUncompressedLength(compressed, compressed_size, &expected_size) || expected_size != raw_size ||
+          !snappy::RawUncompress(compressed, compressed_size, out)) {
+        syslog(LOG_ERR, "corrupt snappy block [%ld] bytes, expected [%ld] raw", compressed_size, raw_size);
+        throw runtime_error("corrupt snappy block");
+      }
+    }
+
+  };  // TSnappyCodec
+
+  /* Wraps lz4's block (unframed) format. */
+  class TLz4Codec final
+      : public TCodec {
+    public:
+
+    virtual TCodecKind GetKind() const override {
+      return TCodecKind::Lz4;
+    }
+
+    virtual const char *GetName() const override {
+      return "lz4";
+    }
+
+    virtual size_t GetMaxCompressedSize(size_t raw_size) const override {
+      assert(raw_size <= LZ4_MAX_INPUT_SIZE);
+      return LZ4_compressBound(raw_size);
+    }
+
+    virtual size_t Compress(const char *raw, size_t raw_size, char *out) const override {
+      const int compressed_size = LZ4_compress_default(raw, out, raw_size, GetMaxCompressedSize(raw_size));
+      if (compressed_size <= 0) {
+        syslog(LOG_ERR, "lz4 failed to compress [%ld] bytes", raw_size);
+        throw runtime_error("lz4 failed to compress");
+      }
+      return compressed_size;
+    }
+
+    virtual void Uncompress(const char *compressed, size_t compressed_size, char *out, size_t raw_size) const override {
+      if (LZ4_decompress_safe(compressed, out, compressed_size, raw_size) != static_cast<int>(raw_size)) {
+        syslog(LOG_ERR, "corrupt lz4 block [%ld] bytes, expected [%ld] raw", compressed_size, raw_size);
+        throw runtime_error("corrupt lz4 block");
+      }
+    }
+
+  };  // TLz4Codec
+
+  /* Wraps zstd's simple (single-frame) API. */
+  class TZstdCodec final
+      : public TCodec {
+    public:
+
+    virtual TCodecKind GetKind() const override {
+      return TCodecKind::Zstd;
+    }
+
+    virtual const char *GetName() const override {
+      return "zstd";
+    }
+
+    virtual size_t GetMaxCompressedSize(size_t raw_size) const override {
+      return ZSTD_compressBound(raw_size);
+    }
+
+    virtual size_t Compress(const char *raw, size_t raw_size, char *out) const override {
+      const size_t compressed_size = ZSTD_compress(out, GetMaxCompressedSize(raw_size), raw, raw_size, Level);
+      if (ZSTD_isError(compressed_size)) {
+        syslog(LOG_ERR, "zstd failed to compress [%ld] bytes: %s", raw_size, ZSTD_getErrorName(compressed_size));
+        throw runtime_error("zstd failed to compress");
+      }
+      return compressed_size;
+    }
+
+    virtual void Uncompress(const char *compressed, size_t compressed_size, char *out, size_t raw_size) const override {
+      const size_t actual_size = ZSTD_decompress(out, raw_size, compressed, compressed_size);
+      if (ZSTD_isError(actual_size) || actual_size != raw_size) {
+        syslog(LOG_ERR, "corrupt zstd block [%ld] bytes, expected [%ld] raw", compressed_size, raw_size);
+        throw runtime_error("corrupt zstd block");
+      }
+    }
+
+    private:
+
+    /* zstd's default level; the higher ones cost far more time than they save space on our blocks. */
+    static constexpr int Level = 3;
+
+  };  // TZstdCodec
+
+  const TNoneCodec NoneCodec {};
+  const TSnappyCodec SnappyCodec {};
+  const TLz4Codec Lz4Codec {};
+  const TZstdCodec ZstdCodec {};
+
+  /* Every codec we know, indexed by kind. */
+  const TCodec *const Codecs[] = { &NoneCodec, &SnappyCodec, &Lz4Codec, &ZstdCodec };
+
+}  // <anonymous>
+
+const TCodec *TCodec::Get(TCodecKind kind) {
+  const size_t idx = static_cast<size_t>(kind);
+  if (idx >= sizeof(Codecs) / sizeof(*Codecs)) {
+    syslog(LOG_ERR, "unknown codec kind [%ld]", idx);
+    throw runtime_error("unknown codec kind");
+  }
+  const TCodec *codec = Codecs[idx];
+  assert(codec->GetKind() == kind);
+  return codec;
+}
+
+const TCodec *TCodec::Get(const string &name) {
+  for (const TCodec *codec : Codecs) {
+    if (name == codec->GetName()) {
+      return codec;
+    }
+  }
+  throw invalid_argument("unknown codec \"" + name + "\"");
+}
@@ -0,0 +1,100 @@
+/* <orly/indy/disk/util/codec.h>
+
+   The block compression codecs data file arenas can be written with.
+
+   A codec turns a run of raw bytes into a (hopefully) shorter run and back again.  The codec is chosen per file when
+   the file is written and recorded in its meta data by kind, so a kind's number must never be reused for a different
+   codec.  Adding a codec means adding a kind, a TCodec implementation in codec.cc and a name for it.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <cassert>
+#include <string>
+
+#include <base/class_traits.h>
+
+namespace Orly {
+
+  namespace Indy {
+
+    namespace Disk {
+
+      namespace Util {
+
+        /* The codecs we know of, by the number we record on disk. */
+        enum class TCodecKind : size_t {
+
+          /* The bytes are stored as they are. */
+          None = 0UL,
+
+          /* Google's snappy: fast, with modest ratios. */
+          Snappy = 1UL,
+
+          /* LZ4's block format: faster than snappy to uncompress, with similar ratios. */
+          Lz4 = 2UL,
+
+          /* Zstandard: slower to compress, but with much better ratios for cold data. */
+          Zstd = 3UL
+
+        };  // TCodecKind
+
+        /* A block compressor.  Implementations are stateless singletons, so they may be shared across threads. */
+        class TCodec {
+          NO_COPY(TCodec);
+          public:
+
+          /* The codec of the given kind.  Throws if we don't know the kind, which means the file was written by a newer
+             version of the server. */
+          static const TCodec *Get(TCodecKind kind);
+
+          /* The codec with the given name, as given on the command line.  Throws if there's no such codec. */
+          static const TCodec *Get(const std::string &name);
+
+          /* Our kind, as recorded on disk. */
+          virtual TCodecKind GetKind() const = 0;
+
+          /* Our name, as given on the command line. */
+          virtual const char *GetName() const = 0;
+
+          /* The largest number of bytes Compress() can produce from the given number of raw bytes. */
+          virtual size_t GetMaxCompressedSize(size_t raw_size) const = 0;
+
+          /* Compress the raw bytes into the output buffer, which must hold at least GetMaxCompressedSize(raw_size)
+             bytes, and return the number of bytes written. */
+          virtual size_t Compress(const char *raw, size_t raw_size, char *out) const = 0;
+
+          /* Uncompress bytes produced by Compress() into the output buffer, which must hold exactly the raw size.
+             Throws if the bytes don't uncompress to exactly that many, which means they're corrupt. */
+          virtual void Uncompress(const char *compressed, size_t compressed_size, char *out, size_t raw_size) const = 0;
+
+          protected:
+
+          /* Do-little. */
+          TCodec() {}
+
+          /* Do-little. */
+          virtual ~TCodec() {}
+
+        };  // TCodec
+
+      }  // Util
+
+    }  // Disk
+
+  }  // Indy
+
+}  // Orly
@@ -0,0 +1,89 @@
+/* <orly/indy/disk/util/codec.test.cc>
+
+   Unit test for <orly/indy/disk/util/codec.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/util/codec.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace Orly::Indy::Disk::Util;
+
+/* Every codec we know. */
+static const TCodecKind AllKinds[] = { TCodecKind::None, TCodecKind::Snappy, TCodecKind::Lz4, TCodecKind::Zstd };
+
+/* Compress the raw bytes with the codec and return what they uncompress to. */
+static string RoundTrip(const TCodec *codec, const string &raw, size_t &compressed_size) {
+  string compressed(codec->GetMaxCompressedSize(raw.size()), '\0');
+  compressed_size = codec->Compress(raw.data(), raw.size(), &compressed[0]);
+  string out(raw.size(), '\0');
+  codec->Uncompress(compressed.data(), compressed_size, &out[0], out.size());
+  return out;
+}
+
+FIXTURE(Lookup) {
+  for (TCodecKind kind : AllKinds) {
+    const TCodec *codec = TCodec::Get(kind);
+    EXPECT_TRUE(codec->GetKind() == kind);
+    EXPECT_EQ(TCodec::Get(codec->GetName()), codec);
+  }
+  EXPECT_EQ(string(TCodec::Get(TCodecKind::Snappy)->GetName()), string("snappy"));
+  EXPECT_EQ(string(TCodec::Get(TCodecKind::Lz4)->GetName()), string("lz4"));
+  EXPECT_EQ(string(TCodec::Get(TCodecKind::Zstd)->GetName()), string("zstd"));
+  EXPECT_THROW(invalid_argument, [] { TCodec::Get("no such codec"); });
+  EXPECT_THROW(runtime_error, [] { TCodec::Get(static_cast<TCodecKind>(99UL)); });
+}
+
+FIXTURE(RoundTrip) {
+  string raw;
+  for (size_t i = 0; raw.size() < 65536UL; ++i) {
+    raw += string(64UL, static_cast<char>('a' + i % 7));
+  }
+  for (TCodecKind kind : AllKinds) {
+    const TCodec *codec = TCodec::Get(kind);
+    size_t compressed_size;
+    EXPECT_EQ(RoundTrip(codec, raw, compressed_size), raw);
+    EXPECT_LE(compressed_size, codec->GetMaxCompressedSize(raw.size()));
+    size_t empty_size;
+    EXPECT_EQ(RoundTrip(codec, string(), empty_size), string());
+  }
+  for (TCodecKind kind : { TCodecKind::Snappy, TCodecKind::Lz4, TCodecKind::Zstd }) {
+    size_t compressed_size;
+    RoundTrip(TCodec::Get(kind), raw, compressed_size);
+    EXPECT_LT(compressed_size, raw.size());
+  }
+}
+
+FIXTURE(Corrupt) {
+  const string raw(4096UL, 'x');
+  string out(raw.size(), '\0');
+  for (TCodecKind kind : { TCodecKind::Snappy, TCodecKind::Lz4, TCodecKind::Zstd }) {
+    const TCodec *codec = TCodec::Get(kind);
+    string compressed(codec->GetMaxCompressedSize(raw.size()), '\0');
+    const size_t compressed_size = codec->Compress(raw.data(), raw.size(), &compressed[0]);
+    /* asking for the wrong raw size is as bad as a damaged block */
+    auto wrong_size = [&] { codec->Uncompress(compressed.data(), compressed_size, &out[0], raw.size() - 1UL); };
+    EXPECT_THROW_FUNC(runtime_error, wrong_size);
+    auto truncated = [&] { codec->Uncompress(compressed.data(), compressed_size / 2UL, &out[0], raw.size()); };
+    EXPECT_THROW_FUNC(runtime_error, truncated);
+  }
+  auto short_raw = [&] { TCodec::Get(TCodecKind::None)->Uncompress(raw.data(), raw.size() - 1UL, &out[0], raw.size()); };
+  EXPECT_THROW_FUNC(runtime_error, short_raw);
+}
@@ -48,7 +48,8 @@ namespace Orly {
                       size_t num_block_lru,
                       size_t append_log_mb,
                       bool create = false,
-                      bool no_realtime = false)
+                      bool no_realtime = false,
+                      TDiskBackend disk_backend = TDiskBackend::Aio)
             : Scheduler(scheduler),
               SystemBlockId(0UL),
               FileAppendLogBlocks((append_log_mb * 1024 * 1024) / Util::PhysicalBlockSize) {
@@ -124,7 +125,7 @@ namespace Orly {
                 }
               }
             };
-            DiskController = std::make_unique<TDiskController>();
+            DiskController = std::make_unique<TDiskController>(disk_backend);
             DiskUtil = std::make_unique<TDiskUtil>(scheduler, DiskController.get(), instance_name, do_fsync, CacheCb, true);
             VolMan = DiskUtil->GetVolumeManager(instance_name);
             std::vector<std::vector<TPersistentDevice *>> device_vec;
@@ -143,6 +144,9 @@ namespace Orly {
 
             PageCache = std::make_unique<Util::TPageCache>(VolMan, page_cache_size, num_page_lru);
             BlockCache = std::make_unique<Util::TBlockCache>(VolMan, block_cache_size, num_block_lru);
+            DiskController->RegisterBuffers({
+                { PageCache->GetPageData(), PageCache->GetPageDataSize() },
+                { BlockCache->GetPageData(), BlockCache->GetPageDataSize() }});
 
             std::unique_ptr<const TBufBlock> buf_block(new TBufBlock());
             memset(buf_block->GetData(), 0, PhysicalBlockSize);
@@ -232,7 +236,7 @@ namespace Orly {
                                          file_length);
 
 
-                  TDataFileReader::TInStream in_stream(HERE, Source::System, RealTime, &reader, PageCache.get(), (reader.GetStartingBlockOffset() * Disk::Util::LogicalBlockSize) + (TData::NumMetaFields * sizeof(size_t)));
+                  TDataFileReader::TInStream in_stream(HERE, Source::System, RealTime, &reader, PageCache.get(), (reader.GetStartingBlockOffset() * Disk::Util::LogicalBlockSize) + (reader.GetNumMetaFields() * sizeof(size_t)));
                   size_t block_id;
                   for (size_t i = 0; i < reader.GetNumMetaBlocks(); ++i) {
                     in_stream.Read(block_id);
@@ -342,6 +346,7 @@ namespace Orly {
             /* TODO */
             using TReadFile::GetStartingBlockOffset;
             using TReadFile::GetNumBlocks;
+            using TReadFile::GetNumMetaFields;
             using TReadFile::GetNumMetaBlocks;
             using TReadFile::GetNumSequentialBlockPairings;
             using TReadFile::GetNumUpdates;
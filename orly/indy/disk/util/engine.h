@@ -21,7 +21,10 @@
 #include <base/class_traits.h>
 #include <base/uuid.h>
 #include <orly/indy/disk/file_service_base.h>
+#include <orly/indy/disk/util/bloom_filter.h>
 #include <orly/indy/disk/util/cache.h>
+#include <orly/indy/disk/util/codec.h>
+#include <orly/indy/disk/util/hash_util.h>
 #include <orly/indy/disk/util/volume_manager.h>
 #include <orly/indy/util/block_vec.h>
 
@@ -52,7 +55,10 @@ namespace Orly {
                 PageCache(page_cache),
                 BlockCache(block_cache),
                 FileService(file_service),
-                IsDiskBasedEngine(is_disk_engine) {}
+                IsDiskBasedEngine(is_disk_engine),
+                BloomFilterBitsPerKey(TBloomFilter::DefaultBitsPerKey),
+                HashIndexVersion(DefaultHashIndexVersion),
+                DataFileCodec(TCodec::Get(TCodecKind::None)) {}
 
           /* TODO */
           ~TEngine() {}
@@ -186,6 +192,45 @@ namespace Orly {
             return IsDiskBasedEngine;
           }
 
+          /* The number of bloom filter bits spent per key in each index segment of newly written data files. */
+          inline size_t GetBloomFilterBitsPerKey() const {
+            assert(this);
+            return BloomFilterBitsPerKey;
+          }
+
+          /* Change the bloom filter bits per key used for new data files.  Zero disables the filters. Existing files
+             keep whatever filter they were written with. */
+          inline void SetBloomFilterBitsPerKey(size_t bits_per_key) {
+            assert(this);
+            BloomFilterBitsPerKey = bits_per_key;
+          }
+
+          /* The format of the hash indexes in newly written data files.  Readers handle every format. */
+          inline size_t GetHashIndexVersion() const {
+            assert(this);
+            return HashIndexVersion;
+          }
+
+          /* Change the format of the hash indexes in newly written data files. */
+          inline void SetHashIndexVersion(size_t version) {
+            assert(this);
+            assert(version == LinearProbeHashIndex || version == BucketedHashIndex);
+            HashIndexVersion = version;
+          }
+
+          /* The codec the arenas of newly written data files are compressed with.  Readers handle every codec. */
+          inline const TCodec *GetDataFileCodec() const {
+            assert(this);
+            return DataFileCodec;
+          }
+
+          /* Change the codec the arenas of newly written data files are compressed with. */
+          inline void SetDataFileCodec(const TCodec *codec) {
+            assert(this);
+            assert(codec);
+            DataFileCodec = codec;
+          }
+
           private:
 
           /* TODO */
@@ -216,6 +261,15 @@ namespace Orly {
           /* TODO */
           bool IsDiskBasedEngine;
 
+          /* See accessor. */
+          size_t BloomFilterBitsPerKey;
+
+          /* See accessor. */
+          size_t HashIndexVersion;
+
+          /* See accessor. */
+          const TCodec *DataFileCodec;
+
         };  // TEngine
 
         template <>
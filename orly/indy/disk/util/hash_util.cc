@@ -109,3 +109,12 @@ size_t Orly::Indy::Disk::Util::SuggestGeneration(size_t num_keys) {
   auto upper = GenSizeSet.upper_bound(num_keys);
   return *upper;
 }
+
+size_t Orly::Indy::Disk::Util::SuggestNumHashBuckets(size_t num_keys) {
+  return max(1UL, static_cast<size_t>(ceil(num_keys / (THashBucket::NumSlots * MaximumBucketLoadFactor))));
+}
+
+size_t Orly::Indy::Disk::Util::GetBucketedHashIndexSize(size_t num_buckets, size_t num_keys, size_t entry_size) {
+  const size_t num_bytes = num_buckets * sizeof(THashBucket) + num_keys * entry_size;
+  return ((num_bytes + sizeof(THashBucket) - 1UL) / sizeof(THashBucket)) * sizeof(THashBucket);
+}
@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <set>
 #include <unistd.h>
 
@@ -46,6 +49,188 @@ namespace Orly {
         /* TODO */
         size_t SuggestGeneration(size_t num_keys);
 
+        /* The on-disk hash index formats.  A linear probe index is an open-addressed array of (core, offset) entries.  A
+           bucketed index is an array of cache-line sized THashBuckets followed by a dense array of (core, offset) entries
+           in bucket order. */
+        constexpr size_t LinearProbeHashIndex = 1UL;
+        constexpr size_t BucketedHashIndex = 2UL;
+
+        /* The format we write unless told otherwise. */
+        constexpr size_t DefaultHashIndexVersion = BucketedHashIndex;
+
+        /* Key hashes are not guaranteed to be well mixed (small integers hash to themselves), so we run them through a
+           finalizer before picking a bucket or a fingerprint. */
+        inline size_t MixHash(size_t hash) {
+          hash ^= hash >> 33;
+          hash *= 0xff51afd7ed558ccdUL;
+          hash ^= hash >> 33;
+          hash *= 0xc4ceb9fe1a85ec53UL;
+          hash ^= hash >> 33;
+          return hash;
+        }
+
+        /* The bucket in which a lookup for the given key hash starts. */
+        inline size_t GetHomeBucket(size_t hash, size_t num_home_buckets) {
+          assert(num_home_buckets);
+          return MixHash(hash) % num_home_buckets;
+        }
+
+        /* The 32-bit fingerprint stored in a bucket slot.  Never zero, as zero marks an empty slot. */
+        inline uint32_t GetHashFingerprint(size_t hash) {
+          const uint32_t fingerprint = static_cast<uint32_t>(MixHash(hash) >> 32);
+          return fingerprint ? fingerprint : 1U;
+        }
+
+        /* One cache line of a bucketed hash index.  Slots are filled in order, so the first empty slot ends the bucket.  A
+           lookup reads its home bucket and compares fingerprints; only on a fingerprint match does it read the full entry
+           to compare the key.  If the home bucket is full, the lookup moves on to the next bucket and stops at the first
+           bucket with an empty slot.  The writer guarantees that the last bucket always has an empty slot. */
+        class THashBucket {
+          public:
+
+          /* The number of entries per bucket. */
+          static constexpr size_t NumSlots = 8UL;
+
+          /* An empty bucket. */
+          THashBucket() {
+            Clear();
+          }
+
+          /* Empty the bucket. */
+          void Clear() {
+            assert(this);
+            memset(Fingerprints, 0, sizeof(Fingerprints));
+            memset(Entries, 0, sizeof(Entries));
+          }
+
+          /* True iff. every slot is used. */
+          bool IsFull() const {
+            assert(this);
+            return Fingerprints[NumSlots - 1] != 0U;
+          }
+
+          /* True iff. no slot is used. */
+          bool IsEmpty() const {
+            assert(this);
+            return Fingerprints[0] == 0U;
+          }
+
+          /* Fill the next free slot.  The bucket must not be full. */
+          void Add(uint32_t fingerprint, uint32_t entry) {
+            assert(this);
+            assert(fingerprint);
+            for (size_t i = 0; i < NumSlots; ++i) {
+              if (!Fingerprints[i]) {
+                Fingerprints[i] = fingerprint;
+                Entries[i] = entry;
+                return;
+              }
+            }
+            assert(false);
+          }
+
+          /* The fingerprints of the keys in this bucket.  Zero for an unused slot. */
+          uint32_t Fingerprints[NumSlots];
+
+          /* The position of each key's entry in the entry array. */
+          uint32_t Entries[NumSlots];
+
+        };  // THashBucket
+
+        static_assert(sizeof(THashBucket) == 64UL, "THashBucket must be exactly one cache line");
+
+        /* Assigns keys to buckets as the writer streams them out in order of home bucket.  A key goes into its home bucket
+           if there's room, otherwise into the first bucket after it that has room. */
+        class THashBucketPlacer {
+          public:
+
+          /* TODO */
+          THashBucketPlacer()
+              : CurBucket(0UL), NumInCur(0UL) {}
+
+          /* Returns the bucket into which the next key goes.  Keys must be placed in non-decreasing order of home
+             bucket. */
+          size_t Place(size_t home_bucket) {
+            assert(this);
+            if (home_bucket > CurBucket) {
+              CurBucket = home_bucket;
+              NumInCur = 0UL;
+            } else if (NumInCur == THashBucket::NumSlots) {
+              ++CurBucket;
+              NumInCur = 0UL;
+            }
+            ++NumInCur;
+            return CurBucket;
+          }
+
+          /* The total number of buckets required to hold the keys placed so far, including any overflow buckets past the
+             home buckets. */
+          size_t GetNumBuckets(size_t num_home_buckets) const {
+            assert(this);
+            /* the last bucket must have an empty slot to stop lookups from running off the end */
+            return std::max(num_home_buckets, CurBucket + (NumInCur == THashBucket::NumSlots ? 2UL : 1UL));
+          }
+
+          private:
+
+          /* The bucket we're currently filling. */
+          size_t CurBucket;
+
+          /* The number of keys in CurBucket. */
+          size_t NumInCur;
+
+        };  // THashBucketPlacer
+
+        /* The total number of buckets (home plus overflow) a bucketed hash index needs.  'csr' must yield objects whose
+           Hash is their home bucket, in non-decreasing order. */
+        template <typename TCursor>
+        size_t CountHashBuckets(TCursor &csr, size_t num_home_buckets) {
+          THashBucketPlacer placer;
+          for (; csr; ++csr) {
+            placer.Place((*csr).Hash);
+          }
+          return placer.GetNumBuckets(num_home_buckets);
+        }
+
+        /* Stream out a bucketed hash index.  'csr' must yield objects whose Hash is their home bucket, in non-decreasing
+           order, whose Core carries the stored key hash and whose Offset is the key's position in the file.  The buckets
+           go to 'bucket_stream' and the (core, offset) entries to 'entry_stream'. */
+        template <typename TCursor, typename TOutStream>
+        void WriteBucketedHashIndex(TCursor &csr, size_t num_buckets, TOutStream &bucket_stream, TOutStream &entry_stream) {
+          THashBucketPlacer placer;
+          THashBucket bucket;
+          size_t bucket_in_buf = 0UL;
+          uint32_t entry = 0U;
+          for (; csr; ++csr) {
+            const auto &obj = *csr;
+            const size_t pos = placer.Place(obj.Hash);
+            assert(pos < num_buckets);
+            for (; bucket_in_buf < pos; ++bucket_in_buf) {
+              bucket_stream.Write(&bucket, sizeof(bucket));
+              bucket.Clear();
+            }
+            bucket.Add(GetHashFingerprint(obj.Core.ForceGetStoredHash()), entry);
+            ++entry;
+            entry_stream.Write(&obj.Core, sizeof(obj.Core));
+            entry_stream << obj.Offset;
+          }
+          for (; bucket_in_buf < num_buckets; ++bucket_in_buf) {
+            bucket_stream.Write(&bucket, sizeof(bucket));
+            bucket.Clear();
+          }
+        }
+
+        /* The fraction of bucket slots we fill.  This is lower than MaximumLoadFactor so that only a few percent of keys
+           spill out of their home bucket. */
+        constexpr double MaximumBucketLoadFactor = 0.6;
+
+        /* The number of home buckets to use for the given number of keys. */
+        size_t SuggestNumHashBuckets(size_t num_keys);
+
+        /* The number of bytes a bucketed hash index occupies, given its total number of buckets and keys.  This is always
+           a multiple of the bucket size so that the following index stays cache line aligned. */
+        size_t GetBucketedHashIndexSize(size_t num_buckets, size_t num_keys, size_t entry_size);
+
       }  // Util
 
     }  // Disk
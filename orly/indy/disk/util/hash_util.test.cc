@@ -0,0 +1,96 @@
+/* <orly/indy/disk/util/hash_util.test.cc>
+
+   Unit test for <orly/indy/disk/util/hash_util.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/util/hash_util.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace Orly::Indy::Disk::Util;
+
+FIXTURE(SuggestHashSize) {
+  EXPECT_EQ(SuggestHashSize(0UL), 97UL);
+  EXPECT_GE(SuggestHashSize(1000UL), static_cast<size_t>(1000UL / MaximumLoadFactor));
+}
+
+FIXTURE(Bucket) {
+  THashBucket bucket;
+  EXPECT_TRUE(bucket.IsEmpty());
+  EXPECT_FALSE(bucket.IsFull());
+  for (size_t i = 0; i < THashBucket::NumSlots; ++i) {
+    bucket.Add(GetHashFingerprint(i), i);
+    EXPECT_FALSE(bucket.IsEmpty());
+  }
+  EXPECT_TRUE(bucket.IsFull());
+  for (size_t i = 0; i < THashBucket::NumSlots; ++i) {
+    EXPECT_EQ(bucket.Fingerprints[i], GetHashFingerprint(i));
+    EXPECT_EQ(bucket.Entries[i], i);
+  }
+  bucket.Clear();
+  EXPECT_TRUE(bucket.IsEmpty());
+}
+
+FIXTURE(Fingerprint) {
+  size_t zeros = 0UL;
+  for (size_t i = 0; i < 100000UL; ++i) {
+    zeros += GetHashFingerprint(i) ? 0UL : 1UL;
+  }
+  EXPECT_EQ(zeros, 0UL);
+}
+
+FIXTURE(Placer) {
+  THashBucketPlacer placer;
+  /* a full home bucket spills into the next one */
+  for (size_t i = 0; i < THashBucket::NumSlots; ++i) {
+    EXPECT_EQ(placer.Place(0UL), 0UL);
+  }
+  EXPECT_EQ(placer.Place(0UL), 1UL);
+  EXPECT_EQ(placer.Place(1UL), 1UL);
+  EXPECT_EQ(placer.Place(5UL), 5UL);
+  EXPECT_EQ(placer.GetNumBuckets(10UL), 10UL);
+  /* the last bucket must keep a free slot */
+  for (size_t i = 1; i < THashBucket::NumSlots; ++i) {
+    EXPECT_EQ(placer.Place(9UL), 9UL);
+  }
+  EXPECT_EQ(placer.GetNumBuckets(10UL), 10UL);
+  EXPECT_EQ(placer.Place(9UL), 9UL);
+  EXPECT_EQ(placer.GetNumBuckets(10UL), 11UL);
+}
+
+FIXTURE(Load) {
+  /* place a realistic number of keys and make sure hardly any of them leave their home bucket */
+  const size_t num_keys = 100000UL;
+  const size_t num_home_buckets = SuggestNumHashBuckets(num_keys);
+  vector<size_t> home_vec;
+  for (size_t i = 0; i < num_keys; ++i) {
+    home_vec.push_back(GetHomeBucket(i, num_home_buckets));
+  }
+  sort(home_vec.begin(), home_vec.end());
+  THashBucketPlacer placer;
+  size_t displaced = 0UL;
+  for (size_t home : home_vec) {
+    displaced += (placer.Place(home) != home) ? 1UL : 0UL;
+  }
+  EXPECT_LT(displaced, num_keys / 25UL);
+  EXPECT_LE(placer.GetNumBuckets(num_home_buckets), num_home_buckets + 8UL);
+  EXPECT_EQ(GetBucketedHashIndexSize(3UL, 5UL, 24UL) % sizeof(THashBucket), 0UL);
+  EXPECT_EQ(GetBucketedHashIndexSize(3UL, 8UL, 24UL), 3UL * 64UL + 192UL);
+}
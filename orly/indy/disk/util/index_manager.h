@@ -212,9 +212,8 @@ namespace Orly {
             return Size;
           }
 
-          private:
-
-          /* TODO */
+          /* Sorts the in-memory buffer if needed. Constructing a cursor does this lazily; call it first when cursors
+             will be opened on more than one runner at once. */
           void SortMem() {
             assert(this);
             if (!MemSorted) {
@@ -228,6 +227,8 @@ namespace Orly {
             }
           }
 
+          private:
+
           /* TODO */
           void ConsolidateGeneration(size_t gen, size_t num) {
             assert(this);
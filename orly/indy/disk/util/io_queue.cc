@@ -0,0 +1,423 @@
+/* <orly/indy/disk/util/io_queue.cc>
+
+   Implements <orly/indy/disk/util/io_queue.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/util/io_queue.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <base/fd.h>
+#include <util/error.h>
+
+using namespace std;
+using namespace Orly::Indy::Disk::Util;
+
+namespace {
+
+  /* Linux native AIO. */
+  class TAioQueue final
+      : public TIoQueue {
+    public:
+
+    /* See TIoQueue::New(). */
+    TAioQueue(size_t depth)
+        : Ctx(0) {
+      try {
+        ::Util::IfWeird(io_setup(depth, &Ctx));
+      } catch (const std::exception &ex) {
+        syslog(LOG_ERR, "Error in io_setup: [%s]", ex.what());
+        throw;
+      }
+    }
+
+    virtual ~TAioQueue() {
+      io_destroy(Ctx);
+    }
+
+    virtual TDiskBackend GetBackend() const override {
+      return TDiskBackend::Aio;
+    }
+
+    virtual void Submit(struct iocb **iocbs, size_t num_iocbs) override {
+      assert(this);
+      int ret = io_submit(Ctx, num_iocbs, iocbs);
+      if (ret < 0) {
+        syslog(LOG_ERR, "Error in io_submit; nr=[%ld]", num_iocbs);
+        for (size_t nr = 0; nr < num_iocbs; ++nr) {
+          switch (iocbs[nr]->aio_lio_opcode) {
+            case IO_CMD_PREAD: {
+              syslog(LOG_INFO, "ioq[%ld] IO_CMD_PREAD, offset=[%lld], nbytes=[%ld]", nr, iocbs[nr]->u.c.offset, iocbs[nr]->u.c.nbytes);
+              break;
+            }
+            case IO_CMD_PWRITE: {
+              syslog(LOG_INFO, "ioq[%ld] IO_CMD_PWRITE, offset=[%lld], nbytes=[%ld]", nr, iocbs[nr]->u.c.offset, iocbs[nr]->u.c.nbytes);
+              break;
+            }
+            case IO_CMD_PREADV: {
+              syslog(LOG_INFO, "ioq[%ld] IO_CMD_PREADV, nr=[%d], offset=[%lld], size=[%ld]", nr, iocbs[nr]->u.v.nr, iocbs[nr]->u.v.offset, iocbs[nr]->u.v.vec[0].iov_len);
+              break;
+            }
+            case IO_CMD_PWRITEV: {
+              syslog(LOG_INFO, "ioq[%ld] IO_CMD_PWRITEV, nr=[%d], offset=[%lld], size=[%ld]", nr, iocbs[nr]->u.v.nr, iocbs[nr]->u.v.offset, iocbs[nr]->u.v.vec[0].iov_len);
+              break;
+            }
+            default: {
+              syslog(LOG_INFO, "ioq[%ld] unexpected opcode [%d]", nr, iocbs[nr]->aio_lio_opcode);
+              break;
+            }
+          }
+        }
+        ::Util::ThrowSystemError(-ret);
+      }
+      if (ret != static_cast<int>(num_iocbs)) {
+        syslog(LOG_ERR, "io_submit did not sumbit as as many events as requested [%ld] vs. [%d]", num_iocbs, ret);
+        throw std::runtime_error("io_submit did not submit every event");
+      }
+    }
+
+    virtual size_t Reap(struct io_event *events, size_t max_events, size_t min_events) override {
+      assert(this);
+      int ret = io_getevents(Ctx, min_events, max_events, events, nullptr);
+      if (ret < 0) {
+        if (ret == -EINTR) {
+          return 0UL;
+        }
+        ::Util::ThrowSystemError(-ret);
+      }
+      return ret;
+    }
+
+    private:
+
+    /* Our kernel aio context. */
+    io_context_t Ctx;
+
+  };  // TAioQueue
+
+  /* io_uring, with one submission queue entry per iocb. */
+  class TUringQueue final
+      : public TIoQueue {
+    public:
+
+    /* See TIoQueue::New().  Throws std::system_error if the kernel doesn't do io_uring, or doesn't do the operations
+       we need. */
+    TUringQueue(size_t depth)
+        : ToSubmit(0U), SqPtr(MAP_FAILED), SqSize(0UL), CqPtr(MAP_FAILED), CqSize(0UL), Sqes(static_cast<struct io_uring_sqe *>(MAP_FAILED)), SqesSize(0UL) {
+      struct io_uring_params params;
+      memset(&params, 0, sizeof(params));
+      #ifdef __NR_io_uring_setup
+      Fd = syscall(__NR_io_uring_setup, depth, &params);
+      #else
+      errno = ENOSYS;
+      Fd = -1;
+      #endif
+      try {
+        CheckOps();
+        SqSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+        CqSize = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+          SqSize = CqSize = std::max(SqSize, CqSize);
+        }
+        SqPtr = Map(SqSize, IORING_OFF_SQ_RING);
+        CqPtr = single_mmap ? SqPtr : Map(CqSize, IORING_OFF_CQ_RING);
+        SqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        Sqes = static_cast<struct io_uring_sqe *>(Map(SqesSize, IORING_OFF_SQES));
+      } catch (...) {
+        Unmap();
+        throw;
+      }
+      char *sq = static_cast<char *>(SqPtr);
+      SqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+      SqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+      SqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+      SqEntries = params.sq_entries;
+      /* we always fill the entries in ring order, so the index array never changes */
+      unsigned *sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+      for (unsigned i = 0; i < SqEntries; ++i) {
+        sq_array[i] = i;
+      }
+      char *cq = static_cast<char *>(CqPtr);
+      CqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+      CqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+      CqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+      Cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    virtual ~TUringQueue() {
+      Unmap();
+    }
+
+    virtual TDiskBackend GetBackend() const override {
+      return TDiskBackend::IoUring;
+    }
+
+    virtual void Submit(struct iocb **iocbs, size_t num_iocbs) override {
+      assert(this);
+      for (size_t i = 0; i < num_iocbs; ++i) {
+        unsigned tail = *SqTail;
+        if (tail - __atomic_load_n(SqHead, __ATOMIC_ACQUIRE) == SqEntries) {
+          /* the ring is full; push what we have into the kernel to make room */
+          Enter(0U, 0U);
+          tail = *SqTail;
+        }
+        struct io_uring_sqe *sqe = &Sqes[tail & SqMask];
+        Prep(sqe, iocbs[i]);
+        __atomic_store_n(SqTail, tail + 1U, __ATOMIC_RELEASE);
+        ++ToSubmit;
+      }
+    }
+
+    virtual size_t Reap(struct io_event *events, size_t max_events, size_t min_events) override {
+      assert(this);
+      size_t num_reaped = ReapReady(events, max_events);
+      if (ToSubmit || num_reaped < min_events) {
+        /* one syscall submits everything queued since the last reap and waits for whatever we're still short of */
+        Enter(num_reaped < min_events ? min_events - num_reaped : 0U, IORING_ENTER_GETEVENTS);
+        num_reaped += ReapReady(events + num_reaped, max_events - num_reaped);
+      }
+      return num_reaped;
+    }
+
+    private:
+
+    virtual bool RegisterBuffers(const std::vector<struct iovec> &regions) override {
+      assert(this);
+      assert(Regions.empty());
+      /* an I/O which straddles two pieces just doesn't use a fixed buffer; see Prep() */
+      std::vector<struct iovec> pieces = SplitBufferRegions(regions, MaxRegisteredBufferSize);
+      #ifdef __NR_io_uring_register
+      if (syscall(__NR_io_uring_register, static_cast<int>(Fd), IORING_REGISTER_BUFFERS, pieces.data(), pieces.size()) < 0) {
+        syslog(LOG_WARNING, "io_uring could not register [%ld] buffers: %s", pieces.size(), strerror(errno));
+        return false;
+      }
+      Regions = std::move(pieces);
+      return true;
+      #else
+      syslog(LOG_WARNING, "io_uring could not register [%ld] buffers: built without io_uring_register", pieces.size());
+      return false;
+      #endif
+    }
+
+    /* Make sure the kernel knows every opcode Prep() might use. */
+    void CheckOps() {
+      static constexpr size_t MaxOps = 256UL;
+      std::unique_ptr<char[]> buf(new char[sizeof(struct io_uring_probe) + (MaxOps * sizeof(struct io_uring_probe_op))]());
+      struct io_uring_probe *probe = reinterpret_cast<struct io_uring_probe *>(buf.get());
+      #ifdef __NR_io_uring_register
+      ::Util::IfLt0(syscall(__NR_io_uring_register, static_cast<int>(Fd), IORING_REGISTER_PROBE, probe, MaxOps));
+      #endif
+      for (int op : { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READV, IORING_OP_WRITEV, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED }) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+          ::Util::ThrowSystemError(EOPNOTSUPP);
+        }
+      }
+    }
+
+    /* Map one of the ring's regions. */
+    void *Map(size_t size, off_t offset) {
+      void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd, offset);
+      if (ptr == MAP_FAILED) {
+        ::Util::ThrowSystemError(errno);
+      }
+      return ptr;
+    }
+
+    /* Undo whatever Map()s succeeded. */
+    void Unmap() {
+      if (Sqes != MAP_FAILED) {
+        munmap(Sqes, SqesSize);
+      }
+      if (CqPtr != MAP_FAILED && CqPtr != SqPtr) {
+        munmap(CqPtr, CqSize);
+      }
+      if (SqPtr != MAP_FAILED) {
+        munmap(SqPtr, SqSize);
+      }
+    }
+
+    /* Translate the iocb into the submission queue entry.  Single-buffer I/O to or from a registered region uses the
+       fixed-buffer form. */
+    void Prep(struct io_uring_sqe *sqe, struct iocb *io) {
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->fd = io->aio_fildes;
+      sqe->user_data = reinterpret_cast<__u64>(io);
+      switch (io->aio_lio_opcode) {
+        case IO_CMD_PREAD:
+        case IO_CMD_PWRITE: {
+          const bool is_read = io->aio_lio_opcode == IO_CMD_PREAD;
+          sqe->opcode = is_read ? IORING_OP_READ : IORING_OP_WRITE;
+          sqe->addr = reinterpret_cast<__u64>(io->u.c.buf);
+          sqe->len = io->u.c.nbytes;
+          sqe->off = io->u.c.offset;
+          const char *start = static_cast<const char *>(io->u.c.buf);
+          for (size_t i = 0; i < Regions.size(); ++i) {
+            const char *base = static_cast<const char *>(Regions[i].iov_base);
+            if (start >= base && start + io->u.c.nbytes <= base + Regions[i].iov_len) {
+              sqe->opcode = is_read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+              sqe->buf_index = i;
+              break;
+            }
+          }
+          break;
+        }
+        case IO_CMD_PREADV:
+        case IO_CMD_PWRITEV: {
+          sqe->opcode = (io->aio_lio_opcode == IO_CMD_PREADV) ? IORING_OP_READV : IORING_OP_WRITEV;
+          sqe->addr = reinterpret_cast<__u64>(io->u.v.vec);
+          sqe->len = io->u.v.nr;
+          sqe->off = io->u.v.offset;
+          break;
+        }
+        default: {
+          syslog(LOG_ERR, "io_uring can't submit iocb opcode [%d]", io->aio_lio_opcode);
+          throw std::logic_error("unsupported iocb opcode");
+        }
+      }
+    }
+
+    /* Submit everything queued, and wait for the given number of completions if the flags say to. */
+    void Enter(unsigned min_complete, unsigned flags) {
+      for (;;) {
+        #ifdef __NR_io_uring_enter
+        const long ret = syscall(__NR_io_uring_enter, static_cast<int>(Fd), ToSubmit, min_complete, flags, nullptr, 0UL);
+        #else
+        errno = ENOSYS;
+        const long ret = -1;
+        #endif
+        if (ret < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          syslog(LOG_ERR, "Error in io_uring_enter; to_submit=[%u]: %s", ToSubmit, strerror(errno));
+          ::Util::ThrowSystemError(errno);
+        }
+        assert(static_cast<unsigned>(ret) <= ToSubmit);
+        ToSubmit -= ret;
+        if (!ToSubmit) {
+          break;
+        }
+        /* the kernel took only some of them; we've already waited, if we were going to */
+        min_complete = 0U;
+      }
+    }
+
+    /* Move whatever completions are ready, up to the given max, into the events. */
+    size_t ReapReady(struct io_event *events, size_t max_events) {
+      unsigned head = *CqHead;
+      const unsigned tail = __atomic_load_n(CqTail, __ATOMIC_ACQUIRE);
+      size_t num_reaped = 0UL;
+      for (; head != tail && num_reaped < max_events; ++head, ++num_reaped) {
+        const struct io_uring_cqe &cqe = Cqes[head & CqMask];
+        struct iocb *io = reinterpret_cast<struct iocb *>(cqe.user_data);
+        struct io_event &event = events[num_reaped];
+        event.data = io->data;
+        event.obj = io;
+        event.res = static_cast<unsigned long>(static_cast<long>(cqe.res));
+        event.res2 = 0UL;
+      }
+      __atomic_store_n(CqHead, head, __ATOMIC_RELEASE);
+      return num_reaped;
+    }
+
+    /* The ring. */
+    Base::TFd Fd;
+
+    /* Entries we've queued which the kernel hasn't taken yet. */
+    unsigned ToSubmit;
+
+    /* The mapped submission and completion rings and submission entries. */
+    void *SqPtr;
+    size_t SqSize;
+    void *CqPtr;
+    size_t CqSize;
+    struct io_uring_sqe *Sqes;
+    size_t SqesSize;
+
+    /* The submission ring. */
+    unsigned *SqHead;
+    unsigned *SqTail;
+    unsigned SqMask;
+    unsigned SqEntries;
+
+    /* The completion ring. */
+    unsigned *CqHead;
+    unsigned *CqTail;
+    unsigned CqMask;
+    struct io_uring_cqe *Cqes;
+
+    /* The registered buffers, in the order we registered them. */
+    std::vector<struct iovec> Regions;
+
+  };  // TUringQueue
+
+}  // <anonymous>
+
+TDiskBackend Orly::Indy::Disk::Util::GetDiskBackend(const string &name) {
+  if (name == "aio") {
+    return TDiskBackend::Aio;
+  }
+  if (name == "io_uring") {
+    return TDiskBackend::IoUring;
+  }
+  throw invalid_argument("unknown disk backend \"" + name + "\"");
+}
+
+const char *Orly::Indy::Disk::Util::GetDiskBackendName(TDiskBackend backend) {
+  switch (backend) {
+    case TDiskBackend::Aio: {
+      return "aio";
+    }
+    case TDiskBackend::IoUring: {
+      return "io_uring";
+    }
+  }
+  throw invalid_argument("unknown disk backend");
+}
+
+vector<struct iovec> Orly::Indy::Disk::Util::SplitBufferRegions(const vector<struct iovec> &regions, size_t max_size) {
+  assert(max_size);
+  vector<struct iovec> pieces;
+  for (const auto &region : regions) {
+    char *base = static_cast<char *>(region.iov_base);
+    for (size_t offset = 0; offset < region.iov_len; offset += max_size) {
+      pieces.push_back({ base + offset, min(region.iov_len - offset, max_size) });
+    }
+  }
+  return pieces;
+}
+
+unique_ptr<TIoQueue> TIoQueue::New(TDiskBackend backend, size_t depth) {
+  if (backend == TDiskBackend::IoUring) {
+    try {
+      return unique_ptr<TIoQueue>(new TUringQueue(depth));
+    } catch (const system_error &ex) {
+      syslog(LOG_WARNING, "io_uring is not available (%s); falling back to aio", ex.what());
+    }
+  }
+  return unique_ptr<TIoQueue>(new TAioQueue(depth));
+}
@@ -0,0 +1,139 @@
+/* <orly/indy/disk/util/io_queue.h>
+
+   The kernel interfaces a disk controller submits I/O through.
+
+   A TIoQueue takes libaio iocbs, which is how TDiskController::TEvent describes its I/O, and hands back io_events, so
+   the controller's completion logic doesn't care which backend it runs on.  There are two backends:
+
+     aio:      Linux native AIO.  Every submit and every reap is a syscall of its own.
+     io_uring: Submissions are queued in a ring shared with the kernel and go in, along with the wait for completions,
+               in a single io_uring_enter().  Completions are read straight out of the shared ring.  Reads and writes of
+               buffers which have been registered with the ring (the page and block cache memory) skip the per-I/O
+               page pinning.
+
+   io_uring is driven through its raw syscalls, so we don't need liburing.  If the kernel doesn't have io_uring (or
+   it's been locked down), asking for it gets you aio instead.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <cassert>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <libaio.h>
+#include <sys/uio.h>
+
+#include <base/class_traits.h>
+
+namespace Orly {
+
+  namespace Indy {
+
+    namespace Disk {
+
+      namespace Util {
+
+        /* The kernel interfaces we know how to submit I/O through.  See the comment at the top of this file. */
+        enum class TDiskBackend {
+          Aio,
+          IoUring
+        };
+
+        /* The backend with the given name, as given on the command line: "aio" or "io_uring".  Throws if there's no such
+           backend. */
+        TDiskBackend GetDiskBackend(const std::string &name);
+
+        /* The name of the given backend. */
+        const char *GetDiskBackendName(TDiskBackend backend);
+
+        /* The kernel won't register a buffer bigger than this (1 GiB) with an io_uring. */
+        static constexpr size_t MaxRegisteredBufferSize = 1UL << 30;
+
+        /* The given regions, with any bigger than the given max size cut into consecutive pieces no bigger than it. */
+        std::vector<struct iovec> SplitBufferRegions(const std::vector<struct iovec> &regions, size_t max_size);
+
+        /* A queue of I/O to and from the kernel.  A queue belongs to the one thread which submits to it and reaps from
+           it. */
+        class TIoQueue {
+          NO_COPY(TIoQueue);
+          public:
+
+          /* A queue of the given backend with room for the given number of I/Os in flight.  If io_uring isn't available,
+             logs as much and returns an aio queue. */
+          static std::unique_ptr<TIoQueue> New(TDiskBackend backend, size_t depth);
+
+          /* Do-little. */
+          virtual ~TIoQueue() {}
+
+          /* The backend we're actually running on. */
+          virtual TDiskBackend GetBackend() const = 0;
+
+          /* Hand the I/Os over to the kernel.  The iocbs must stay put until they complete.  A backend which can batch
+             may hold on to them until the next Reap(). */
+          virtual void Submit(struct iocb **iocbs, size_t num_iocbs) = 0;
+
+          /* Wait until at least the given number of I/Os have completed, then fill in as many completions as are ready,
+             up to the given max, and return how many we filled in.  Each event's data and obj are those of the iocb
+             which completed; res is the number of bytes transferred (or -errno, as an unsigned long) and res2 is 0. */
+          virtual size_t Reap(struct io_event *events, size_t max_events, size_t min_events) = 0;
+
+          /* Try to register the given regions of memory with the kernel, so I/O to and from them is cheaper.  This must
+             only be done while nothing is in flight.  Only the first call per queue does anything; later ones just
+             return what it did.  Returns false (and changes nothing) if the backend can't do it or the kernel won't;
+             either way, I/O to any buffer still works. */
+          bool TryRegisterBuffers(const std::vector<struct iovec> &regions) {
+            assert(this);
+            if (!TriedToRegisterBuffers) {
+              TriedToRegisterBuffers = true;
+              RegisteredBuffers = RegisterBuffers(regions);
+            }
+            return RegisteredBuffers;
+          }
+
+          /* True iff. TryRegisterBuffers() has been called, whether or not it worked. */
+          bool HasTriedToRegisterBuffers() const {
+            assert(this);
+            return TriedToRegisterBuffers;
+          }
+
+          protected:
+
+          /* Do-little. */
+          TIoQueue()
+              : TriedToRegisterBuffers(false), RegisteredBuffers(false) {}
+
+          /* Called once, by TryRegisterBuffers(), to do the work.  By default, we can't. */
+          virtual bool RegisterBuffers(const std::vector<struct iovec> &/*regions*/) {
+            return false;
+          }
+
+          private:
+
+          /* See TryRegisterBuffers(). */
+          bool TriedToRegisterBuffers;
+          bool RegisteredBuffers;
+
+        };  // TIoQueue
+
+      }  // Util
+
+    }  // Disk
+
+  }  // Indy
+
+}  // Orly
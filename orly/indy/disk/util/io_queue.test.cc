@@ -0,0 +1,113 @@
+/* <orly/indy/disk/util/io_queue.test.cc>
+
+   Unit test for <orly/indy/disk/util/io_queue.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/util/io_queue.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <base/tmp_file.h>
+#include <test/kit.h>
+
+using namespace std;
+using namespace Base;
+using namespace Orly::Indy::Disk::Util;
+
+static constexpr size_t NumIos = 16UL;
+static constexpr size_t IoSize = 4096UL;
+
+/* Write NumIos buffers of IoSize bytes through a queue, each filled with its own number, read them back into a second
+   set of buffers, and return true iff. everything completed in full and came back as written. */
+static bool RoundTrip(TIoQueue *queue, char *out, char *in) {
+  TTmpFile tmp_file("/tmp/orly_io_queue_XXXXXX.tmp", true);
+  struct iocb iocbs[NumIos];
+  struct iocb *ioq[NumIos];
+  struct io_event events[NumIos];
+  for (int pass = 0; pass < 2; ++pass) {
+    for (size_t i = 0; i < NumIos; ++i) {
+      char *buf = (pass ? in : out) + (i * IoSize);
+      if (pass) {
+        io_prep_pread(&iocbs[i], tmp_file.GetFd(), buf, IoSize, i * IoSize);
+      } else {
+        memset(buf, static_cast<int>(i + 1), IoSize);
+        io_prep_pwrite(&iocbs[i], tmp_file.GetFd(), buf, IoSize, i * IoSize);
+      }
+      iocbs[i].data = &iocbs[i];
+      ioq[i] = &iocbs[i];
+    }
+    queue->Submit(ioq, NumIos);
+    for (size_t num_done = 0; num_done < NumIos; ) {
+      const size_t num_reaped = queue->Reap(events, NumIos, 1UL);
+      for (size_t i = 0; i < num_reaped; ++i) {
+        if (events[i].obj != events[i].data || events[i].res != IoSize || events[i].res2) {
+          return false;
+        }
+      }
+      num_done += num_reaped;
+    }
+  }
+  return memcmp(out, in, NumIos * IoSize) == 0;
+}
+
+FIXTURE(Names) {
+  EXPECT_TRUE(GetDiskBackend("aio") == TDiskBackend::Aio);
+  EXPECT_TRUE(GetDiskBackend("io_uring") == TDiskBackend::IoUring);
+  EXPECT_EQ(string(GetDiskBackendName(TDiskBackend::IoUring)), string("io_uring"));
+  EXPECT_THROW(invalid_argument, []() { GetDiskBackend("epoll"); });
+}
+
+/* Whichever backend we end up with (io_uring, or aio if the kernel doesn't have it), I/O goes through. */
+FIXTURE(Typical) {
+  unique_ptr<TIoQueue> queue = TIoQueue::New(TDiskBackend::IoUring, 64UL);
+  unique_ptr<char[]> out(new char[NumIos * IoSize]), in(new char[NumIos * IoSize]);
+  EXPECT_TRUE(RoundTrip(queue.get(), out.get(), in.get()));
+}
+
+/* I/O to and from registered buffers goes through too, as does I/O to buffers outside them. */
+FIXTURE(RegisteredBuffers) {
+  unique_ptr<TIoQueue> queue = TIoQueue::New(TDiskBackend::IoUring, 64UL);
+  unique_ptr<char[]> out(new char[NumIos * IoSize]), in(new char[NumIos * IoSize]), elsewhere(new char[NumIos * IoSize]);
+  /* whether the kernel lets us register them depends on the backend and on our memlock limit, so we don't check */
+  queue->TryRegisterBuffers({ { out.get(), NumIos * IoSize }, { in.get(), NumIos * IoSize } });
+  EXPECT_TRUE(RoundTrip(queue.get(), out.get(), in.get()));
+  EXPECT_TRUE(RoundTrip(queue.get(), out.get(), elsewhere.get()));
+}
+
+/* Only the first registration per queue does anything; later ones report what it did. */
+FIXTURE(RegisterOnce) {
+  unique_ptr<TIoQueue> queue = TIoQueue::New(TDiskBackend::IoUring, 64UL);
+  unique_ptr<char[]> out(new char[NumIos * IoSize]), in(new char[NumIos * IoSize]);
+  EXPECT_FALSE(queue->HasTriedToRegisterBuffers());
+  const bool registered = queue->TryRegisterBuffers({ { out.get(), NumIos * IoSize } });
+  EXPECT_TRUE(queue->HasTriedToRegisterBuffers());
+  EXPECT_EQ(queue->TryRegisterBuffers({ { in.get(), NumIos * IoSize } }), registered);
+  EXPECT_TRUE(RoundTrip(queue.get(), out.get(), in.get()));
+}
+
+/* Regions too big for the kernel are cut into consecutive pieces which cover them exactly. */
+FIXTURE(SplitBufferRegions) {
+  char *base = reinterpret_cast<char *>(0x10000UL);
+  const vector<struct iovec> pieces = SplitBufferRegions({ { base, 10UL }, { base + 100UL, 4UL }, { base + 200UL, 0UL } }, 4UL);
+  if (EXPECT_EQ(pieces.size(), 4UL)) {
+    EXPECT_TRUE(pieces[0].iov_base == base && pieces[0].iov_len == 4UL);
+    EXPECT_TRUE(pieces[1].iov_base == base + 4UL && pieces[1].iov_len == 4UL);
+    EXPECT_TRUE(pieces[2].iov_base == base + 8UL && pieces[2].iov_len == 2UL);
+    EXPECT_TRUE(pieces[3].iov_base == base + 100UL && pieces[3].iov_len == 4UL);
+  }
+}
@@ -0,0 +1,128 @@
+/* <orly/indy/disk/util/io_queue.test.manual.cc>
+
+   Compares the IOPS and tail latency of the aio and io_uring backends.
+
+   By default this runs against a temp file.  To measure something closer to a real device, back a loop device with a
+   file and point the benchmark at it.  Whatever it points at gets overwritten.
+
+     truncate -s 1G /tmp/orly_bench.img && losetup -f --show /tmp/orly_bench.img
+     ORLY_IO_QUEUE_BENCH_PATH=/dev/loop0 ./io_queue.test.manual
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/disk/util/io_queue.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <base/fd.h>
+#include <base/mem_aligned_ptr.h>
+#include <base/tmp_file.h>
+#include <test/kit.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Base;
+using namespace Orly::Indy::Disk::Util;
+
+static constexpr size_t IoSize = 4096UL;
+static constexpr size_t QueueDepth = 32UL;
+static constexpr size_t NumIos = 200000UL;
+static constexpr size_t TmpFileSize = 256UL * 1024UL * 1024UL;
+
+/* Keep QueueDepth random IoSize reads (or writes) in flight until NumIos have completed, then print the IOPS and the
+   median and p99 latency. */
+static void Bench(TDiskBackend backend, int fd, size_t file_size, bool is_write) {
+  unique_ptr<TIoQueue> queue = TIoQueue::New(backend, QueueDepth * 2UL);
+  unique_ptr<char> bufs = MemAlignedAlloc<char>(IoSize, IoSize * QueueDepth);
+  queue->TryRegisterBuffers({ { bufs.get(), IoSize * QueueDepth } });
+  struct iocb iocbs[QueueDepth];
+  struct io_event events[QueueDepth];
+  steady_clock::time_point started[QueueDepth];
+  vector<nanoseconds> latencies;
+  latencies.reserve(NumIos);
+  mt19937_64 engine(42);
+  uniform_int_distribution<size_t> block(0UL, (file_size / IoSize) - 1UL);
+  auto issue = [&](size_t slot) {
+    struct iocb *io = &iocbs[slot];
+    char *buf = bufs.get() + (slot * IoSize);
+    if (is_write) {
+      io_prep_pwrite(io, fd, buf, IoSize, block(engine) * IoSize);
+    } else {
+      io_prep_pread(io, fd, buf, IoSize, block(engine) * IoSize);
+    }
+    io->data = reinterpret_cast<void *>(slot);
+    started[slot] = steady_clock::now();
+    queue->Submit(&io, 1UL);
+  };
+  const auto start = steady_clock::now();
+  for (size_t slot = 0; slot < QueueDepth; ++slot) {
+    issue(slot);
+  }
+  size_t num_issued = QueueDepth, num_failed = 0UL;
+  while (latencies.size() < NumIos) {
+    const size_t num_reaped = queue->Reap(events, QueueDepth, 1UL);
+    const auto now = steady_clock::now();
+    for (size_t i = 0; i < num_reaped; ++i) {
+      const size_t slot = reinterpret_cast<size_t>(events[i].data);
+      latencies.push_back(duration_cast<nanoseconds>(now - started[slot]));
+      if (events[i].res != IoSize) {
+        ++num_failed;
+      }
+      if (num_issued < NumIos) {
+        issue(slot);
+        ++num_issued;
+      }
+    }
+  }
+  const double secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  sort(latencies.begin(), latencies.end());
+  EXPECT_EQ(num_failed, 0UL);
+  cout << GetDiskBackendName(queue->GetBackend()) << (is_write ? " random write" : " random read")
+       << "\t[" << static_cast<size_t>(NumIos / secs) << " IOPS]"
+       << "\t[p50 " << duration_cast<microseconds>(latencies[NumIos / 2]).count() << " us]"
+       << "\t[p99 " << duration_cast<microseconds>(latencies[(NumIos * 99) / 100]).count() << " us]" << endl;
+}
+
+FIXTURE(Backends) {
+  const char *path = getenv("ORLY_IO_QUEUE_BENCH_PATH");
+  unique_ptr<TTmpFile> tmp_file;
+  if (!path) {
+    tmp_file.reset(new TTmpFile("/tmp/orly_io_queue_bench_XXXXXX.tmp", true));
+    EXPECT_EQ(ftruncate(tmp_file->GetFd(), TmpFileSize), 0);
+    path = tmp_file->GetName();
+  }
+  /* not every file system does O_DIRECT */
+  int os_fd = open(path, O_RDWR | O_DIRECT);
+  if (os_fd < 0) {
+    os_fd = open(path, O_RDWR);
+  }
+  TFd fd(os_fd);
+  const off_t file_size = lseek(fd, 0, SEEK_END);
+  EXPECT_LE(static_cast<off_t>(IoSize), file_size);
+  cout << endl << "[" << path << "], [" << (file_size >> 20) << "] MB, queue depth [" << QueueDepth << "]" << endl;
+  for (bool is_write : { false, true }) {
+    for (TDiskBackend backend : { TDiskBackend::Aio, TDiskBackend::IoUring }) {
+      Bench(backend, fd, file_size, is_write);
+    }
+  }
+}
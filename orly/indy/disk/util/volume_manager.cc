@@ -129,8 +129,10 @@ namespace Orly {
 
 }
 
-TDiskController::TDiskController()
-    : DeviceCollection(this)
+TDiskController::TDiskController(TDiskBackend backend)
+    : Backend(backend),
+      HasBufferRegions(false),
+      DeviceCollection(this)
 #ifndef NDEBUG
     ,NextId(0UL)
 #endif
@@ -140,18 +142,35 @@ TDiskController::TDiskController()
 TDiskController::~TDiskController() {
 }
 
+void TDiskController::RegisterBuffers(const std::vector<struct iovec> &regions) {
+  assert(this);
+  std::lock_guard<std::mutex> lock(BufferRegionMutex);
+  if (!HasBufferRegions) {
+    BufferRegions = regions;
+    HasBufferRegions = true;
+  }
+}
+
+void TDiskController::TryRegisterBuffers(TIoQueue *queue) {
+  assert(this);
+  assert(queue);
+  if (!queue->HasTriedToRegisterBuffers() && HasBufferRegions) {
+    std::lock_guard<std::mutex> lock(BufferRegionMutex);
+    if (queue->TryRegisterBuffers(BufferRegions)) {
+      syslog(LOG_INFO, "Registered [%ld] buffer regions with the %s queue", BufferRegions.size(), GetDiskBackendName(queue->GetBackend()));
+    } else {
+      syslog(LOG_WARNING, "Could not register [%ld] buffer regions with the %s queue; its I/O will pin pages as it goes", BufferRegions.size(), GetDiskBackendName(queue->GetBackend()));
+    }
+  }
+}
+
 void TDiskController::QueueRunner(std::vector<TPersistentDevice *> device_vec, bool no_realtime, size_t core) {
   assert(this);
   const size_t max_aio_num = 64;
   size_t inflight = 0UL;
 
-  io_context_t ctxp(0);
-  try {
-    IfWeird(io_setup(max_aio_num, &ctxp));
-  } catch (const std::exception &ex) {
-    syslog(LOG_ERR, "Error in io_setup: [%s]", ex.what());
-    throw;
-  }
+  std::unique_ptr<TIoQueue> queue = TIoQueue::New(Backend, max_aio_num);
+  syslog(LOG_INFO, "QueueRunner on core [%ld] is using %s", core, GetDiskBackendName(queue->GetBackend()));
   cpu_set_t mask;
   CPU_ZERO(&mask);
   CPU_SET(core, &mask);
@@ -175,6 +194,10 @@ void TDiskController::QueueRunner(std::vector<TPersistentDevice *> device_vec, b
       if (num_laps_without_work > laps_before_sleep) {
         this_thread::sleep_for(10000ns);
       }
+      /* buffers can only be registered while nothing is in flight */
+      if (!inflight) {
+        TryRegisterBuffers(queue.get());
+      }
       /* wait for a queue to be ready */
       for (TPersistentDevice *ready_device : device_vec) {
         TEvent *cur_tail = __sync_lock_test_and_set(&ready_device->IncomingEventQueue, nullptr);
@@ -255,58 +278,12 @@ void TDiskController::QueueRunner(std::vector<TPersistentDevice *> device_vec, b
 
       if (ioq_pos > 0) {
         inflight += ioq_pos;
-        int ret = io_submit(ctxp, ioq_pos, ioq);
-        if (ret < 0) {
-          syslog(LOG_ERR, "Error in io_submit; nr=[%ld]", ioq_pos);
-          for (size_t nr = 0; nr < ioq_pos; ++nr) {
-            switch (ioq[nr]->aio_lio_opcode) {
-              case IO_CMD_PREAD: {
-                syslog(LOG_INFO, "ioq[%ld] IO_CMD_PREAD, offset=[%lld], nbytes=[%ld]", nr, ioq[nr]->u.c.offset, ioq[nr]->u.c.nbytes);
-                break;
-              }
-              case IO_CMD_PWRITE: {
-                syslog(LOG_INFO, "ioq[%ld] IO_CMD_PWRITE, offset=[%lld], nbytes=[%ld]", nr, ioq[nr]->u.c.offset, ioq[nr]->u.c.nbytes);
-                break;
-              }
-              case IO_CMD_FSYNC: {
-                throw;
-                break;
-              }
-              case IO_CMD_FDSYNC: {
-                throw;
-                break;
-              }
-              case IO_CMD_POLL: {
-                throw;
-                break;
-              }
-              case IO_CMD_NOOP: {
-                throw;
-                break;
-              }
-              case IO_CMD_PREADV: {
-                syslog(LOG_INFO, "ioq[%ld] IO_CMD_PREADV, nr=[%d], offset=[%lld], size=[%ld]", nr, ioq[nr]->u.v.nr, ioq[nr]->u.v.offset, ioq[nr]->u.v.vec[0].iov_len);
-                break;
-              }
-              case IO_CMD_PWRITEV: {
-                syslog(LOG_INFO, "ioq[%ld] IO_CMD_PWRITEV, nr=[%d], offset=[%lld], size=[%ld]", nr, ioq[nr]->u.v.nr, ioq[nr]->u.v.offset, ioq[nr]->u.v.vec[0].iov_len);
-                break;
-              }
-            }
-          }
-          ThrowSystemError(-ret);
-        }
-        if (ret != static_cast<int>(ioq_pos)) {
-          syslog(LOG_ERR, "io_submit did not sumbit as as many events as requested [%ld] vs. [%d]", ioq_pos, ret);
-          throw;
-        }
+        queue->Submit(ioq, ioq_pos);
       }
 
       if (inflight > 0) {
-        int num_popped = io_getevents(ctxp, 1, max_aio_num, io_ev, NULL);
-        if (num_popped > 0) {
-          inflight -= num_popped;
-        }
+        const int num_popped = queue->Reap(io_ev, max_aio_num, 1UL);
+        inflight -= num_popped;
         try {
 
           #ifndef NDEBUG
@@ -48,6 +48,7 @@
 #include <orly/indy/disk/priority.h>
 #include <orly/indy/disk/result.h>
 #include <orly/indy/disk/util/device_util.h>
+#include <orly/indy/disk/util/io_queue.h>
 #include <util/error.h>
 
 namespace Orly {
@@ -516,12 +517,23 @@ namespace Orly {
 
           };  // TEvent
 
-          /* TODO */
-          TDiskController();
+          /* Each queue runner submits its I/O through the given backend, or through aio if the kernel doesn't have it. */
+          TDiskController(TDiskBackend backend = TDiskBackend::Aio);
 
           /* TODO */
           ~TDiskController();
 
+          /* The backend we were asked to use.  See TIoQueue for the one a queue runner actually got. */
+          TDiskBackend GetBackend() const {
+            assert(this);
+            return Backend;
+          }
+
+          /* Ask each queue runner to register the given regions of memory with its queue, so I/O to and from them is
+             cheaper.  The regions must outlive the controller.  Only the first call counts, and it's only a request: a
+             runner whose backend (or kernel) can't register buffers just goes on without. */
+          void RegisterBuffers(const std::vector<struct iovec> &regions);
+
           /* TODO */
           inline TDeviceCollection *GetDeviceCollection() const {
             assert(this);
@@ -536,11 +548,23 @@ namespace Orly {
 
           private:
 
+          /* Register the buffers we've been asked to with the given queue's ring, if we have any and haven't tried
+             already.  Logs if the ring won't take them. */
+          void TryRegisterBuffers(TIoQueue *queue);
+
           /* TODO */
           static constexpr int RealTimePriority = -2;
           static constexpr int MediumPriority = 2;
           static constexpr int LowPriority = 4;
 
+          /* See accessor. */
+          const TDiskBackend Backend;
+
+          /* See RegisterBuffers().  The flag lets the runners check for a request without taking the lock. */
+          std::mutex BufferRegionMutex;
+          std::vector<struct iovec> BufferRegions;
+          std::atomic<bool> HasBufferRegions;
+
           /* TODO */
           mutable TDeviceCollection::TImpl DeviceCollection;
 
@@ -19,12 +19,14 @@
 #pragma once
 
 #include <cassert>
+#include <chrono>
 
 #include <base/class_traits.h>
 #include <inv_con/unordered_list.h>
 #include <orly/indy/disk/buf_block.h>
 #include <orly/indy/disk/result.h>
 #include <orly/indy/disk/util/volume_manager.h>
+#include <orly/indy/util/group_commit.h>
 
 namespace Orly {
 
@@ -46,6 +48,14 @@ namespace Orly {
       /* TODO */
       class TWriteGroup {
         NO_COPY(TWriteGroup);
+        public:
+
+        /* Copy out and reset the stats on the flushes of every write group in the process.  Each block counts as a
+           commit, and its latency is the time it sat buffered in its group. */
+        static void TakeGroupCommitStats(Indy::Util::TGroupCommit::TStats &out) {
+          GetGroupCommit().TakeStats(out);
+        }
+
         protected:
 
         /* Forward Declarations. */
@@ -113,6 +123,10 @@ namespace Orly {
           assert(this);
           WriteCollection.DeleteEachMember();
           QueueSize = 0UL;
+          if (!Batch.IsEmpty()) {
+            const auto now = Indy::Util::TGroupCommit::TClock::now();
+            GetGroupCommit().OnFlushed(Batch, now, now);
+          }
         }
 
         /* TODO */
@@ -149,6 +163,7 @@ namespace Orly {
               new TBufferedWrite(this, cur_block_id, buf);
             }
           }
+          Batch.Push(Indy::Util::TGroupCommit::TClock::now());
           if (QueueSize == MaxGroupSize) {
             Flush();
           }
@@ -165,6 +180,16 @@ namespace Orly {
         /* TODO */
         size_t MaxGroupSize;
 
+        /* The arrival times of the buffered writes. */
+        Indy::Util::TGroupCommit::TBatch Batch;
+
+        /* Where every write group reports its flushes.  The groups flush on their own schedule (when they fill up or
+           stop being sequential), so we only use this for its stats. */
+        static Indy::Util::TGroupCommit &GetGroupCommit() {
+          static Indy::Util::TGroupCommit group_commit(std::chrono::microseconds(0), Util::MaxOutBlockGroupSize);
+          return group_commit;
+        }
+
         /* TODO */
         friend class TController;
         friend class TService;
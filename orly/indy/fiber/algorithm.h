@@ -46,26 +46,30 @@ namespace Orly {
                          const TComparator &comp)
             : Begin(begin), End(end), SafeSync(safe_sync), Comp(comp) {
           SafeSync.WaitForMore(1UL);
-          Frame = TFrame::LocalFramePool->Alloc();
-          work_pool.Schedule(Frame, this, static_cast<TRunnable::TFunc>(&TSubSortRunnable::DoSort));
+          FramePool = TFrame::LocalFramePool;
+          work_pool.Schedule(FramePool->Alloc(), this, static_cast<TRunnable::TFunc>(&TSubSortRunnable::DoSort));
         }
 
         /* TODO */
         ~TSubSortRunnable() {
           assert(this);
-          TFrame::LocalFramePool->Free(Frame);
         }
 
         /* TODO */
         void DoSort() {
           assert(this);
           std::sort(Begin, End, Comp);
+          /* once we complete the sync, the sorter may destroy us, but our frame is still running until it gets back to
+             its runner, so it's the runner which has to free it */
+          auto *frame_pool = FramePool;
           SafeSync.Complete();
+          FreeMyFrame(frame_pool);
         }
 
         private:
 
-        TFrame *Frame;
+        /* The pool our frame came from. */
+        Base::TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool *FramePool;
 
         /* TODO */
         const TRandomAccessIterator Begin;
@@ -95,14 +99,13 @@ namespace Orly {
                          const TComparator &comp)
             : Begin(begin), Middle(middle), End(end), WaitOnSafeSync(wait_on_safe_sync), TriggerToSafeSync(trigger_to_safe_sync), Comp(comp) {
           TriggerToSafeSync.WaitForMore(1UL);
-          Frame = TFrame::LocalFramePool->Alloc();
-          work_pool.Schedule(Frame, this, static_cast<TRunnable::TFunc>(&TInplaceMergeRunnable::DoMerge));
+          FramePool = TFrame::LocalFramePool;
+          work_pool.Schedule(FramePool->Alloc(), this, static_cast<TRunnable::TFunc>(&TInplaceMergeRunnable::DoMerge));
         }
 
         /* TODO */
         ~TInplaceMergeRunnable() {
           assert(this);
-          TFrame::LocalFramePool->Free(Frame);
         }
 
         /* TODO */
@@ -110,12 +113,16 @@ namespace Orly {
           assert(this);
           WaitOnSafeSync.Sync();
           std::inplace_merge(Begin, Middle, End, Comp);
+          /* see TSubSortRunnable::DoSort() */
+          auto *frame_pool = FramePool;
           TriggerToSafeSync.Complete();
+          FreeMyFrame(frame_pool);
         }
 
         private:
 
-        TFrame *Frame;
+        /* The pool our frame came from. */
+        Base::TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool *FramePool;
 
         /* TODO */
         const TRandomAccessIterator Begin;
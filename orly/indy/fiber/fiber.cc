@@ -20,11 +20,16 @@
 
 #include <xmmintrin.h>
 
+#include <algorithm>
 #include <thread>
 
+#include <base/demangle.h>
+
+using namespace std::chrono;
 using namespace std::literals;
 using namespace Orly::Indy::Fiber;
 
+std::atomic<bool> TRunner::Profiling(false);
 __thread TRunner *TRunner::LocalRunner = nullptr;
 __thread TFrame *TFrame::LocalFrame = nullptr;
 __thread Base::TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool *TFrame::LocalFramePool = nullptr;
@@ -104,6 +109,7 @@ void TRunner::Run() {
   try {
     const size_t laps_before_short_sleep = 100UL;
     const size_t laps_before_long_sleep = 100UL;
+    const size_t laps_before_park = 100UL;
     size_t laps_without_work = 0UL;
     for (; likely(KeepRunning.load());) {
       assert(!ReadyToRunQueue);
@@ -134,49 +140,70 @@ void TRunner::Run() {
           }
           rt_queue = nullptr;
         } else {
-          for (size_t i = 0; i < TotalNumRunners; ++i) {
-            TRunner *cur_runner = RunnerArray[i];
-            if (cur_runner) {
-              TFrame *&cur_inbound_queue = cur_runner->QueueArray[RunnerId].Ptr;
-              if (cur_inbound_queue) {
-                assert(rt_queue == nullptr);
-                TFrame *cur_tail = __sync_lock_test_and_set(&cur_inbound_queue, nullptr);
-                for (TFrame *frame = cur_tail; frame; frame = next_frame) {
-                  assert(frame->InboundQueueNextFrame != frame);
-                  next_frame = frame->InboundQueueNextFrame;
-                  if (!frame->ComeBackRightAway) {
+          /* only look at the runners which have told us they have something for us */
+          for (size_t word = 0; word < NumInboundWords; ++word) {
+            uint64_t bits = InboundBits[word].load(std::memory_order_relaxed) ? InboundBits[word].exchange(0UL) : 0UL;
+            for (; bits; bits &= bits - 1UL) {
+              TRunner *cur_runner = RunnerArray[(word * 64UL) + __builtin_ctzll(bits)];
+              if (cur_runner) {
+                TFrame *&cur_inbound_queue = cur_runner->QueueArray[RunnerId].Ptr;
+                if (cur_inbound_queue) {
+                  assert(rt_queue == nullptr);
+                  TFrame *cur_tail = __sync_lock_test_and_set(&cur_inbound_queue, nullptr);
+                  for (TFrame *frame = cur_tail; frame; frame = next_frame) {
+                    assert(frame->InboundQueueNextFrame != frame);
+                    next_frame = frame->InboundQueueNextFrame;
+                    if (!frame->ComeBackRightAway) {
+                      frame->InboundQueueNextFrame = ReadyToRunQueue;
+                      ReadyToRunQueue = frame;
+                      //frame->QueueMembership.Insert(&MyFrameQueue, InvCon::Rev);
+                      //_mm_prefetch(frame->MyFiber.jmp, _MM_HINT_T1);
+                    } else {
+                      frame->InboundQueueNextFrame = rt_queue;
+                      rt_queue = frame;
+                    }
+                    //printf("TRunner [%p] push frame [%p]\n", this, frame);
+                  }
+                  /* here we have to choose between putting the most recent or least recent "high priority" (come_back_soon) fiber first. We currently
+                     implement the more recent one (as opposed to fair one) because it's most likely to still have data in the cache... */
+                  for (TFrame *frame = rt_queue; frame; frame = next_frame) {
+                    next_frame = frame->InboundQueueNextFrame;
                     frame->InboundQueueNextFrame = ReadyToRunQueue;
                     ReadyToRunQueue = frame;
                     //frame->QueueMembership.Insert(&MyFrameQueue, InvCon::Rev);
-                    //_mm_prefetch(frame->MyFiber.jmp, _MM_HINT_T1);
-                  } else {
-                    frame->InboundQueueNextFrame = rt_queue;
-                    rt_queue = frame;
+                    #ifdef FAST_SWITCH
+                    _mm_prefetch(frame->MyFiber.jmp, _MM_HINT_T1);
+                    #endif
                   }
-                  //printf("TRunner [%p] push frame [%p]\n", this, frame);
+                  rt_queue = nullptr;
                 }
-                /* here we have to choose between putting the most recent or least recent "high priority" (come_back_soon) fiber first. We currently
-                   implement the more recent one (as opposed to fair one) because it's most likely to still have data in the cache... */
-                for (TFrame *frame = rt_queue; frame; frame = next_frame) {
-                  next_frame = frame->InboundQueueNextFrame;
-                  frame->InboundQueueNextFrame = ReadyToRunQueue;
-                  ReadyToRunQueue = frame;
-                  //frame->QueueMembership.Insert(&MyFrameQueue, InvCon::Rev);
-                  #ifdef FAST_SWITCH
-                  _mm_prefetch(frame->MyFiber.jmp, _MM_HINT_T1);
-                  #endif
-                }
-                rt_queue = nullptr;
               }
             }
           }
         }
       }
+      /* Take one stealable frame per lap, so stealable frames share the runner with pinned ones and stay up for grabs
+         as long as possible.  We only steal from our peers when we have nothing else to do. */
+      if (StealGroup) {
+        TFrame *frame = PopStealable();
+        if (!frame && !ReadyToRunQueue) {
+          frame = TrySteal();
+        }
+        if (frame) {
+          frame->InboundQueueNextFrame = ReadyToRunQueue;
+          ReadyToRunQueue = frame;
+        }
+      }
       if (ReadyToRunQueue) {
         laps_without_work = 0UL;
       } else {
         ++laps_without_work;
-        if (laps_without_work >= laps_before_long_sleep) {
+        if (MayPark) {
+          if (laps_without_work >= laps_before_park) {
+            Park();
+            laps_without_work = 0UL;
+          }
+        } else if (laps_without_work >= laps_before_long_sleep) {
           std::this_thread::sleep_for(10000ns);
         } else if (laps_without_work >= laps_before_short_sleep) {
           std::this_thread::sleep_for(100000ns);
@@ -187,12 +214,23 @@ void TRunner::Run() {
           ReadyToRunQueue = frame->InboundQueueNextFrame;
           _mm_prefetch(reinterpret_cast<uint8_t *>(ReadyToRunQueue) + offsetof(TFrame, MyFiber), _MM_HINT_T0);
           fiber_t *sched_fib = &frame->GetFiber();
+          /* once it starts, the frame belongs to us */
+          frame->Stealable = false;
           TFrame::LocalFrame = frame;
           FreeFrame = nullptr;
           FreeFramePool = nullptr;
+          const bool profiling = IsProfiling();
+          int64_t switched_in_at = 0;
+          if (unlikely(profiling)) {
+            switched_in_at = GetTicks();
+            OnSwitchIn(frame, switched_in_at);
+          }
           //printf("[%p]\tSwitch to Frame\n", this);
           switch_to_fiber(*sched_fib, MainFiber);
           //printf("[%p]\tDone Frame\n", this);
+          if (unlikely(profiling)) {
+            OnSwitchOut(frame, switched_in_at);
+          }
           if (FreeFrame) {
             assert(FreeFrame == frame);
             assert(FreeFramePool);
@@ -227,4 +265,135 @@ void TRunner::Run() {
   LocalRunner = nullptr;
 }
 
-#pragma GCC diagnostic pop
\ No newline at end of file
+#pragma GCC diagnostic pop
+
+TFrame *TRunner::TrySteal() {
+  assert(this);
+  assert(StealGroup);
+  const std::vector<TRunner *> &members = StealGroup->Members;
+  const size_t num_members = members.size();
+  for (size_t i = 1; i < num_members; ++i) {
+    TFrame *frame = members[(StealPos + i) % num_members]->PopStealable();
+    if (frame) {
+      StealGroup->NumSteals.fetch_add(1UL, std::memory_order_relaxed);
+      return frame;
+    }
+  }
+  return nullptr;
+}
+
+bool TRunner::HasWork() const {
+  assert(this);
+  if (!KeepRunning.load() || InboundFrameQueue || NumStealable.load()) {
+    return true;
+  }
+  for (size_t word = 0; word < NumInboundWords; ++word) {
+    if (InboundBits[word].load()) {
+      return true;
+    }
+  }
+  if (StealGroup) {
+    for (const TRunner *peer: StealGroup->Members) {
+      if (peer->NumStealable.load()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void TRunner::Park() {
+  assert(this);
+  Parked.store(true);
+  if (HasWork()) {
+    if (!Parked.exchange(false)) {
+      /* someone saw us parked and has pushed (or is about to push) the semaphore, so take it now or we'd wake for nothing later */
+      WakeSem.Pop();
+    }
+    return;
+  }
+  const auto start = steady_clock::now();
+  WakeSem.Pop();
+  const auto stop = steady_clock::now();
+  const auto sent_at = steady_clock::time_point(steady_clock::duration(WakeSentAt.load(std::memory_order_acquire)));
+  Base::TSpinLock::TLock lock(ParkStatsLock);
+  ++ParkStats.NumParks;
+  ParkStats.ParkedTime += duration_cast<nanoseconds>(stop - start);
+  ParkStats.WakeLatency.Push(duration_cast<duration<double, std::micro>>(stop - sent_at).count());
+}
+
+void TRunner::OnSwitchIn(TFrame *frame, int64_t now) {
+  assert(this);
+  assert(frame);
+  /* A frame can be made ready again before it has finished switching out (see TSafeSync), so it was blocked only if it
+     became ready after it switched out, and it has been waiting since whichever came last.  A ReadyAt of 0 means
+     profiling was off when it was scheduled. */
+  const int64_t ready_at = frame->ReadyAt, switched_out_at = frame->SwitchedOutAt;
+  SwitchedKind = frame->Kind;
+  SwitchedWaitTime = ready_at ? std::max<int64_t>(now - std::max(ready_at, switched_out_at), 0) : 0;
+  SwitchedBlockedTime = (ready_at && switched_out_at) ? std::max<int64_t>(ready_at - switched_out_at, 0) : 0;
+  CurrentKind.store(SwitchedKind, std::memory_order_relaxed);
+}
+
+void TRunner::OnSwitchOut(TFrame *frame, int64_t switched_in_at) {
+  assert(this);
+  assert(frame);
+  const int64_t now = GetTicks();
+  frame->SwitchedOutAt = now;
+  CurrentKind.store(nullptr, std::memory_order_relaxed);
+  Base::TSpinLock::TLock lock(ProfileLock);
+  /* every latch sets a kind, but a frame with none still counts, as a plain runnable */
+  TProfile::TKindStats &stats = Profile.ByKind[std::type_index(SwitchedKind ? *SwitchedKind : typeid(TRunnable))];
+  ++stats.NumSwitches;
+  stats.RunTime += duration_cast<nanoseconds>(steady_clock::duration(now - switched_in_at));
+  stats.WaitTime += duration_cast<nanoseconds>(steady_clock::duration(SwitchedWaitTime));
+  stats.BlockedTime += duration_cast<nanoseconds>(steady_clock::duration(SwitchedBlockedTime));
+}
+
+void TRunner::TakeProfile(TProfile &out) {
+  assert(this);
+  assert(&out);
+  Base::TSpinLock::TLock lock(ProfileLock);
+  for (const auto &item: Profile.ByKind) {
+    TProfile::TKindStats &stats = out.ByKind[item.first];
+    stats.NumSwitches += item.second.NumSwitches;
+    stats.RunTime += item.second.RunTime;
+    stats.WaitTime += item.second.WaitTime;
+    stats.BlockedTime += item.second.BlockedTime;
+  }
+  Profile.ByKind.clear();
+}
+
+std::string TRunner::GetKindName(const std::type_index &kind) {
+  auto name = Base::Demangle(kind.name());
+  return name ? name.get() : kind.name();
+}
+
+void TRunner::DumpSamples(std::ostream &strm, const std::vector<const TRunner *> &runners, size_t num_samples, nanoseconds interval) {
+  assert(&strm);
+  assert(&runners);
+  std::vector<std::unordered_map<std::type_index, size_t>> counts(runners.size());
+  /* the samples which found each runner between frames */
+  std::vector<size_t> idle_counts(runners.size(), 0UL);
+  for (size_t i = 0; i < num_samples; ++i) {
+    if (i) {
+      std::this_thread::sleep_for(interval);
+    }
+    for (size_t j = 0; j < runners.size(); ++j) {
+      const std::type_info *kind = runners[j]->GetCurrentKind();
+      if (kind) {
+        ++counts[j][std::type_index(*kind)];
+      } else {
+        ++idle_counts[j];
+      }
+    }
+  }
+  for (size_t j = 0; j < runners.size(); ++j) {
+    for (const auto &item: counts[j]) {
+      strm << "runner_" << runners[j]->GetRunnerId() << ';' << GetKindName(item.first) << ' ' << item.second << '\n';
+    }
+    if (idle_counts[j]) {
+      strm << "runner_" << runners[j]->GetRunnerId() << ";[idle] " << idle_counts[j] << '\n';
+    }
+  }
+}
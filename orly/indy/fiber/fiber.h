@@ -18,13 +18,21 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <ostream>
 #include <queue>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
 #include <unordered_set>
-
+#include <vector>
 
 #include <setjmp.h>
 #include <stdlib.h>
@@ -35,6 +43,8 @@
 
 #include <base/assert_true.h>
 #include <base/class_traits.h>
+#include <base/event_semaphore.h>
+#include <base/histogram.h>
 #include <base/likely.h>
 #include <base/spin_lock.h>
 #include <base/thread_local_global_pool.h>
@@ -265,6 +275,93 @@ namespace Orly {
 
         };  // TRunnerCons
 
+        /* A set of runners which may run one another's stealable frames.  A frame latched with LatchStealable() waits in
+           its runner's steal deque, and whichever runner in the group gets to it first runs it.  Once a frame starts
+           running, it stays with the runner which started it.  Runners must join before any of them starts running, and
+           the group must outlive their Run() loops. */
+        class TStealGroup {
+          NO_COPY(TStealGroup);
+          public:
+
+          /* An empty group. */
+          TStealGroup()
+              : NumSteals(0UL) {}
+
+          /* Add the given runner to the group. */
+          void Join(TRunner *runner) {
+            assert(this);
+            assert(runner);
+            assert(!runner->StealGroup);
+            runner->StealGroup = this;
+            runner->StealPos = Members.size();
+            Members.push_back(runner);
+          }
+
+          /* The number of frames run by a runner other than the one they were latched to since the last call. */
+          size_t TakeNumSteals() {
+            assert(this);
+            return NumSteals.exchange(0UL);
+          }
+
+          private:
+
+          /* The runners in the group. */
+          std::vector<TRunner *> Members;
+
+          /* See accessor. */
+          std::atomic<size_t> NumSteals;
+
+          friend class TRunner;
+
+        };  // TStealGroup
+
+        /* How a runner has spent its idle time. */
+        struct TParkStats {
+
+          /* Nothing yet. */
+          TParkStats()
+              : NumParks(0UL), ParkedTime(0) {}
+
+          /* The number of times the runner blocked waiting for work. */
+          size_t NumParks;
+
+          /* The total time it spent blocked. */
+          std::chrono::nanoseconds ParkedTime;
+
+          /* Microseconds from a wake-up being sent to the runner running again. */
+          Base::THistogram WakeLatency;
+
+        };  // TParkStats
+
+        /* Where runners' time has gone, by runnable kind.  A runnable's kind is the type it was latched as. */
+        struct TProfile {
+
+          /* The time frames of one kind have spent in each state. */
+          struct TKindStats {
+
+            /* Nothing yet. */
+            TKindStats()
+                : NumSwitches(0UL), RunTime(0), WaitTime(0), BlockedTime(0) {}
+
+            /* The number of times a runner switched to a frame of this kind. */
+            size_t NumSwitches;
+
+            /* The time spent running. */
+            std::chrono::nanoseconds RunTime;
+
+            /* The time spent ready to run, waiting for the runner to get to it. */
+            std::chrono::nanoseconds WaitTime;
+
+            /* The time spent switched out and not ready, waiting on a TSync, a TFiberLock or the like. */
+            std::chrono::nanoseconds BlockedTime;
+
+          };  // TKindStats
+
+          /* Keyed by kind.  See GetKindName(). */
+          std::unordered_map<std::type_index, TKindStats> ByKind;
+
+        };  // TProfile
+
         TRunner(TRunnerCons &runner_cons) : TRunner(runner_cons.NumRunners, runner_cons.GetNewId(), runner_cons.RunnerArray) {
           runner_cons.RunnerArray[RunnerId] = this;
         }
@@ -282,7 +379,18 @@ namespace Orly {
               FrameToMoveToForeignRunner(nullptr),
               TotalNumRunners(total_num_runners),
               RunnerId(runner_id),
-              RunnerArray(runner_array) {
+              RunnerArray(runner_array),
+              StealGroup(nullptr),
+              StealPos(0UL),
+              NumStealable(0UL),
+              NumInboundWords((total_num_runners + 63UL) / 64UL),
+              MayPark(true),
+              Parked(false),
+              WakeSentAt(0),
+              CurrentKind(nullptr),
+              SwitchedKind(nullptr),
+              SwitchedWaitTime(0),
+              SwitchedBlockedTime(0) {
           assert(runner_id < total_num_runners);
           #ifdef FAST_SWITCH
           Base::Zero(MainFiber.fib);
@@ -293,12 +401,17 @@ namespace Orly {
           for (size_t i = 0; i < total_num_runners; ++i) {
             QueueArray[i].Ptr = nullptr;
           }
+          InboundBits = new std::atomic<uint64_t>[NumInboundWords];
+          for (size_t i = 0; i < NumInboundWords; ++i) {
+            InboundBits[i] = 0UL;
+          }
         }
 
         /* TODO */
         ~TRunner() {
           assert(this);
           RunnerArray[RunnerId] = nullptr;
+          delete[] InboundBits;
           delete[] QueueArray;
         }
 
@@ -309,8 +422,65 @@ namespace Orly {
         void ShutDown() {
           assert(this);
           KeepRunning.store(false);
+          TryWake();
+        }
+
+        /* By default, a runner which runs out of work blocks until someone schedules a frame on it.  If may_park is
+           false, it polls instead, sleeping for short spells between laps.  Call this before Run(). */
+        void SetMayPark(bool may_park) {
+          assert(this);
+          MayPark = may_park;
+        }
+
+        /* Add our park stats since the last call to the given totals. */
+        void TakeParkStats(TParkStats &out) {
+          assert(this);
+          assert(&out);
+          Base::TSpinLock::TLock lock(ParkStatsLock);
+          out.NumParks += ParkStats.NumParks;
+          out.ParkedTime += ParkStats.ParkedTime;
+          out.WakeLatency.Add(ParkStats.WakeLatency);
+          ParkStats.NumParks = 0UL;
+          ParkStats.ParkedTime = std::chrono::nanoseconds(0);
+          ParkStats.WakeLatency.Reset();
+        }
+
+        /* Turn profiling on or off for all runners.  While it's on, each runner keeps a TProfile and publishes the kind
+           of runnable it's running, at the cost of a few clock reads per switch. */
+        static void SetProfiling(bool profiling) {
+          Profiling.store(profiling, std::memory_order_relaxed);
         }
 
+        /* See SetProfiling(). */
+        static bool IsProfiling() {
+          return Profiling.load(std::memory_order_relaxed);
+        }
+
+        /* Add our profile since the last call to the given totals. */
+        void TakeProfile(TProfile &out);
+
+        /* The kind of runnable we're running right now, or null if we're between frames or profiling is off.  Safe to
+           call from any thread. */
+        const std::type_info *GetCurrentKind() const {
+          assert(this);
+          return CurrentKind.load(std::memory_order_relaxed);
+        }
+
+        /* See accessor. */
+        size_t GetRunnerId() const {
+          assert(this);
+          return RunnerId;
+        }
+
+        /* The readable name of a kind from a TProfile or GetCurrentKind(). */
+        static std::string GetKindName(const std::type_index &kind);
+
+        /* Look at what each of the given runners is running, num_samples times, interval apart, and write the counts to
+           strm in the folded format flame graph tools read: a line of "runner_<id>;<kind> <count>" per runner and
+           kind, with "[idle]" for a runner between frames.  Profiling must be on. */
+        static void DumpSamples(
+            std::ostream &strm, const std::vector<const TRunner *> &runners, size_t num_samples, std::chrono::nanoseconds interval);
+
         /* TODO */
         static inline void Yield(fiber_t &fiber) {
           assert(LocalRunner);
@@ -338,6 +508,18 @@ namespace Orly {
 
         private:
 
+        /* The time on the steady clock, in ticks. */
+        static int64_t GetTicks() {
+          return std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+
+        /* If we're profiling, note that the given frame is ready to run as of now. */
+        static inline void MarkReady(TFrame *frame);
+
+        /* Called around each switch to a frame when we're profiling. */
+        void OnSwitchIn(TFrame *frame, int64_t now);
+        void OnSwitchOut(TFrame *frame, int64_t switched_in_at);
+
         /* Schedule this frame using the CAS queue, so that we can exit the runner loop for the local queue. An example of somewhere to use this is
            when you are waiting on an event in a spin loop, and the event can only be triggered by also being scheduled on this runner using the CAS
            queue. */
@@ -345,6 +527,72 @@ namespace Orly {
 
         inline void ScheduleFrameSlow(TRunner *other_runner, TFrame *frame);
 
+        /* Put a ready, stealable frame at the back of our steal deque. */
+        void PushStealable(TFrame *frame) {
+          assert(this);
+          assert(frame);
+          Base::TSpinLock::TLock lock(StealLock);
+          StealDeque.push_back(frame);
+          NumStealable.store(StealDeque.size(), std::memory_order_relaxed);
+        }
+
+        /* Take the oldest frame from our steal deque, or return null if it's empty. */
+        TFrame *PopStealable() {
+          assert(this);
+          if (!NumStealable.load(std::memory_order_relaxed)) {
+            return nullptr;
+          }
+          Base::TSpinLock::TLock lock(StealLock);
+          if (StealDeque.empty()) {
+            return nullptr;
+          }
+          TFrame *frame = StealDeque.front();
+          StealDeque.pop_front();
+          NumStealable.store(StealDeque.size(), std::memory_order_relaxed);
+          return frame;
+        }
+
+        /* Take the oldest stealable frame from the next runner in our group which has one, or return null if none do. */
+        TFrame *TrySteal();
+
+        /* Note that the given runner has put a frame on its outbound queue to us. */
+        void SetInboundBit(size_t runner_id) {
+          assert(this);
+          InboundBits[runner_id / 64UL].fetch_or(1UL << (runner_id % 64UL));
+        }
+
+        /* True iff. there's anything for us to do. */
+        bool HasWork() const;
+
+        /* Block until someone wakes us, unless there turns out to be work after all. */
+        void Park();
+
+        /* If we're parked, wake us and return true.  Call this after giving us work, from any thread.  The seq_cst
+           read of Parked here, paired with the seq_cst write in Park(), means either we see the work before blocking
+           or the caller sees us parked. */
+        bool TryWake() {
+          assert(this);
+          if (Parked.load() && Parked.exchange(false)) {
+            WakeSentAt.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
+            WakeSem.Push();
+            return true;
+          }
+          return false;
+        }
+
+        /* Wake us if we're parked, and otherwise a parked peer, so somebody gets to a new stealable frame soon. */
+        void WakeForStealable() {
+          assert(this);
+          assert(StealGroup);
+          if (!TryWake()) {
+            for (TRunner *peer: StealGroup->Members) {
+              if (peer != this && peer->TryWake()) {
+                break;
+              }
+            }
+          }
+        }
+
         /* TODO */
         //mutable TFrameQueue::TImpl MyFrameQueue;
         TFrame *ReadyToRunQueue;
@@ -371,6 +619,48 @@ namespace Orly {
 
         TRunner **RunnerArray;
 
+        /* The group we steal from and are stolen from, if any, and our position in it. */
+        TStealGroup *StealGroup;
+        size_t StealPos;
+
+        /* Ready frames which any runner in our group may run.  NumStealable lets thieves skip an empty deque without
+           taking the lock. */
+        Base::TSpinLock StealLock;
+        std::deque<TFrame *> StealDeque;
+        std::atomic<size_t> NumStealable;
+
+        /* A bit per runner, set when that runner has put frames on its outbound queue to us, so we don't have to poll
+           every runner's queue on every lap. */
+        const size_t NumInboundWords;
+        std::atomic<uint64_t> *InboundBits;
+
+        /* See SetMayPark(). */
+        bool MayPark;
+
+        /* True while we're blocked, or about to block, on WakeSem.  Whoever flips it back to false owes WakeSem a push,
+           and stamps WakeSentAt (in steady clock ticks) when it does. */
+        std::atomic<bool> Parked;
+        std::atomic<int64_t> WakeSentAt;
+        Base::TEventSemaphore WakeSem;
+
+        /* See TakeParkStats(). */
+        Base::TSpinLock ParkStatsLock;
+        TParkStats ParkStats;
+
+        /* See SetProfiling(). */
+        static std::atomic<bool> Profiling;
+
+        /* See accessor. */
+        std::atomic<const std::type_info *> CurrentKind;
+
+        /* The kind, queue wait and blocked time of the frame we've switched to, from OnSwitchIn(). */
+        const std::type_info *SwitchedKind;
+        int64_t SwitchedWaitTime, SwitchedBlockedTime;
+
+        /* See TakeProfile(). */
+        Base::TSpinLock ProfileLock;
+        TProfile Profile;
+
         /* Access to ComeBackSoon */
         friend class TFrame;
         friend class TFramePool;
@@ -397,15 +687,31 @@ namespace Orly {
         NO_COPY(TRunnerPool);
         public:
 
-        /* TODO */
+        /* Runs a worker's runner on its thread. Lets the owner do per-thread setup and teardown around the call to
+           Run(). */
+        using TLaunch = std::function<void (TRunner *)>;
+
+        /* If work_stealing is true, the workers form a steal group and frames scheduled through the pool may run on
+           whichever worker gets to them first. */
         TRunnerPool(TRunner::TRunnerCons &runner_cons,
-                    size_t num_worker)
-            : WorkerCount(num_worker), AssignPos(0UL) {
+                    size_t num_worker,
+                    const TLaunch &launch = TLaunch(),
+                    bool work_stealing = false)
+            : WorkerCount(num_worker), WorkStealing(work_stealing), AssignPos(0UL) {
           for (size_t i = 0; i < num_worker; ++i) {
             RunnerVec.emplace_back(new TRunner(runner_cons));
-            ThreadVec.emplace_back(new std::thread(std::bind([](TRunner *runner) {
-              runner->Run();
-            }, RunnerVec.back().get())));
+            if (work_stealing) {
+              StealGroup.Join(RunnerVec.back().get());
+            }
+          }
+          for (auto &runner : RunnerVec) {
+            ThreadVec.emplace_back(new std::thread(std::bind([launch](TRunner *runner) {
+              if (launch) {
+                launch(runner);
+              } else {
+                runner->Run();
+              }
+            }, runner.get())));
           }
         }
 
@@ -426,13 +732,26 @@ namespace Orly {
         }
 
         /* TODO */
-        inline void Schedule(TFrame *frame, TRunnable *runnable, const TRunnable::TFunc &func);
+        template <typename TRunnableImpl>
+        inline void Schedule(TFrame *frame, TRunnableImpl *runnable, const TRunnable::TFunc &func);
+
+        /* See TRunner::TStealGroup. */
+        size_t TakeNumSteals() {
+          assert(this);
+          return StealGroup.TakeNumSteals();
+        }
 
         private:
 
         /* TODO */
         const size_t WorkerCount;
 
+        /* True iff. our workers steal from one another. */
+        const bool WorkStealing;
+
+        /* The group our workers steal in, if WorkStealing. */
+        TRunner::TStealGroup StealGroup;
+
         /* TODO: use better data structure */
         std::vector<std::unique_ptr<TRunner>> RunnerVec;
         std::vector<std::unique_ptr<std::thread>> ThreadVec;
@@ -460,7 +779,11 @@ namespace Orly {
               Runnable(nullptr),
               //QueueMembership(this),
               InboundQueueNextFrame(nullptr),
-              ComeBackRightAway(false) {
+              ComeBackRightAway(false),
+              Stealable(false),
+              Kind(nullptr),
+              ReadyAt(0),
+              SwitchedOutAt(0) {
           create_fiber(MyFiber, StartFrame, this, stack_size);
         }
 
@@ -472,25 +795,45 @@ namespace Orly {
           free_fiber(MyFiber);
         }
 
-        /* TODO */
-        inline void Latch(TRunner *runner, TRunnable *runnable, TRunnable::TFunc runnable_func) {
+        /* TODO.  The type we're given the runnable as is its kind in the runners' profiles. */
+        template <typename TRunnableImpl>
+        inline void Latch(TRunner *runner, TRunnableImpl *runnable, TRunnable::TFunc runnable_func) {
           //printf("TFrame [%p] Latch runnable [%p]\n", this, runnable);
           CheckFrameUnwound();
           assert(Runnable == nullptr);
           assert(RunnableFunc == nullptr);
           Runnable = runnable;
           RunnableFunc = runnable_func;
+          Stealable = false;
+          SetKind(&typeid(TRunnableImpl));
+          runner->ScheduleFrame(this);
+        }
+
+        /* Like Latch(), but if the runner belongs to a steal group, any runner in the group may start the runnable.  Use
+           this only for runnables which don't care which runner they start on. */
+        template <typename TRunnableImpl>
+        inline void LatchStealable(TRunner *runner, TRunnableImpl *runnable, TRunnable::TFunc runnable_func) {
+          CheckFrameUnwound();
+          assert(Runnable == nullptr);
+          assert(RunnableFunc == nullptr);
+          Runnable = runnable;
+          RunnableFunc = runnable_func;
+          Stealable = true;
+          SetKind(&typeid(TRunnableImpl));
           runner->ScheduleFrame(this);
         }
 
         /* TODO */
-        inline void Latch(TRunnable *runnable, TRunnable::TFunc runnable_func) {
+        template <typename TRunnableImpl>
+        inline void Latch(TRunnableImpl *runnable, TRunnable::TFunc runnable_func) {
           //printf("TFrame [%p] Latch runnable [%p]\n", this, runnable);
           CheckFrameUnwound();
           assert(Runnable == nullptr);
           assert(RunnableFunc == nullptr);
           Runnable = runnable;
           RunnableFunc = runnable_func;
+          Stealable = false;
+          SetKind(&typeid(TRunnableImpl));
           TRunner::Schedule(this);
         }
 
@@ -506,6 +849,7 @@ namespace Orly {
         inline void YieldSlow() {
           assert(this);
           ComeBackRightAway = false;
+          TRunner::MarkReady(this);
           TRunner::LocalRunner->ScheduleFrameSlow(this);
           TRunner::Yield(MyFiber);
         }
@@ -580,6 +924,12 @@ namespace Orly {
 
         private:
 
+        /* Start profiling a new runnable of the given kind. */
+        inline void SetKind(const std::type_info *kind) {
+          Kind = kind;
+          SwitchedOutAt = 0;
+        }
+
         /* TODO */
         inline void CheckFrameUnwound() {
           /* this is where we make sure that our frame's stack unwound properly... */
@@ -614,6 +964,16 @@ namespace Orly {
         /* TODO */
         bool ComeBackRightAway;
 
+        /* True iff. we've been latched with LatchStealable() and haven't started running yet. */
+        bool Stealable;
+
+        /* The kind of our runnable, for the profile.  See TRunner::SetProfiling(). */
+        const std::type_info *Kind;
+
+        /* When we were last made ready to run, and when we last switched out (or 0 if our runnable hasn't run yet),
+           in steady clock ticks.  We only keep these while profiling. */
+        int64_t ReadyAt, SwitchedOutAt;
+
         /* MyFiber */
         friend class TFramePool;
         friend class TRunner;
@@ -976,10 +1336,15 @@ namespace Orly {
         *** Inline ***
         *************/
 
-      inline void TRunnerPool::Schedule(TFrame *frame, TRunnable *runnable, const TRunnable::TFunc &func) {
+      template <typename TRunnableImpl>
+      inline void TRunnerPool::Schedule(TFrame *frame, TRunnableImpl *runnable, const TRunnable::TFunc &func) {
         size_t prev_assignment_count = std::atomic_fetch_add(&AssignPos, 1UL);
         TRunner *const chosen_runner = RunnerVec[prev_assignment_count % WorkerCount].get();
-        frame->Latch(chosen_runner, runnable, func);
+        if (WorkStealing) {
+          frame->LatchStealable(chosen_runner, runnable, func);
+        } else {
+          frame->Latch(chosen_runner, runnable, func);
+        }
       }
 
       static inline void Yield() {
@@ -1036,6 +1401,13 @@ namespace Orly {
 
       };  // TSwitchToRunner
 
+      inline void TRunner::MarkReady(TFrame *frame) {
+        assert(frame);
+        if (unlikely(IsProfiling())) {
+          frame->ReadyAt = GetTicks();
+        }
+      }
+
       inline void TRunner::ScheduleFrameSlow(TFrame *frame) {
         assert(this);
         assert(frame);
@@ -1044,11 +1416,13 @@ namespace Orly {
           do {
             frame->InboundQueueNextFrame = outbound_queue;
           } while (!__sync_bool_compare_and_swap(&outbound_queue, frame->InboundQueueNextFrame, frame));
+          SetInboundBit(LocalRunner->RunnerId);
         } else {
           do {
             frame->InboundQueueNextFrame = InboundFrameQueue;
           } while (!__sync_bool_compare_and_swap(&InboundFrameQueue, frame->InboundQueueNextFrame, frame));
         }
+        TryWake();
       }
 
       inline void TRunner::ScheduleFrameSlow(TRunner *other_runner, TFrame *frame) {
@@ -1060,12 +1434,20 @@ namespace Orly {
         do {
           frame->InboundQueueNextFrame = outbound_queue;
         } while (!__sync_bool_compare_and_swap(&outbound_queue, frame->InboundQueueNextFrame, frame));
+        other_runner->SetInboundBit(RunnerId);
+        other_runner->TryWake();
       }
 
       inline void TRunner::ScheduleFrame(TFrame *frame) {
         assert(this);
         assert(frame);
-        if (this == LocalRunner) {
+        MarkReady(frame);
+        if (frame->Stealable && StealGroup) {
+          /* stealable frames skip the inbound queues, so our peers can see them even while we're busy running something
+             else */
+          PushStealable(frame);
+          WakeForStealable();
+        } else if (this == LocalRunner) {
           //printf("ScheduleFrame local\n");
           if (!frame->ComeBackRightAway) {
             frame->InboundQueueNextFrame = NewReadyToRunQueue;
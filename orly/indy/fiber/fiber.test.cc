@@ -18,8 +18,13 @@
 
 #include <orly/indy/fiber/fiber.h>
 
+#include <chrono>
 #include <condition_variable>
+#include <memory>
+#include <sstream>
 #include <thread>
+#include <typeindex>
+#include <vector>
 
 #include <unistd.h>
 
@@ -672,3 +677,219 @@ FIXTURE(Sem) {
   EXPECT_EQ(pos_counter, 5UL);
   EXPECT_EQ(accuracy_counter, 127UL);
 }
+
+/* Counts which runner it ran on.  If it's the blocker, it keeps its runner busy until everyone else has run. */
+class TStealRunnable
+    : public TRunnable {
+  NO_COPY(TStealRunnable);
+  public:
+
+  TStealRunnable(TRunner *runner, bool is_blocker, size_t num_others, std::atomic<size_t> &num_run, std::atomic<TRunner *> &ran_on)
+      : IsBlocker(is_blocker), NumOthers(num_others), NumRun(num_run), RanOn(ran_on) {
+    Frame = TFrame::LocalFramePool->Alloc();
+    try {
+      if (is_blocker) {
+        Frame->Latch(runner, this, static_cast<TRunnable::TFunc>(&TStealRunnable::Run));
+      } else {
+        Frame->LatchStealable(runner, this, static_cast<TRunnable::TFunc>(&TStealRunnable::Run));
+      }
+    } catch (...) {
+      TFrame::LocalFramePool->Free(Frame);
+      throw;
+    }
+  }
+
+  ~TStealRunnable() {
+    TFrame::LocalFramePool->Free(Frame);
+  }
+
+  void Run() {
+    if (IsBlocker) {
+      RanOn = TRunner::LocalRunner;
+      const auto give_up = chrono::steady_clock::now() + chrono::seconds(10);
+      while (NumRun < NumOthers && chrono::steady_clock::now() < give_up) {
+        this_thread::yield();
+      }
+      ++NumRun;
+    } else {
+      /* we should never run on the blocked runner */
+      if (TRunner::LocalRunner == RanOn) {
+        NumRun += NumOthers + 1;
+      } else {
+        ++NumRun;
+      }
+    }
+  }
+
+  private:
+
+  TFrame *Frame;
+
+  const bool IsBlocker;
+
+  const size_t NumOthers;
+
+  std::atomic<size_t> &NumRun;
+
+  std::atomic<TRunner *> &RanOn;
+
+};
+
+FIXTURE(StealGroup) {
+  const size_t num_others = 8UL;
+  const size_t stack_size = 1 * 1024 * 1024;
+  TRunner::TRunnerCons runner_cons(2UL);
+  TRunner runner_1(runner_cons);
+  TRunner runner_2(runner_cons);
+  TRunner::TStealGroup steal_group;
+  steal_group.Join(&runner_1);
+  steal_group.Join(&runner_2);
+  TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *> frame_pool_manager(num_others + 1, stack_size, &runner_1);
+  TFrame::LocalFramePool = new TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool(&frame_pool_manager);
+  std::atomic<size_t> num_run(0UL);
+  std::atomic<TRunner *> ran_on(nullptr);
+  try {
+    auto launch_fiber_sched = [&](TRunner *runner) {
+      runner->Run();
+    };
+    thread t1(std::bind(launch_fiber_sched, &runner_1));
+    thread t2(std::bind(launch_fiber_sched, &runner_2));
+    /* tie up runner 1, then give it work which only runner 2 is free to do */
+    vector<unique_ptr<TStealRunnable>> runnables;
+    runnables.emplace_back(new TStealRunnable(&runner_1, true, num_others, num_run, ran_on));
+    while (!ran_on) {
+      this_thread::yield();
+    }
+    for (size_t i = 0; i < num_others; ++i) {
+      runnables.emplace_back(new TStealRunnable(&runner_1, false, num_others, num_run, ran_on));
+    }
+    while (num_run <= num_others) {
+      this_thread::yield();
+    }
+    runner_1.ShutDown();
+    runner_2.ShutDown();
+    t1.join();
+    t2.join();
+    runnables.clear();
+  } catch (...) {
+    delete TFrame::LocalFramePool;
+    TFrame::LocalFramePool = nullptr;
+    throw;
+  }
+  delete TFrame::LocalFramePool;
+  TFrame::LocalFramePool = nullptr;
+  EXPECT_EQ(num_run, num_others + 1);
+  EXPECT_EQ(steal_group.TakeNumSteals(), num_others);
+  EXPECT_EQ(steal_group.TakeNumSteals(), 0UL);
+}
+
+class TProfiledRunnable
+    : public TRunnable {
+  NO_COPY(TProfiledRunnable);
+  public:
+
+  TProfiledRunnable(TRunner *runner, size_t num_yields, TSem &sem, std::atomic<bool> &popping, std::atomic<bool> &stop)
+      : NumYields(num_yields), Sem(sem), Popping(popping), Stop(stop), Done(false) {
+    Frame = TFrame::LocalFramePool->Alloc();
+    try {
+      Frame->Latch(runner, this, static_cast<TRunnable::TFunc>(&TProfiledRunnable::Run));
+    } catch (...) {
+      TFrame::LocalFramePool->Free(Frame);
+      throw;
+    }
+  }
+
+  ~TProfiledRunnable() {
+    TFrame::LocalFramePool->Free(Frame);
+  }
+
+  bool IsDone() const {
+    return Done;
+  }
+
+  void Run() {
+    for (size_t i = 0; i < NumYields; ++i) {
+      Yield();
+    }
+    Popping = true;
+    Sem.Pop();
+    while (!Stop) {
+      this_thread::yield();
+    }
+    Done = true;
+  }
+
+  private:
+
+  TFrame *Frame;
+
+  const size_t NumYields;
+
+  TSem &Sem;
+
+  std::atomic<bool> &Popping, &Stop, Done;
+
+};
+
+FIXTURE(Profile) {
+  const size_t num_yields = 5UL;
+  const size_t stack_size = 1 * 1024 * 1024;
+  TRunner::SetProfiling(true);
+  TRunner::TRunnerCons runner_cons(1);
+  TRunner runner(runner_cons);
+  TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *> frame_pool_manager(1, stack_size, &runner);
+  TFrame::LocalFramePool = new TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool(&frame_pool_manager);
+  stringstream samples;
+  try {
+    thread t1([&runner] { runner.Run(); });
+    TSem sem;
+    std::atomic<bool> popping(false), stop(false);
+    TProfiledRunnable runnable(&runner, num_yields, sem, popping, stop);
+    /* wait for it to block on the semaphore and switch out before we let it go */
+    while (!popping) {
+      this_thread::yield();
+    }
+    while (runner.GetCurrentKind()) {
+      this_thread::yield();
+    }
+    sem.Push();
+    while (!runner.GetCurrentKind()) {
+      this_thread::yield();
+    }
+    /* it spins until we stop it, so every sample finds it running */
+    TRunner::DumpSamples(samples, { &runner }, 10, chrono::milliseconds(1));
+    stop = true;
+    while (!runnable.IsDone()) {
+      this_thread::yield();
+    }
+    runner.ShutDown();
+    t1.join();
+  } catch (...) {
+    TRunner::SetProfiling(false);
+    delete TFrame::LocalFramePool;
+    TFrame::LocalFramePool = nullptr;
+    throw;
+  }
+  TRunner::SetProfiling(false);
+  delete TFrame::LocalFramePool;
+  TFrame::LocalFramePool = nullptr;
+  EXPECT_EQ(samples.str(), "runner_0;TProfiledRunnable 10\n");
+  TRunner::TProfile profile;
+  runner.TakeProfile(profile);
+  EXPECT_EQ(profile.ByKind.size(), 1UL);
+  const auto iter = profile.ByKind.find(type_index(typeid(TProfiledRunnable)));
+  if (EXPECT_TRUE(iter != profile.ByKind.end())) {
+    EXPECT_EQ(TRunner::GetKindName(iter->first), "TProfiledRunnable");
+    /* once to start, once after each yield and once after the semaphore */
+    EXPECT_EQ(iter->second.NumSwitches, num_yields + 2);
+    /* it was made ready only after it had switched out, so the semaphore counts as blocked time */
+    EXPECT_TRUE(iter->second.BlockedTime > chrono::nanoseconds::zero());
+  }
+  /* taking again adds nothing new */
+  runner.TakeProfile(profile);
+  EXPECT_EQ(profile.ByKind.size(), 1UL);
+  EXPECT_EQ(profile.ByKind[type_index(typeid(TProfiledRunnable))].NumSwitches, num_yields + 2);
+  TRunner::TProfile empty;
+  runner.TakeProfile(empty);
+  EXPECT_TRUE(empty.ByKind.empty());
+}
@@ -0,0 +1,335 @@
+/* <orly/indy/fiber/fiber.test.manual.cc>
+
+   Benchmark for <orly/indy/fiber/fiber.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/fiber/fiber.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Base;
+using namespace Orly::Indy::Fiber;
+
+static constexpr size_t NumRunners = 4UL;
+static constexpr size_t NumConnections = 16UL;
+static constexpr size_t NumRequests = 20000UL;
+static constexpr size_t MaxInFlight = 256UL;
+
+/* Connections are pinned to runners round-robin, the way TServer assigns them.  Connection 0 is the heavy client: its
+   requests cost HeavyCost, everyone else's cost LightCost. */
+static const nanoseconds HeavyCost = microseconds(400);
+static const nanoseconds LightCost = microseconds(20);
+
+/* The gap between requests, taken round-robin across connections.  This keeps the pool as a whole at about half load,
+   while the heavy client's runner alone is overloaded. */
+static const nanoseconds ArrivalGap = microseconds(40);
+
+/* One request from one connection.  Burns its cost on whichever runner gets it, records its latency and frees itself. */
+class TRequest
+    : public TRunnable {
+  NO_COPY(TRequest);
+  public:
+
+  TRequest(TRunner *runner, nanoseconds cost, nanoseconds &latency, atomic<size_t> &num_in_flight)
+      : FramePool(TFrame::LocalFramePool),
+        Cost(cost),
+        Latency(latency),
+        NumInFlight(num_in_flight),
+        Start(steady_clock::now()) {
+    TFrame *frame = FramePool->Alloc();
+    try {
+      frame->LatchStealable(runner, this, static_cast<TRunnable::TFunc>(&TRequest::Run));
+    } catch (...) {
+      FramePool->Free(frame);
+      throw;
+    }
+  }
+
+  void Run() {
+    const auto until = steady_clock::now() + Cost;
+    while (steady_clock::now() < until);
+    Latency = duration_cast<nanoseconds>(steady_clock::now() - Start);
+    --NumInFlight;
+    FreeMyFrame(FramePool);
+    delete this;
+  }
+
+  private:
+
+  TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool *FramePool;
+
+  const nanoseconds Cost;
+
+  nanoseconds &Latency;
+
+  atomic<size_t> &NumInFlight;
+
+  const steady_clock::time_point Start;
+
+};  // TRequest
+
+/* Records how long after its creation it got to run. */
+class TPing
+    : public TRunnable {
+  NO_COPY(TPing);
+  public:
+
+  TPing(TRunner *runner, nanoseconds &latency, atomic<bool> &done)
+      : FramePool(TFrame::LocalFramePool),
+        Latency(latency),
+        Done(done),
+        Start(steady_clock::now()) {
+    TFrame *frame = FramePool->Alloc();
+    try {
+      frame->Latch(runner, this, static_cast<TRunnable::TFunc>(&TPing::Run));
+    } catch (...) {
+      FramePool->Free(frame);
+      throw;
+    }
+  }
+
+  void Run() {
+    Latency = duration_cast<nanoseconds>(steady_clock::now() - Start);
+    auto *frame_pool = FramePool;
+    Done = true;
+    FreeMyFrame(frame_pool);
+    delete this;
+  }
+
+  private:
+
+  TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool *FramePool;
+
+  nanoseconds &Latency;
+
+  atomic<bool> &Done;
+
+  const steady_clock::time_point Start;
+
+};  // TPing
+
+/* Yields NumYields times, then signals it's done. */
+class TYielder
+    : public TRunnable {
+  NO_COPY(TYielder);
+  public:
+
+  static constexpr size_t NumYields = 1000000UL;
+
+  TYielder(TRunner *runner, atomic<bool> &done)
+      : FramePool(TFrame::LocalFramePool),
+        Done(done) {
+    TFrame *frame = FramePool->Alloc();
+    try {
+      frame->Latch(runner, this, static_cast<TRunnable::TFunc>(&TYielder::Run));
+    } catch (...) {
+      FramePool->Free(frame);
+      throw;
+    }
+  }
+
+  void Run() {
+    for (size_t i = 0; i < NumYields; ++i) {
+      Yield();
+    }
+    auto *frame_pool = FramePool;
+    Done = true;
+    FreeMyFrame(frame_pool);
+    delete this;
+  }
+
+  private:
+
+  TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool *FramePool;
+
+  atomic<bool> &Done;
+
+};  // TYielder
+
+/* The CPU time used so far by the whole process. */
+static nanoseconds GetProcessCpuTime() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return seconds(ts.tv_sec) + nanoseconds(ts.tv_nsec);
+}
+
+/* The given percentile of the given latencies, in microseconds. */
+static size_t GetPercentile(vector<nanoseconds> &latencies, size_t per_mille) {
+  assert(!latencies.empty());
+  sort(latencies.begin(), latencies.end());
+  return duration_cast<microseconds>(latencies[min((latencies.size() * per_mille) / 1000UL, latencies.size() - 1UL)]).count();
+}
+
+/* Run NumRequests through NumRunners runners, stealing or not, and print the latencies seen by the heavy client and
+   by everyone else. */
+static void Bench(bool work_stealing) {
+  TRunner::TRunnerCons runner_cons(NumRunners);
+  vector<unique_ptr<TRunner>> runners;
+  TRunner::TStealGroup steal_group;
+  for (size_t i = 0; i < NumRunners; ++i) {
+    runners.emplace_back(new TRunner(runner_cons));
+    if (work_stealing) {
+      steal_group.Join(runners.back().get());
+    }
+  }
+  TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *> frame_pool_manager(MaxInFlight, 64UL * 1024UL, runners[0].get());
+  TFrame::LocalFramePool = new TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool(&frame_pool_manager);
+  vector<thread> threads;
+  for (auto &runner: runners) {
+    threads.emplace_back([&runner] { runner->Run(); });
+  }
+  vector<nanoseconds> latencies(NumRequests);
+  atomic<size_t> num_in_flight(0UL);
+  auto next_arrival = steady_clock::now();
+  for (size_t i = 0; i < NumRequests; ++i) {
+    const size_t conn = i % NumConnections;
+    /* a runner frees a request's frame only after the request finishes, so leave each runner one frame of slack */
+    while (steady_clock::now() < next_arrival || num_in_flight >= MaxInFlight - NumRunners) {
+      this_thread::yield();
+    }
+    next_arrival += ArrivalGap;
+    ++num_in_flight;
+    new TRequest(runners[conn % NumRunners].get(), conn ? LightCost : HeavyCost, latencies[i], num_in_flight);
+  }
+  while (num_in_flight) {
+    this_thread::yield();
+  }
+  for (auto &runner: runners) {
+    runner->ShutDown();
+  }
+  for (auto &t: threads) {
+    t.join();
+  }
+  delete TFrame::LocalFramePool;
+  TFrame::LocalFramePool = nullptr;
+  /* split out the heavy client, the light clients sharing its runner, and everyone else */
+  vector<nanoseconds> heavy, neighbors, others;
+  for (size_t i = 0; i < NumRequests; ++i) {
+    const size_t conn = i % NumConnections;
+    (conn == 0 ? heavy : (conn % NumRunners) == 0 ? neighbors : others).push_back(latencies[i]);
+  }
+  const size_t num_steals = steal_group.TakeNumSteals();
+  auto report = [work_stealing, num_steals](const char *name, vector<nanoseconds> &latencies) {
+    cout << (work_stealing ? "stealing" : "pinned  ") << '\t' << name
+         << "\t[p50 " << GetPercentile(latencies, 500) << " us]"
+         << "\t[p99 " << GetPercentile(latencies, 990) << " us]"
+         << "\t[p99.9 " << GetPercentile(latencies, 999) << " us]"
+         << "\t[" << num_steals << " steals]" << endl;
+  };
+  report("heavy    ", heavy);
+  report("neighbors", neighbors);
+  report("others   ", others);
+}
+
+/* Let NumRunners runners sit idle for a second and print the CPU they burned, then ping them one at a time, a
+   millisecond apart, and print how long a ping took to start running. */
+static void BenchIdle(bool may_park) {
+  static constexpr size_t NumPings = 2000UL;
+  TRunner::TRunnerCons runner_cons(NumRunners);
+  vector<unique_ptr<TRunner>> runners;
+  for (size_t i = 0; i < NumRunners; ++i) {
+    runners.emplace_back(new TRunner(runner_cons));
+    runners.back()->SetMayPark(may_park);
+  }
+  TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *> frame_pool_manager(NumRunners * 2UL, 64UL * 1024UL, runners[0].get());
+  TFrame::LocalFramePool = new TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool(&frame_pool_manager);
+  vector<thread> threads;
+  for (auto &runner: runners) {
+    threads.emplace_back([&runner] { runner->Run(); });
+  }
+  /* give the runners time to run out of laps */
+  this_thread::sleep_for(milliseconds(100));
+  const auto cpu_start = GetProcessCpuTime();
+  this_thread::sleep_for(seconds(1));
+  const auto idle_cpu = GetProcessCpuTime() - cpu_start;
+  vector<nanoseconds> latencies(NumPings);
+  for (size_t i = 0; i < NumPings; ++i) {
+    this_thread::sleep_for(milliseconds(1));
+    atomic<bool> done(false);
+    new TPing(runners[i % NumRunners].get(), latencies[i], done);
+    while (!done) {
+      this_thread::yield();
+    }
+  }
+  for (auto &runner: runners) {
+    runner->ShutDown();
+  }
+  for (auto &t: threads) {
+    t.join();
+  }
+  delete TFrame::LocalFramePool;
+  TFrame::LocalFramePool = nullptr;
+  TRunner::TParkStats park_stats;
+  for (auto &runner: runners) {
+    runner->TakeParkStats(park_stats);
+  }
+  cout << (may_park ? "parking " : "polling ")
+       << "\t[idle CPU " << (duration_cast<duration<double>>(idle_cpu).count() * 100.0) << "% of a core]"
+       << "\t[wake p50 " << GetPercentile(latencies, 500) << " us]"
+       << "\t[wake p99 " << GetPercentile(latencies, 990) << " us]"
+       << "\t[" << park_stats.NumParks << " parks]" << endl;
+}
+
+/* Time a million yields on one runner, profiling or not, and print the cost of a switch. */
+static void BenchSwitch(bool profiling) {
+  TRunner::SetProfiling(profiling);
+  TRunner::TRunnerCons runner_cons(1UL);
+  TRunner runner(runner_cons);
+  TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *> frame_pool_manager(2UL, 64UL * 1024UL, &runner);
+  TFrame::LocalFramePool = new TThreadLocalGlobalPoolManager<TFrame, size_t, TRunner *>::TThreadLocalPool(&frame_pool_manager);
+  thread t([&runner] { runner.Run(); });
+  atomic<bool> done(false);
+  const auto start = steady_clock::now();
+  new TYielder(&runner, done);
+  while (!done) {
+    this_thread::yield();
+  }
+  const auto elapsed = steady_clock::now() - start;
+  runner.ShutDown();
+  t.join();
+  delete TFrame::LocalFramePool;
+  TFrame::LocalFramePool = nullptr;
+  TRunner::SetProfiling(false);
+  cout << (profiling ? "profiling" : "plain    ")
+       << "\t[" << (duration_cast<nanoseconds>(elapsed).count() / TYielder::NumYields) << " ns / switch]" << endl;
+}
+
+FIXTURE(Idle) {
+  BenchIdle(false);
+  BenchIdle(true);
+}
+
+FIXTURE(ProfilingOverhead) {
+  BenchSwitch(false);
+  BenchSwitch(true);
+}
+
+FIXTURE(SkewedLoad) {
+  Bench(false);
+  Bench(true);
+}
@@ -59,7 +59,7 @@ void TFileSync::Write(Io::TBinaryOutputStream &stream) const {
   stream << Context;
   stream << file_length;
   stream << sync_file.GetStartingBlockOffset();
-  TFileSyncReadFile::TInStream in_stream(HERE, Disk::Source::FileSync, Low, &sync_file, Engine->GetPageCache(), 0UL);
+  TFileSyncReadFile::TInStream in_stream(HERE, Disk::Source::FileSync, Low, &sync_file, Engine->GetPageCache(), 0UL, true /* dont_cache: we copy the file once and are done with it */);
   const size_t max_compressed = snappy::MaxCompressedLength(CopyBufSize);
   char CopyBuf[max_compressed];
   for (size_t i = 0; i < file_length; i+= CopyBufSize) {
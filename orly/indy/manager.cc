@@ -18,6 +18,8 @@
 
 #include <orly/indy/manager.h>
 
+#include <deque>
+
 #include <base/debug_log.h>
 #include <base/shutting_down.h>
 #include <orly/indy/file_sync.h>
@@ -41,6 +43,9 @@ const TUuid TManager::MinId("00000000-0000-0000-0000-000000000000");
 const TUuid TManager::MaxId("FFFFFFFF-FFFF-FFFF-FFFF-FFFFFFFFFFFF");
 const TUuid TManager::SystemRepoId("AAAAAAAA-AAAA-AAAA-AAAA-AAAAAAAAAAAA");
 
+const size_t TManager::MaxReplicationFrameBytes = 4UL * 1024UL * 1024UL;
+const size_t TManager::MaxReplicationFramesInFlight = 8UL;
+
 RECORD_ELEM(TManager::TSavedRepoObj, bool                               , IsSafe);
 RECORD_ELEM(TManager::TSavedRepoObj, TManager::TSavedRepoObj::TRootPath , RootPath);
 RECORD_ELEM(TManager::TSavedRepoObj, TManager::TSavedRepoObj::TOptSeq   , LowestSequenceNumber);
@@ -94,6 +99,22 @@ TManager::TManager(Disk::Util::TEngine *engine,
       ReplicationWork(false),
       ReplicationNextTime(chrono::steady_clock::now()),
       ReplicationDelay(replication_delay),
+      ReplicationCodec(Disk::Util::TCodec::Get(Disk::Util::TCodecKind::None)),
+      ReplicationQueuedSeq(0UL),
+      ReplicationAckedSeq(0UL),
+      NumReplicationFramesSent(0UL),
+      NumReplicationItemsSent(0UL),
+      NumReplicationRawBytesSent(0UL),
+      NumReplicationWireBytesSent(0UL),
+      NumReplicationFramesReceived(0UL),
+      NumReplicationRawBytesReceived(0UL),
+      NumReplicationWireBytesReceived(0UL),
+      NumReplicationFramesInFlight(0UL),
+      ReplicationSlaveLag(0UL),
+      NumBootstrapFiles(0UL),
+      NumBootstrapBytes(0UL),
+      BootstrapShipNs(0UL),
+      BootstrapCaughtUpNs(0UL),
       UpdateReplicationNotificationCb(update_replication_notification_cb),
       OnReplicateIndexIdCb(on_replicate_index_id),
       ForEachIndexIdCb(for_each_index_cb),
@@ -290,14 +311,39 @@ void TManager::RunReplicationWork() {
 
 void TManager::RunReplicateTransaction() {
   assert(this);
+  /* A frame we've sent to the slave, along with the items in it, which we hold on to until the slave acks. */
+  struct TInFlight {
+    std::shared_ptr<Rpc::TFuture<void>> Future;
+    std::unique_ptr<TReplicationQueue> Queue;
+    size_t Seq;
+  };
+  deque<TInFlight> in_flight;
+  /* Wait for the oldest frame in flight to be acked, then deliver its notifications. */
+  auto retire = [this, &in_flight]() {
+    TInFlight frame = move(in_flight.front());
+    in_flight.pop_front();
+    NumReplicationFramesInFlight = in_flight.size();
+    try {
+      frame.Future->Sync();
+      if (!static_cast<bool>(*frame.Future)) {
+        throw std::runtime_error("Future did not complete.");
+      }
+      ReplicationAckedSeq = frame.Seq;
+      OnReplicated(*frame.Queue);
+    } catch (const Rpc::TAnyFuture::TRemoteError &error) {
+      std::cout << "our future failed and we caught it : " << error.what() << std::endl;
+    }
+  };
   epoll_event event;
-  int timeout = -1;
-  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  size_t sent_seq = 0UL;
   for (;;) {
     try {
       lock_guard<mutex> epoll_lock(ReplicationEpollLock);
+      /* while frames are in flight, wake up now and then to collect their acks */
+      int timeout = in_flight.empty() ? -1 : static_cast<int>(ReplicationDelay.count());
+      int ret;
       for (;;) {
-        int ret = epoll_wait(ReplicationEpollFd, &event, 1, timeout);
+        ret = epoll_wait(ReplicationEpollFd, &event, 1, timeout);
         if (ret < 0 && errno == EINTR) {
           if (Base::IsShuttingDown()) {
             throw std::runtime_error("RunReplicateTransaction() Service Shutdown");
@@ -309,171 +355,90 @@ void TManager::RunReplicateTransaction() {
           break;
         }
       }
+      while (!in_flight.empty() && static_cast<bool>(*in_flight.front().Future)) {
+        retire();
+      }
+      if (!ret) {
+        continue;
+      }
       SleepUntil(ReplicationNextTime);
       ReplicationNextTime = chrono::steady_clock::now() + ReplicationDelay;
-      TReplicationStreamer replication_streamer;
       TState state_used;
       TReplicationQueue copy_queue;
       std::shared_ptr<TCommonContext> context;
       /* acquire Context lock */ {
         lock_guard<mutex> lock(ContextLock);
         state_used = State;
-        switch (State) {
-          case Solo : {
-            /* acquire Replication lock */ {
-              std::lock_guard<std::mutex> lock(ReplicationLock);
-              ReplicationSem.Pop();
-              copy_queue.Swap(ReplicationQueue);
-              assert(ReplicationQueue.IsEmpty());
-            }
-            break;
-          }
-          case Master : {
-            context = Context;
-            /* acquire Replication lock */ {
-              std::lock_guard<std::mutex> lock(ReplicationLock);
-              ReplicationSem.Pop();
-              copy_queue.Swap(ReplicationQueue);
-              assert(ReplicationQueue.IsEmpty());
-            }  // release Replication lock
-            try {
-              size_t num_trans_to_replicate = 0UL;
-              for (TReplicationQueue::TItemCollection::TCursor csr(copy_queue.GetItemCollection()); csr; ++csr, ++num_trans_to_replicate) {
-                switch (csr->GetKind()) {
-                  case TReplicationQueue::TReplicationItem::Repo : {
-                    replication_streamer.PushRepo(*reinterpret_cast<TRepoReplication *>(&*csr));
-                    break;
-                  }
-                  case TReplicationQueue::TReplicationItem::Durable : {
-                    replication_streamer.PushDurable(*reinterpret_cast<TDurableReplication *>(&*csr));
-                    break;
-                  }
-                  case TReplicationQueue::TReplicationItem::Transaction : {
-                    replication_streamer.PushTransaction(dynamic_cast<TTransactionReplication *>(&*csr)->GetReplica());
-                    break;
-                  }
-                  case TReplicationQueue::TReplicationItem::IndexId : {
-                    replication_streamer.PushIndexId(*reinterpret_cast<TIndexIdReplication *>(&*csr));
-                    break;
-                  }
-                }
-              }
-              if (num_trans_to_replicate > 10000UL) {
-                syslog(LOG_INFO, "Replicating [%ld] transactions", num_trans_to_replicate);
-              }
-            } catch (...) {
-              throw;
-            }
-            break;
-          }
-          case SyncSlave : {
-            /* acquire Replication lock */ {
-              std::lock_guard<std::mutex> lock(ReplicationLock);
-              ReplicationSem.Pop();
-              ReplicationQueue.Clear();
-            }
-            break;
-          }
-          case Slave : {
-            /* acquire Replication lock */ {
-              std::lock_guard<std::mutex> lock(ReplicationLock);
-              ReplicationSem.Pop();
-              ReplicationQueue.Clear();
-            }
-            break;
-          }
+        if (State == Master) {
+          context = Context;
         }
+        /* acquire Replication lock */ {
+          std::lock_guard<std::mutex> lock(ReplicationLock);
+          ReplicationSem.Pop();
+          copy_queue.Swap(ReplicationQueue);
+          assert(ReplicationQueue.IsEmpty());
+        }  // release Replication lock
       }  // release Context lock
-      switch (state_used) {
-        case Solo : {
-          break;
+      if (state_used != Master) {
+        /* there's no one to send these to */
+        for (TReplicationQueue::TItemCollection::TCursor csr(copy_queue.GetItemCollection()); csr; ++csr) {
+          ++sent_seq;
         }
-        case Master : {
-          if (!replication_streamer.IsEmpty()) {
-            try {
-              Base::TTimer timer;
-              //auto future = context->Write<void>(TSlave::PushNotificationsId, replication_streamer);
-              auto future = context->Write<void>(TSlave::PushNotificationsId, replication_streamer);
-              timer.Stop();
-              if (timer.GetTotal() < 1s) {
-                syslog(LOG_INFO, "Write TSlave::PushNotificationsId took [%fs]", ToSecondsDouble(timer.GetTotal()));
-              }
-              assert(future);
-              future->Sync();  // wait for the future to complete
-              if (!static_cast<bool>(*future)) {
-                throw std::runtime_error("Future did not complete.");
-              }
-              /* now apply all the necessary replication notifications. */
-              for (TReplicationQueue::TItemCollection::TCursor csr(copy_queue.GetItemCollection()); csr; ++csr) {
-                switch (csr->GetKind()) {
-                  case TReplicationQueue::TReplicationItem::Repo : {
-                    break;
-                  }
-                  case TReplicationQueue::TReplicationItem::Durable : {
-                    break;
-                  }
-                  case TReplicationQueue::TReplicationItem::IndexId : {
-                    break;
-                  }
-                  case TReplicationQueue::TReplicationItem::Transaction : {
-                    for (const auto &mutation : reinterpret_cast<TTransactionReplication *>(&*csr)->GetReplica().GetMutationList()) {
-                      switch (mutation.GetKind()) {
-                        case L1::TTransaction::TReplica::TMutation::Pusher: {
-                          if (mutation.GetRepoId() == GlobalPovId) {
-                            Base::TUuid session_id;
-                            try {
-                              Sabot::ToNative(*Sabot::State::TAny::TWrapper(mutation.GetUpdate().GetMetadata().NewState(mutation.GetUpdate().GetSuprena().get(), state_alloc)), session_id);
-                            } catch (const exception &ex) {
-                              syslog(LOG_ERR, "Exception while trying to access ession ID of update promoted to global: [%s]", ex.what());
-                            }
-                            Base::TUuid tracker_id;
-                            Sabot::ToNative(*Sabot::State::TAny::TWrapper(mutation.GetUpdate().GetId().NewState(mutation.GetUpdate().GetSuprena().get(), state_alloc)), tracker_id);
-                            //std::cout << "Calling UpdateReplicationNotificationCb() for global" << std::endl;
-                            UpdateReplicationNotificationCb(session_id, mutation.GetRepoId(), tracker_id);
-                          } else {
-                            Server::TMetaRecord meta_record;
-                            Sabot::ToNative(*Sabot::State::TAny::TWrapper(mutation.GetUpdate().GetMetadata().NewState(mutation.GetUpdate().GetSuprena().get(), state_alloc)), meta_record);
-                            /* TODO : when we start merging updates we need to notify all update tracker ids. */
-                            Base::TUuid tracker_id;
-                            Sabot::ToNative(*Sabot::State::TAny::TWrapper(mutation.GetUpdate().GetId().NewState(mutation.GetUpdate().GetSuprena().get(), state_alloc)), tracker_id);
-                            for (const auto &item: meta_record.GetEntryByUpdateId()) {
-                              const auto &entry = item.second;
-                              //std::cout << "Calling UpdateReplicationNotificationCb() for private" << std::endl;
-                              UpdateReplicationNotificationCb(entry.GetSessionId(), mutation.GetRepoId(), tracker_id);
-                            }
-                          }
-                          break;
-                        }
-                        case L1::TTransaction::TReplica::TMutation::Popper: {
-                          break;
-                        }
-                        case L1::TTransaction::TReplica::TMutation::Failer: {
-                          break;
-                        }
-                        case L1::TTransaction::TReplica::TMutation::Pauser: {
-                          break;
-                        }
-                        case L1::TTransaction::TReplica::TMutation::UnPauser: {
-                          break;
-                        }
-                      }
-                    }
-                    break;
-                  }
-                }
-              }
-            } catch (const Rpc::TAnyFuture::TRemoteError &error) {
-              std::cout << "our future failed and we caught it : " << error.what() << std::endl;
+        ReplicationAckedSeq = sent_seq;
+        continue;
+      }
+      /* Cut the queue into frames of about MaxReplicationFrameBytes each, keeping no more than
+         MaxReplicationFramesInFlight of them unacked at once. */
+      size_t num_trans_to_replicate = 0UL;
+      while (!copy_queue.IsEmpty()) {
+        TReplicationStreamer replication_streamer;
+        auto frame_queue = make_unique<TReplicationQueue>();
+        size_t num_items = 0UL;
+        do {
+          auto csr = copy_queue.GetItemCollection()->TryGetFirstMember();
+          switch (csr->GetKind()) {
+            case TReplicationQueue::TReplicationItem::Repo : {
+              replication_streamer.PushRepo(*reinterpret_cast<TRepoReplication *>(csr));
+              break;
+            }
+            case TReplicationQueue::TReplicationItem::Durable : {
+              replication_streamer.PushDurable(*reinterpret_cast<TDurableReplication *>(csr));
+              break;
+            }
+            case TReplicationQueue::TReplicationItem::Transaction : {
+              replication_streamer.PushTransaction(dynamic_cast<TTransactionReplication *>(csr)->GetReplica());
+              break;
+            }
+            case TReplicationQueue::TReplicationItem::IndexId : {
+              replication_streamer.PushIndexId(*reinterpret_cast<TIndexIdReplication *>(csr));
+              break;
             }
           }
-          break;
+          copy_queue.MoveFirstTo(*frame_queue);
+          ++num_items;
+        } while (!copy_queue.IsEmpty() && replication_streamer.GetNumPushedBytes() < MaxReplicationFrameBytes);
+        sent_seq += num_items;
+        num_trans_to_replicate += num_items;
+        replication_streamer.Seal(ReplicationCodec, sent_seq, ReplicationQueuedSeq);
+        while (in_flight.size() >= MaxReplicationFramesInFlight) {
+          retire();
         }
-        case SyncSlave : {
-          break;
-        }
-        case Slave : {
-          break;
+        Base::TTimer timer;
+        auto future = context->Write<void>(TSlave::PushNotificationsId, replication_streamer);
+        timer.Stop();
+        if (timer.GetTotal() > 1s) {
+          syslog(LOG_INFO, "Write TSlave::PushNotificationsId took [%fs]", ToSecondsDouble(timer.GetTotal()));
         }
+        assert(future);
+        in_flight.push_back(TInFlight{ future, move(frame_queue), sent_seq });
+        ++NumReplicationFramesSent;
+        NumReplicationItemsSent += num_items;
+        NumReplicationRawBytesSent += replication_streamer.GetNumRawBytes();
+        NumReplicationWireBytesSent += replication_streamer.GetNumWireBytes();
+        NumReplicationFramesInFlight = in_flight.size();
+      }
+      if (num_trans_to_replicate > 10000UL) {
+        syslog(LOG_INFO, "Replicating [%ld] transactions", num_trans_to_replicate);
       }
     } catch (const std::system_error &err) {
       if (WasInterrupted(err)) {
@@ -494,6 +459,91 @@ void TManager::RunReplicateTransaction() {
   DEBUG_LOG("RunReplicateTransaction() Exiting");
 }
 
+void TManager::OnReplicated(const TReplicationQueue &queue) {
+  assert(this);
+  assert(&queue);
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  for (TReplicationQueue::TItemCollection::TCursor csr(queue.GetItemCollection()); csr; ++csr) {
+    switch (csr->GetKind()) {
+      case TReplicationQueue::TReplicationItem::Repo : {
+        break;
+      }
+      case TReplicationQueue::TReplicationItem::Durable : {
+        break;
+      }
+      case TReplicationQueue::TReplicationItem::IndexId : {
+        break;
+      }
+      case TReplicationQueue::TReplicationItem::Transaction : {
+        for (const auto &mutation : reinterpret_cast<TTransactionReplication *>(&*csr)->GetReplica().GetMutationList()) {
+          switch (mutation.GetKind()) {
+            case L1::TTransaction::TReplica::TMutation::Pusher: {
+              if (mutation.GetRepoId() == GlobalPovId) {
+                Base::TUuid session_id;
+                try {
+                  Sabot::ToNative(*Sabot::State::TAny::TWrapper(mutation.GetUpdate().GetMetadata().NewState(mutation.GetUpdate().GetSuprena().get(), state_alloc)), session_id);
+                } catch (const exception &ex) {
+                  syslog(LOG_ERR, "Exception while trying to access ession ID of update promoted to global: [%s]", ex.what());
+                }
+                Base::TUuid tracker_id;
+                Sabot::ToNative(*Sabot::State::TAny::TWrapper(mutation.GetUpdate().GetId().NewState(mutation.GetUpdate().GetSuprena().get(), state_alloc)), tracker_id);
+                UpdateReplicationNotificationCb(session_id, mutation.GetRepoId(), tracker_id);
+              } else {
+                Server::TMetaRecord meta_record;
+                Sabot::ToNative(*Sabot::State::TAny::TWrapper(mutation.GetUpdate().GetMetadata().NewState(mutation.GetUpdate().GetSuprena().get(), state_alloc)), meta_record);
+                /* An update may carry the entries of several merged ones (such as an atomic TryBatch), each tracked by its own id. */
+                for (const auto &item: meta_record.GetEntryByUpdateId()) {
+                  const auto &entry = item.second;
+                  UpdateReplicationNotificationCb(entry.GetSessionId(), mutation.GetRepoId(), item.first);
+                }
+              }
+              break;
+            }
+            case L1::TTransaction::TReplica::TMutation::Popper: {
+              break;
+            }
+            case L1::TTransaction::TReplica::TMutation::Failer: {
+              break;
+            }
+            case L1::TTransaction::TReplica::TMutation::Pauser: {
+              break;
+            }
+            case L1::TTransaction::TReplica::TMutation::UnPauser: {
+              break;
+            }
+          }
+        }
+        break;
+      }
+    }
+  }
+}
+
+void TManager::GetBootstrapStats(TBootstrapStats &out) const {
+  assert(this);
+  assert(&out);
+  out.NumFiles = NumBootstrapFiles;
+  out.NumBytes = NumBootstrapBytes;
+  out.ShipTime = chrono::nanoseconds(BootstrapShipNs);
+  out.TimeToCaughtUp = chrono::nanoseconds(BootstrapCaughtUpNs);
+}
+
+void TManager::TakeReplicationStats(TReplicationStats &out) {
+  assert(this);
+  assert(&out);
+  out.NumFramesSent = NumReplicationFramesSent.exchange(0UL);
+  out.NumItemsSent = NumReplicationItemsSent.exchange(0UL);
+  out.NumRawBytesSent = NumReplicationRawBytesSent.exchange(0UL);
+  out.NumWireBytesSent = NumReplicationWireBytesSent.exchange(0UL);
+  out.NumFramesReceived = NumReplicationFramesReceived.exchange(0UL);
+  out.NumRawBytesReceived = NumReplicationRawBytesReceived.exchange(0UL);
+  out.NumWireBytesReceived = NumReplicationWireBytesReceived.exchange(0UL);
+  out.NumFramesInFlight = NumReplicationFramesInFlight;
+  const size_t queued_seq = ReplicationQueuedSeq, acked_seq = ReplicationAckedSeq;
+  out.MasterLag = (queued_seq > acked_seq) ? (queued_seq - acked_seq) : 0UL;
+  out.SlaveLag = ReplicationSlaveLag;
+}
+
 TManager::TMaster::TMaster(TManager *manager, const TFd &fd)
     : TMasterContext(fd), Manager(manager) {}
 
@@ -566,7 +616,11 @@ TFileSync TManager::TMaster::SyncFile(const Base::TUuid &file_id, size_t gen_id,
 }
 
 TManager::TSlave::TSlave(TManager *manager, const TFd &fd)
-    : TSlaveContext(fd), Manager(manager), SlushCoreVec(new TCoreVectorBuilder()), Flusher(make_shared<TFlusher>(Manager->GetEngine())) {}
+    : TSlaveContext(fd),
+      Manager(manager),
+      SlushCoreVec(new TCoreVectorBuilder()),
+      Flusher(make_shared<TFlusher>(Manager->GetEngine())),
+      ConnectTime(chrono::steady_clock::now()) {}
 
 TManager::TSlave::~TSlave() {}
 
@@ -650,20 +704,30 @@ void TManager::TSlave::SyncInventory() {
         if (my_lowest > std::get<0>(view_def[0])) {
           PullUpdateRange(repo_id, repo, my_lowest + 1, std::get<0>(view_def[0]) - 1);
         }
-        /* fill in the middle disk files */
+        /* fill in the middle disk files.  We ask for all of them up front, so the master streams them to us back to back
+           rather than waiting on a round trip per file. */
         TSequenceNumber highest_filled = 0UL;
+        Base::TTimer ship_timer;
+        std::vector<std::pair<std::shared_ptr<Rpc::TFuture<TFileSync>>, const TMaster::TFileTuple *>> file_futures;
         for (const auto &view_file : view_def) {
           if (std::get<0>(view_file) >= my_lowest && std::get<1>(view_file) <= *highest) {
             highest_filled = std::max(highest_filled, std::get<1>(view_file));
             syslog(LOG_INFO, "sync file [%ld] for [%ld -> %ld] with service [%p]", std::get<2>(view_file), std::get<0>(view_file), std::get<1>(view_file), Manager->GetEngine());
             auto file_future = Write<TFileSync>(TMaster::SyncFileId, repo_id, std::get<2>(view_file), reinterpret_cast<size_t>(Manager->GetEngine()));
             assert(file_future);
-            TFileSync file = **file_future;
-            repo->AddSyncedFileToRepo(file.GetStartingBlockId(), file.GetStartingBlockOffset(), file.GetFileLength(), std::get<0>(view_file), std::get<1>(view_file), std::get<3>(view_file));
-            repo->UseSequenceNumbers((std::get<1>(view_file) - std::get<0>(view_file)) + 1);
-            //std::cout << "UseSequenceNumbers[" << ((std::get<1>(view_file) - std::get<0>(view_file)) + 1) << "]" << std::endl;
+            file_futures.emplace_back(file_future, &view_file);
           }
         }
+        for (const auto &item : file_futures) {
+          const TMaster::TFileTuple &view_file = *item.second;
+          TFileSync file = **item.first;
+          repo->AddSyncedFileToRepo(file.GetStartingBlockId(), file.GetStartingBlockOffset(), file.GetFileLength(), std::get<0>(view_file), std::get<1>(view_file), std::get<3>(view_file));
+          repo->UseSequenceNumbers((std::get<1>(view_file) - std::get<0>(view_file)) + 1);
+          ++(Manager->NumBootstrapFiles);
+          Manager->NumBootstrapBytes += file.GetFileLength();
+        }
+        ship_timer.Stop();
+        Manager->BootstrapShipNs += chrono::duration_cast<chrono::nanoseconds>(ship_timer.GetTotal()).count();
         /* do we need to fill the end? if highest > highest_filled */
         if (*highest > highest_filled) {
           PullUpdateRange(repo_id, repo, highest_filled + 1, *highest);
@@ -829,6 +893,9 @@ void TManager::TSlave::PushNotifications(const TReplicationStreamer &replication
   assert(Indy::Fiber::TRunner::LocalRunner);
   Indy::Fiber::TSwitchToRunner RunnerSwitcher(Manager->BGFastRunner);
   void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  ++(Manager->NumReplicationFramesReceived);
+  Manager->NumReplicationRawBytesReceived += replication_streamer.GetNumRawBytes();
+  Manager->NumReplicationWireBytesReceived += replication_streamer.GetNumWireBytes();
   /* acquire Context lock */ {
     std::lock_guard<std::mutex> lock(Manager->ContextLock);
     switch (Manager->State) {
@@ -878,7 +945,7 @@ void TManager::TSlave::PushNotifications(const TReplicationStreamer &replication
               ++durable_iter;
               Sabot::ToNative(*Sabot::State::TAny::TWrapper(durable_iter->NewState(durable_arena, state_alloc)), serialized_obj);
               Durable::TSem sem;
-              Manager->DurableManager->Save(durable_id, TDeadline(now + durable_ttl), durable_ttl, serialized_obj, &sem);
+              Manager->DurableManager->Save(durable_id, TDeadline(now + durable_ttl), durable_ttl, make_shared<const string>(move(serialized_obj)), &sem);
             }
           }
           /* Store the transaction changes next */ {
@@ -960,7 +1027,7 @@ void TManager::TSlave::PushNotifications(const TReplicationStreamer &replication
               ++durable_iter;
               Sabot::ToNative(*Sabot::State::TAny::TWrapper(durable_iter->NewState(durable_arena, state_alloc)), serialized_obj);
               Durable::TSem sem;
-              Manager->DurableManager->Save(durable_id, TDeadline(now + durable_ttl), durable_ttl, serialized_obj, &sem);
+              Manager->DurableManager->Save(durable_id, TDeadline(now + durable_ttl), durable_ttl, make_shared<const string>(move(serialized_obj)), &sem);
             }
           }
           /* Apply the transactions next */
@@ -981,6 +1048,8 @@ void TManager::TSlave::PushNotifications(const TReplicationStreamer &replication
       }
     }
   }
+  const size_t seq = replication_streamer.GetSeq(), queued_seq = replication_streamer.GetQueuedSeq();
+  Manager->ReplicationSlaveLag = (queued_seq > seq) ? (queued_seq - seq) : 0UL;
 }
 
 size_t TManager::TSlave::ApplyCoreVectorTransactions(const std::vector<TCore> &core_vec, TCore::TArena *arena) {
@@ -1091,6 +1160,7 @@ void TManager::TSlave::TransitionToSlave() {
           Flusher.reset();
 
           std::cout << "TSlave::TransitionToSlave() changing state" << std::endl;
+          Manager->BootstrapCaughtUpNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - ConnectTime).count();
           Manager->State = Slave;
           Manager->StateChangeCb(Slave);
           break;
@@ -1440,6 +1510,7 @@ void TManager::Enqueue(TTransactionReplication *transaction_replication, L1::TTr
     ReplicationSem.Push();
   }
   ReplicationQueue.Insert(transaction_replication);
+  ++ReplicationQueuedSeq;
 }
 
 void TManager::Enqueue(TRepoReplication *repo_replication) NO_THROW {
@@ -1449,6 +1520,7 @@ void TManager::Enqueue(TRepoReplication *repo_replication) NO_THROW {
     ReplicationSem.Push();
   }
   ReplicationQueue.Insert(repo_replication);
+  ++ReplicationQueuedSeq;
 }
 
 void TManager::EnqueueDurable(TDurableReplication *durable_replication) NO_THROW {
@@ -1458,6 +1530,7 @@ void TManager::EnqueueDurable(TDurableReplication *durable_replication) NO_THROW
     ReplicationSem.Push();
   }
   ReplicationQueue.Insert(durable_replication);
+  ++ReplicationQueuedSeq;
 }
 
 void TManager::Enqueue(TIndexIdReplication *index_replication) NO_THROW {
@@ -1468,9 +1541,10 @@ void TManager::Enqueue(TIndexIdReplication *index_replication) NO_THROW {
     ReplicationSem.Push();
   }
   ReplicationQueue.Insert(index_replication);
+  ++ReplicationQueuedSeq;
 }
 
-TDurableReplication *TManager::NewDurableReplication(const Base::TUuid &id, const TTtl &ttl, const std::string &serialized_form) const {
+TDurableReplication *TManager::NewDurableReplication(const Base::TUuid &id, const TTtl &ttl, const Durable::TBlob &serialized_form) const {
   assert(this);
   return new TDurableReplication(id, ttl, serialized_form);
 }
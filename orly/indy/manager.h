@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <thread>
 
@@ -143,6 +144,60 @@ namespace Orly {
         DurableManager = durable_manager;
       }
 
+      /* A snapshot of the replication counters.  See TakeReplicationStats().  Lags are measured in replication items
+         (transactions, repos, durables and index ids), which are numbered in the order the master queues them. */
+      struct TReplicationStats {
+
+        /* Frames we've sent to the slave, their items, and their sizes before compression and on the wire. */
+        size_t NumFramesSent;
+        size_t NumItemsSent;
+        size_t NumRawBytesSent;
+        size_t NumWireBytesSent;
+
+        /* Frames we've received from the master, and their sizes before compression and on the wire. */
+        size_t NumFramesReceived;
+        size_t NumRawBytesReceived;
+        size_t NumWireBytesReceived;
+
+        /* Frames sent to the slave which it has yet to ack.  (This is a gauge, not a counter.) */
+        size_t NumFramesInFlight;
+
+        /* As master, the items queued which the slave has yet to ack.  As slave, the items the master had queued, but
+           not yet sent, when it sealed the last frame we applied.  (These are gauges, not counters.) */
+        size_t MasterLag;
+        size_t SlaveLag;
+
+      };  // TReplicationStats
+
+      /* Copy out our replication counters and reset them, except for the gauges. */
+      void TakeReplicationStats(TReplicationStats &out);
+
+      /* How our bootstrap from the master went, if we started as a slave.  These are totals, never reset. */
+      struct TBootstrapStats {
+
+        /* Sealed data files shipped from the master, and their total size. */
+        size_t NumFiles;
+        size_t NumBytes;
+
+        /* The time spent shipping them. */
+        std::chrono::nanoseconds ShipTime;
+
+        /* The time from connecting to the master until we caught up with it and became a slave.  Zero until then. */
+        std::chrono::nanoseconds TimeToCaughtUp;
+
+      };  // TBootstrapStats
+
+      /* Copy out our bootstrap stats. */
+      void GetBootstrapStats(TBootstrapStats &out) const;
+
+      /* The codec with which we compress the replication frames we send.  Each frame records its codec, so the slave
+         needn't be told. */
+      inline void SetReplicationCodec(const Disk::Util::TCodec *codec) {
+        assert(this);
+        assert(codec);
+        ReplicationCodec = codec;
+      }
+
       /* TODO */
       static const Base::TUuid MinId;
       static const Base::TUuid MaxId;
@@ -150,6 +205,13 @@ namespace Orly {
 
       private:
 
+      /* We cut the replication queue into frames of about this many bytes (before compression), so one big burst
+         doesn't become one giant message. */
+      static const size_t MaxReplicationFrameBytes;
+
+      /* The number of frames we'll have sent to the slave without hearing back before we stop and wait for acks. */
+      static const size_t MaxReplicationFramesInFlight;
+
       enum TTransactionPushType {
         Meta,
         Id,
@@ -273,7 +335,7 @@ namespace Orly {
 
       /* TODO */
       class TSlave
-          : public TSlaveContext, Indy::Fiber::TRunnable {
+          : public TSlaveContext, public Indy::Fiber::TRunnable {
         NO_COPY(TSlave);
         public:
 
@@ -491,6 +553,9 @@ namespace Orly {
         /* TODO */
         std::shared_ptr<TFlusher> Flusher;
 
+        /* When we connected to the master.  See TBootstrapStats::TimeToCaughtUp. */
+        std::chrono::steady_clock::time_point ConnectTime;
+
       };  // TSlave
 
       /* TODO */
@@ -557,7 +622,7 @@ namespace Orly {
       virtual void EnqueueDurable(TDurableReplication *durable_replication) NO_THROW override;
 
       /* TOOD */
-      virtual TDurableReplication *NewDurableReplication(const Base::TUuid &id, const TTtl &ttl, const std::string &serialized_form) const override;
+      virtual TDurableReplication *NewDurableReplication(const Base::TUuid &id, const TTtl &ttl, const Durable::TBlob &serialized_form) const override;
 
       /* TODO */
       virtual void DeleteDurableReplication(TDurableReplication *durable_replication) NO_THROW override;
@@ -629,6 +694,34 @@ namespace Orly {
       /* TODO */
       std::chrono::milliseconds ReplicationDelay;
 
+      /* Called once the slave has acked the frame carrying these items. */
+      void OnReplicated(const TReplicationQueue &queue);
+
+      /* See SetReplicationCodec(). */
+      const Disk::Util::TCodec *ReplicationCodec;
+
+      /* The number of replication items ever queued, and the number of those the slave has acked (or which we
+         dropped because we had no slave). */
+      std::atomic<size_t> ReplicationQueuedSeq;
+      std::atomic<size_t> ReplicationAckedSeq;
+
+      /* See TReplicationStats. */
+      std::atomic<size_t> NumReplicationFramesSent;
+      std::atomic<size_t> NumReplicationItemsSent;
+      std::atomic<size_t> NumReplicationRawBytesSent;
+      std::atomic<size_t> NumReplicationWireBytesSent;
+      std::atomic<size_t> NumReplicationFramesReceived;
+      std::atomic<size_t> NumReplicationRawBytesReceived;
+      std::atomic<size_t> NumReplicationWireBytesReceived;
+      std::atomic<size_t> NumReplicationFramesInFlight;
+      std::atomic<size_t> ReplicationSlaveLag;
+
+      /* See TBootstrapStats.  Times are in nanoseconds. */
+      std::atomic<size_t> NumBootstrapFiles;
+      std::atomic<size_t> NumBootstrapBytes;
+      std::atomic<size_t> BootstrapShipNs;
+      std::atomic<size_t> BootstrapCaughtUpNs;
+
       /* TODO */
       std::function<void (const Base::TUuid &, const Base::TUuid &, const Base::TUuid &)> UpdateReplicationNotificationCb;
 
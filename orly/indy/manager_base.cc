@@ -20,6 +20,8 @@
 
 #include <sys/syscall.h>
 
+#include <thread>
+
 #include <base/assert_true.h>
 #include <base/cpu_clock.h>
 #include <base/shutting_down.h>
@@ -209,7 +211,7 @@ TManager::TManager(Disk::Util::TEngine *engine,
                    const std::vector<size_t> &merge_mem_cores,
                    const std::vector<size_t> &merge_disk_cores,
                    bool /*create_new*/)
-    :
+    : MergeMemCommit(merge_mem_delay, MaxMergeMemBatchSize),
       Scheduler(scheduler),
       ShuttingDown(false),
       AllowTailing(allow_tailing),
@@ -217,6 +219,7 @@ TManager::TManager(Disk::Util::TEngine *engine,
       LayerCleanerTimer(layer_cleaning_interval),
       MergeMemQueue(this),
       MergeDiskQueue(this),
+      MergeDiskQueueGen(0UL),
       MergeMemDelay(merge_mem_delay),
       MergeDiskDelay(merge_disk_delay),
       BlockSlotsAvailablePerMerger(block_slots_available_per_merger),
@@ -226,11 +229,15 @@ TManager::TManager(Disk::Util::TEngine *engine,
       MergeMemCores(merge_mem_cores),
       MergeDiskCores(merge_disk_cores),
       TetrisManager(nullptr),
+      MergeWorkerPool(nullptr),
+      MaxMergeDiskShare(1.0),
       OnCloseCb(std::bind(&TManager::OnClose, this, std::placeholders::_1)) {}
 
 TManager::~TManager() {
   RemoveLayersFromQueue(); /* get rid of any layers pushed by the removal of the system repo (predtor) */
   ShuttingDown = true;
+  MergeMemQueueChanged.notify_all();
+  MergeDiskQueueChanged.notify_all();
 }
 
 void TManager::CloseAllUnreferencedObjects() {
@@ -273,6 +280,16 @@ void TManager::SetTetrisManager(Orly::Server::TTetrisManager *tetris_manager) {
   TetrisManager = tetris_manager;
 }
 
+Orly::Indy::Fiber::TRunnerPool *TManager::GetMergeWorkerPool() const {
+  return MergeWorkerPool;
+}
+
+void TManager::SetMergeWorkerPool(Fiber::TRunnerPool *merge_worker_pool) {
+  assert(this);
+  assert(MergeWorkerPool == nullptr);
+  MergeWorkerPool = merge_worker_pool;
+}
+
 void TManager::CompactOpemMap() {
   assert(this);
   //throw std::logic_error("TODO: Implement CompactOpenMap()");
@@ -306,10 +323,7 @@ void TManager::RunMergeMem() {
     Disk::Util::TDiskController::TEvent::LocalEventPool = new TThreadLocalGlobalPoolManager<Disk::Util::TDiskController::TEvent>::TThreadLocalPool(Disk::Util::TDiskController::TEvent::DiskEventPoolManager.get());
   }
 
-  bool should_sleep = true;
-  steady_clock::time_point deadline;
-
-    TRepo *repo = nullptr;
+  TRepo *repo = nullptr;
   /* Register ourselves for CPU time collection */ {
     lock_guard<mutex> lock(MergeThreadCPUMutex);
     MergeMemThreadCPUMap.insert(make_pair(pthread_self(), cpu_clock::now()));
@@ -317,41 +331,33 @@ void TManager::RunMergeMem() {
   while(!ShuttingDown) {
     /* we can only have 1 thread waiting on MergeMemSem at a time */ {
       lock_guard<mutex> epoll_lock(MergeMemEpollLock);
-      if (should_sleep) {
-        SleepUntil(deadline);
-      }
       MergeMemSem.Pop();
     }
     /* acquire MergeMem lock */ {
-      std::lock_guard<std::mutex> lock(MergeMemLock);
+      std::unique_lock<std::mutex> lock(MergeMemLock);
       repo = MergeMemQueue.TryGetFirstMember();
-      if (repo && !ShuttingDown) {
-        deadline = repo->GetTimeOfNextMergeMem();
-        bool cont = false;
-        auto now = steady_clock::now();
-        if (deadline < now) {
-          should_sleep = true;
-          cont = true;
-        } else {
-          repo->SetTimeOfNextMergeMem(now + MergeMemDelay);
-          repo->MergeMemMembership.Remove();
-        }
-        if (!MergeMemQueue.IsEmpty()) {
-          MergeMemSem.Push();
-        }
-        if (cont) {
-          continue;
-        }
-      } else {
-        should_sleep = false;
+      if (!repo || ShuttingDown) {
         continue;
       }
+      const auto deadline = repo->GetTimeOfNextMergeMem();
+      if (steady_clock::now() < deadline) {
+        /* The soonest repo isn't due yet.  Leave the sem up for whoever looks next and wait until the repo is due or
+           EnqueueMergeMem() moves something sooner, then look again.  This is a dedicated runner, so it's all right to
+           block the thread. */
+        MergeMemSem.Push();
+        MergeMemQueueChanged.wait_until(lock, deadline);
+        continue;
+      }
+      repo->MergeMemMembership.Remove();
+      if (!MergeMemQueue.IsEmpty()) {
+        MergeMemSem.Push();
+      }
     }  // release MergeMem lock
     assert(repo);
     try {
       repo->StepMergeMem();
     } catch (...) {
-      EnqueueMergeMem(repo);
+      EnqueueMergeMem(repo, steady_clock::now() + MergeMemDelay);
       throw;
     }
   }
@@ -375,8 +381,6 @@ void TManager::RunMergeDisk() {
     assert(!Disk::Util::TDiskController::TEvent::LocalEventPool);
     Disk::Util::TDiskController::TEvent::LocalEventPool = new TThreadLocalGlobalPoolManager<Disk::Util::TDiskController::TEvent>::TThreadLocalPool(Disk::Util::TDiskController::TEvent::DiskEventPoolManager.get());
   }
-  bool should_sleep = true;
-  steady_clock::time_point deadline;
   TRepo *repo = nullptr;
   /* Register ourselves for CPU time collection */ {
     lock_guard<mutex> lock(MergeThreadCPUMutex);
@@ -386,44 +390,51 @@ void TManager::RunMergeDisk() {
   while (!ShuttingDown) {
     /* we can only have 1 thread waiting on MergeDiskSem at a time */ {
       Fiber::TFiberLock::TLock lock(MergeDiskEpollLock);
-      if (should_sleep) {
-        SleepUntil(deadline);
-        /* TODO: we need a fiber way to sleep instead of doing nanosleep. doesn't matter so much in this case since it's a dedicated runner. */
-      }
       MergeDiskSem.Pop();
     }
+    bool is_due;
+    steady_clock::time_point deadline;
+    size_t queue_gen = 0UL;
     /* acquire MergeDisk lock */ {
       Fiber::TFiberLock::TLock lock(MergeDiskLock);
       repo = MergeDiskQueue.TryGetFirstMember();
-      if (repo && !ShuttingDown) {
-        deadline = repo->GetTimeOfNextMergeDisk();
-        bool cont = false;
-        auto now = steady_clock::now();
-        if (deadline < now) {
-          should_sleep = true;
-          cont = true;
-        } else {
-          repo->SetTimeOfNextMergeDisk(now + MergeDiskDelay);
-          repo->MergeDiskMembership.Remove();
-        }
-        if (!MergeDiskQueue.IsEmpty()) {
-          MergeDiskSem.Push();
-        }
-        if (cont) {
-          continue;
-        }
-      } else {
-        should_sleep = false;
+      if (!repo || ShuttingDown) {
         continue;
       }
+      deadline = repo->GetTimeOfNextMergeDisk();
+      is_due = (steady_clock::now() >= deadline);
+      if (is_due) {
+        repo->MergeDiskMembership.Remove();
+      } else {
+        /* The queue is in order by the times the cost model picked, so nobody else is due either.  Note where the queue
+           stands, so we can wait below for it to change. */
+        std::lock_guard<std::mutex> wait_lock(MergeDiskWaitMutex);
+        queue_gen = MergeDiskQueueGen;
+      }
+      if (!MergeDiskQueue.IsEmpty()) {
+        MergeDiskSem.Push();
+      }
     }  // release MergeDisk lock
+    if (!is_due) {
+      /* Wait until the repo is due or EnqueueMergeDisk() moves something sooner, then look again.  This is a dedicated
+         runner, so it's all right to block the thread. */
+      std::unique_lock<std::mutex> wait_lock(MergeDiskWaitMutex);
+      MergeDiskQueueChanged.wait_until(
+          wait_lock, deadline, [this, queue_gen] { return MergeDiskQueueGen != queue_gen || ShuttingDown; });
+      continue;
+    }
     assert(repo);
+    const auto start = steady_clock::now();
     try {
       repo->StepMergeDisk(BlockSlotsAvailablePerMerger);
     } catch (...) {
       EnqueueMergeDisk(repo);
       throw;
     }
+    /* Rest long enough that this runner spends no more than its share of the time merging. */
+    if (MaxMergeDiskShare < 1.0) {
+      this_thread::sleep_for((steady_clock::now() - start) * ((1.0 - MaxMergeDiskShare) / MaxMergeDiskShare));
+    }
   }
   /* De-Register ourselves for CPU time collection */ {
     lock_guard<mutex> lock(MergeThreadCPUMutex);
@@ -431,6 +442,43 @@ void TManager::RunMergeDisk() {
   }
 }
 
+void TManager::RunMergeWorker(Fiber::TRunner *runner) {
+  assert(this);
+  assert(runner);
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  assert(MergeDiskCores.size());
+  for (size_t core : MergeDiskCores) {
+    CPU_SET(core, &mask);
+  }
+  IfLt0(sched_setaffinity(syscall(SYS_gettid), sizeof(cpu_set_t), &mask));
+  if (Engine->IsDiskBased()) {
+    assert(!Disk::Util::TDiskController::TEvent::LocalEventPool);
+    Disk::Util::TDiskController::TEvent::LocalEventPool = new TThreadLocalGlobalPoolManager<Disk::Util::TDiskController::TEvent>::TThreadLocalPool(Disk::Util::TDiskController::TEvent::DiskEventPoolManager.get());
+  }
+  /* Register ourselves for CPU time collection */ {
+    lock_guard<mutex> lock(MergeThreadCPUMutex);
+    MergeDiskThreadCPUMap.insert(make_pair(pthread_self(), cpu_clock::now()));
+  }
+  try {
+    runner->Run();
+  } catch (...) {
+    /* De-Register ourselves for CPU time collection */ {
+      lock_guard<mutex> lock(MergeThreadCPUMutex);
+      MergeDiskThreadCPUMap.erase(pthread_self());
+    }
+    delete Disk::Util::TDiskController::TEvent::LocalEventPool;
+    Disk::Util::TDiskController::TEvent::LocalEventPool = nullptr;
+    throw;
+  }
+  /* De-Register ourselves for CPU time collection */ {
+    lock_guard<mutex> lock(MergeThreadCPUMutex);
+    MergeDiskThreadCPUMap.erase(pthread_self());
+  }
+  delete Disk::Util::TDiskController::TEvent::LocalEventPool;
+  Disk::Util::TDiskController::TEvent::LocalEventPool = nullptr;
+}
+
 void TManager::ReportMergeCPUTime(nanoseconds &out_merge_mem, nanoseconds &out_merge_disk) {
   assert(this);
   out_merge_mem = nanoseconds::zero();
@@ -460,26 +508,84 @@ void TManager::OnClose(TRepo *repo) {
   throw std::logic_error("TODO: implement TManager::OnClose()");
 }
 
-void TManager::EnqueueMergeMem(TRepo *repo) {
+void TManager::EnqueueMergeMem(TRepo *repo, const steady_clock::time_point &time) {
   /* acquire MergeMem lock */ {
     std::lock_guard<std::mutex> lock(MergeMemLock);
-    if (repo->MergeMemMembership.TryGetCollector() == nullptr) {
+    if (repo->MergeMemMembership.TryGetCollector() == nullptr || time < repo->GetTimeOfNextMergeMem()) {
+      repo->SetTimeOfNextMergeMem(time);
       MergeMemQueue.Insert(&repo->MergeMemMembership);
       MergeMemSem.Push();
+      MergeMemQueueChanged.notify_all();
     }
   }  // release MergeMem lock
 }
 
 void TManager::EnqueueMergeDisk(TRepo *repo) {
+  /* The cost model picks the time, so repos whose reads suffer the most get merged first. */
+  const auto time = steady_clock::now() + Indy::Util::TMergeCost::GetDelay(repo->MergeCost.Sample(), MergeDiskDelay);
   /* acquire MergeDisk lock */ {
     Fiber::TFiberLock::TLock lock(MergeDiskLock);
-    if (repo->MergeDiskMembership.TryGetCollector() == nullptr) {
+    if (repo->MergeDiskMembership.TryGetCollector() == nullptr || time < repo->GetTimeOfNextMergeDisk()) {
+      repo->SetTimeOfNextMergeDisk(time);
       MergeDiskQueue.Insert(&repo->MergeDiskMembership);
       MergeDiskSem.Push();
+      /* Wake any mergers waiting on a later repo. */ {
+        std::lock_guard<std::mutex> wait_lock(MergeDiskWaitMutex);
+        ++MergeDiskQueueGen;
+      }
+      MergeDiskQueueChanged.notify_all();
     }
   }  // release MergeDisk lock
 }
 
+void TManager::GetRepoMergeReports(std::vector<TRepoMergeReport> &out) {
+  assert(this);
+  assert(&out);
+  out.clear();
+  /* Hold on to the open repos so we can look at them without keeping everyone else out of the manager. */
+  std::vector<TPtr<TRepo>> repos;
+  /* acquire durable lock */ {
+    std::lock_guard<std::mutex> durable_lock(DurableMutex);
+    repos.reserve(OpenableObjs.size());
+    for (const auto &item: OpenableObjs) {
+      TRepo *repo = dynamic_cast<TRepo *>(item.second);
+      /* Skip the cached repos; pinning one would reopen it. */
+      if (repo && !repo->GetDeadline()) {
+        repos.push_back(TPtr<TRepo>(repo, Orly::Indy::L0::Old));
+      }
+    }
+  }  // release durable lock
+  out.reserve(repos.size());
+  for (const auto &repo: repos) {
+    TRepoMergeReport report;
+    report.Id = repo->GetId();
+    report.NumMemLayers = 0UL;
+    report.NumDiskLayers = 0UL;
+    /* acquire Mapping lock */ {
+      std::lock_guard<std::mutex> mapping_lock(repo->MappingLock);
+      TRepo::TMapping *mapping = repo->MappingCollection.TryGetLastMember();
+      if (mapping) {
+        for (TRepo::TMapping::TEntryCollection::TCursor csr(mapping->GetEntryCollection()); csr; ++csr) {
+          if (csr->GetLayer()->GetKind() == TRepo::TDataLayer::Mem) {
+            ++report.NumMemLayers;
+          } else {
+            ++report.NumDiskLayers;
+          }
+        }
+      }
+    }  // release Mapping lock
+    /* Just look; sampling here would move the rates the merge scheduler goes by. */
+    report.Load = repo->MergeCost.GetLoad();
+    out.push_back(report);
+  }
+}
+
+void TManager::SetMaxMergeDiskShare(double share) {
+  assert(this);
+  assert(share > 0.0 && share <= 1.0);
+  MaxMergeDiskShare = share;
+}
+
 void TManager::RemoveLayersFromQueue() {
   assert(this);
   TRepo::TDataLayer *layer = nullptr;
@@ -18,6 +18,7 @@
 
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 
 #include <base/class_traits.h>
 #include <base/cpu_clock.h>
@@ -35,7 +36,9 @@
 #include <orly/indy/status.h>
 #include <orly/indy/update.h>
 #include <orly/indy/update_walker.h>
+#include <orly/indy/util/group_commit.h>
 #include <orly/indy/util/lockless_pool.h>
+#include <orly/indy/util/merge_cost.h>
 #include <orly/server/tetris_manager.h>
 #include <orly/time.h>
 
@@ -642,9 +645,12 @@ namespace Orly {
           /* TODO */
           virtual std::unique_ptr<Indy::TUpdateWalker> NewUpdateWalkerFile(size_t gen_id, TSequenceNumber from) const;
 
-          /* TODO */
+          /* Queue the memory layers for merging after the manager's merge mem delay. */
           inline void EnqueueMergeMem();
 
+          /* Queue the memory layers for merging at the given time, or sooner if they're already queued for sooner. */
+          inline void EnqueueMergeMem(const std::chrono::steady_clock::time_point &time);
+
           /* TODO */
           inline void EnqueueMergeDisk();
 
@@ -678,6 +684,9 @@ namespace Orly {
           /* TODO */
           TStatus Status;
 
+          /* Our lookups, probes and updates, which decide how soon the manager merges our disk layers. */
+          mutable Indy::Util::TMergeCost MergeCost;
+
           private:
 
           /* TODO */
@@ -737,6 +746,36 @@ namespace Orly {
         /* TODO */
         void SetTetrisManager(Server::TTetrisManager *tetris_manager);
 
+        /* A repo's layers and what the merge scheduler makes of its load. */
+        struct TRepoMergeReport {
+
+          /* The repo. */
+          Base::TUuid Id;
+
+          /* The layers in the repo's current mapping. */
+          size_t NumMemLayers, NumDiskLayers;
+
+          /* The repo's recent load, including its merge debt. */
+          Indy::Util::TMergeCost::TLoad Load;
+
+        };  // TRepoMergeReport
+
+        /* Report on every open repo. */
+        void GetRepoMergeReports(std::vector<TRepoMergeReport> &out);
+
+        /* Limit the fraction of its time each merge disk runner spends merging.  The default is 1, which is no limit. */
+        void SetMaxMergeDiskShare(double share);
+
+        /* The pool merges may fan their work out to, or null if merges run entirely on the merge disk runners. */
+        Fiber::TRunnerPool *GetMergeWorkerPool() const;
+
+        /* TODO */
+        void SetMergeWorkerPool(Fiber::TRunnerPool *merge_worker_pool);
+
+        /* Launches a merge worker runner on the calling thread, pinned to the merge disk cores and counted in the merge
+           disk CPU time. Pass as the launch function of the merge worker pool. */
+        void RunMergeWorker(Fiber::TRunner *runner);
+
         /* TODO */
         void ReportMergeCPUTime(std::chrono::nanoseconds &out_merge_mem, std::chrono::nanoseconds &out_merge_disk);
 
@@ -773,6 +812,13 @@ namespace Orly {
           return sizeof(TRepo::TDataLayer);
         }
 
+        /* Decides when a safe repo's memory layer should be merged to disk, and keeps latency stats on the commits
+           waiting for it. */
+        Indy::Util::TGroupCommit MergeMemCommit;
+
+        /* Merge a safe repo's memory layer right away once this many commits are waiting in it. */
+        static constexpr size_t MaxMergeMemBatchSize = 4096UL;
+
         Base::TSigmaCalc MergeMemAverageKeysCalc;
         std::mutex MergeMemCPULock;
 
@@ -909,8 +955,8 @@ namespace Orly {
         /* TODO */
         void OnClose(TRepo *repo);
 
-        /* TODO */
-        void EnqueueMergeMem(TRepo *repo);
+        /* Queue the repo for a memory merge at the given time.  If it's already queued, only move it sooner. */
+        void EnqueueMergeMem(TRepo *repo, const std::chrono::steady_clock::time_point &time);
 
         /* TODO */
         void EnqueueMergeDisk(TRepo *repo);
@@ -935,12 +981,25 @@ namespace Orly {
         std::mutex MergeMemEpollLock;
         Fiber::TSingleSem MergeMemSem;
 
+        /* Signalled when a repo is enqueued for a mem merge, so mergers waiting for a later one can look again.  Waited
+           on with MergeMemLock. */
+        std::condition_variable MergeMemQueueChanged;
+
         /* TODO */
         mutable TRepoQueue::TImpl MergeDiskQueue;
         Fiber::TFiberLock MergeDiskLock;
         Fiber::TFiberLock MergeDiskEpollLock;
         Fiber::TSingleSem MergeDiskSem;
 
+        /* Signalled when a repo is enqueued for a disk merge, so mergers waiting for a later one can look again.  The fiber
+           lock can't be waited on, so this has its own mutex, which covers MergeDiskQueueGen.  Take it after
+           MergeDiskLock, if at all. */
+        std::mutex MergeDiskWaitMutex;
+        std::condition_variable MergeDiskQueueChanged;
+
+        /* Bumped each time EnqueueMergeDisk() changes the queue, so a waiting merger can tell it missed nothing. */
+        size_t MergeDiskQueueGen;
+
         /* TODO */
         std::chrono::milliseconds MergeMemDelay;
         std::chrono::milliseconds MergeDiskDelay;
@@ -966,6 +1025,12 @@ namespace Orly {
         /* TODO */
         Server::TTetrisManager *TetrisManager;
 
+        /* TODO */
+        Fiber::TRunnerPool *MergeWorkerPool;
+
+        /* See SetMaxMergeDiskShare(). */
+        double MaxMergeDiskShare;
+
         /* TODO */
         std::function<void (TRepo *)> OnCloseCb;
 
@@ -1053,7 +1118,12 @@ namespace Orly {
 
       inline void TManager::TRepo::EnqueueMergeMem() {
         assert(this);
-        Manager->EnqueueMergeMem(this);
+        Manager->EnqueueMergeMem(this, std::chrono::steady_clock::now() + Manager->MergeMemDelay);
+      }
+
+      inline void TManager::TRepo::EnqueueMergeMem(const std::chrono::steady_clock::time_point &time) {
+        assert(this);
+        Manager->EnqueueMergeMem(this, time);
       }
 
       inline void TManager::TRepo::EnqueueMergeDisk() {
@@ -73,7 +73,11 @@ TMemoryLayer::TMatchPresentWalker::TMatchPresentWalker(const TMemoryLayer *layer
     : Orly::Indy::TPresentWalker(Match),
       Layer(layer),
       Key(key),
-      Csr(Layer->GetEntryCollection()),
+      /* Seek straight to the start of our index.  We can't seek any further, as the key may have free fields. */
+      Csr(Layer->GetEntryCollection()->TryGetFirstMembershipNotBefore(
+          [&key](const auto &entry_key) {
+            return Atom::IsLt(Atom::CompareOrdered(entry_key.GetEntry()->GetIndexKey().GetIndexId(), key.GetIndexId()));
+          })),
       Valid(true),
       Cached(false),
       PassedMatch(false) {
@@ -163,7 +167,13 @@ TMemoryLayer::TRangePresentWalker::TRangePresentWalker(const TMemoryLayer *layer
       Layer(layer),
       From(from),
       To(to),
-      Csr(Layer->GetEntryCollection()),
+      /* Seek straight to the first entry not less than our starting key. */
+      Csr(Layer->GetEntryCollection()->TryGetFirstMembershipNotBefore(
+          [&from](const auto &entry_key) {
+            const TIndexKey &index_key = entry_key.GetEntry()->GetIndexKey();
+            Atom::TComparison comp = Atom::CompareOrdered(index_key.GetIndexId(), from.GetIndexId());
+            return Atom::IsLt(comp) || (Atom::IsEq(comp) && index_key.GetKey() < from.GetKey());
+          })),
       Valid(true), Cached(false), PassedMatch(false) {
   assert(From.GetIndexId() == To.GetIndexId());
   Refresh();
@@ -219,7 +229,7 @@ void TMemoryLayer::TRangePresentWalker::Refresh() const {
             if (Atom::IsGe(comp)) {
               PassedMatch = true;
               Sabot::State::TAny::TWrapper to_state(To.GetKey().GetCore().NewState(To.GetKey().GetArena(), key_state_alloc_3));
-              Atom::TComparison comp = OrderStates(*cur_state, *key_state);
+              Atom::TComparison comp = OrderStates(*cur_state, *to_state);
               if (Atom::IsGt(comp)) {
                 Valid = false;
                 return;
@@ -20,6 +20,7 @@
 
 #include <base/class_traits.h>
 #include <inv_con/ordered_list.h>
+#include <inv_con/skip_list.h>
 #include <orly/indy/manager_base.h>
 #include <orly/indy/update.h>
 #include <orly/sabot/all.h>
@@ -47,7 +48,7 @@ namespace Orly {
 
       /* TODO */
       typedef InvCon::OrderedList::TCollection<TMemoryLayer, TUpdate, TSequenceNumber> TUpdateCollection;
-      typedef InvCon::OrderedList::TCollection<TMemoryLayer, TUpdate::TEntry, TUpdate::TEntry::TEntryKey> TEntryCollection;
+      typedef InvCon::SkipList::TCollection<TMemoryLayer, TUpdate::TEntry, TUpdate::TEntry::TEntryKey> TEntryCollection;
 
       /* TODO */
       TMemoryLayer(L0::TManager *manager);
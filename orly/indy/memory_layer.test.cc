@@ -152,6 +152,44 @@ FIXTURE(Free) {
   }
 }
 
+FIXTURE(RangeSeek) {
+  TMemoryLayer mem_layer(nullptr);
+  Base::TUuid idx_1(Base::TUuid::Twister), idx_2(Base::TUuid::Twister);
+  TSuprena arena;
+  TSequenceNumber seq_num = 0UL;
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  /* insert data, out of order and interleaving the indices */ {
+    for (int64_t i = 0; i < 100; ++i) {
+      int64_t val = (i * 37) % 100;
+      Insert(mem_layer, ++seq_num, idx_1, val, val * 2);
+      Insert(mem_layer, ++seq_num, idx_2, val, val * 2 + 1);
+    }
+  }
+  /* start between keys */ {
+    TIndexKey from(idx_1, TKey(make_tuple(31L), &arena, state_alloc)), to(idx_1, TKey(make_tuple(40L), &arena, state_alloc));
+    auto walker_ptr = mem_layer.NewPresentWalker(from, to);
+    int64_t expected = 32L;
+    for (auto &walker = *walker_ptr; walker; ++walker, expected += 2L) {
+      EXPECT_EQ(TKey((*walker).Key, (*walker).KeyArena), TKey(make_tuple(expected), &arena, state_alloc));
+    }
+    EXPECT_EQ(expected, 42L);
+  }
+  /* start on a key in the second index */ {
+    TIndexKey from(idx_2, TKey(make_tuple(191L), &arena, state_alloc)), to(idx_2, TKey(make_tuple(1000L), &arena, state_alloc));
+    auto walker_ptr = mem_layer.NewPresentWalker(from, to);
+    int64_t expected = 191L;
+    for (auto &walker = *walker_ptr; walker; ++walker, expected += 2L) {
+      EXPECT_EQ(TKey((*walker).Key, (*walker).KeyArena), TKey(make_tuple(expected), &arena, state_alloc));
+    }
+    EXPECT_EQ(expected, 201L);
+  }
+  /* start past the end */ {
+    TIndexKey from(idx_1, TKey(make_tuple(500L), &arena, state_alloc)), to(idx_1, TKey(make_tuple(1000L), &arena, state_alloc));
+    auto walker_ptr = mem_layer.NewPresentWalker(from, to);
+    EXPECT_FALSE(*walker_ptr);
+  }
+}
+
 #if 0
 FIXTURE(Range) {
   TMemoryLayer layer(nullptr);
@@ -0,0 +1,108 @@
+/* <orly/indy/memory_layer.test.manual.cc>
+
+   Benchmarks for <orly/indy/memory_layer.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/memory_layer.h>
+#include <orly/indy/update.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <base/timer.h>
+#include <test/kit.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Base;
+using namespace Orly;
+using namespace Orly::Atom;
+using namespace Orly::Indy;
+
+Orly::Indy::Util::TPool L0::TManager::TRepo::TMapping::Pool(sizeof(TRepo::TMapping), "Repo Mapping");
+Orly::Indy::Util::TPool L0::TManager::TRepo::TMapping::TEntry::Pool(sizeof(TRepo::TMapping::TEntry), "Repo Mapping Entry");
+Orly::Indy::Util::TPool L0::TManager::TRepo::TDataLayer::Pool(sizeof(TMemoryLayer), "Data Layer");
+
+Orly::Indy::Util::TPool TUpdate::Pool(sizeof(TUpdate), "Update", 2000004UL);
+Orly::Indy::Util::TPool TUpdate::TEntry::Pool(sizeof(TUpdate::TEntry), "Entry", 2000004UL);
+
+/* Insert a single-entry update into the layer. */
+static void Insert(TMemoryLayer &mem_layer, TSequenceNumber seq_num, const Base::TUuid &idx_id, int64_t key) {
+  Atom::TSuprena arena;
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  std::shared_ptr<TUpdate> update(TUpdate::NewUpdate(TUpdate::TOpByKey{
+    { TIndexKey(idx_id, TKey(std::make_tuple(key), &arena, state_alloc)), TKey(key, &arena, state_alloc)}
+    }, TKey(&arena), TKey(Base::TUuid(Base::TUuid::Best), &arena, state_alloc)));
+  update->SetSequenceNumber(seq_num);
+  mem_layer.Insert(TUpdate::CopyUpdate(update.get(), state_alloc));
+}
+
+/* Fill a layer with the given number of entries, inserted in random key order, then time short range walks from
+   random starting points. */
+static void BenchLayer(int64_t num_entries) {
+  static const int64_t num_seeks = 10000L;
+  static const int64_t range_len = 16L;
+  mt19937_64 engine(num_entries);
+  vector<int64_t> keys(num_entries);
+  for (int64_t i = 0; i < num_entries; ++i) {
+    keys[i] = i;
+  }
+  shuffle(keys.begin(), keys.end(), engine);
+  TMemoryLayer mem_layer(nullptr);
+  Base::TUuid idx(Base::TUuid::Twister);
+  TSequenceNumber seq_num = 0UL;
+  TTimer timer;
+  for (int64_t key : keys) {
+    Insert(mem_layer, ++seq_num, idx, key);
+  }
+  timer.Stop();
+  double insert_secs = duration_cast<duration<double>>(timer.GetTotal()).count();
+  TSuprena arena;
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  uniform_int_distribution<int64_t> start(0L, num_entries - range_len);
+  int64_t num_found = 0L;
+  timer.Start();
+  for (int64_t i = 0; i < num_seeks; ++i) {
+    int64_t from = start(engine);
+    /* The walker holds references to its bounds, so they must outlive it. */
+    TIndexKey from_key(idx, TKey(make_tuple(from), &arena, state_alloc)),
+              to_key(idx, TKey(make_tuple(from + range_len - 1L), &arena, state_alloc));
+    auto walker_ptr = mem_layer.NewPresentWalker(from_key, to_key);
+    for (auto &walker = *walker_ptr; walker; ++walker) {
+      ++num_found;
+    }
+  }
+  timer.Stop();
+  EXPECT_EQ(num_found, num_seeks * range_len);
+  double seek_secs = duration_cast<duration<double>>(timer.GetTotal()).count();
+  cout << "entries = " << num_entries
+       << ", inserts/s = " << (num_entries / insert_secs)
+       << ", range walk (" << range_len << " entries) = " << (seek_secs * 1000000.0 / num_seeks) << " us" << endl;
+}
+
+FIXTURE(Entries10K) {
+  BenchLayer(10000L);
+}
+
+FIXTURE(Entries100K) {
+  BenchLayer(100000L);
+}
+
+FIXTURE(Entries1M) {
+  BenchLayer(1000000L);
+}
@@ -18,7 +18,14 @@
 
 #include <orly/indy/replication.h>
 
+#include <stdexcept>
+
+#include <syslog.h>
+
 #include <base/debug_log.h>
+#include <io/binary_input_only_stream.h>
+#include <io/binary_output_only_stream.h>
+#include <io/recorder_and_player.h>
 
 using namespace std;
 using namespace Base;
@@ -49,6 +56,15 @@ void TReplicationQueue::Swap(TReplicationQueue &that) {
   }
 }
 
+void TReplicationQueue::MoveFirstTo(TReplicationQueue &that) {
+  assert(this);
+  assert(&that);
+  auto item = ItemCollection.TryGetFirstMember();
+  assert(item);
+  item->QueueMembership.Remove();
+  that.ItemCollection.Insert(&item->QueueMembership);
+}
+
 TRepoReplication::TRepoReplication(const Base::TUuid &repo_id, bool is_safe, const TTtl &ttl, const Base::TOpt<Base::TUuid> &opt_parent_repo_id)
     : Ttl(ttl),
       RepoId(repo_id),
@@ -57,10 +73,12 @@ TRepoReplication::TRepoReplication(const Base::TUuid &repo_id, bool is_safe, con
 
 TRepoReplication::~TRepoReplication() {}
 
-TDurableReplication::TDurableReplication(const Base::TUuid &durable_id, const TTtl &ttl, const std::string &serialized_obj)
+TDurableReplication::TDurableReplication(const Base::TUuid &durable_id, const TTtl &ttl, const std::shared_ptr<const std::string> &serialized_obj)
     : DurableTtl(ttl),
       DurableId(durable_id),
-      SerializedObj(serialized_obj) {}
+      SerializedObj(serialized_obj) {
+  assert(serialized_obj);
+}
 
 TDurableReplication::~TDurableReplication() {}
 
@@ -76,16 +94,19 @@ TTransactionReplication::TTransactionReplication(L1::TTransaction::TReplica &&re
 
 TTransactionReplication::~TTransactionReplication() {}
 
-TReplicationStreamer::TReplicationStreamer() {}
+const size_t TReplicationStreamer::FrameVersionTag;
+const size_t TReplicationStreamer::FrameVersionMask;
+const size_t TReplicationStreamer::CurrentFrameVersion;
+const size_t TReplicationStreamer::MaxNumRawBytes;
+
+TReplicationStreamer::TReplicationStreamer()
+    : Seq(0UL), QueuedSeq(0UL), NumRawBytes(0UL), CodecKind(Disk::Util::TCodecKind::None) {}
 
 TReplicationStreamer::~TReplicationStreamer() {}
 
 void TReplicationStreamer::Write(Io::TBinaryOutputStream &strm) const {
   assert(this);
-  IndexIdBuilder.Write(strm);
-  RepoBuilder.Write(strm);
-  DurableBuilder.Write(strm);
-  TransactionBuilder.Write(strm);
+  strm << (FrameVersionTag | CurrentFrameVersion) << Seq << QueuedSeq << static_cast<size_t>(CodecKind) << NumRawBytes << Frame;
 }
 
 void TReplicationStreamer::Read(Io::TBinaryInputStream &strm) {
@@ -94,10 +115,71 @@ void TReplicationStreamer::Read(Io::TBinaryInputStream &strm) {
   assert(!RepoVector);
   assert(!DurableVector);
   assert(!TransactionVector);
-  IndexIdVector = make_unique<TCoreVector>(strm);
-  RepoVector = make_unique<TCoreVector>(strm);
-  DurableVector = make_unique<TCoreVector>(strm);
-  TransactionVector = make_unique<TCoreVector>(strm);
+  size_t version_word;
+  strm >> version_word;
+  if ((version_word & ~FrameVersionMask) != FrameVersionTag) {
+    syslog(LOG_ERR, "TReplicationStreamer::Read() got an unframed replication stream; the master is running an older version");
+    throw std::runtime_error("unframed replication stream");
+  }
+  if ((version_word & FrameVersionMask) != CurrentFrameVersion) {
+    syslog(LOG_ERR, "TReplicationStreamer::Read() unknown replication frame version [%ld]", version_word & FrameVersionMask);
+    throw std::runtime_error("unknown replication frame version");
+  }
+  size_t codec_kind;
+  strm >> Seq >> QueuedSeq >> codec_kind >> NumRawBytes;
+  if (NumRawBytes > MaxNumRawBytes) {
+    syslog(LOG_ERR, "TReplicationStreamer::Read() replication frame of [%ld] bytes is bigger than [%ld]", NumRawBytes, MaxNumRawBytes);
+    throw std::runtime_error("replication frame too big");
+  }
+  strm >> Frame;
+  CodecKind = static_cast<Disk::Util::TCodecKind>(codec_kind);
+  string raw;
+  if (CodecKind == Disk::Util::TCodecKind::None) {
+    raw = Frame;
+  } else {
+    raw.resize(NumRawBytes);
+    Disk::Util::TCodec::Get(CodecKind)->Uncompress(Frame.data(), Frame.size(), &raw[0], NumRawBytes);
+  }
+  Io::TBinaryInputOnlyStream frame_strm(make_shared<Io::TPlayer>(make_shared<Io::TRecorder>(raw)));
+  IndexIdVector = make_unique<TCoreVector>(frame_strm);
+  RepoVector = make_unique<TCoreVector>(frame_strm);
+  DurableVector = make_unique<TCoreVector>(frame_strm);
+  TransactionVector = make_unique<TCoreVector>(frame_strm);
+}
+
+void TReplicationStreamer::Seal(const Disk::Util::TCodec *codec, size_t seq, size_t queued_seq) {
+  assert(this);
+  assert(codec);
+  string raw;
+  /* extra */ {
+    auto recorder = make_shared<Io::TRecorder>();
+    Io::TBinaryOutputOnlyStream strm(recorder);
+    IndexIdBuilder.Write(strm);
+    RepoBuilder.Write(strm);
+    DurableBuilder.Write(strm);
+    TransactionBuilder.Write(strm);
+    strm.Flush();
+    recorder->CopyOut(raw);
+  }
+  Seq = seq;
+  QueuedSeq = queued_seq;
+  NumRawBytes = raw.size();
+  CodecKind = codec->GetKind();
+  if (CodecKind == Disk::Util::TCodecKind::None) {
+    Frame.swap(raw);
+  } else {
+    Frame.resize(codec->GetMaxCompressedSize(NumRawBytes));
+    Frame.resize(codec->Compress(raw.data(), NumRawBytes, &Frame[0]));
+  }
+}
+
+size_t TReplicationStreamer::GetNumPushedBytes() const {
+  assert(this);
+  size_t num_bytes = 0UL;
+  for (const auto *builder : { &IndexIdBuilder, &RepoBuilder, &DurableBuilder, &TransactionBuilder }) {
+    num_bytes += builder->GetCores().size() * sizeof(TCore) + builder->GetNumArenaBytes();
+  }
+  return num_bytes;
 }
 
 void TReplicationStreamer::PushIndexId(const TIndexIdReplication &index_id) {
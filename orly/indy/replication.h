@@ -16,8 +16,12 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
+
 #include <orly/atom/core_vector.h>
 #include <orly/atom/core_vector_builder.h>
+#include <orly/indy/disk/util/codec.h>
 #include <orly/indy/transaction_base.h>
 #include <orly/time.h>
 
@@ -133,6 +137,9 @@ namespace Orly {
       /* TODO */
       void Swap(TReplicationQueue &that);
 
+      /* Move our first item onto the end of the given queue.  We must not be empty. */
+      void MoveFirstTo(TReplicationQueue &that);
+
       /* TODO */
       inline void Clear();
 
@@ -280,8 +287,8 @@ namespace Orly {
 
       };  // TReplica
 
-      /* TODO */
-      TDurableReplication(const Base::TUuid &durable_id, const TTtl &ttl, const std::string &serialized_obj);
+      /* Shares the serialized object with whoever else holds it; it must not change. */
+      TDurableReplication(const Base::TUuid &durable_id, const TTtl &ttl, const std::shared_ptr<const std::string> &serialized_obj);
 
       /* TODO */
       virtual ~TDurableReplication();
@@ -306,8 +313,8 @@ namespace Orly {
       /* TODO */
       const Base::TUuid DurableId;
 
-      /* TODO */
-      const std::string SerializedObj;
+      /* Never null. */
+      const std::shared_ptr<const std::string> SerializedObj;
 
     };  // TDurableReplication
 
@@ -427,10 +434,27 @@ namespace Orly {
       /* TODO */
       ~TReplicationStreamer();
 
-      /* TODO */
+      /* FrameVersionTag | the version of the frame layout.  Streams from before frames began with the size of a core
+         vector, which never comes near the tag, so a slave can tell it's talking to a master too old (or too new) to
+         understand, and says so rather than misreading the frame. */
+      static const size_t FrameVersionTag = 0x5245504C00000000UL;  // "REPL"
+
+      /* The low half of the first word of a frame. */
+      static const size_t FrameVersionMask = 0x00000000FFFFFFFFUL;
+
+      /* The frame layout we write: version word, seq, queued seq, codec kind, raw size, frame. */
+      static const size_t CurrentFrameVersion = 1UL;
+
+      /* No frame is bigger than this before compression.  The master cuts frames at about
+         TManager::MaxReplicationFrameBytes, but one big item can carry a frame past that, so this is the bound on what
+         we'll allocate for a frame off the wire, not where frames are cut. */
+      static const size_t MaxNumRawBytes = 1024UL * 1024UL * 1024UL;
+
+      /* Write the sealed frame, led by its version word. */
       void Write(Io::TBinaryOutputStream &stream) const;
 
-      /* TODO */
+      /* Read and uncompress a frame.  Throws if the frame isn't one we know how to read or claims to be bigger than
+         MaxNumRawBytes. */
       void Read(Io::TBinaryInputStream &stream);
 
       /* TODO */
@@ -445,6 +469,38 @@ namespace Orly {
       /* TODO */
       void PushRepo(const TRepoReplication &repo_replica);
 
+      /* Pack everything pushed so far into a single frame, compressed with the given codec, ready to be written.  The
+         frame carries its own sequence number and the number of frames the master had queued when it was sealed, so
+         the slave can tell how far behind it is running. */
+      void Seal(const Disk::Util::TCodec *codec, size_t seq, size_t queued_seq);
+
+      /* The bytes pushed so far, before compression.  This is an estimate, used to decide when a frame is full. */
+      size_t GetNumPushedBytes() const;
+
+      /* The sequence number of this frame. */
+      inline size_t GetSeq() const {
+        assert(this);
+        return Seq;
+      }
+
+      /* The sequence number of the latest frame the master had queued when this one was sealed. */
+      inline size_t GetQueuedSeq() const {
+        assert(this);
+        return QueuedSeq;
+      }
+
+      /* The size of this frame before compression. */
+      inline size_t GetNumRawBytes() const {
+        assert(this);
+        return NumRawBytes;
+      }
+
+      /* The size of this frame on the wire. */
+      inline size_t GetNumWireBytes() const {
+        assert(this);
+        return Frame.size();
+      }
+
       /* TODO */
       inline const Atom::TCoreVector &GetIndexIdVec() const {
         assert(this);
@@ -504,6 +560,17 @@ namespace Orly {
       /* TODO */
       std::unique_ptr<Atom::TCoreVector> TransactionVector;
 
+      /* See accessors. */
+      size_t Seq;
+      size_t QueuedSeq;
+      size_t NumRawBytes;
+
+      /* The kind of codec which compressed the frame. */
+      Disk::Util::TCodecKind CodecKind;
+
+      /* The builders (or, once read, the vectors), serialized and compressed. */
+      std::string Frame;
+
     };  // TReplicationStreamer
 
     /***************
@@ -552,7 +619,7 @@ namespace Orly {
 
     inline const std::string &TDurableReplication::GetSerializedObj() const {
       assert(this);
-      return SerializedObj;
+      return *SerializedObj;
     }
 
     inline TReplicationQueue::TReplicationItem::TKind TIndexIdReplication::GetKind() const {
@@ -628,7 +695,7 @@ namespace Orly {
         : Ttl(ttl), Id(id), SerializedObj(serialized_obj) {}
 
     inline TDurableReplication::TReplica::TReplica(const TDurableReplication &replication_obj)
-        : Ttl(replication_obj.DurableTtl), Id(replication_obj.DurableId), SerializedObj(replication_obj.SerializedObj) {}
+        : Ttl(replication_obj.DurableTtl), Id(replication_obj.DurableId), SerializedObj(*replication_obj.SerializedObj) {}
 
     inline TDurableReplication::TReplica::TReplica(const TReplica &that)
         : Ttl(that.Ttl), Id(that.Id), SerializedObj(that.SerializedObj) {}
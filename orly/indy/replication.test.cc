@@ -0,0 +1,135 @@
+/* <orly/indy/replication.test.cc>
+
+   Unit test for <orly/indy/replication.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/replication.h>
+
+#include <io/binary_input_only_stream.h>
+#include <io/binary_output_only_stream.h>
+#include <io/recorder_and_player.h>
+#include <orly/indy/memory_layer.h>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace Base;
+using namespace Orly;
+using namespace Orly::Indy;
+
+Orly::Indy::Util::TPool L0::TManager::TRepo::TMapping::Pool(sizeof(TRepo::TMapping), "Repo Mapping", 100UL);
+Orly::Indy::Util::TPool L0::TManager::TRepo::TMapping::TEntry::Pool(sizeof(TRepo::TMapping::TEntry), "Repo Mapping Entry", 100UL);
+Orly::Indy::Util::TPool L0::TManager::TRepo::TDataLayer::Pool(sizeof(TMemoryLayer), "Data Layer", 100UL);
+
+Orly::Indy::Util::TPool L1::TTransaction::TMutation::Pool(max(max(sizeof(L1::TTransaction::TPusher), sizeof(L1::TTransaction::TPopper)), sizeof(L1::TTransaction::TStatusChanger)), "Transaction::TMutation", 100UL);
+Orly::Indy::Util::TPool L1::TTransaction::Pool(sizeof(L1::TTransaction), "Transaction", 100UL);
+
+Disk::TBufBlock::TPool Disk::TBufBlock::Pool(Disk::Util::PhysicalBlockSize);
+
+Orly::Indy::Util::TPool TUpdate::Pool(sizeof(TUpdate), "Update", 100UL);
+Orly::Indy::Util::TPool TUpdate::TEntry::Pool(sizeof(TUpdate::TEntry), "Entry", 100UL);
+
+static const size_t NumDurables = 100UL;
+
+/* Read a streamer out of the blob. */
+static void ReadBlob(const string &blob, TReplicationStreamer &in) {
+  Io::TBinaryInputOnlyStream strm(make_shared<Io::TPlayer>(make_shared<Io::TRecorder>(blob)));
+  strm >> in;
+}
+
+/* Seal a frame of durables with the given codec, send it through a recorder, and check what comes out the other end. */
+static void RoundTrip(const Disk::Util::TCodec *codec) {
+  const auto serialized_obj = make_shared<const string>(1000UL, 'x');
+  TReplicationStreamer out;
+  for (size_t i = 0; i < NumDurables; ++i) {
+    TDurableReplication durable(TUuid(TUuid::Twister), TTtl(i), serialized_obj);
+    out.PushDurable(durable);
+  }
+  EXPECT_LE(NumDurables * serialized_obj->size(), out.GetNumPushedBytes());
+  out.Seal(codec, 101UL, 150UL);
+  string blob;
+  /* extra */ {
+    auto recorder = make_shared<Io::TRecorder>();
+    Io::TBinaryOutputOnlyStream strm(recorder);
+    strm << out;
+    strm.Flush();
+    recorder->CopyOut(blob);
+  }
+  TReplicationStreamer in;
+  ReadBlob(blob, in);
+  EXPECT_EQ(in.GetSeq(), 101UL);
+  EXPECT_EQ(in.GetQueuedSeq(), 150UL);
+  EXPECT_EQ(in.GetNumRawBytes(), out.GetNumRawBytes());
+  EXPECT_EQ(in.GetNumWireBytes(), out.GetNumWireBytes());
+  EXPECT_TRUE(in.GetIndexIdVec().GetCores().empty());
+  EXPECT_TRUE(in.GetRepoVec().GetCores().empty());
+  EXPECT_TRUE(in.GetTransactionVec().GetCores().empty());
+  EXPECT_EQ(in.GetDurableVec().GetCores().size(), NumDurables * 3UL);
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  string last_obj;
+  Sabot::ToNative(*Sabot::State::TAny::TWrapper(in.GetDurableVec().GetCores().back().NewState(in.GetDurableVec().GetArena(), state_alloc)), last_obj);
+  EXPECT_EQ(last_obj, *serialized_obj);
+}
+
+FIXTURE(Uncompressed) {
+  RoundTrip(Disk::Util::TCodec::Get(Disk::Util::TCodecKind::None));
+}
+
+FIXTURE(Compressed) {
+  const Disk::Util::TCodec *codec = Disk::Util::TCodec::Get(Disk::Util::TCodecKind::Snappy);
+  RoundTrip(codec);
+  /* a frame full of the same bytes over and over had better shrink */
+  TReplicationStreamer streamer;
+  for (size_t i = 0; i < NumDurables; ++i) {
+    streamer.PushDurable(TDurableReplication(TUuid(), TTtl(1), make_shared<const string>(1000UL, 'x')));
+  }
+  streamer.Seal(codec, 1UL, 1UL);
+  EXPECT_LT(streamer.GetNumWireBytes(), streamer.GetNumRawBytes() / 10UL);
+}
+
+/* A slave refuses a stream from before frames, or a frame newer than it knows, rather than misreading it. */
+FIXTURE(Version) {
+  for (size_t first_word : { 3UL, TReplicationStreamer::FrameVersionTag | (TReplicationStreamer::CurrentFrameVersion + 1UL) }) {
+    string blob;
+    /* extra */ {
+      auto recorder = make_shared<Io::TRecorder>();
+      Io::TBinaryOutputOnlyStream strm(recorder);
+      strm << first_word << 1UL << 1UL << 0UL << 0UL << string();
+      strm.Flush();
+      recorder->CopyOut(blob);
+    }
+    TReplicationStreamer in;
+    auto read = [&] { ReadBlob(blob, in); };
+    EXPECT_THROW_FUNC(runtime_error, read);
+  }
+}
+
+/* A slave refuses a frame claiming to be bigger than any frame can be, rather than trying to allocate it. */
+FIXTURE(TooBig) {
+  string blob;
+  /* extra */ {
+    auto recorder = make_shared<Io::TRecorder>();
+    Io::TBinaryOutputOnlyStream strm(recorder);
+    strm
+        << (TReplicationStreamer::FrameVersionTag | TReplicationStreamer::CurrentFrameVersion) << 1UL << 1UL
+        << static_cast<size_t>(Disk::Util::TCodecKind::Snappy) << (TReplicationStreamer::MaxNumRawBytes + 1UL) << string("x");
+    strm.Flush();
+    recorder->CopyOut(blob);
+  }
+  TReplicationStreamer in;
+  auto read = [&] { ReadBlob(blob, in); };
+  EXPECT_THROW_FUNC(runtime_error, read);
+}
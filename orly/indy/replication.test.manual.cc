@@ -0,0 +1,129 @@
+/* <orly/indy/replication.test.manual.cc>
+
+   Streams replication frames from a master to a slave over a socketpair, once with each codec, and reports the bytes
+   on the wire, the frames per second and how far the slave runs behind.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/replication.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <base/fd.h>
+#include <io/binary_io_stream.h>
+#include <io/device.h>
+#include <orly/indy/memory_layer.h>
+#include <test/kit.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Base;
+using namespace Io;
+using namespace Orly;
+using namespace Orly::Indy;
+using namespace Orly::Indy::Disk::Util;
+
+Orly::Indy::Util::TPool L0::TManager::TRepo::TMapping::Pool(sizeof(TRepo::TMapping), "Repo Mapping", 100UL);
+Orly::Indy::Util::TPool L0::TManager::TRepo::TMapping::TEntry::Pool(sizeof(TRepo::TMapping::TEntry), "Repo Mapping Entry", 100UL);
+Orly::Indy::Util::TPool L0::TManager::TRepo::TDataLayer::Pool(sizeof(TMemoryLayer), "Data Layer", 100UL);
+
+Orly::Indy::Util::TPool L1::TTransaction::TMutation::Pool(max(max(sizeof(L1::TTransaction::TPusher), sizeof(L1::TTransaction::TPopper)), sizeof(L1::TTransaction::TStatusChanger)), "Transaction::TMutation", 100UL);
+Orly::Indy::Util::TPool L1::TTransaction::Pool(sizeof(L1::TTransaction), "Transaction", 100UL);
+
+Disk::TBufBlock::TPool Disk::TBufBlock::Pool(Disk::Util::PhysicalBlockSize);
+
+Orly::Indy::Util::TPool TUpdate::Pool(sizeof(TUpdate), "Update", 100UL);
+Orly::Indy::Util::TPool TUpdate::TEntry::Pool(sizeof(TUpdate::TEntry), "Entry", 100UL);
+
+static constexpr size_t NumFrames = 2000UL;
+static constexpr size_t NumDurablesPerFrame = 64UL;
+
+/* A durable object about the size and shape of the ones a real app saves. */
+static shared_ptr<const string> MakeObj(size_t n) {
+  ostringstream strm;
+  strm
+      << "{ \"id\": " << n << ", \"name\": \"user-" << n << "\", \"email\": \"user-" << n << "@example.com\", "
+      << "\"balance\": " << (n * 7919UL) % 100000UL << ", \"tags\": [ \"alpha\", \"beta\", \"gamma\" ], "
+      << "\"history\": [ " << n % 13UL << ", " << n % 17UL << ", " << n % 19UL << ", " << n % 23UL << " ] }";
+  return make_shared<const string>(strm.str());
+}
+
+/* Stream NumFrames frames with the given codec and report on them. */
+static void Bench(const TCodec *codec) {
+  vector<unique_ptr<TDurableReplication>> durables;
+  durables.reserve(NumDurablesPerFrame);
+  for (size_t i = 0; i < NumDurablesPerFrame; ++i) {
+    durables.push_back(make_unique<TDurableReplication>(TUuid(TUuid::Twister), seconds(3600), MakeObj(i)));
+  }
+  TFd master_fd, slave_fd;
+  TFd::SocketPair(master_fd, slave_fd, AF_UNIX, SOCK_STREAM, 0);
+  auto master_device = make_shared<Io::TDevice>(move(master_fd));
+  auto slave_device = make_shared<Io::TDevice>(move(slave_fd));
+  /* the time each frame was sealed, by sequence number */
+  vector<steady_clock::time_point> sealed_at(NumFrames + 1UL);
+  size_t num_raw_bytes = 0UL, num_wire_bytes = 0UL;
+  auto start = steady_clock::now();
+  thread master([&] {
+    TBinaryIoStream strm(master_device);
+    for (size_t seq = 1; seq <= NumFrames; ++seq) {
+      TReplicationStreamer streamer;
+      for (const auto &durable: durables) {
+        streamer.PushDurable(*durable);
+      }
+      sealed_at[seq] = steady_clock::now();
+      streamer.Seal(codec, seq, NumFrames);
+      num_raw_bytes += streamer.GetNumRawBytes();
+      num_wire_bytes += streamer.GetNumWireBytes();
+      strm << streamer;
+      strm.Flush();
+    }
+  });
+  TBinaryIoStream strm(slave_device);
+  double total_lag = 0, max_lag = 0;
+  size_t num_durables = 0UL;
+  for (size_t i = 0; i < NumFrames; ++i) {
+    TReplicationStreamer streamer;
+    strm >> streamer;
+    auto lag = duration_cast<duration<double>>(steady_clock::now() - sealed_at[streamer.GetSeq()]).count();
+    total_lag += lag;
+    max_lag = max(max_lag, lag);
+    num_durables += streamer.GetDurableVec().GetCores().size() / 3UL;
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  master.join();
+  EXPECT_EQ(num_durables, NumFrames * NumDurablesPerFrame);
+  cout
+      << setw(8) << codec->GetName() << fixed << setprecision(2)
+      << setw(12) << num_raw_bytes / (1024.0 * 1024.0)
+      << setw(12) << num_wire_bytes / (1024.0 * 1024.0)
+      << setw(12) << setprecision(0) << NumFrames / elapsed
+      << setw(14) << setprecision(3) << total_lag / NumFrames * 1000.0
+      << setw(14) << max_lag * 1000.0 << endl;
+}
+
+FIXTURE(Codecs) {
+  cout
+      << setw(8) << "codec" << setw(12) << "raw MiB" << setw(12) << "wire MiB" << setw(12) << "frames / s"
+      << setw(14) << "mean lag ms" << setw(14) << "max lag ms" << endl;
+  for (auto kind: { TCodecKind::None, TCodecKind::Snappy, TCodecKind::Lz4, TCodecKind::Zstd }) {
+    Bench(TCodec::Get(kind));
+  }
+}
@@ -48,6 +48,7 @@ class TReader
 
   using TReadFile::GetStartingBlockOffset;
   using TReadFile::GetNumBlocks;
+  using TReadFile::GetNumMetaFields;
   using TReadFile::GetNumMetaBlocks;
   using TReadFile::GetNumSequentialBlockPairings;
   using TReadFile::GetNumUpdates;
@@ -172,6 +173,51 @@ unique_ptr<Indy::TPresentWalker> TRepo::NewPresentWalker(const std::unique_ptr<T
   return make_unique<TPresentWalker>(view, key, ignore_tombstone);
 }
 
+bool TRepo::FindNewest(const std::unique_ptr<TView> &view,
+                       const TIndexKey &key,
+                       Indy::TPresentWalker::TItem &out_item,
+                       unique_ptr<Indy::TPresentWalker> &out_walker,
+                       size_t &num_probed) const {
+  assert(this);
+  assert(view);
+  if (!view->GetLower() || !view->GetUpper()) {
+    return false;
+  }
+  const TSequenceNumber lower = *view->GetLower(), upper = *view->GetUpper();
+  const size_t num_probed_before = num_probed;
+  bool found = false;
+  /* Probe one layer, unless it's empty, entirely outside the view, or can't beat what we already have.  A layer walks a
+     key's versions newest first, so the first one within the view is the layer's best. */
+  auto probe = [&](const TDataLayer *layer) {
+    if (!layer->GetSize() || layer->GetLowestSeq() > upper || layer->GetHighestSeq() < lower ||
+        (found && layer->GetHighestSeq() <= out_item.SequenceNumber)) {
+      return;
+    }
+    ++num_probed;
+    unique_ptr<Indy::TPresentWalker> walker = layer->NewPresentWalker(key);
+    for (; *walker; ++*walker) {
+      const Indy::TPresentWalker::TItem &item = **walker;
+      if (item.SequenceNumber > upper) {
+        continue;
+      }
+      if (item.SequenceNumber >= lower && (!found || item.SequenceNumber > out_item.SequenceNumber)) {
+        found = true;
+        out_item = item;
+        out_walker = move(walker);
+      }
+      break;
+    }
+  };
+  assert(view->GetCurMem());
+  probe(view->GetCurMem());
+  /* the mapping keeps its layers in order of their lowest sequence numbers, so walking it backward goes newest first */
+  for (TMapping::TEntryCollection::TCursor csr(view->GetMapping()->GetEntryCollection(), InvCon::TOrient::Rev); csr; ++csr) {
+    probe(csr->GetLayer());
+  }
+  MergeCost.OnLookup(num_probed - num_probed_before);
+  return found;
+}
+
 unique_ptr<Indy::TUpdateWalker> TRepo::NewUpdateWalker(const std::unique_ptr<TView> &view,
                                                        TSequenceNumber from,
                                                        const Base::TOpt<TSequenceNumber> &to) {
@@ -204,6 +250,22 @@ TRepo::TView::TView(TRepo *repo)
   }  // release DataLayer lock
 }
 
+TRepo::TView::TView(const TView *that)
+    : Repo(that->Repo),
+      CurrentMemoryLayer(that->CurrentMemoryLayer),
+      Mapping(that->Mapping),
+      LowerBound(that->LowerBound),
+      UpperBound(that->UpperBound),
+      NextId(that->NextId) {
+  assert(that);
+  assert(Repo);
+  assert(CurrentMemoryLayer);
+  /* that holds both the mapping and the memory layer, so they're still alive */
+  std::lock_guard<std::mutex> lock(Repo->MappingLock);
+  Mapping->Incr();
+  CurrentMemoryLayer->Incr();
+}
+
 TRepo::TView::~TView() {
   assert(this);
   assert(CurrentMemoryLayer);
@@ -313,7 +375,15 @@ Base::TOpt<TSequenceNumber> TRepo::AppendUpdate(TUpdate *update, TSequenceNumber
     assert(CurMemoryLayer);
     bool was_empty = CurMemoryLayer->IsEmpty();
     CurMemoryLayer->Insert(update);
-    if (was_empty) {
+    MergeCost.OnUpdate();
+    if (IsSafeRepo()) {
+      /* Someone may be waiting on this update's persistence notification, so let the group commit policy decide when
+         the layer goes to disk.  A full batch moves the merge up to right now. */
+      Manager->MergeMemCommit.Arrive(PendingCommits);
+      if (was_empty || PendingCommits.GetSize() == L0::TManager::MaxMergeMemBatchSize) {
+        EnqueueMergeMem(Manager->MergeMemCommit.GetFlushTime(PendingCommits));
+      }
+    } else if (was_empty) {
       EnqueueMergeMem();
     }
     MakeDirty();
@@ -438,6 +508,8 @@ void TRepo::StepMergeMem() {
   assert(this);
   void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
   Disk::Util::TVolume::TDesc::TStorageSpeed storage_speed = Disk::Util::TVolume::TDesc::TStorageSpeed::Fast;
+  Util::TGroupCommit::TBatch batch;
+  const auto start = std::chrono::steady_clock::now();
   try {
     /*** If the current memory layer is not empty, add it to the mapping layer and create a new current memory layer ***/
     /* acquire DataLayer lock */ {
@@ -452,6 +524,7 @@ void TRepo::StepMergeMem() {
           syslog(LOG_EMERG, "Error allocating new CurMemoryLayer for Repo [%s]", ex.what());
           throw;
         }
+        batch.Swap(PendingCommits);
         //EnqueueMergeMem();
       }
     }  // release DataLayer lock
@@ -646,6 +719,10 @@ void TRepo::StepMergeMem() {
               EnqueueMergeDisk();
             }
           }
+          /* The persistence notifications have gone out, so the commits we took are done. */
+          if (new_disk && !batch.IsEmpty()) {
+            Manager->MergeMemCommit.OnFlushed(batch, start);
+          }
         } catch (const exception &ex) {
           syslog(LOG_ERR, "Caught exception in StepMergeMem [%s]", ex.what());
           ReleaseMapping(mapping);
@@ -1117,6 +1194,8 @@ void TSafeRepo::StepTail(size_t block_slots_available) {
 
 void TSafeRepo::StepMergeDisk(size_t block_slots_available) {
   Disk::Util::TVolume::TDesc::TStorageSpeed storage_speed = Disk::Util::TVolume::TDesc::TStorageSpeed::Fast;
+  /* If lookups are paying for our layers more than updates would pay for merging them, don't wait for generations to line up. */
+  const bool read_hot = Util::TMergeCost::IsReadHot(MergeCost.Sample());
   try {
     /* Flush a merge disk file if available */ {
       /* grab the current mapping */ {
@@ -1140,7 +1219,7 @@ void TSafeRepo::StepMergeDisk(size_t block_slots_available) {
                   && (rhs_layer->GetKind() == TDataLayer::TKind::Disk)  // my neighbor is a disk layer
                   && (!lhs_layer->GetMarkedTaken())  // I'm not marked taken
                   && (!rhs_layer->GetMarkedTaken())  // my neighbor is not marked taken
-                  && (Disk::Util::SuggestGeneration(lhs_layer->GetSize()) <= Disk::Util::SuggestGeneration(rhs_layer->GetSize()))  // in in the same or lower gen set than my neighbor
+                  && (read_hot || Disk::Util::SuggestGeneration(lhs_layer->GetSize()) <= Disk::Util::SuggestGeneration(rhs_layer->GetSize()))  // reads are hot, or i'm in the same or lower gen set than my neighbor
                   ) {
                 lowest_seq = std::min(lowest_seq, lhs_layer->GetLowestSeq());
                 highest_seq = std::max(highest_seq, lhs_layer->GetHighestSeq());
@@ -1328,7 +1407,7 @@ size_t TSafeRepo::MergeFiles(const std::vector<size_t> &gen_id_vec,
   size_t gen_id = GetNextGenId();
   bool my_can_tail = can_tail && !static_cast<bool>(GetParentRepo()) && IsTailingAllowed();
   bool my_can_tail_tombstone = my_can_tail && can_tail_tombstone && (gen_id_vec.size() == 1);
-  TMergeDataFile merge_data_file(Manager->GetEngine(), storage_speed, GetId(), gen_id_vec, GetId(), gen_id, release_up_to, Low, max_block_cache_read_slots_allowed, temp_file_consol_thresh, my_can_tail, my_can_tail_tombstone);
+  TMergeDataFile merge_data_file(Manager->GetEngine(), storage_speed, GetId(), gen_id_vec, GetId(), gen_id, release_up_to, Low, max_block_cache_read_slots_allowed, temp_file_consol_thresh, my_can_tail, my_can_tail_tombstone, Manager->GetMergeWorkerPool());
   out_num_keys = merge_data_file.GetNumKeys();
   out_saved_low_seq = merge_data_file.GetLowestSequence();
   out_saved_high_seq = merge_data_file.GetHighestSequence();
@@ -1341,7 +1420,7 @@ void TSafeRepo::RemoveFile(size_t gen_id) {
   /* reader life span */ {
     TReader reader(Manager->GetEngine(), GetId(), Low, gen_id);
     try {
-      TReader::TInStream in_stream(HERE, Source::FileRemoval, Low, &reader, Manager->GetEngine()->GetPageCache(), (reader.GetStartingBlockOffset() * Disk::Util::LogicalBlockSize) + (TData::NumMetaFields * sizeof(size_t)));
+      TReader::TInStream in_stream(HERE, Source::FileRemoval, Low, &reader, Manager->GetEngine()->GetPageCache(), (reader.GetStartingBlockOffset() * Disk::Util::LogicalBlockSize) + (reader.GetNumMetaFields() * sizeof(size_t)));
       size_t block_id;
       for (size_t i = 0; i < reader.GetNumMetaBlocks(); ++i) {
         in_stream.Read(block_id);
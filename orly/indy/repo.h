@@ -65,6 +65,10 @@ namespace Orly {
         /* TODO */
         TView(TRepo *repo);
 
+        /* Another view of the same repo which sees exactly what the given one does, no matter what has happened to the
+           repo since. */
+        explicit TView(const TView *that);
+
         /* TODO */
         ~TView();
 
@@ -171,6 +175,18 @@ namespace Orly {
                                                                      const TIndexKey &key,
                                                                      bool ignore_tombstone = false);
 
+      /* Look up the newest version of the given key visible through the given view, without merging walkers over every
+         layer.  The memory layer goes first, then the data layers from newest to oldest, and a layer is only probed if
+         it could hold a newer version than the best found so far, so a key which lives in the newest layer costs one
+         probe.  If there is a version (which may be a tombstone), returns true, copies it to out_item and leaves the
+         walker it came from in out_walker; that walker owns the version's memory, so keep it around for as long as the
+         item is in use.  Adds the number of layers probed to num_probed. */
+      bool FindNewest(const std::unique_ptr<TView> &view,
+                      const TIndexKey &key,
+                      Indy::TPresentWalker::TItem &out_item,
+                      std::unique_ptr<Indy::TPresentWalker> &out_walker,
+                      size_t &num_probed) const;
+
       /* TODO */
       virtual std::unique_ptr<Indy::TUpdateWalker> NewUpdateWalker(const std::unique_ptr<TView> &view,
                                                                    TSequenceNumber from,
@@ -243,6 +259,10 @@ namespace Orly {
       /* TODO */
       TMemoryLayer *CurMemoryLayer;
 
+      /* The commits in CurMemoryLayer which are waiting to be merged to disk.  Only kept for safe repos.  Covered by
+         DataLock. */
+      Util::TGroupCommit::TBatch PendingCommits;
+
       private:
 
       /* TODO */
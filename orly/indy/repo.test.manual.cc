@@ -0,0 +1,258 @@
+/* <orly/indy/repo.test.manual.cc>
+
+   Benchmarks point lookups in <orly/indy/repo.h> as the number of data layers grows.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/repo.h>
+
+#include <iostream>
+#include <random>
+
+#include <base/scheduler.h>
+#include <base/timer.h>
+#include <orly/indy/disk/sim/mem_engine.h>
+#include <orly/indy/fiber/fiber_test_runner.h>
+#include <orly/indy/manager.h>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace std::chrono;
+using namespace Base;
+using namespace Orly;
+using namespace Orly::Atom;
+using namespace Orly::Indy;
+
+Orly::Indy::Util::TPool L0::TManager::TRepo::TMapping::Pool(sizeof(TRepo::TMapping), "Repo Mapping", 100UL);
+Orly::Indy::Util::TPool L0::TManager::TRepo::TMapping::TEntry::Pool(sizeof(TRepo::TMapping::TEntry), "Repo Mapping Entry", 1000UL);
+Orly::Indy::Util::TPool L0::TManager::TRepo::TDataLayer::Pool(sizeof(TMemoryLayer), "Data Layer", 100UL);
+
+Orly::Indy::Util::TPool L1::TTransaction::TMutation::Pool(max(max(sizeof(L1::TTransaction::TPusher), sizeof(L1::TTransaction::TPopper)), sizeof(L1::TTransaction::TStatusChanger)), "Transaction::TMutation", 100UL);
+Orly::Indy::Util::TPool L1::TTransaction::Pool(sizeof(L1::TTransaction), "Transaction", 100UL);
+
+Disk::TBufBlock::TPool Disk::TBufBlock::Pool(Disk::Util::PhysicalBlockSize);
+
+Orly::Indy::Util::TPool TUpdate::Pool(sizeof(TUpdate), "Update", 200000UL);
+Orly::Indy::Util::TPool TUpdate::TEntry::Pool(sizeof(TUpdate::TEntry), "Entry", 200000UL);
+
+const std::vector<size_t> MemMergeCoreVec{0};
+const std::vector<size_t> DiskMergeCoreVec{0};
+
+static const int64_t NumHotKeys = 100L;
+static const int64_t NumLookups = 2000L;
+
+/* A fast repo whose data layers we lay down by hand, so no merge gets to fold them together. */
+class TLayeredRepo
+    : public TFastRepo {
+  NO_COPY(TLayeredRepo);
+  public:
+
+  TLayeredRepo(L0::TManager *manager, const Base::TUuid &repo_id, const TTtl &ttl, TSequenceNumber highest)
+      : TFastRepo(manager, repo_id, ttl, TOpt<L0::TManager::TPtr<L0::TManager::TRepo>>::GetUnknown(), 1UL, highest, highest + 1UL, Normal) {}
+
+  using TRepo::AddMapping;
+
+};  // TLayeredRepo
+
+class TMyManager
+    : public L1::TManager {
+  NO_COPY(TMyManager);
+  public:
+
+  TMyManager(Disk::Util::TEngine *engine,
+             Base::TScheduler *scheduler,
+             const std::vector<size_t> &mem_merge_cores,
+             const std::vector<size_t> &disk_merge_cores)
+      : TManager(engine,
+                 10ms,
+                 100ms,
+                 true,
+                 true,
+                 1000ms,
+                 scheduler,
+                 100UL,
+                 100UL,
+                 20UL,
+                 mem_merge_cores,
+                 disk_merge_cores,
+                 true),
+        Highest(0UL) {}
+
+  virtual ~TMyManager() {}
+
+  virtual TRepo *ConstructRepo(const Base::TUuid &repo_id,
+                               const Base::TOpt<TTtl> &ttl,
+                               const Base::TOpt<TManager::TPtr<TRepo>> &/*parent_repo*/,
+                               bool /*is_safe*/,
+                               bool /*create*/) override {
+    return new TLayeredRepo(this, repo_id, *ttl, Highest);
+  }
+
+  virtual void SaveRepo(Orly::Indy::L0::TManager::TRepo *) override {}
+
+  virtual void Enqueue(Orly::Indy::TTransactionReplication *, Orly::Indy::L1::TTransaction::TReplica &&) NO_THROW override {}
+
+  virtual Orly::Indy::TTransactionReplication* NewTransactionReplication() override {
+    return nullptr;
+  }
+
+  virtual void DeleteTransactionReplication(Orly::Indy::TTransactionReplication*) NO_THROW override {}
+
+  virtual void ForEachScheduler(const std::function<bool (Fiber::TRunner *)> &/*cb*/) const override {}
+
+  virtual bool CanLoad(const L0::TId &/*id*/) override {
+    return true;
+  }
+
+  virtual void Delete(const L0::TId &/*id*/, L0::TSem */*sem*/) override {}
+
+  virtual void Save(const L0::TId &/*id*/, const L0::TDeadline &/*deadline*/, const std::string &/*blob*/, L0::TSem */*sem*/) override {}
+
+  virtual bool TryLoad(const L0::TId &/*id*/, std::string &/*blob*/) override {
+    return true;
+  }
+
+  virtual TRepo *ReconstructRepo(const Base::TUuid &/*repo_id*/) override {
+    return nullptr;
+  }
+
+  virtual void RunReplicationQueue() override {}
+
+  virtual void RunReplicationWork() override {}
+
+  virtual void RunReplicateTransaction() override {}
+
+  virtual std::mutex &GetReplicationQueueLock() NO_THROW override {
+    return ReplicationQueueLock;
+  }
+
+  /* A new repo whose view covers sequence numbers [1, highest]. */
+  TManager::TPtr<Indy::TRepo> NewRepo(TSequenceNumber highest) {
+    assert(this);
+    Highest = highest;
+    return OpenOrCreate(Base::TUuid(TUuid::Twister), TTtl::max(), TOpt<TManager::TPtr<L0::TManager::TRepo>>::GetUnknown(), false);
+  }
+
+  private:
+
+  std::mutex ReplicationQueueLock;
+
+  TSequenceNumber Highest;
+
+};
+
+/* Insert a single-entry update into the layer. */
+static void Insert(TMemoryLayer *mem_layer, TSequenceNumber seq_num, const Base::TUuid &idx_id, int64_t key) {
+  Atom::TSuprena arena;
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  std::shared_ptr<TUpdate> update(TUpdate::NewUpdate(TUpdate::TOpByKey{
+    { TIndexKey(idx_id, TKey(std::make_tuple(key), &arena, state_alloc)), TKey(key, &arena, state_alloc)}
+    }, TKey(&arena), TKey(Base::TUuid(Base::TUuid::Best), &arena, state_alloc)));
+  update->SetSequenceNumber(seq_num);
+  mem_layer->Insert(TUpdate::CopyUpdate(update.get(), state_alloc));
+}
+
+/* Time NumLookups point lookups of random keys, first by merging a walker over every layer, then newest-first.  The
+   hot keys live in every layer, so their newest version is always in the newest one.  The cold keys live only in the
+   oldest layer. */
+static void BenchLayers(TMyManager *manager, size_t num_layers, bool hot) {
+  const TSequenceNumber highest = num_layers * NumHotKeys + NumHotKeys;
+  auto repo = manager->NewRepo(highest);
+  TLayeredRepo *layered_repo = dynamic_cast<TLayeredRepo *>(repo.Get());
+  Base::TUuid idx_id(TUuid::Twister);
+  TSequenceNumber seq_num = 0UL;
+  for (size_t i = 0; i < num_layers; ++i) {
+    TMemoryLayer *mem_layer = new TMemoryLayer(manager);
+    for (int64_t key = 0; key < NumHotKeys; ++key) {
+      Insert(mem_layer, ++seq_num, idx_id, key);
+    }
+    if (!i) {
+      for (int64_t key = NumHotKeys; key < NumHotKeys * 2L; ++key) {
+        Insert(mem_layer, ++seq_num, idx_id, key);
+      }
+    }
+    layered_repo->AddMapping(mem_layer);
+  }
+  auto view = make_unique<TRepo::TView>(repo);
+  EXPECT_EQ(view->GetNumEntries(), num_layers);
+  TSuprena arena;
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  mt19937_64 engine(num_layers);
+  uniform_int_distribution<int64_t> pick(hot ? 0L : NumHotKeys, hot ? NumHotKeys - 1L : NumHotKeys * 2L - 1L);
+  vector<int64_t> keys(NumLookups);
+  for (auto &key : keys) {
+    key = pick(engine);
+  }
+  /* both ways had better agree */
+  for (size_t i = 0; i < 100UL; ++i) {
+    TIndexKey index_key(idx_id, TKey(make_tuple(keys[i]), &arena, state_alloc));
+    auto walker = repo->NewPresentWalker(view, index_key);
+    Indy::TPresentWalker::TItem item;
+    unique_ptr<Indy::TPresentWalker> found_walker;
+    size_t num_probed = 0UL;
+    if (EXPECT_TRUE(static_cast<bool>(*walker)) && EXPECT_TRUE(repo->FindNewest(view, index_key, item, found_walker, num_probed))) {
+      EXPECT_EQ(item.SequenceNumber, (**walker).SequenceNumber);
+    }
+  }
+  TTimer timer;
+  timer.Start();
+  for (int64_t key : keys) {
+    TIndexKey index_key(idx_id, TKey(make_tuple(key), &arena, state_alloc));
+    auto walker = repo->NewPresentWalker(view, index_key);
+    EXPECT_TRUE(static_cast<bool>(*walker));
+  }
+  timer.Stop();
+  const double merged_us = duration_cast<duration<double, micro>>(timer.GetTotal()).count() / NumLookups;
+  size_t num_probed = 0UL;
+  timer.Start();
+  for (int64_t key : keys) {
+    TIndexKey index_key(idx_id, TKey(make_tuple(key), &arena, state_alloc));
+    Indy::TPresentWalker::TItem item;
+    unique_ptr<Indy::TPresentWalker> walker;
+    EXPECT_TRUE(repo->FindNewest(view, index_key, item, walker, num_probed));
+  }
+  timer.Stop();
+  const double newest_first_us = duration_cast<duration<double, micro>>(timer.GetTotal()).count() / NumLookups;
+  cout << "layers = " << num_layers << (hot ? ", hot" : ", cold")
+       << ", merged = " << merged_us << " us"
+       << ", newest first = " << newest_first_us << " us"
+       << " (" << (static_cast<double>(num_probed) / NumLookups) << " layers probed)" << endl;
+}
+
+FIXTURE(LayerCount) {
+  Fiber::TFiberTestRunner runner([](std::mutex &mut, std::condition_variable &cond, bool &fin, Fiber::TRunner::TRunnerCons &) {
+    const TScheduler::TPolicy scheduler_policy(10, 10, 10ms);
+    TScheduler scheduler;
+    scheduler.SetPolicy(scheduler_policy);
+    Orly::Indy::Disk::Sim::TMemEngine mem_engine(&scheduler,
+                                                 256 /* fast disk space: 256MB */,
+                                                 64 /* slow disk space: 64MB */,
+                                                 128 /* page cache slots: 8MB */,
+                                                 1 /* num page lru */,
+                                                 64 /* block cache slots: 4MB */,
+                                                 1 /* num block lru */);
+    auto manager = make_unique<TMyManager>(mem_engine.GetEngine(), &scheduler, MemMergeCoreVec, DiskMergeCoreVec);
+    cout << endl;
+    for (bool hot : { true, false }) {
+      for (size_t num_layers : { 1UL, 2UL, 4UL, 8UL, 16UL }) {
+        BenchLayers(manager.get(), num_layers, hot);
+      }
+    }
+    std::lock_guard<std::mutex> lock(mut);
+    fin = true;
+    cond.notify_one();
+  });
+}
@@ -20,6 +20,7 @@
 
 #include <base/class_traits.h>
 #include <inv_con/ordered_list.h>
+#include <inv_con/skip_list.h>
 #include <orly/atom/kit2.h>
 #include <orly/atom/suprena.h>
 #include <orly/indy/key.h>
@@ -153,6 +154,9 @@ namespace Orly {
           /* TODO */
           bool operator>(const TEntryKey &that) const;
 
+          /* The entry whose key this is.  Lets a search over the memory layer compare against a partial key. */
+          inline const TEntry *GetEntry() const;
+
           private:
 
           /* TODO */
@@ -162,7 +166,7 @@ namespace Orly {
 
         /* TODO */
         typedef InvCon::OrderedList::TMembership<TEntry, TUpdate, TKey> TUpdateMembership;
-        typedef InvCon::OrderedList::TMembership<TEntry, TMemoryLayer, TEntryKey> TMemoryLayerMembership;
+        typedef InvCon::SkipList::TMembership<TEntry, TMemoryLayer, TEntryKey> TMemoryLayerMembership;
 
         /* TODO */
         TEntry(TUpdate *update, const TIndexKey &key, const TKey &op, void *state_alloc);
@@ -439,6 +443,11 @@ namespace Orly {
       return MemoryLayerMembership.GetKey();
     }
 
+    inline const TUpdate::TEntry *TUpdate::TEntry::TEntryKey::GetEntry() const {
+      assert(this);
+      return Entry;
+    }
+
     /* TODO */
     inline TUpdate::TEntryCollection *TUpdate::GetEntryCollection() const {
       assert(this);
@@ -0,0 +1,106 @@
+/* <orly/indy/util/group_commit.cc>
+
+   Implements <orly/indy/util/group_commit.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/util/group_commit.h>
+
+#include <algorithm>
+
+using namespace std;
+using namespace chrono;
+using namespace Orly::Indy::Util;
+
+/* The number of microseconds between two times, as a double. */
+static inline double GetMicros(const TGroupCommit::TTime &start, const TGroupCommit::TTime &stop) {
+  return duration_cast<duration<double, micro>>(stop - start).count();
+}
+
+/* Move the given moving average toward the given sample. */
+static inline void Update(atomic<double> &avg, double sample, double alpha) {
+  double expected = avg.load();
+  while (!avg.compare_exchange_weak(expected, expected + alpha * (sample - expected))) {}
+}
+
+TGroupCommit::TGroupCommit(const microseconds &max_delay, size_t max_batch_size)
+    : MaxDelay(static_cast<double>(max_delay.count())),
+      MaxBatchSize(max_batch_size),
+      ArrivalGap(static_cast<double>(max_delay.count())),
+      FlushCost(0.0),
+      LastArrival(0) {
+  assert(max_delay.count() >= 0);
+  assert(max_batch_size);
+  Stats.NumFlushes = 0UL;
+  Stats.NumCommits = 0UL;
+}
+
+void TGroupCommit::Arrive(TBatch &batch, const TTime &now) {
+  assert(this);
+  assert(&batch);
+  batch.Push(now);
+  /* Advance LastArrival to now (unless someone got there first with a later time) and remember what it was. */
+  const TClock::rep ticks = now.time_since_epoch().count();
+  TClock::rep last_arrival = LastArrival.load();
+  while (last_arrival < ticks && !LastArrival.compare_exchange_weak(last_arrival, ticks)) {}
+  if (last_arrival) {
+    /* A long quiet spell shouldn't take a whole burst to forget, so no gap counts for more than the max delay. */
+    Update(ArrivalGap, min(max(GetMicros(TTime(TClock::duration(last_arrival)), now), 0.0), MaxDelay), Alpha);
+  }
+}
+
+TGroupCommit::TTime TGroupCommit::GetFlushTime(const TBatch &batch) const {
+  assert(this);
+  assert(&batch);
+  if (batch.IsEmpty()) {
+    return TTime::max();
+  }
+  const TTime &first_arrival = batch.GetFirstArrival();
+  if (batch.GetSize() >= MaxBatchSize) {
+    return first_arrival;
+  }
+  const double flush_cost = FlushCost.load();
+  if (flush_cost < ArrivalGap.load()) {
+    /* We don't expect anyone else to show up before a flush could finish, so waiting would only add latency. */
+    return first_arrival;
+  }
+  const double wait = min(flush_cost, MaxDelay);
+  return first_arrival + duration_cast<TClock::duration>(duration<double, micro>(wait));
+}
+
+void TGroupCommit::OnFlushed(TBatch &batch, const TTime &start, const TTime &now) {
+  assert(this);
+  assert(&batch);
+  Update(FlushCost, max(GetMicros(start, now), 0.0), Alpha);
+  lock_guard<mutex> lock(Mutex);
+  ++Stats.NumFlushes;
+  Stats.NumCommits += batch.GetSize();
+  Stats.BatchSize.Push(static_cast<double>(batch.GetSize()));
+  for (const TTime &arrival: batch.Arrivals) {
+    Stats.Latency.Push(GetMicros(arrival, now));
+  }
+  batch.Arrivals.clear();
+}
+
+void TGroupCommit::TakeStats(TStats &out) {
+  assert(this);
+  assert(&out);
+  lock_guard<mutex> lock(Mutex);
+  out = Stats;
+  Stats.NumFlushes = 0UL;
+  Stats.NumCommits = 0UL;
+  Stats.Latency.Reset();
+  Stats.BatchSize.Reset();
+}
@@ -0,0 +1,167 @@
+/* <orly/indy/util/group_commit.h>
+
+   Decides when a batch of commits waiting for disk should be flushed, and keeps latency statistics about the flushes.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <base/class_traits.h>
+#include <base/histogram.h>
+
+namespace Orly {
+
+  namespace Indy {
+
+    namespace Util {
+
+      /* An adaptive group-commit policy.
+         We keep moving averages of the gap between arriving commits and of the time it takes to flush a batch.  If we
+         expect less than one more commit to arrive while a flush is running, the system is idle and a batch should be
+         flushed as soon as it has anything in it.  Otherwise we hold the batch open for about one flush time (but never
+         more than the max delay) so that concurrent commits share a flush, unless the batch fills up first.
+         The policy is thread-safe, and Arrive() and GetFlushTime() never block, so they may be called under the lock
+         which guards the batch.  Each batch is guarded by whoever owns it. */
+      class TGroupCommit {
+        NO_COPY(TGroupCommit);
+        public:
+
+        /* The clock we schedule by. */
+        using TClock = std::chrono::steady_clock;
+
+        /* A point in time on our clock. */
+        using TTime = TClock::time_point;
+
+        /* The commits which will go to disk together in the next flush. */
+        class TBatch {
+          NO_COPY(TBatch);
+          public:
+
+          /* Start out empty. */
+          TBatch() {}
+
+          /* The time at which the oldest commit in the batch arrived.  The batch must not be empty. */
+          const TTime &GetFirstArrival() const {
+            assert(this);
+            assert(!Arrivals.empty());
+            return Arrivals.front();
+          }
+
+          /* The number of commits in the batch. */
+          size_t GetSize() const {
+            assert(this);
+            return Arrivals.size();
+          }
+
+          /* True iff. the batch has no commits in it. */
+          bool IsEmpty() const {
+            assert(this);
+            return Arrivals.empty();
+          }
+
+          /* Add a commit to the batch without telling the policy about it.  Use this when the batch is flushed on some
+             other schedule but you still want its latencies counted. */
+          void Push(const TTime &now) {
+            assert(this);
+            Arrivals.push_back(now);
+          }
+
+          /* Trade contents with the given batch. */
+          void Swap(TBatch &that) {
+            assert(this);
+            assert(&that);
+            Arrivals.swap(that.Arrivals);
+          }
+
+          private:
+
+          /* The arrival time of each commit in the batch, oldest first. */
+          std::vector<TTime> Arrivals;
+
+          /* For Arrivals. */
+          friend class TGroupCommit;
+
+        };  // TBatch
+
+        /* What we've seen since the last time the stats were taken. */
+        struct TStats {
+
+          /* The number of batches flushed. */
+          size_t NumFlushes;
+
+          /* The number of commits in those batches. */
+          size_t NumCommits;
+
+          /* The time (in microseconds) each commit waited between arriving and its flush finishing. */
+          Base::THistogram Latency;
+
+          /* The number of commits in each flush. */
+          Base::THistogram BatchSize;
+
+        };  // TStats
+
+        /* Never hold a batch open longer than max_delay, and flush right away once it holds max_batch_size commits. */
+        TGroupCommit(const std::chrono::microseconds &max_delay, size_t max_batch_size);
+
+        /* Add a commit arriving now to the given batch. */
+        void Arrive(TBatch &batch, const TTime &now = TClock::now());
+
+        /* The time at which the given batch should be flushed.  This is TTime::max() if the batch is empty and never
+           later than the first arrival plus the max delay. */
+        TTime GetFlushTime(const TBatch &batch) const;
+
+        /* The given batch was flushed, starting at the given time and finishing now.  This empties the batch. */
+        void OnFlushed(TBatch &batch, const TTime &start, const TTime &now = TClock::now());
+
+        /* Copy out our stats and reset them. */
+        void TakeStats(TStats &out);
+
+        private:
+
+        /* The weight given to each new sample in our moving averages. */
+        static constexpr double Alpha = 0.125;
+
+        /* See ctor. */
+        const double MaxDelay;
+
+        /* See ctor. */
+        const size_t MaxBatchSize;
+
+        /* Moving averages, in microseconds, of the gap between commits and of the time a flush takes. */
+        std::atomic<double> ArrivalGap, FlushCost;
+
+        /* When the most recent commit arrived, as ticks since the clock's epoch, or zero if none have. */
+        std::atomic<TClock::rep> LastArrival;
+
+        /* Covers Stats. */
+        std::mutex Mutex;
+
+        /* See TakeStats(). */
+        TStats Stats;
+
+      };  // TGroupCommit
+
+    }  // Util
+
+  }  // Indy
+
+}  // Orly
@@ -0,0 +1,121 @@
+/* <orly/indy/util/group_commit.test.cc>
+
+   Unit test for <orly/indy/util/group_commit.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/util/group_commit.h>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Orly::Indy::Util;
+
+/* A point in time, so many microseconds after an arbitrary start. */
+static TGroupCommit::TTime At(size_t micros) {
+  return TGroupCommit::TTime() + hours(1) + microseconds(micros);
+}
+
+/* Make the policy believe commits arrive every gap microseconds and flushes take cost microseconds. */
+static void Train(TGroupCommit &group_commit, size_t gap, size_t cost) {
+  TGroupCommit::TBatch batch;
+  size_t now = 0;
+  for (size_t i = 0; i < 100; ++i) {
+    group_commit.Arrive(batch, At(now));
+    now += gap;
+    group_commit.OnFlushed(batch, At(now), At(now + cost));
+  }
+  TGroupCommit::TStats stats;
+  group_commit.TakeStats(stats);
+}
+
+FIXTURE(Empty) {
+  TGroupCommit group_commit(microseconds(1000), 100);
+  TGroupCommit::TBatch batch;
+  EXPECT_TRUE(batch.IsEmpty());
+  EXPECT_TRUE(group_commit.GetFlushTime(batch) == TGroupCommit::TTime::max());
+}
+
+FIXTURE(Idle) {
+  TGroupCommit group_commit(microseconds(1000), 100);
+  /* Nothing has happened yet, so the first commit goes right away. */
+  TGroupCommit::TBatch batch;
+  group_commit.Arrive(batch, At(0));
+  EXPECT_TRUE(group_commit.GetFlushTime(batch) == At(0));
+  group_commit.OnFlushed(batch, At(0), At(10));
+  EXPECT_TRUE(batch.IsEmpty());
+  /* Commits arrive much further apart than a flush takes, so there's no point waiting. */
+  Train(group_commit, 500, 10);
+  group_commit.Arrive(batch, At(5000));
+  EXPECT_TRUE(group_commit.GetFlushTime(batch) == At(5000));
+}
+
+FIXTURE(Loaded) {
+  TGroupCommit group_commit(microseconds(1000), 100);
+  /* Many commits arrive during each flush, so hold the batch open for about one flush time. */
+  Train(group_commit, 10, 200);
+  TGroupCommit::TBatch batch;
+  group_commit.Arrive(batch, At(5000));
+  group_commit.Arrive(batch, At(5010));
+  auto flush_time = group_commit.GetFlushTime(batch);
+  EXPECT_TRUE(flush_time > At(5000));
+  EXPECT_TRUE(flush_time <= At(5200));
+}
+
+FIXTURE(MaxDelay) {
+  TGroupCommit group_commit(microseconds(100), 100);
+  /* Flushes are slow, but we never wait longer than the max delay. */
+  Train(group_commit, 10, 100000);
+  TGroupCommit::TBatch batch;
+  group_commit.Arrive(batch, At(5000));
+  EXPECT_TRUE(group_commit.GetFlushTime(batch) == At(5100));
+}
+
+FIXTURE(Full) {
+  TGroupCommit group_commit(microseconds(1000), 4);
+  Train(group_commit, 10, 200);
+  TGroupCommit::TBatch batch;
+  for (size_t i = 0; i < 3; ++i) {
+    group_commit.Arrive(batch, At(5000 + i));
+  }
+  EXPECT_TRUE(group_commit.GetFlushTime(batch) > At(5000));
+  group_commit.Arrive(batch, At(5003));
+  EXPECT_TRUE(group_commit.GetFlushTime(batch) == At(5000));
+}
+
+FIXTURE(Stats) {
+  TGroupCommit group_commit(microseconds(1000), 100);
+  TGroupCommit::TBatch batch;
+  for (size_t i = 0; i < 10; ++i) {
+    group_commit.Arrive(batch, At(i * 10));
+  }
+  EXPECT_EQ(batch.GetSize(), 10UL);
+  group_commit.OnFlushed(batch, At(100), At(1000));
+  batch.Push(At(2000));
+  group_commit.OnFlushed(batch, At(2000), At(2001));
+  TGroupCommit::TStats stats;
+  group_commit.TakeStats(stats);
+  EXPECT_EQ(stats.NumFlushes, 2UL);
+  EXPECT_EQ(stats.NumCommits, 11UL);
+  EXPECT_EQ(stats.Latency.GetCount(), 11UL);
+  EXPECT_EQ(stats.BatchSize.GetCount(), 2UL);
+  /* Ten of the eleven commits waited between 910 and 1000 microseconds. */
+  EXPECT_EQ(stats.Latency.GetPercentile(50), 1024.0);
+  EXPECT_LE(stats.Latency.GetPercentile(1), 2.0);
+  group_commit.TakeStats(stats);
+  EXPECT_EQ(stats.NumFlushes, 0UL);
+  EXPECT_EQ(stats.Latency.GetCount(), 0UL);
+}
@@ -0,0 +1,76 @@
+/* <orly/indy/util/merge_cost.cc>
+
+   Implements <orly/indy/util/merge_cost.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/util/merge_cost.h>
+
+#include <cmath>
+
+using namespace std;
+using namespace chrono;
+using namespace Orly::Indy::Util;
+
+const TMergeCost::TClock::duration TMergeCost::MinSampleInterval = milliseconds(100);
+
+TMergeCost::TMergeCost()
+    : NumLookups(0UL),
+      NumProbes(0UL),
+      NumUpdates(0UL),
+      LastSample(TClock::now()),
+      LastNumLookups(0UL),
+      LastNumProbes(0UL),
+      LastNumUpdates(0UL) {
+  Load.LookupRate = 0.0;
+  Load.ReadAmp = 1.0;
+  Load.UpdateRate = 0.0;
+}
+
+TMergeCost::TLoad TMergeCost::Sample(const TClock::time_point &now) {
+  assert(this);
+  lock_guard<mutex> lock(Mutex);
+  if (now - LastSample >= MinSampleInterval) {
+    const double secs = duration_cast<duration<double>>(now - LastSample).count();
+    const size_t
+        num_lookups = NumLookups.load(memory_order_relaxed),
+        num_probes = NumProbes.load(memory_order_relaxed),
+        num_updates = NumUpdates.load(memory_order_relaxed);
+    const size_t lookups = num_lookups - LastNumLookups;
+    Load.LookupRate += Alpha * ((lookups / secs) - Load.LookupRate);
+    /* With no lookups, we've learned nothing new about how many layers they probe. */
+    if (lookups) {
+      Load.ReadAmp += Alpha * ((static_cast<double>(num_probes - LastNumProbes) / lookups) - Load.ReadAmp);
+    }
+    Load.UpdateRate += Alpha * (((num_updates - LastNumUpdates) / secs) - Load.UpdateRate);
+    LastSample = now;
+    LastNumLookups = num_lookups;
+    LastNumProbes = num_probes;
+    LastNumUpdates = num_updates;
+  }
+  return Load;
+}
+
+TMergeCost::TLoad TMergeCost::GetLoad() const {
+  assert(this);
+  lock_guard<mutex> lock(Mutex);
+  return Load;
+}
+
+TMergeCost::TClock::duration TMergeCost::GetDelay(const TLoad &load, const TClock::duration &base_delay) {
+  assert(&load);
+  /* Interpolate geometrically, so each step in urgency shortens the delay by the same factor. */
+  return duration_cast<TClock::duration>(base_delay * pow(MaxDelayFactor, 1.0 - load.GetUrgency()));
+}
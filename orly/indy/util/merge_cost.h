@@ -0,0 +1,142 @@
+/* <orly/indy/util/merge_cost.h>
+
+   Tracks a repo's reads and writes and turns them into a priority for merging its layers.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+#include <base/class_traits.h>
+
+namespace Orly {
+
+  namespace Indy {
+
+    namespace Util {
+
+      /* The cost model behind merge scheduling.
+         Merging a repo's layers pays off in reads: every point lookup probes layers until it finds the newest version, so
+         a repo with many layers and many lookups wastes probes.  Merging costs writes, and a repo taking a lot of updates
+         will grow new layers right behind the merge.  We count lookups, probes and updates as they happen, and sample
+         them into moving rates when it's time to schedule a merge.
+         Counting is lock-free.  Sampling and looking are thread-safe. */
+      class TMergeCost {
+        NO_COPY(TMergeCost);
+        public:
+
+        /* The clock we sample by. */
+        using TClock = std::chrono::steady_clock;
+
+        /* What a repo's recent load says about merging it. */
+        struct TLoad {
+
+          /* Point lookups per second. */
+          double LookupRate;
+
+          /* The mean number of layers probed per point lookup. */
+          double ReadAmp;
+
+          /* Updates per second. */
+          double UpdateRate;
+
+          /* The merge debt: probes per second which would go away if the repo were merged down to a single layer. */
+          double GetDebt() const {
+            assert(this);
+            return LookupRate * std::max(ReadAmp - 1.0, 0.0);
+          }
+
+          /* How much a merge would help reads compared to how fast writes would undo it, from 0 (not at all) to almost
+             1 (reads are all that matter). */
+          double GetUrgency() const {
+            assert(this);
+            const double debt = GetDebt();
+            return debt / (debt + UpdateRate + 1.0);
+          }
+
+        };  // TLoad
+
+        /* Start out with no load. */
+        TMergeCost();
+
+        /* Count a point lookup which probed the given number of layers. */
+        void OnLookup(size_t num_probed) noexcept {
+          assert(this);
+          NumLookups.fetch_add(1UL, std::memory_order_relaxed);
+          NumProbes.fetch_add(num_probed, std::memory_order_relaxed);
+        }
+
+        /* Count an update. */
+        void OnUpdate() noexcept {
+          assert(this);
+          NumUpdates.fetch_add(1UL, std::memory_order_relaxed);
+        }
+
+        /* Fold the counts since the last sample into our moving rates and return the result.  If the last sample was
+           too recent to say much, this just returns the current rates. */
+        TLoad Sample(const TClock::time_point &now = TClock::now());
+
+        /* The rates as of the last sample, without folding in anything since.  Use this to look without disturbing the
+           schedule. */
+        TLoad GetLoad() const;
+
+        /* How long to wait before merging a repo with the given load.  This runs from base_delay, for a repo whose reads
+           are all that matter, up to MaxDelayFactor times that, for one which is only written. */
+        static TClock::duration GetDelay(const TLoad &load, const TClock::duration &base_delay);
+
+        /* True iff. the given load makes it worth merging neighboring layers even when they're of different generations.
+           Otherwise we only merge a layer into a neighbor of the same or a higher generation, which keeps the bytes each
+           update gets rewritten down to about the number of generations. */
+        static bool IsReadHot(const TLoad &load) {
+          return load.GetUrgency() >= 0.5;
+        }
+
+        /* See GetDelay(). */
+        static constexpr double MaxDelayFactor = 16.0;
+
+        private:
+
+        /* The weight given to each new sample in our moving rates. */
+        static constexpr double Alpha = 0.25;
+
+        /* Samples closer together than this are ignored. */
+        static const TClock::duration MinSampleInterval;
+
+        /* Counts since construction. */
+        std::atomic<size_t> NumLookups, NumProbes, NumUpdates;
+
+        /* Covers everything below. */
+        mutable std::mutex Mutex;
+
+        /* When we last sampled, and the counts at that time. */
+        TClock::time_point LastSample;
+        size_t LastNumLookups, LastNumProbes, LastNumUpdates;
+
+        /* The moving rates. */
+        TLoad Load;
+
+      };  // TMergeCost
+
+    }  // Util
+
+  }  // Indy
+
+}  // Orly
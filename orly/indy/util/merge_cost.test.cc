@@ -0,0 +1,112 @@
+/* <orly/indy/util/merge_cost.test.cc>
+
+   Unit test for <orly/indy/util/merge_cost.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/indy/util/merge_cost.h>
+
+#include <test/kit.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Orly::Indy::Util;
+
+/* Run the given number of one-second sample periods, each with the given lookups, probes per lookup and updates. */
+static TMergeCost::TLoad Run(TMergeCost &merge_cost, size_t num_periods, size_t num_lookups, size_t read_amp, size_t num_updates) {
+  auto now = TMergeCost::TClock::now();
+  TMergeCost::TLoad load;
+  for (size_t i = 0; i < num_periods; ++i) {
+    for (size_t j = 0; j < num_lookups; ++j) {
+      merge_cost.OnLookup(read_amp);
+    }
+    for (size_t j = 0; j < num_updates; ++j) {
+      merge_cost.OnUpdate();
+    }
+    now += seconds(1);
+    load = merge_cost.Sample(now);
+  }
+  return load;
+}
+
+FIXTURE(Idle) {
+  TMergeCost merge_cost;
+  auto load = merge_cost.Sample();
+  EXPECT_EQ(load.LookupRate, 0.0);
+  EXPECT_EQ(load.ReadAmp, 1.0);
+  EXPECT_EQ(load.UpdateRate, 0.0);
+  EXPECT_EQ(load.GetDebt(), 0.0);
+  EXPECT_EQ(load.GetUrgency(), 0.0);
+  EXPECT_FALSE(TMergeCost::IsReadHot(load));
+  /* With no reason to merge, we wait as long as we ever do. */
+  auto delay = TMergeCost::GetDelay(load, milliseconds(10));
+  EXPECT_TRUE(delay == duration_cast<TMergeCost::TClock::duration>(milliseconds(160)));
+}
+
+FIXTURE(ReadHeavy) {
+  TMergeCost merge_cost;
+  auto load = Run(merge_cost, 50, 1000, 5, 10);
+  EXPECT_LE(999.0, load.LookupRate);
+  EXPECT_LE(4.99, load.ReadAmp);
+  EXPECT_LE(3900.0, load.GetDebt());
+  EXPECT_TRUE(TMergeCost::IsReadHot(load));
+  auto delay = TMergeCost::GetDelay(load, milliseconds(10));
+  EXPECT_TRUE(delay >= milliseconds(10));
+  EXPECT_TRUE(delay < milliseconds(11));
+}
+
+FIXTURE(WriteHeavy) {
+  TMergeCost merge_cost;
+  auto load = Run(merge_cost, 50, 10, 5, 100000);
+  EXPECT_LE(99000.0, load.UpdateRate);
+  EXPECT_FALSE(TMergeCost::IsReadHot(load));
+  auto delay = TMergeCost::GetDelay(load, milliseconds(10));
+  EXPECT_TRUE(delay > milliseconds(150));
+}
+
+FIXTURE(NoAmplification) {
+  /* Lots of lookups, but each finds its key in the first layer, so merging wouldn't help. */
+  TMergeCost merge_cost;
+  auto load = Run(merge_cost, 50, 1000, 1, 0);
+  EXPECT_EQ(load.GetDebt(), 0.0);
+  EXPECT_FALSE(TMergeCost::IsReadHot(load));
+}
+
+FIXTURE(SampleTooSoon) {
+  TMergeCost merge_cost;
+  auto now = TMergeCost::TClock::now() + seconds(1);
+  merge_cost.OnLookup(3);
+  auto load = merge_cost.Sample(now);
+  EXPECT_LE(0.24, load.LookupRate);
+  /* Too soon to learn anything, even though there have been more lookups. */
+  merge_cost.OnLookup(3);
+  auto again = merge_cost.Sample(now + milliseconds(1));
+  EXPECT_EQ(again.LookupRate, load.LookupRate);
+  EXPECT_EQ(again.ReadAmp, load.ReadAmp);
+}
+
+FIXTURE(GetLoad) {
+  TMergeCost merge_cost;
+  auto now = TMergeCost::TClock::now() + seconds(1);
+  merge_cost.OnLookup(3);
+  auto load = merge_cost.Sample(now);
+  /* Looking doesn't fold in the lookups since, so the next sample still sees them. */
+  merge_cost.OnLookup(3);
+  auto peek = merge_cost.GetLoad();
+  EXPECT_EQ(peek.LookupRate, load.LookupRate);
+  EXPECT_EQ(peek.ReadAmp, load.ReadAmp);
+  auto again = merge_cost.Sample(now + seconds(1));
+  EXPECT_GT(again.LookupRate, load.LookupRate);
+}
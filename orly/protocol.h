@@ -359,7 +359,16 @@ namespace Orly {
 
     /* TailGlobalPov() -> void
          Tail the global pov. */
-      TailGlobalPov = 1018;
+      TailGlobalPov = 1018,
+
+      /* TryBatch(Base::TUuid pov_id, std::vector<std::string> fq_name, std::vector<TClosure> closures, bool atomic) -> std::vector<TMethodResult>;
+         Execute the closures' methods, all from the same package, in order and return their results in the same order.  This is like
+         calling Try() once per closure, but in one round trip and against one view of the pov: every closure reads the pov as it was when
+         the batch started and does not see what earlier closures in the batch wrote.  The one exception is a non-final effect (such as an
+         increment), which builds on the value an earlier closure wrote to the same key.  If atomic, all the closures' effects commit as
+         one update, or none do if any closure fails; where two closures write the same key, the later one wins.  Otherwise each closure's
+         effects commit as soon as it runs, and a failure leaves the effects of the closures before it in place. */
+      TryBatch = 1019;
 
   }  // Orly::ServerRpc
 
@@ -31,6 +31,10 @@ RECORD_ELEM(TMetaRecord::TEntry, TMetaRecord::TEntry::TArgByName, ArgByName);
 RECORD_ELEM(TMetaRecord::TEntry, TMetaRecord::TEntry::TExpectedPredicateResults, ExpectedPredicateResults);
 RECORD_ELEM(TMetaRecord::TEntry, Base::Chrono::TTimePnt, RunTimestamp);
 RECORD_ELEM(TMetaRecord::TEntry, uint32_t, RandomSeed);
+RECORD_ELEM(TMetaRecord::TEntry, TMetaRecord::TEntry::TKeysByIndexId, ReadKeys);
+RECORD_ELEM(TMetaRecord::TEntry, TMetaRecord::TEntry::TKeysByIndexId, ReadPatterns);
+RECORD_ELEM(TMetaRecord::TEntry, TMetaRecord::TEntry::TRangesByIndexId, ReadRanges);
+RECORD_ELEM(TMetaRecord::TEntry, TMetaRecord::TEntry::TSnapshot, Snapshot);
 
 /* Metadata for TMetaRecord. */
 RECORD_ELEM(TMetaRecord, TMetaRecord::TEntryByUpdateId, EntryByUpdateId);
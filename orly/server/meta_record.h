@@ -41,6 +41,16 @@ namespace Orly {
         /* TODO */
         using TArgByName = std::map<std::string, Var::TVar>;
 
+        /* Keys (or patterns) the method read, by index id. */
+        using TKeysByIndexId = std::map<Base::TUuid, std::vector<Var::TVar>>;
+
+        /* Ranges of keys the method walked, each as its first key mapped to its last, by index id. */
+        using TRangesByIndexId = std::map<Base::TUuid, std::map<Var::TVar, Var::TVar>>;
+
+        /* For each repo the method read from, by repo id, the sequence number of the first update it couldn't see.  See
+           Indy::TContext::TSnapshot. */
+        using TSnapshot = std::map<Base::TUuid, uint64_t>;
+
         /* Why not vector of bool?  Because up yours, STL explicit specialization with weird return types on operator[], that's why. */
         using TExpectedPredicateResults = std::vector<uint8_t>;
 
@@ -50,9 +60,13 @@ namespace Orly {
         /* TODO */
         TEntry(
             const Base::TUuid &session_id, const Base::TOpt<Base::TUuid> &user_id, const TPackageFqName &package_fq_name, const std::string &method_name, TArgByName &&arg_by_name,
-            TExpectedPredicateResults &&expected_predicate_results, Base::Chrono::TTimePnt now, uint32_t random_seed)
+            TExpectedPredicateResults &&expected_predicate_results, Base::Chrono::TTimePnt now, uint32_t random_seed,
+            TKeysByIndexId &&read_keys = TKeysByIndexId(), TKeysByIndexId &&read_patterns = TKeysByIndexId(),
+            TRangesByIndexId &&read_ranges = TRangesByIndexId(), TSnapshot &&snapshot = TSnapshot())
             : SessionId(session_id), UserId(user_id), PackageFqName(package_fq_name), MethodName(method_name), ArgByName(std::move(arg_by_name)),
-              ExpectedPredicateResults(std::move(expected_predicate_results)), RunTimestamp(now), RandomSeed(random_seed) {}
+              ExpectedPredicateResults(std::move(expected_predicate_results)), RunTimestamp(now), RandomSeed(random_seed),
+              ReadKeys(std::move(read_keys)), ReadPatterns(std::move(read_patterns)), ReadRanges(std::move(read_ranges)),
+              Snapshot(std::move(snapshot)) {}
 
         /* TODO */
         const TArgByName &GetArgByName() const {
@@ -77,6 +91,31 @@ namespace Orly {
           return PackageFqName;
         }
 
+        /* The keys the method looked up, whether or not they were there. */
+        const TKeysByIndexId &GetReadKeys() const {
+          assert(this);
+          return ReadKeys;
+        }
+
+        /* The patterns the method walked with key cursors. */
+        const TKeysByIndexId &GetReadPatterns() const {
+          assert(this);
+          return ReadPatterns;
+        }
+
+        /* The ranges the method walked with key cursors. */
+        const TRangesByIndexId &GetReadRanges() const {
+          assert(this);
+          return ReadRanges;
+        }
+
+        /* Where the method read, or empty if its reads weren't kept track of, in which case the read keys, patterns
+           and ranges are incomplete and mean nothing. */
+        const TSnapshot &GetSnapshot() const {
+          assert(this);
+          return Snapshot;
+        }
+
         uint32_t GetRandomSeed() const {
           assert(this);
           return RandomSeed;
@@ -125,6 +164,18 @@ namespace Orly {
         /* TODO */
         uint32_t RandomSeed;
 
+        /* See GetReadKeys(). */
+        TKeysByIndexId ReadKeys;
+
+        /* See GetReadPatterns(). */
+        TKeysByIndexId ReadPatterns;
+
+        /* See GetReadRanges(). */
+        TRangesByIndexId ReadRanges;
+
+        /* See GetSnapshot(). */
+        TSnapshot Snapshot;
+
       };  // TMetaRecord::TEntry
 
       /* TODO */
@@ -138,6 +189,13 @@ namespace Orly {
         EntryByUpdateId.insert(std::make_pair(update_id, std::forward<TEntry>(entry)));
       }
 
+      /* Add the entry for another update folded into this one.  The id must be new to us. */
+      void AddEntry(const Base::TUuid &update_id, TEntry &&entry) {
+        assert(this);
+        assert(!EntryByUpdateId.count(update_id));
+        EntryByUpdateId.insert(std::make_pair(update_id, std::forward<TEntry>(entry)));
+      }
+
       /* TODO */
       const TEntry &GetEntry(const Base::TUuid &id) const;
 
@@ -18,8 +18,11 @@
 
 #include <orly/server/repo_tetris_manager.h>
 
+#include <unordered_set>
 #include <vector>
 
+#include <base/event_semaphore.h>
+#include <base/timer.h>
 #include <orly/mynde/protocol.h> // For Mynde::PackageName
 #include <orly/notification/pov_failure.h>
 #include <orly/notification/update_progress.h>
@@ -32,6 +35,9 @@ using namespace Orly::Indy;
 using namespace Orly::Server;
 using namespace ::Util;
 
+/* The number of children we test at once per play worker. */
+static const size_t TestersPerWorker = 4UL;
+
 TRepoTetrisManager::TRepoTetrisManager(
     TScheduler *scheduler,
     Fiber::TRunner::TRunnerCons &runner_cons,
@@ -41,12 +47,15 @@ TRepoTetrisManager::TRepoTetrisManager(
     Indy::TManager *repo_manager,
     Package::TManager *package_manager,
     Durable::TManager *durable_manager,
-    bool log_assertion_failures)
+    bool log_assertion_failures,
+    size_t num_play_workers)
     : TTetrisManager(scheduler, runner_cons, frame_pool_manager, runner_setup_cb, is_master),
       PushCount(0UL),
       PopCount(0UL),
       FailCount(0UL),
       RoundCount(0UL),
+      SkipCount(0UL),
+      RecheckCount(0UL),
       RepoManager(repo_manager),
       PackageManager(package_manager),
       DurableManager(durable_manager),
@@ -54,6 +63,28 @@ TRepoTetrisManager::TRepoTetrisManager(
   assert(repo_manager);
   assert(package_manager);
   assert(durable_manager);
+  if (num_play_workers) {
+    /* the workers read repos, so they need the same per-thread setup as our own runner, one at a time */
+    mutex setup_lock;
+    TEventSemaphore setup_is_complete;
+    PlayWorkerPool = make_unique<Fiber::TRunnerPool>(runner_cons, num_play_workers,
+        [frame_pool_manager, runner_setup_cb, &setup_lock, &setup_is_complete](Fiber::TRunner *runner) {
+          if (!Fiber::TFrame::LocalFramePool) {
+            Fiber::TFrame::LocalFramePool = new Base::TThreadLocalGlobalPoolManager<Fiber::TFrame, size_t, Fiber::TRunner *>::TThreadLocalPool(frame_pool_manager);
+          }
+          /* extra */ {
+            lock_guard<mutex> lock(setup_lock);
+            runner_setup_cb(runner);
+          }
+          setup_is_complete.Push();
+          runner->Run();
+          delete Fiber::TFrame::LocalFramePool;
+          Fiber::TFrame::LocalFramePool = nullptr;
+        });
+    for (size_t i = 0; i < num_play_workers; ++i) {
+      setup_is_complete.Pop();
+    }
+  }
 }
 
 TRepoTetrisManager::~TRepoTetrisManager() {
@@ -82,11 +113,10 @@ TRepoTetrisManager::TPlayer::TChild::TChild(TPlayer *player, const TUuid &child_
 }
 
 bool TRepoTetrisManager::TPlayer::TChild::Play(
-    const unique_ptr<Indy::L1::TTransaction, function<void (Indy::L1::TTransaction *)>> &transaction, Indy::TContext &context) {
+    const unique_ptr<Indy::L1::TTransaction, function<void (Indy::L1::TTransaction *)>> &transaction, bool passed) {
   assert(this);
   assert(transaction);
-  bool success = TestAssertions(context);
-  if (success) {
+  if (passed) {
     /* swap the metadata with just the session ids if we're pushing to global */
     if (Player->Repo->GetId() == TSession::GlobalPovId) {
       void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
@@ -141,7 +171,7 @@ bool TRepoTetrisManager::TPlayer::TChild::Play(
       Flush();
     }
   }
-  return success;
+  return passed;
 }
 
 bool TRepoTetrisManager::TPlayer::TChild::Refresh(const unique_ptr<Indy::L1::TTransaction, function<void (Indy::L1::TTransaction *)>> &transaction) {
@@ -177,6 +207,104 @@ bool TRepoTetrisManager::TPlayer::TChild::SortsBefore(const TChild *lhs, const T
   return lhs->Age > rhs->Age;
 }
 
+void TRepoTetrisManager::TPlayer::TChild::AppendWrites(vector<Indy::TIndexKey> &keys, Atom::TCore::TExtensibleArena *arena) const {
+  assert(this);
+  assert(&keys);
+  assert(arena);
+  assert(PeekedUpdate);
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  for (TUpdate::TEntryCollection::TCursor csr(PeekedUpdate->GetEntryCollection()); csr; ++csr) {
+    const Indy::TIndexKey &index_key = csr->GetIndexKey();
+    keys.emplace_back(index_key.GetIndexId(), Indy::TKey(arena, state_alloc, index_key.GetKey()));
+  }
+}
+
+void TRepoTetrisManager::TPlayer::TChild::TReadSet::Add(const TMetaRecord::TEntry &entry) {
+  assert(this);
+  assert(&entry);
+  if (entry.GetSnapshot().empty()) {
+    Known = false;
+    return;
+  }
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  auto to_key = [this, state_alloc](const TUuid &index_id, const Var::TVar &var) {
+    return Indy::TIndexKey(index_id, Indy::TKey(&Arena, Sabot::State::TAny::TWrapper(Var::NewSabot(state_alloc, var)).get()));
+  };
+  for (const auto &item : entry.GetReadKeys()) {
+    for (const auto &var : item.second) {
+      Keys.insert(to_key(item.first, var));
+    }
+  }
+  for (const auto &item : entry.GetReadPatterns()) {
+    for (const auto &var : item.second) {
+      Patterns.push_back(to_key(item.first, var));
+    }
+  }
+  for (const auto &item : entry.GetReadRanges()) {
+    for (const auto &range : item.second) {
+      Ranges.emplace_back(to_key(item.first, range.first), to_key(item.first, range.second));
+    }
+  }
+}
+
+void TRepoTetrisManager::TPlayer::TChild::TReadSet::Add(const Indy::TIndyContext &context) {
+  assert(this);
+  assert(&context);
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  auto keep = [this, state_alloc](const Indy::TIndexKey &key) {
+    return Indy::TIndexKey(key.GetIndexId(), Indy::TKey(&Arena, state_alloc, key.GetKey()));
+  };
+  context.ForEachRead(
+      [this, &keep](const Indy::TIndexKey &key) {
+        Keys.insert(keep(key));
+      },
+      [this, &keep](const Indy::TIndexKey &pattern) {
+        Patterns.push_back(keep(pattern));
+      },
+      [this, &keep](const Indy::TIndexKey &from, const Indy::TIndexKey &to) {
+        Ranges.emplace_back(keep(from), keep(to));
+      });
+}
+
+bool TRepoTetrisManager::TPlayer::TChild::TReadSet::Contains(const Indy::TIndexKey &key) const {
+  assert(this);
+  assert(&key);
+  if (Keys.count(key)) {
+    return true;
+  }
+  /* a pattern is hit when the key unifies with it, same as a key cursor would see */
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize() * 2);
+  void *other_state_alloc = reinterpret_cast<uint8_t *>(state_alloc) + Sabot::State::GetMaxStateSize();
+  for (const auto &pattern : Patterns) {
+    if (pattern.GetIndexId() == key.GetIndexId() &&
+        Sabot::IsUnifies(Sabot::MatchPrefixState(
+            *Sabot::State::TAny::TWrapper(pattern.GetKey().GetState(state_alloc)),
+            *Sabot::State::TAny::TWrapper(key.GetKey().GetState(other_state_alloc))))) {
+      return true;
+    }
+  }
+  for (const auto &range : Ranges) {
+    if (!(key < range.first) && !(range.second < key)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TRepoTetrisManager::TPlayer::TChild::TReadSet::MayContainAny(const vector<Indy::TIndexKey> &keys) const {
+  assert(this);
+  assert(&keys);
+  if (!Known) {
+    return true;
+  }
+  for (const auto &key : keys) {
+    if (Contains(key)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void TRepoTetrisManager::TPlayer::TChild::Flush() {
   assert(this);
   PeekedUpdate.reset();
@@ -201,9 +329,27 @@ namespace Orly {
   }
 }
 
-bool TRepoTetrisManager::TPlayer::TChild::TestAssertions(Indy::TContext &context) const {
+bool TRepoTetrisManager::TPlayer::TChild::MayConflict(const TMetaRecord::TEntry &entry, const Indy::TContext &context) {
+  assert(&entry);
+  assert(&context);
+  TReadSet read_set;
+  read_set.Add(entry);
+  if (!read_set.IsKnown()) {
+    return true;
+  }
+  bool conflict = false;
+  Indy::TContext::TSnapshot snapshot(entry.GetSnapshot().begin(), entry.GetSnapshot().end());
+  bool known = context.ForEachKeyWrittenSince(snapshot, [&read_set, &conflict](const Indy::TIndexKey &key) {
+    conflict = read_set.Contains(key);
+    return !conflict;
+  });
+  return conflict || !known;
+}
+
+bool TRepoTetrisManager::TPlayer::TChild::TestAssertions(Indy::TContext &context, TReadSet &reads) const {
   assert(this);
   assert(&context);
+  assert(&reads);
   void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
   for (const auto &item: FuncHolderByUpdateId) {
     const auto &entry = MetaRecord.GetEntry(item.first);
@@ -215,7 +361,11 @@ bool TRepoTetrisManager::TPlayer::TChild::TestAssertions(Indy::TContext &context
       return true;
     }
     const auto &expected_predicate_results = entry.GetExpectedPredicateResults();
-    if (expected_predicate_results.size()) {
+    if (expected_predicate_results.size() && !MayConflict(entry, context)) {
+      /* the method would read just what it did when it first ran */
+      reads.Add(entry);
+      ++(Player->RepoTetrisManager->SkipCount);
+    } else if (expected_predicate_results.size()) {
       Atom::TSuprena my_arena;
       Rt::TOpt<Base::TUuid> user_id;
       if (entry.GetUserId()) {
@@ -232,6 +382,7 @@ bool TRepoTetrisManager::TPlayer::TChild::TestAssertions(Indy::TContext &context
           arg_map.insert(make_pair(iter.first, Indy::TKey(core, &my_arena)));
         }
         item.second->Call(indy_context, arg_map);
+        reads.Add(indy_context);
         if (vector<bool>(expected_predicate_results.begin(), expected_predicate_results.end()) != indy_context.GetPredicateResults()) {
           if (Player->RepoTetrisManager->LogAssertionFailures) {
             stringstream ss;
@@ -266,6 +417,86 @@ bool TRepoTetrisManager::TPlayer::TChild::TestAssertions(Indy::TContext &context
   return true;
 }
 
+TRepoTetrisManager::TPlayer::TTester::TTester(
+    Fiber::TRunnerPool &pool, Fiber::TSafeSync &safe_sync, const TChild *child, const Indy::TContext &context,
+    TChild::TReadSet &reads)
+    : Child(child), Reads(reads), Context(context, &Arena), SafeSync(safe_sync), Success(false) {
+  assert(child);
+  SafeSync.WaitForMore(1UL);
+  FramePool = Fiber::TFrame::LocalFramePool;
+  Fiber::TFrame *frame = FramePool->Alloc();
+  try {
+    pool.Schedule(frame, this, static_cast<Fiber::TRunnable::TFunc>(&TTester::Run));
+  } catch (...) {
+    FramePool->Free(frame);
+    throw;
+  }
+}
+
+bool TRepoTetrisManager::TPlayer::TTester::Passed() const {
+  assert(this);
+  if (Error) {
+    rethrow_exception(Error);
+  }
+  return Success;
+}
+
+void TRepoTetrisManager::TPlayer::TTester::Run() {
+  assert(this);
+  try {
+    Success = Child->TestAssertions(Context, Reads);
+  } catch (...) {
+    Error = current_exception();
+  }
+  auto *frame_pool = FramePool;
+  SafeSync.Complete();
+  Fiber::FreeMyFrame(frame_pool);
+}
+
+void TRepoTetrisManager::TPlayer::TestAll(
+    const vector<TChild *> &children, Indy::TContext &context, vector<bool> &passed,
+    vector<unique_ptr<TChild::TReadSet>> &reads) const {
+  assert(this);
+  assert(&children);
+  assert(&context);
+  assert(&passed);
+  assert(&reads);
+  passed.assign(children.size(), false);
+  reads.clear();
+  reads.reserve(children.size());
+  for (size_t i = 0; i < children.size(); ++i) {
+    reads.emplace_back(new TChild::TReadSet);
+  }
+  Fiber::TRunnerPool *pool = RepoTetrisManager->PlayWorkerPool.get();
+  if (!pool) {
+    for (size_t i = 0; i < children.size(); ++i) {
+      passed[i] = children[i]->TestAssertions(context, *reads[i]);
+    }
+    return;
+  }
+  /* keep a bounded number of frames in flight */
+  const size_t batch_size = pool->GetWorkerCount() * TestersPerWorker;
+  for (size_t begin = 0; begin < children.size(); begin += batch_size) {
+    const size_t end = min(begin + batch_size, children.size());
+    Fiber::TSafeSync safe_sync;
+    vector<unique_ptr<TTester>> testers;
+    testers.reserve(end - begin);
+    try {
+      for (size_t i = begin; i < end; ++i) {
+        testers.emplace_back(new TTester(*pool, safe_sync, children[i], context, *reads[i]));
+      }
+    } catch (...) {
+      /* the ones already scheduled refer to the sync */
+      safe_sync.Sync();
+      throw;
+    }
+    safe_sync.Sync();
+    for (size_t i = begin; i < end; ++i) {
+      passed[i] = testers[i - begin]->Passed();
+    }
+  }
+}
+
 void TRepoTetrisManager::TPlayer::OnJoin(const TUuid &child_pov_id) {
   assert(this);
   lock_guard<mutex> lock(Mutex);
@@ -299,6 +530,7 @@ void TRepoTetrisManager::TPlayer::OnUnpause() {
 void TRepoTetrisManager::TPlayer::Play() {
   assert(this);
   Base::TCPUTimer snapshot_timer, sort_timer, play_timer, commit_timer;
+  Base::TTimer play_wall_timer;
   Atom::TSuprena my_arena;
   try {
     /* Begin a transaction and make a vector of all our children who are ready to participate in it. */
@@ -320,15 +552,39 @@ void TRepoTetrisManager::TPlayer::Play() {
     sort_timer.Start();
     sort(children.begin(), children.end(), TChild::SortsBefore);
     sort_timer.Stop();
-    /* Give each child a chance to play.  At most one will be permitted to promote (for now), but any number might fail
-       due to age. */
+    /* Test every child against the same view of the parent, then give each a chance to play, in order.  Any number
+       might promote and any number might fail due to age.  A transaction can push to the parent only once, so each
+       promotion gets a transaction of its own, committed before the next child plays.  A child whose test read
+       something promoted ahead of it gets tested again, against the parent as it now stands.  We go by what the test
+       read, not by what the child's methods read when they first ran, since a method re-run for the test may read
+       different keys. */
     play_timer.Start();
+    play_wall_timer.Start();
     Indy::TContext context(Repo, &my_arena);
-    for (TChild *child: children) {
-      if (child->Play(transaction, context)) {
-        break;
+    vector<bool> passed;
+    vector<unique_ptr<TChild::TReadSet>> reads;
+    TestAll(children, context, passed, reads);
+    vector<Indy::TIndexKey> written;
+    for (size_t i = 0; i < children.size(); ++i) {
+      TChild *child = children[i];
+      bool success = passed[i];
+      if (success && !written.empty() && reads[i]->MayContainAny(written)) {
+        ++(RepoTetrisManager->RecheckCount);
+        Indy::TContext recheck_context(Repo, &my_arena);
+        TChild::TReadSet recheck_reads;
+        success = child->TestAssertions(recheck_context, recheck_reads);
+      }
+      if (success) {
+        child->AppendWrites(written, &my_arena);
+        unique_ptr<Indy::L1::TTransaction, function<void (Indy::L1::TTransaction *)>> promotion = RepoTetrisManager->RepoManager->NewTransaction();
+        child->Play(promotion, true);
+        promotion->Prepare();
+        promotion->CommitAction();
+      } else {
+        child->Play(transaction, false);
       }
     }
+    play_wall_timer.Stop();
     play_timer.Stop();
     /* Commit. */
     transaction->Prepare();
@@ -346,6 +602,7 @@ void TRepoTetrisManager::TPlayer::Play() {
   RepoTetrisManager->TetrisSortCPUTime.Push(ToSecondsDouble(sort_timer.GetTotal()));
   RepoTetrisManager->TetrisPlayCPUTime.Push(ToSecondsDouble(play_timer.GetTotal()));
   RepoTetrisManager->TetrisCommitCPUTime.Push(ToSecondsDouble(commit_timer.GetTotal()));
+  RepoTetrisManager->TetrisPlayWallTime.Push(duration_cast<duration<double, micro>>(play_wall_timer.GetTotal()).count());
 }
 
 TTetrisManager::TPlayer *TRepoTetrisManager::NewPlayer(const TUuid &parent_pov_id, const TUuid &child_pov_id, bool is_paused, bool is_master) {
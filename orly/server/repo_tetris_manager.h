@@ -22,9 +22,14 @@
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <base/class_traits.h>
+#include <base/histogram.h>
 #include <orly/indy/context.h>
+#include <orly/indy/fiber/fiber.h>
 #include <orly/indy/manager.h>
 #include <orly/package/manager.h>
 #include <orly/server/meta_record.h>
@@ -50,7 +55,8 @@ namespace Orly {
           Indy::TManager *repo_manager,
           Package::TManager *package_manager,
           Durable::TManager *durable_manager,
-          bool log_assertion_failures);
+          bool log_assertion_failures,
+          size_t num_play_workers = 0UL);
 
       /* TODO */
       virtual ~TRepoTetrisManager();
@@ -61,11 +67,23 @@ namespace Orly {
       std::atomic<size_t> FailCount;
       std::atomic<size_t> RoundCount;
 
+      /* The number of times we didn't have to re-run a method to test its assertions, because nothing it read had been
+         written since it ran. */
+      std::atomic<size_t> SkipCount;
+
+      /* The number of times a child which passed its assertions had to be tested again, because a child promoted
+         ahead of it in the same round wrote something it may have read. */
+      std::atomic<size_t> RecheckCount;
+
       /* TODO */
       Base::TSigmaCalc TetrisSnapshotCPUTime;
       Base::TSigmaCalc TetrisSortCPUTime;
       Base::TSigmaCalc TetrisPlayCPUTime;
       Base::TSigmaCalc TetrisCommitCPUTime;
+
+      /* The wall-clock time, in microseconds, of each round's play.  With play workers, this comes in under the play
+         CPU time above, which only counts the player's own thread. */
+      Base::THistogram TetrisPlayWallTime;
       std::mutex TetrisTimerLock;
 
       private:
@@ -88,12 +106,60 @@ namespace Orly {
           NO_COPY(TChild);
           public:
 
+          /* What methods read, either as recorded in their meta record entries (brought back out of var form) or as
+             seen by a re-run of them, so keys written since can be checked against it. */
+          class TReadSet {
+            NO_COPY(TReadSet);
+            public:
+
+            /* Start out knowing nothing was read. */
+            TReadSet()
+                : Known(true) {}
+
+            /* Add what the entry's method read.  If the entry didn't record it, we no longer know what was read. */
+            void Add(const TMetaRecord::TEntry &entry);
+
+            /* Add what an evaluation in the given context read, copied into our arena. */
+            void Add(const Indy::TIndyContext &context);
+
+            /* True iff. we know everything that was read. */
+            bool IsKnown() const {
+              assert(this);
+              return Known;
+            }
+
+            /* True iff. the key was read, unifies with a pattern that was read, or falls in a range that was read. */
+            bool Contains(const Indy::TIndexKey &key) const;
+
+            /* True iff. we contain any of the keys, or if we don't know what was read. */
+            bool MayContainAny(const std::vector<Indy::TIndexKey> &keys) const;
+
+            private:
+
+            /* Holds the keys below. */
+            Atom::TSuprena Arena;
+
+            /* See IsKnown(). */
+            bool Known;
+
+            /* Keys read directly. */
+            std::unordered_set<Indy::TIndexKey> Keys;
+
+            /* Patterns walked by key cursors. */
+            std::vector<Indy::TIndexKey> Patterns;
+
+            /* Inclusive ranges walked by key cursors. */
+            std::vector<std::pair<Indy::TIndexKey, Indy::TIndexKey>> Ranges;
+
+          };  // TRepoTetrisManager::TPlayer::TChild::TReadSet
+
           /* TODO */
           TChild(TPlayer *player, const Base::TUuid &child_pov_id);
 
-          /* TODO */
+          /* If our assertions passed, promote our peeked update to the parent in the given transaction; otherwise, count
+             the failure and, if we've failed too often, fail our pov.  Returns 'passed'. */
           bool Play(
-              const std::unique_ptr<Indy::L1::TTransaction, std::function<void (Indy::L1::TTransaction *)>> &transaction, Indy::TContext &context);
+              const std::unique_ptr<Indy::L1::TTransaction, std::function<void (Indy::L1::TTransaction *)>> &transaction, bool passed);
 
           /* TODO */
           bool Refresh(const std::unique_ptr<Indy::L1::TTransaction, std::function<void (Indy::L1::TTransaction *)>> &transaction);
@@ -101,13 +167,22 @@ namespace Orly {
           /* TODO */
           static bool SortsBefore(const TChild *lhs, const TChild *rhs);
 
+          /* Test our assertions against the context, adding to 'reads' what they depend on: what each method re-run
+             for the test actually read, and, for each method which didn't need to be re-run, what it read when it
+             first ran. */
+          bool TestAssertions(Indy::TContext &context, TReadSet &reads) const;
+
+          /* Append the keys our peeked update writes, copied into the given arena. */
+          void AppendWrites(std::vector<Indy::TIndexKey> &keys, Atom::TCore::TExtensibleArena *arena) const;
+
           private:
 
           /* TODO */
           void Flush();
 
-          /* TODO */
-          bool TestAssertions(Indy::TContext &context) const;
+          /* True iff. something written since the entry's method ran might change what the method read, or if we can't
+             tell.  If not, its assertions come out the same as they did then and there's no need to re-run it. */
+          static bool MayConflict(const TMetaRecord::TEntry &entry, const Indy::TContext &context);
 
           /* The player which owns us.  Never null. */
           TPlayer *Player;
@@ -132,6 +207,57 @@ namespace Orly {
 
         };  // TRepoTetrisManager::TPlayer::TChild
 
+        /* Tests one child's assertions on a play worker, against its own copy of the round's context.  The frame comes
+           from, and goes back to, the frame pool of the player's thread. */
+        class TTester
+            : public Indy::Fiber::TRunnable {
+          NO_COPY(TTester);
+          public:
+
+          /* Schedule the test on the pool. */
+          TTester(
+              Indy::Fiber::TRunnerPool &pool, Indy::Fiber::TSafeSync &safe_sync, const TChild *child, const Indy::TContext &context,
+              TChild::TReadSet &reads);
+
+          /* Call only after the sync has completed. */
+          bool Passed() const;
+
+          private:
+
+          /* Runs on the worker. */
+          void Run();
+
+          /* The pool our frame came from.  The worker gives the frame back once the test is done, since we may be
+             destroyed as soon as the sync completes. */
+          Base::TThreadLocalGlobalPoolManager<Indy::Fiber::TFrame, size_t, Indy::Fiber::TRunner *>::TThreadLocalPool *FramePool;
+
+          /* The child under test.  Never null. */
+          const TChild *Child;
+
+          /* Where the test records what it read. */
+          TChild::TReadSet &Reads;
+
+          /* Our own arena and context, seeing what the round's context sees. */
+          Atom::TSuprena Arena;
+          Indy::TContext Context;
+
+          /* TODO */
+          Indy::Fiber::TSafeSync &SafeSync;
+
+          /* The result of the test. */
+          bool Success;
+
+          /* Anything the test threw. */
+          std::exception_ptr Error;
+
+        };  // TRepoTetrisManager::TPlayer::TTester
+
+        /* Test the assertions of each of the children against the context, filling in 'passed' and what each test read
+           in the same order.  If we have play workers, the children are tested all at once. */
+        void TestAll(
+            const std::vector<TChild *> &children, Indy::TContext &context, std::vector<bool> &passed,
+            std::vector<std::unique_ptr<TChild::TReadSet>> &reads) const;
+
         /* See TRepoTetrisManager::TPlayer. */
         virtual void OnJoin(const Base::TUuid &child_pov_id) override;
 
@@ -178,6 +304,9 @@ namespace Orly {
       /* TODO */
       bool LogAssertionFailures;
 
+      /* The workers which test children's assertions in parallel.  Null if we test them on the player's fiber. */
+      std::unique_ptr<Indy::Fiber::TRunnerPool> PlayWorkerPool;
+
     };  // TRepoTetrisManager
 
   }  // Server
@@ -70,6 +70,8 @@ Base::TSigmaCalc TSession::TServer::TryWalkerTimeCalc;
 Base::TSigmaCalc TSession::TServer::TryCallCPUTimerCalc;
 Base::TSigmaCalc TSession::TServer::TryFetchCountCalc;
 Base::TSigmaCalc TSession::TServer::TryHashHitCountCalc;
+Base::TSigmaCalc TSession::TServer::TryMemoHitCountCalc;
+Base::TSigmaCalc TSession::TServer::TryMemoMissCountCalc;
 Base::TSigmaCalc TSession::TServer::TryWriteSyncHitCalc;
 Base::TSigmaCalc TSession::TServer::TryWriteSyncTimeCalc;
 Base::TSigmaCalc TSession::TServer::TryReadSyncHitCalc;
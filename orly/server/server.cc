@@ -21,6 +21,9 @@
 #include <poll.h>
 #include <sys/syscall.h>
 
+#include <algorithm>
+#include <cstring>
+
 #include <base/as_str.h>
 #include <base/booster.h>
 #include <base/glob.h>
@@ -30,6 +33,7 @@
 #include <io/binary_io_stream.h>
 #include <io/device.h>
 #include <orly/atom/core_vector.h>
+#include <orly/indy/disk/arena_chunk.h>
 #include <orly/indy/disk/durable_manager.h>
 #include <orly/mynde/binary_protocol.h>
 #include <orly/mynde/protocol.h>
@@ -65,6 +69,16 @@ static const size_t BlockSize = Disk::Util::PhysicalBlockSize;
 //static const size_t StackSize = 8 * 1024 * 1024;
 static const size_t StackSize = 1 * 1024 * 1024;
 
+/* Translate a cache policy given on the command line. */
+static Disk::Util::TCachePolicy GetCachePolicy(const string &name) {
+  if (name == "lru") {
+    return Disk::Util::TCachePolicy::LRU;
+  } else if (name == "slru") {
+    return Disk::Util::TCachePolicy::SegmentedLRU;
+  }
+  throw runtime_error("Cache policy must be lru or slru");
+}
+
 Orly::Indy::Util::TLocklessPool Disk::TDurableManager::TMapping::Pool(sizeof(Disk::TDurableManager::TMapping), "Durable Mapping");
 Orly::Indy::Util::TLocklessPool Disk::TDurableManager::TMapping::TEntry::Pool(sizeof(Disk::TDurableManager::TMapping::TEntry), "Durable Mapping Entry");
 Orly::Indy::Util::TPool Disk::TDurableManager::TDurableLayer::Pool(std::max(sizeof(Disk::TDurableManager::TMemSlushLayer), sizeof(Disk::TDurableManager::TDiskOrderedLayer)), "Durable Layer");
@@ -92,6 +106,8 @@ Base::TSigmaCalc TSession::TServer::TryWriteCallTimerCalc;
 Base::TSigmaCalc TSession::TServer::TryWalkerConsTimerCalc;
 Base::TSigmaCalc TSession::TServer::TryFetchCountCalc;
 Base::TSigmaCalc TSession::TServer::TryHashHitCountCalc;
+Base::TSigmaCalc TSession::TServer::TryMemoHitCountCalc;
+Base::TSigmaCalc TSession::TServer::TryMemoMissCountCalc;
 Base::TSigmaCalc TSession::TServer::TryWriteSyncHitCalc;
 Base::TSigmaCalc TSession::TServer::TryWriteSyncTimeCalc;
 Base::TSigmaCalc TSession::TServer::TryReadSyncHitCalc;
@@ -168,6 +184,26 @@ TServer::TCmd::TMeta::TMeta(const char *desc)
       &TCmd::BlockCacheSizeMB, "block_cache_size", Optional, "block_cache_size\0",
       "The size of the block cache in MB. This cache uses 64K blocks."
   );
+  Param(
+      &TCmd::PageCachePolicy, "page_cache_policy", Optional, "page_cache_policy\0",
+      "The replacement policy of the page cache: lru or slru. slru (segmented LRU) keeps pages that get reused from being pushed out by large scans, and reclaims pages read only by merges and other low priority readers first."
+  );
+  Param(
+      &TCmd::BlockCachePolicy, "block_cache_policy", Optional, "block_cache_policy\0",
+      "The replacement policy of the block cache: lru or slru."
+  );
+  Param(
+      &TCmd::PageCacheReadAhead, "page_cache_read_ahead", Optional, "page_cache_read_ahead\0",
+      "The most pages a sequential scan through the page cache keeps loading ahead of itself. The window starts small and grows with the length of the scan. 0 disables read-ahead."
+  );
+  Param(
+      &TCmd::BlockCacheReadAhead, "block_cache_read_ahead", Optional, "block_cache_read_ahead\0",
+      "The most blocks a sequential scan through the block cache keeps loading ahead of itself. 0 disables read-ahead."
+  );
+  Param(
+      &TCmd::ArenaChunkCacheSizeMB, "arena_chunk_cache_size", Optional, "arena_chunk_cache_size\0",
+      "The size of the arena chunk cache in MB. This cache holds decompressed chunks of data files written with a codec other than none."
+  );
   Param(
       &TCmd::FileServiceAppendLogMB, "file_service_append_log_size", Optional, "file_service_append_log_size\0",
       "The size of the file service append log in MB."
@@ -176,14 +212,35 @@ TServer::TCmd::TMeta::TMeta(const char *desc)
       &TCmd::DiskMaxAioNum, "disk_max_aio_num", Optional, "disk_max_aio_num\0",
       "The maximum number of aio events at a time."
   );
+  Param(
+      &TCmd::DiskBackend, "disk_backend", Optional, "disk_backend\0",
+      "The kernel interface disk I/O goes through: aio or io_uring. io_uring falls back to aio if the kernel doesn't have it."
+  );
   Param(
       &TCmd::HighDiskUtilizationThreshold, "high_disk_utilization_threshold", Optional, "high_disk_utilization_threshold\0",
-      "The percentage of disk space that needs to be used before we start re-routing discard blocks to become ready for allocation."
+      "The percentage of disk space that needs to be used before we start re-routing discard blocks to become ready for allocation.  "
+      "Also the most of its time a disk merge thread may spend merging."
+  );
+  Param(
+      &TCmd::BloomFilterBitsPerKey, "bloom_filter_bits_per_key", Optional, "bloom_filter_bits_per_key\0",
+      "The number of bloom filter bits per key written into each data file index. 0 disables the filters."
+  );
+  Param(
+      &TCmd::BloomFilterFalsePositiveRate, "bloom_filter_false_positive_rate", Optional, "bloom_filter_false_positive_rate\0",
+      "If set, the target false positive rate (e.g. 0.01) of the data file bloom filters. This overrides bloom_filter_bits_per_key."
+  );
+  Param(
+      &TCmd::DataFileCodec, "data_file_codec", Optional, "data_file_codec\0",
+      "The codec new data file arenas are compressed with: none, snappy, lz4 or zstd. Files already on disk keep their own codec."
   );
   Param(
       &TCmd::DiscardOnCreate, "discard_on_create", Optional, "discard_on_create\0",
       "If create=true, this option determines whether a full discard will be done on the block device upon startup."
   );
+  Param(
+      &TCmd::ReplicationCodec, "replication_codec", Optional, "replication_codec\0",
+      "The codec replication frames sent to the slave are compressed with: none, snappy, lz4 or zstd."
+  );
   Param(
       &TCmd::ReplicationSyncBufMB, "replication_sync_buf_mb", Optional, "replication_sync_buf_mb\0",
       "The buffer used by the slave while synchronizing replication updates. This only stores live transactions, seperate from the large background sync."
@@ -220,6 +277,14 @@ TServer::TCmd::TMeta::TMeta(const char *desc)
       &TCmd::NumDiskMergeThreads, "num_disk_merge_threads", Optional, "num_disk_merge_threads\0",
       "The number of threads merging disk layers in repos."
   );
+  Param(
+      &TCmd::NumMergeWorkerThreads, "num_merge_worker_threads", Optional, "num_merge_worker_threads\0",
+      "The number of threads a disk merge may split each index's keys across, by key range. 0 keeps each merge on its own thread."
+  );
+  Param(
+      &TCmd::NumTetrisWorkerThreads, "num_tetris_worker_threads", Optional, "num_tetris_worker_threads\0",
+      "The number of threads tetris may test child povs' assertions on in parallel. 0 tests them on the tetris thread."
+  );
   Param(
       &TCmd::NumWsThreads, "num_ws_threads", Optional, "num_ws_threads\0",
       "The number of threads to use to answer websocket requests."
@@ -236,6 +301,15 @@ TServer::TCmd::TMeta::TMeta(const char *desc)
       &TCmd::SlowCoreVec, "slow_cores", Optional, "slow_cores\0",
       "The cores which will be pinned by the slow blocking schedulers."
   );
+  Param(
+      &TCmd::SlowWorkStealing, "slow_work_stealing", Optional, "slow_work_stealing\0",
+      "If true, an idle slow scheduler takes client connections and requests which are waiting on a busy one."
+  );
+  Param(
+      &TCmd::FiberProfiling, "fiber_profiling", Optional, "fiber_profiling\0",
+      "If true, the fiber schedulers track run, wait and blocked time by runnable, and the reporting port serves "
+      "samples of what each one is running at /fiber_samples."
+  );
   Param(
       &TCmd::DiskControllerCoreVec, "disk_controller_cores", Optional, "disk_controller_cores\0",
       "The cores which will be pinned by the disk controllers."
@@ -391,10 +465,20 @@ TServer::TCmd::TCmd()
       TempFileConsolidationThreshold(20),
       PageCacheSizeMB(1024),
       BlockCacheSizeMB(256),
+      PageCachePolicy("lru"),
+      BlockCachePolicy("lru"),
+      PageCacheReadAhead(Disk::Util::TPageCache::DefaultMaxReadAhead),
+      BlockCacheReadAhead(Disk::Util::TBlockCache::DefaultMaxReadAhead),
+      ArenaChunkCacheSizeMB(Disk::TArenaChunkCache::DefaultMaxBytes / (1024UL * 1024UL)),
       FileServiceAppendLogMB(4),
       DiskMaxAioNum(65024),
+      DiskBackend("aio"),
       HighDiskUtilizationThreshold(0.9),
+      BloomFilterBitsPerKey(Disk::Util::TBloomFilter::DefaultBitsPerKey),
+      BloomFilterFalsePositiveRate(0.0),
+      DataFileCodec("none"),
       DiscardOnCreate(false),
+      ReplicationCodec("snappy"),
       ReplicationSyncBufMB(32),
       MergeMemInterval(40),
       MergeDiskInterval(10),
@@ -403,8 +487,12 @@ TServer::TCmd::TCmd()
       DurableMergeInterval(10),
       NumMemMergeThreads(3),
       NumDiskMergeThreads(8),
+      NumMergeWorkerThreads(4),
+      NumTetrisWorkerThreads(0),
       NumWsThreads(4),
       MaxRepoCacheSize(10000),
+      SlowWorkStealing(false),
+      FiberProfiling(false),
       NumFiberFrames(1000UL),
       NumDiskEvents(10000UL),
       ReportingPortNumber(19388),
@@ -515,6 +603,10 @@ TServer::TCmd::TCmd()
     BlockCacheSizeMB *= mult_factor;
     const size_t br_block_cache = BlockCacheSizeMB * mb;
     bytes_available -= br_block_cache;
+    /* Arena Chunk Cache */
+    ArenaChunkCacheSizeMB *= mult_factor;
+    const size_t br_arena_chunk_cache = ArenaChunkCacheSizeMB * mb;
+    bytes_available -= br_arena_chunk_cache;
     /* Page Cache */
     PageCacheSizeMB *= mult_factor;
     const size_t br_page_cache = PageCacheSizeMB * mb;
@@ -637,6 +729,7 @@ TServer::TCmd::TCmd()
       << "[" << (100 * static_cast<double>(br_repo_cache) / bytes_alloted) << "%] br_repo_cache = [" << br_repo_cache << "]" << endl
       << "[" << (100 * static_cast<double>(br_file_service_append_log) / bytes_alloted) << "%] br_file_service_append_log = [" << br_file_service_append_log << "]" << endl
       << "[" << (100 * static_cast<double>(br_block_cache) / bytes_alloted) << "%] br_block_cache = [" << br_block_cache << "]" << endl
+      << "[" << (100 * static_cast<double>(br_arena_chunk_cache) / bytes_alloted) << "%] br_arena_chunk_cache = [" << br_arena_chunk_cache << "]" << endl
       << "[" << (100 * static_cast<double>(br_page_cache) / bytes_alloted) << "%] br_page_cache = [" << br_page_cache << "]" << endl
       << "[" << (100 * static_cast<double>(br_durable_cache) / bytes_alloted) << "%] br_durable_cache = [" << br_durable_cache << "]" << endl
       << "[" << (100 * static_cast<double>(br_fast_memory_sim) / bytes_alloted) << "%] br_fast_memory_sim = [" << br_fast_memory_sim << "]" << endl
@@ -652,6 +745,8 @@ TServer::TServer(TScheduler *scheduler, const TCmd &cmd)
                         cmd.FastCoreVec.size() +
                         cmd.NumMemMergeThreads +
                         cmd.NumDiskMergeThreads +
+                        cmd.NumMergeWorkerThreads +
+                        cmd.NumTetrisWorkerThreads +
                         1UL /* File Service */ +
                         1UL /* Repo Layer Cleaner */ +
                         1UL /* BGFastRunner */ +
@@ -686,6 +781,7 @@ TServer::TServer(TScheduler *scheduler, const TCmd &cmd)
   assert(scheduler);
   assert(&cmd);
   assert(cmd.StartingState.size());
+  Fiber::TRunner::SetProfiling(cmd.FiberProfiling);
   auto launch_slow_fiber_sched = [this](size_t core, Fiber::TRunner *runner) {
     cpu_set_t mask;
     CPU_ZERO(&mask);
@@ -705,10 +801,16 @@ TServer::TServer(TScheduler *scheduler, const TCmd &cmd)
   if (cmd.SlowCoreVec.size() < 1) {
     throw std::runtime_error("SlowCoreVec is required to have at least NumSlowRunners cores");
   }
+  /* the steal group has to be complete before any of its runners starts */
   for (size_t i = 0; i < cmd.SlowCoreVec.size(); ++i) {
     SlowRunnerVec.emplace_back(new Fiber::TRunner(RunnerCons));
     syslog(LOG_INFO, "SLOW RUNNER [%ld] = [%p]", i, SlowRunnerVec.back().get());
-    SlowRunnerThreadVec.emplace_back(new std::thread(std::bind(launch_slow_fiber_sched, cmd.SlowCoreVec[i], SlowRunnerVec.back().get())));
+    if (cmd.SlowWorkStealing) {
+      SlowStealGroup->Join(SlowRunnerVec.back().get());
+    }
+  }
+  for (size_t i = 0; i < cmd.SlowCoreVec.size(); ++i) {
+    SlowRunnerThreadVec.emplace_back(new std::thread(std::bind(launch_slow_fiber_sched, cmd.SlowCoreVec[i], SlowRunnerVec[i].get())));
   }
 
   /* Run the WsRunner's thread. */
@@ -885,10 +987,22 @@ void TServer::Init() {
           8 /* num block lru */,
           Cmd.FileServiceAppendLogMB,
           Cmd.Create,
-          Cmd.NoRealtime);
+          Cmd.NoRealtime,
+          Disk::Util::GetDiskBackend(Cmd.DiskBackend));
       engine_ptr = DiskEngine->GetEngine();
     }
     assert(engine_ptr);
+    engine_ptr->GetPageCache()->SetPolicy(GetCachePolicy(Cmd.PageCachePolicy));
+    engine_ptr->GetBlockCache()->SetPolicy(GetCachePolicy(Cmd.BlockCachePolicy));
+    engine_ptr->GetPageCache()->SetMaxReadAhead(Cmd.PageCacheReadAhead);
+    engine_ptr->GetBlockCache()->SetMaxReadAhead(Cmd.BlockCacheReadAhead);
+    Disk::TArenaChunkCache::Cache.SetMaxBytes(Cmd.ArenaChunkCacheSizeMB * 1024UL * 1024UL);
+    if (Cmd.BloomFilterFalsePositiveRate > 0.0 && Cmd.BloomFilterFalsePositiveRate < 1.0) {
+      engine_ptr->SetBloomFilterBitsPerKey(Disk::Util::TBloomFilter::GetBitsPerKeyForRate(Cmd.BloomFilterFalsePositiveRate));
+    } else {
+      engine_ptr->SetBloomFilterBitsPerKey(Cmd.BloomFilterBitsPerKey);
+    }
+    engine_ptr->SetDataFileCodec(Disk::Util::TCodec::Get(Cmd.DataFileCodec));
 
     std::cout << "Cmd.DiscardOnCreate = " << (Cmd.DiscardOnCreate ? "true" : "false") << std::endl;
     size_t block_slots_available_per_merger = (((Cmd.BlockCacheSizeMB * 1024) / Disk::Util::PhysicalBlockSize) * 0.8) / Cmd.NumDiskMergeThreads;
@@ -939,6 +1053,7 @@ void TServer::Init() {
                                                     Cmd.MemMergeCoreVec,
                                                     Cmd.DiskMergeCoreVec,
                                                     Cmd.Create);
+    RepoManager->SetReplicationCodec(Disk::Util::TCodec::Get(Cmd.ReplicationCodec));
     auto global_ttl = TTtl::max();
     GlobalRepo = RepoManager->GetRepo(TSession::GlobalPovId,
                                       global_ttl,
@@ -1053,7 +1168,7 @@ void TServer::Init() {
       Disk::TLocalWalkerCache::Cache = new Disk::TLocalWalkerCache();
     };
 
-    TetrisManager = new TRepoTetrisManager(Scheduler, RunnerCons, FramePoolManager.get(), tetris_runner_setup_cb, (RepoState == Orly::Indy::TManager::Solo), RepoManager.get(), &PackageManager, DurableManager.get(), Cmd.LogAssertionFailures);
+    TetrisManager = new TRepoTetrisManager(Scheduler, RunnerCons, FramePoolManager.get(), tetris_runner_setup_cb, (RepoState == Orly::Indy::TManager::Solo), RepoManager.get(), &PackageManager, DurableManager.get(), Cmd.LogAssertionFailures, Cmd.NumTetrisWorkerThreads);
     RepoManager->SetTetrisManager(TetrisManager);
     /* schedule everything the repo manager needs */ {
       /* Read() from master / slave */ {
@@ -1116,6 +1231,7 @@ void TServer::Init() {
         //Scheduler->Schedule(bind(&Orly::Indy::L0::TManager::RunMergeMem, RepoManager.get()));
       }
       /* Merge multiple disk files of a specific size category, in the same safe repo. */
+      RepoManager->SetMaxMergeDiskShare(Cmd.HighDiskUtilizationThreshold);
       for (size_t i = 0; i < Cmd.NumDiskMergeThreads; ++i) {
         MergeDiskRunnerVec.emplace_back(new Fiber::TRunner(RunnerCons));
         Fiber::TRunner *cur_runner = MergeDiskRunnerVec.back().get();
@@ -1130,6 +1246,18 @@ void TServer::Init() {
         MergeDiskFrameVec.emplace_back(frame);
         //Scheduler->Schedule(bind(&Orly::Indy::L0::TManager::RunMergeDisk, RepoManager.get(), block_slots_available_per_merger));
       }
+      /* Workers that a disk merge hands its per-source passes to. */
+      if (Cmd.NumMergeWorkerThreads) {
+        MergeWorkerPool = make_unique<Fiber::TRunnerPool>(RunnerCons, Cmd.NumMergeWorkerThreads, [this](Fiber::TRunner *runner) {
+          if (!Fiber::TFrame::LocalFramePool) {
+            Fiber::TFrame::LocalFramePool = new Base::TThreadLocalGlobalPoolManager<Fiber::TFrame, size_t, Fiber::TRunner *>::TThreadLocalPool(FramePoolManager.get());
+          }
+          RepoManager->RunMergeWorker(runner);
+          delete Fiber::TFrame::LocalFramePool;
+          Fiber::TFrame::LocalFramePool = nullptr;
+        });
+        RepoManager->SetMergeWorkerPool(MergeWorkerPool.get());
+      }
 
     }
 
@@ -1207,6 +1335,7 @@ TServer::~TServer() {
   DurableManager->Clear();
   DurableManager.reset();
   GlobalRepo.Reset();
+  MergeWorkerPool.reset();
   RepoManager.reset();
   Fiber::TFrame::LocalFramePool->Free(Frame);
 }
@@ -1504,6 +1633,7 @@ TServer::TConnection::TProtocol::TProtocol() {
   Register<TConnection, void, TUuid, seconds>(ServerRpc::SetTimeToLive, &TConnection::SetTimeToLive);
   Register<TConnection, TMethodResult, TUuid, vector<string>, TClosure>(ServerRpc::Try, &TConnection::Try);
   Register<TConnection, TMethodResult, TUuid, vector<string>, TClosure>(ServerRpc::TryTracked, &TConnection::TryTracked);
+  Register<TConnection, vector<TMethodResult>, TUuid, vector<string>, vector<TClosure>, bool>(ServerRpc::TryBatch, &TConnection::TryBatch);
   Register<TConnection, TMethodResult, TUuid, vector<string>, TClosure, TUuid>(ServerRpc::DoInPast, &TConnection::DoInPast);
   Register<TConnection, void>(ServerRpc::BeginImport, &TConnection::BeginImport);
   Register<TConnection, void>(ServerRpc::EndImport, &TConnection::EndImport);
@@ -1626,7 +1756,7 @@ string TServer::ImportCoreVector(const string &file_pattern,
 
   size_t completion_count = 0UL;
 
-  class TJobRunner : Fiber::TRunnable {
+  class TJobRunner : public Fiber::TRunnable {
     NO_COPY(TJobRunner);
     public:
 
@@ -1922,7 +2052,7 @@ string TServer::ImportCoreVector(const string &file_pattern,
   TSequenceNumber final_saved_low, final_saved_high;
   size_t final_num_keys;
   /* now iterate over the gen_id_vec till we have just the 1 file */ {
-    class TMergeRunner : Fiber::TRunnable {
+    class TMergeRunner : public Fiber::TRunnable {
       NO_COPY(TMergeRunner);
       public:
 
@@ -2615,15 +2745,21 @@ void TIndyReporter::AcceptClientConnections() {
   }
 }
 
+const char *TIndyReporter::SamplesPath = "/fiber_samples";
+
 void TIndyReporter::ServeClient(TFd &fd) {
   assert(this);
   char buf[8192];
   for (;;) {
-    IfLt0(read(fd, buf, 8192));
+    const string request(buf, IfLt0(read(fd, buf, 8192)));
     stringstream ss;
     ss << "HTTP/1.1 200 OK" << endl;
     stringstream report;
-    AddReport(report);
+    if (request.compare(0, 4, "GET ") == 0 && request.compare(4, strlen(SamplesPath), SamplesPath) == 0) {
+      AddSamples(report);
+    } else {
+      AddReport(report);
+    }
     ss << "Connection: close" << endl;
     ss << "Content-Length: " << report.str().size() << endl << endl;
     ss << report.str();
@@ -2651,6 +2787,9 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
   const size_t num_buf_in_block_lru = block_cache->CountNumBufInLRU();
   const size_t max_buf_in_block_lru = block_cache->GetMaxCacheSize();
   #endif
+  Disk::Util::TCacheStats page_cache_stats, block_cache_stats;
+  engine->GetPageCache()->TakeStats(page_cache_stats);
+  engine->GetBlockCache()->TakeStats(block_cache_stats);
   engine->GetVolMan()->AppendVolumeUsageReport(ss);
   size_t try_count;
   size_t try_read_count;
@@ -2711,6 +2850,18 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
     try_fetch_count_mean,
     try_fetch_count_sigma;
 
+  double
+    try_memo_hit_count_min,
+    try_memo_hit_count_max,
+    try_memo_hit_count_mean,
+    try_memo_hit_count_sigma;
+
+  double
+    try_memo_miss_count_min,
+    try_memo_miss_count_max,
+    try_memo_miss_count_mean,
+    try_memo_miss_count_sigma;
+
   nanoseconds merge_disk_step_cpu;
   nanoseconds merge_mem_step_cpu;
   size_t merge_mem_count = 0UL;
@@ -2752,6 +2903,12 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
     TServer::TryWalkerCountCalc.Report(try_walker_count_min, try_walker_count_max, try_walker_count_mean, try_walker_count_sigma);
     TServer::TryWalkerCountCalc.Reset();
 
+    TServer::TryMemoHitCountCalc.Report(try_memo_hit_count_min, try_memo_hit_count_max, try_memo_hit_count_mean, try_memo_hit_count_sigma);
+    TServer::TryMemoHitCountCalc.Reset();
+
+    TServer::TryMemoMissCountCalc.Report(try_memo_miss_count_min, try_memo_miss_count_max, try_memo_miss_count_mean, try_memo_miss_count_sigma);
+    TServer::TryMemoMissCountCalc.Reset();
+
     TServer::TryCallCPUTimerCalc.Report(try_call_cpu_time_min, try_call_cpu_time_max, try_call_cpu_time_mean, try_call_cpu_time_sigma);
     TServer::TryCallCPUTimerCalc.Reset();
 
@@ -2775,6 +2932,102 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
   ss << "Page LRU Buf Free = " << num_buf_in_page_lru << " / " << max_buf_in_page_lru << endl;
   ss << "Block LRU Buf Free = " << num_buf_in_block_lru << " / " << max_buf_in_block_lru << endl;
   #endif
+  for (const auto &cache : {make_pair("Page", &page_cache_stats), make_pair("Block", &block_cache_stats)}) {
+    const Disk::Util::TCacheStats &stats = *cache.second;
+    const size_t num_gets = stats.NumHits + stats.NumMisses;
+    ss << cache.first << " Cache Hits / s = " << (stats.NumHits / elapsed_time) << endl;
+    ss << cache.first << " Cache Misses / s = " << (stats.NumMisses / elapsed_time) << endl;
+    ss << cache.first << " Cache Hit Ratio = " << (num_gets ? (static_cast<double>(stats.NumHits) / num_gets) : 0.0) << endl;
+    ss << cache.first << " Cache Evictions / s = " << (stats.NumEvictions / elapsed_time) << endl;
+    ss << cache.first << " Cache Loads In Flight = " << stats.NumLoadsInFlight << endl;
+    ss << cache.first << " Cache Load Waits / s = " << (stats.NumWaits / elapsed_time) << endl;
+    ss << cache.first << " Cache Mean Load Wait (us) = " << (stats.NumWaits ? (ToSecondsDouble(stats.WaitTime) * 1000000.0 / stats.NumWaits) : 0.0) << endl;
+    ss << cache.first << " Cache Read Ahead / s = " << (stats.NumReadAheadPages / elapsed_time) << endl;
+    ss << cache.first << " Cache Read Ahead Hits / s = " << (stats.NumReadAheadHits / elapsed_time) << endl;
+  }
+
+  Indy::TManager::TReplicationStats replication_stats;
+  Server->RepoManager->TakeReplicationStats(replication_stats);
+  ss << "Replication Frames Sent / s = " << (replication_stats.NumFramesSent / elapsed_time) << endl;
+  ss << "Replication Items Sent / s = " << (replication_stats.NumItemsSent / elapsed_time) << endl;
+  ss << "Replication Bytes Sent / s = " << (replication_stats.NumWireBytesSent / elapsed_time) << endl;
+  ss << "Replication Send Compression Ratio = " << (replication_stats.NumWireBytesSent ? (static_cast<double>(replication_stats.NumRawBytesSent) / replication_stats.NumWireBytesSent) : 0.0) << endl;
+  ss << "Replication Frames In Flight = " << replication_stats.NumFramesInFlight << endl;
+  ss << "Replication Master Lag = " << replication_stats.MasterLag << endl;
+  ss << "Replication Frames Received / s = " << (replication_stats.NumFramesReceived / elapsed_time) << endl;
+  ss << "Replication Bytes Received / s = " << (replication_stats.NumWireBytesReceived / elapsed_time) << endl;
+  ss << "Replication Slave Lag = " << replication_stats.SlaveLag << endl;
+  Indy::TManager::TBootstrapStats bootstrap_stats;
+  Server->RepoManager->GetBootstrapStats(bootstrap_stats);
+  ss << "Slave Bootstrap Files = " << bootstrap_stats.NumFiles << endl;
+  ss << "Slave Bootstrap MB / s = " << (bootstrap_stats.ShipTime.count() ? ((bootstrap_stats.NumBytes / (1024.0 * 1024.0)) / ToSecondsDouble(bootstrap_stats.ShipTime)) : 0.0) << endl;
+  ss << "Slave Bootstrap Time To Caught Up (s) = " << ToSecondsDouble(bootstrap_stats.TimeToCaughtUp) << endl;
+  Durable::TManager::TCacheStats durable_cache_stats;
+  Server->DurableManager->TakeCacheStats(durable_cache_stats);
+  const size_t num_durable_opens = durable_cache_stats.NumHits + durable_cache_stats.NumMisses;
+  ss << "Durable Cache Hits / s = " << (durable_cache_stats.NumHits / elapsed_time) << endl;
+  ss << "Durable Cache Misses / s = " << (durable_cache_stats.NumMisses / elapsed_time) << endl;
+  ss << "Durable Cache Hit Ratio = " << (num_durable_opens ? (static_cast<double>(durable_cache_stats.NumHits) / num_durable_opens) : 0.0) << endl;
+  ss << "Durable Cache Evictions / s = " << (durable_cache_stats.NumEvictions / elapsed_time) << endl;
+  ss << "Durable Cache Lock Contentions / s = " << (durable_cache_stats.NumContentions / elapsed_time) << endl;
+  ss << "Slow Runner Steals / s = " << (Server->SlowStealGroup->TakeNumSteals() / elapsed_time) << endl;
+  /* extra */ {
+    Fiber::TRunner::TParkStats park_stats;
+    for (auto &runner: Server->SlowRunnerVec) {
+      runner->TakeParkStats(park_stats);
+    }
+    for (auto &runner: Server->FastRunnerVec) {
+      runner->TakeParkStats(park_stats);
+    }
+    const size_t num_runners = Server->SlowRunnerVec.size() + Server->FastRunnerVec.size();
+    ss << "Runner Parks / s = " << (park_stats.NumParks / elapsed_time) << endl;
+    ss << "Runner Idle Fraction = " << (ToSecondsDouble(park_stats.ParkedTime) / (elapsed_time * num_runners)) << endl;
+    ss << "Runner Wake Latency (us) = " << park_stats.WakeLatency << endl;
+  }
+  if (Fiber::TRunner::IsProfiling()) {
+    /* Report each runner on its own, the kinds which ran longest first. */
+    auto report_profile = [&ss, elapsed_time](Fiber::TRunner *runner) {
+      Fiber::TRunner::TProfile profile;
+      runner->TakeProfile(profile);
+      vector<pair<string, Fiber::TRunner::TProfile::TKindStats>> kinds;
+      for (const auto &item: profile.ByKind) {
+        kinds.emplace_back(Fiber::TRunner::GetKindName(item.first), item.second);
+      }
+      sort(kinds.begin(), kinds.end(), [](const pair<string, Fiber::TRunner::TProfile::TKindStats> &lhs, const pair<string, Fiber::TRunner::TProfile::TKindStats> &rhs) {
+        return lhs.second.RunTime > rhs.second.RunTime;
+      });
+      const size_t id = runner->GetRunnerId();
+      for (const auto &kind: kinds) {
+        ss << "Fiber Runner " << id << " [" << kind.first << "] Switches / s = " << (kind.second.NumSwitches / elapsed_time) << endl;
+        ss << "Fiber Runner " << id << " [" << kind.first << "] Run Time (s) / s = " << (ToSecondsDouble(kind.second.RunTime) / elapsed_time) << endl;
+        ss << "Fiber Runner " << id << " [" << kind.first << "] Wait Time (s) / s = " << (ToSecondsDouble(kind.second.WaitTime) / elapsed_time) << endl;
+        ss << "Fiber Runner " << id << " [" << kind.first << "] Blocked Time (s) / s = " << (ToSecondsDouble(kind.second.BlockedTime) / elapsed_time) << endl;
+      }
+    };
+    for (auto &runner: Server->SlowRunnerVec) {
+      report_profile(runner.get());
+    }
+    for (auto &runner: Server->FastRunnerVec) {
+      report_profile(runner.get());
+    }
+  }
+  /* Report one group commit's flushes, commits per flush and commit latencies. */
+  auto report_group_commit = [&ss, elapsed_time](const char *name, const Indy::Util::TGroupCommit::TStats &stats) {
+    ss << name << " Flushes / s = " << (stats.NumFlushes / elapsed_time) << endl;
+    ss << name << " Commits / s = " << (stats.NumCommits / elapsed_time) << endl;
+    ss << name << " Commits / Flush = " << stats.BatchSize << endl;
+    ss << name << " Commit Latency (us) = " << stats.Latency << endl;
+  };
+  Indy::Util::TGroupCommit::TStats group_commit_stats;
+  auto *disk_durable_manager = dynamic_cast<Indy::Disk::TDurableManager *>(Server->DurableManager.get());
+  if (disk_durable_manager) {
+    disk_durable_manager->TakeGroupCommitStats(group_commit_stats);
+    report_group_commit("Durable Group Commit", group_commit_stats);
+  }
+  Server->RepoManager->MergeMemCommit.TakeStats(group_commit_stats);
+  report_group_commit("Repo Group Commit", group_commit_stats);
+  Indy::Disk::TWriteGroup::TakeGroupCommitStats(group_commit_stats);
+  report_group_commit("Write Group", group_commit_stats);
 
   ss << "Durable Mapping Pool = " << Disk::TDurableManager::TMapping::Pool.GetNumBlocksUsed() << " / " << Server->Cmd.DurableMappingPoolSize << endl;
   ss << "Durable Mapping Entry Pool = " << Disk::TDurableManager::TMapping::TEntry::Pool.GetNumBlocksUsed() << " / " << Server->Cmd.DurableMappingEntryPoolSize << endl;
@@ -2803,10 +3056,16 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
   size_t tetris_pop_count = Server->TetrisManager->PopCount.exchange(0UL);
   size_t tetris_fail_count = Server->TetrisManager->FailCount.exchange(0UL);
   size_t tetris_round_count = Server->TetrisManager->RoundCount.exchange(0UL);
+  size_t tetris_skip_count = Server->TetrisManager->SkipCount.exchange(0UL);
+  size_t tetris_recheck_count = Server->TetrisManager->RecheckCount.exchange(0UL);
   ss << "Tetris Push Transactions / s = " << (tetris_push_count / elapsed_time) << endl;
   ss << "Tetris Pop Transactions / s = " << (tetris_pop_count / elapsed_time) << endl;
   ss << "Tetris Fail Transactions / s = " << (tetris_fail_count / elapsed_time) << endl;
   ss << "Tetris Rounds / s = " << (tetris_round_count / elapsed_time) << endl;
+  ss << "Tetris Push Count = " << tetris_push_count << endl;
+  ss << "Tetris Fail Count = " << tetris_fail_count << endl;
+  ss << "Tetris Assertion Skip Count = " << tetris_skip_count << endl;
+  ss << "Tetris Assertion Recheck Count = " << tetris_recheck_count << endl;
 
   size_t tetris_timer_count = 0UL;
   double
@@ -2829,6 +3088,7 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
     tetris_commit_max = 0.0,
     tetris_commit_mean = 0.0,
     tetris_commit_sigma = 0.0;
+  THistogram tetris_play_wall;
 
   {
     std::lock_guard<std::mutex> tetris_timer_lock(Server->TetrisManager->TetrisTimerLock);
@@ -2840,6 +3100,8 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
     Server->TetrisManager->TetrisSortCPUTime.Reset();
     Server->TetrisManager->TetrisPlayCPUTime.Reset();
     Server->TetrisManager->TetrisCommitCPUTime.Reset();
+    tetris_play_wall = Server->TetrisManager->TetrisPlayWallTime;
+    Server->TetrisManager->TetrisPlayWallTime.Reset();
   }
 
   if (tetris_timer_count) {
@@ -2854,7 +3116,8 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
     ss << "Tetris Play CPU / s = " << ((tetris_timer_count * tetris_play_mean) / elapsed_time) << endl
        << "Tetris Play CPU Min = " << tetris_play_min << endl
        << "Tetris Play CPU Max = " << tetris_play_max << endl
-       << "Tetris Play CPU Mean = " << tetris_play_mean << endl;
+       << "Tetris Play CPU Mean = " << tetris_play_mean << endl
+       << "Tetris Play Wall (us) = " << tetris_play_wall << endl;
     ss << "Tetris Commit CPU / s = " << ((tetris_timer_count * tetris_commit_mean) / elapsed_time) << endl
        << "Tetris Commit CPU Min = " << tetris_commit_min << endl
        << "Tetris Commit CPU Max = " << tetris_commit_max << endl
@@ -2868,6 +3131,21 @@ void TIndyReporter::AddReport(std::stringstream &ss) const {
        << "Merge Mem Keys Max = " << merge_mem_key_max << endl
        << "Merge Mem Keys Mean = " << merge_mem_key_mean << endl;
   }
+  /* Per-repo layers and merge debt, worst debt first. */ {
+    vector<Indy::L0::TManager::TRepoMergeReport> repo_merge_reports;
+    Server->RepoManager->GetRepoMergeReports(repo_merge_reports);
+    sort(repo_merge_reports.begin(), repo_merge_reports.end(),
+         [](const Indy::L0::TManager::TRepoMergeReport &lhs, const Indy::L0::TManager::TRepoMergeReport &rhs) {
+           return lhs.Load.GetDebt() > rhs.Load.GetDebt();
+         });
+    for (const auto &report: repo_merge_reports) {
+      ss << "Repo " << report.Id << " Layers (Mem / Disk) = " << report.NumMemLayers << " / " << report.NumDiskLayers
+         << ", Lookups / s = " << report.Load.LookupRate
+         << ", Layers / Lookup = " << report.Load.ReadAmp
+         << ", Updates / s = " << report.Load.UpdateRate
+         << ", Merge Debt (probes / s) = " << report.Load.GetDebt() << endl;
+    }
+  }
   if (merge_disk_count) {
     ss << "Merge Disk Keys Count = " << merge_disk_count << endl
        << "Merge Disk Keys Min = " << merge_disk_key_min << endl
@@ -2893,6 +3171,14 @@ if (try_read_count) {
        << "Try Walker Count Max = " << try_walker_count_max << endl
        << "Try Walker Count Mean = " << try_walker_count_mean << endl;
 
+    ss << "Try Memo Hit Count Min = " << try_memo_hit_count_min << endl
+       << "Try Memo Hit Count Max = " << try_memo_hit_count_max << endl
+       << "Try Memo Hit Count Mean = " << try_memo_hit_count_mean << endl;
+
+    ss << "Try Memo Miss Count Min = " << try_memo_miss_count_min << endl
+       << "Try Memo Miss Count Max = " << try_memo_miss_count_max << endl
+       << "Try Memo Miss Count Mean = " << try_memo_miss_count_mean << endl;
+
     ss << "Try Read Call Time Min = " << try_read_call_time_min << endl
        << "Try Read Call Time Max = " << try_read_call_time_max << endl
        << "Try Read Call Time Mean = " << try_read_call_time_mean << endl;
@@ -2910,12 +3196,28 @@ if (try_read_count) {
   }
 }
 
+void TIndyReporter::AddSamples(std::stringstream &ss) const {
+  assert(this);
+  if (!Fiber::TRunner::IsProfiling()) {
+    ss << "Fiber profiling is off.  Run with --fiber_profiling to sample." << endl;
+    return;
+  }
+  vector<const Fiber::TRunner *> runners;
+  for (const auto &runner: Server->SlowRunnerVec) {
+    runners.push_back(runner.get());
+  }
+  for (const auto &runner: Server->FastRunnerVec) {
+    runners.push_back(runner.get());
+  }
+  Fiber::TRunner::DumpSamples(ss, runners, 1000UL, chrono::milliseconds(1));
+}
+
 TServer::TConnection::TConnectionRunnable::TConnectionRunnable(Fiber::TRunner *runner, const std::shared_ptr<const Rpc::TAnyRequest> &request)
     : Request(request) {
   FramePool = Fiber::TFrame::LocalFramePool;
   Frame = FramePool->Alloc();
   try {
-    Frame->Latch(runner, this, static_cast<TRunnable::TFunc>(&TConnectionRunnable::Compute));
+    Frame->LatchStealable(runner, this, static_cast<TRunnable::TFunc>(&TConnectionRunnable::Compute));
   } catch (...) {
     FramePool->Free(Frame);
     throw;
@@ -134,6 +134,13 @@ namespace Orly {
       /* TODO */
       void AddReport(std::stringstream &ss) const;
 
+      /* Sample what the slow and fast runners are running for a second, in the folded format flame graph tools read.
+         We serve this instead of the report to a GET of SamplesPath. */
+      void AddSamples(std::stringstream &ss) const;
+
+      /* See AddSamples(). */
+      static const char *SamplesPath;
+
       /* TODO */
       const TServer *Server;
 
@@ -225,18 +232,45 @@ namespace Orly {
         /* TODO */
         size_t BlockCacheSizeMB;
 
+        /* The replacement policies of the page and block caches: "lru" or "slru" (segmented LRU). */
+        std::string PageCachePolicy;
+        std::string BlockCachePolicy;
+
+        /* The most pages (blocks) a sequential scan keeps loading ahead of itself in the page (block) cache.  Zero
+           disables read-ahead. */
+        size_t PageCacheReadAhead;
+        size_t BlockCacheReadAhead;
+
+        /* The size, in MB, of the cache of decompressed chunks shared by the compressed arenas of every data file. */
+        size_t ArenaChunkCacheSizeMB;
+
         /* TODO */
         size_t FileServiceAppendLogMB;
 
         /* TODO */
         size_t DiskMaxAioNum;
 
+        /* The kernel interface disk I/O goes through: "aio" or "io_uring". */
+        std::string DiskBackend;
+
         /* TODO */
         double HighDiskUtilizationThreshold;
 
+        /* The number of bloom filter bits to spend per key in each data file index.  Zero disables the filters. */
+        size_t BloomFilterBitsPerKey;
+
+        /* If non-zero, the target false positive rate of the data file bloom filters.  Overrides BloomFilterBitsPerKey. */
+        double BloomFilterFalsePositiveRate;
+
+        /* The codec new data file arenas are compressed with: "none", "snappy", "lz4" or "zstd". */
+        std::string DataFileCodec;
+
         /* TODO */
         bool DiscardOnCreate;
 
+        /* The codec replication frames are compressed with: "none", "snappy", "lz4" or "zstd". */
+        std::string ReplicationCodec;
+
         /* TODO */
         size_t ReplicationSyncBufMB;
 
@@ -264,6 +298,12 @@ namespace Orly {
         /* TODO */
         size_t NumDiskMergeThreads;
 
+        /* The number of worker threads shared by disk merges, which split each index's keys into ranges and merge them side by side. */
+        size_t NumMergeWorkerThreads;
+
+        /* The number of worker threads tetris tests child povs' assertions on. */
+        size_t NumTetrisWorkerThreads;
+
         /* The number of threads to use for answering websocket requests. */
         size_t NumWsThreads;
 
@@ -276,6 +316,13 @@ namespace Orly {
         /* TODO */
         std::vector<size_t> SlowCoreVec;
 
+        /* If true, the slow schedulers steal client requests from one another instead of each running only those
+           assigned to it. */
+        bool SlowWorkStealing;
+
+        /* If true, the fiber runners keep a profile of where their time goes, which the reporter publishes. */
+        bool FiberProfiling;
+
         /* TODO */
         std::vector<size_t> DiskControllerCoreVec;
 
@@ -495,6 +542,13 @@ namespace Orly {
           return Session->Try(Server, pov_id, fq_name, closure);
         }
 
+        /* See <orly/protocol.h>. */
+        std::vector<TMethodResult> TryBatch(
+            const Base::TUuid &pov_id, const std::vector<std::string> &fq_name, const std::vector<TClosure> &closures, bool atomic) {
+          assert(this);
+          return Session->TryBatch(Server, pov_id, fq_name, closures, atomic);
+        }
+
         /* See <orly/protocol.h>. */
         TMethodResult TryTracked(const Base::TUuid &pov_id, const std::vector<std::string> &fq_name, const TClosure &closure) {
           assert(this);
@@ -650,7 +704,7 @@ namespace Orly {
           FramePool = Indy::Fiber::TFrame::LocalFramePool;
           Frame = FramePool->Alloc();
           try {
-              Frame->Latch(runner, this, static_cast<Indy::Fiber::TRunnable::TFunc>(&TServeClientRunnable::Serve));
+              Frame->LatchStealable(runner, this, static_cast<Indy::Fiber::TRunnable::TFunc>(&TServeClientRunnable::Serve));
           } catch (...) {
             FramePool->Free(Frame);
             throw;
@@ -749,6 +803,7 @@ namespace Orly {
       std::vector<std::unique_ptr<Indy::Fiber::TRunner>> MergeMemRunnerVec;
       std::vector<Indy::Fiber::TFrame *> MergeDiskFrameVec;
       std::vector<std::unique_ptr<Indy::Fiber::TRunner>> MergeDiskRunnerVec;
+      std::unique_ptr<Indy::Fiber::TRunnerPool> MergeWorkerPool;
       Indy::Fiber::TRunner DurableLayerCleanerRunner;
       Indy::Fiber::TRunner RepoLayerCleanerRunner;
       Indy::Fiber::TRunner BGFastRunner;
@@ -22,6 +22,7 @@
 #include <orly/indy/context.h>
 #include <orly/notification/all.h>
 #include <orly/server/meta_record.h>
+#include <orly/server/update_batch.h>
 #include <orly/spa/orly_args.h>
 #include <util/time.h>
 
@@ -34,6 +35,45 @@ using namespace Orly::Notification;
 using namespace Orly::Server;
 using namespace Util;
 
+/* Past this many keys, patterns and ranges, we don't keep track of what a method read.  Tetris just re-runs it. */
+static const size_t MaxReadCount = 1000UL;
+
+/* Gather what the method read, in meta record form, along with where it read it.  If it read too much, leave it all
+   empty. */
+static void GetReads(
+    const Indy::TContext &context, const Indy::TIndyContext &indy_context,
+    TMetaRecord::TEntry::TKeysByIndexId &read_keys, TMetaRecord::TEntry::TKeysByIndexId &read_patterns,
+    TMetaRecord::TEntry::TRangesByIndexId &read_ranges, TMetaRecord::TEntry::TSnapshot &snapshot) {
+  if (indy_context.GetReadCount() > MaxReadCount) {
+    return;
+  }
+  void *state_alloc = alloca(Sabot::State::GetMaxStateSize());
+  auto to_var = [state_alloc](const Indy::TIndexKey &key) {
+    return Var::ToVar(*Sabot::State::TAny::TWrapper(key.GetKey().GetState(state_alloc)));
+  };
+  indy_context.ForEachRead(
+      [&](const Indy::TIndexKey &key) {
+        read_keys[key.GetIndexId()].push_back(to_var(key));
+      },
+      [&](const Indy::TIndexKey &pattern) {
+        read_patterns[pattern.GetIndexId()].push_back(to_var(pattern));
+      },
+      [&](const Indy::TIndexKey &from, const Indy::TIndexKey &to) {
+        /* of two ranges starting at the same key, the longer one covers the other */
+        auto &ranges = read_ranges[from.GetIndexId()];
+        Var::TVar first = to_var(from), last = to_var(to);
+        auto iter = ranges.find(first);
+        if (iter == ranges.end()) {
+          ranges.insert(make_pair(first, last));
+        } else if (iter->second < last) {
+          iter->second = last;
+        }
+      });
+  for (const auto &item : context.GetSnapshot()) {
+    snapshot.insert(item);
+  }
+}
+
 TMethodResult TSession::DoInPast(
     TServer */*server*/, const TUuid &/*pov_id*/, const vector<string> &/*fq_name*/, const TClosure &/*closure*/, const TUuid &/*tracking_id*/) {
   assert(this);
@@ -139,58 +179,101 @@ void TSession::SetUserId(TServer */*server*/, const TUuid &user_id) {
 
 TMethodResult TSession::Try(TServer *server, const TUuid &pov_id, const vector<string> &fq_name, const TClosure &closure) {
   assert(this);
+  vector<TMethodResult> results;
+  try {
+    RunClosures(server, pov_id, fq_name, &closure, 1UL, false, results);
+  } catch (const exception &ex) {
+    syslog(LOG_ERR, "Error in Session::Try : [%s]", ex.what());
+    throw;
+  }
+  assert(results.size() == 1UL);
+  return move(results.front());
+}
+
+vector<TMethodResult> TSession::TryBatch(
+    TServer *server, const TUuid &pov_id, const vector<string> &fq_name, const vector<TClosure> &closures, bool atomic) {
+  assert(this);
+  assert(&closures);
+  vector<TMethodResult> results;
+  if (closures.empty()) {
+    return results;
+  }
+  results.reserve(closures.size());
+  try {
+    RunClosures(server, pov_id, fq_name, closures.data(), closures.size(), atomic, results);
+  } catch (const exception &ex) {
+    syslog(LOG_ERR, "Error in Session::TryBatch : closure [%ld] of [%ld]%s : [%s]",
+           results.size(), closures.size(), atomic ? ", nothing committed" : "", ex.what());
+    throw;
+  }
+  return results;
+}
+
+void TSession::RunClosures(
+    TServer *server, const TUuid &pov_id, const vector<string> &fq_name, const TClosure *closures, size_t num_closures, bool atomic,
+    vector<TMethodResult> &out) {
+  assert(this);
+  assert(closures);
+  assert(&out);
   assert(Indy::Fiber::TRunner::LocalRunner);
   size_t prev_assignment_count = std::atomic_fetch_add(&server->FastAssignmentCounter, 1UL);
   Indy::Fiber::TSwitchToRunner RunnerSwitcher(server->FastRunnerVec[prev_assignment_count % server->FastRunnerVec.size()].get());
-  TCore result_core;
-  Base::TTimer timer;
-  Base::TTimer call_timer;
-  bool had_effects = false;
-  TOpt<TTracker> tracker = TOpt<TTracker>();
-  size_t walker_count = 0UL;
   TSuprena my_arena;
-  try {
+  void *state_alloc_1 = alloca(Sabot::State::GetMaxStateSize() * 2);
+  void *state_alloc_2 = reinterpret_cast<uint8_t *>(state_alloc_1) + Sabot::State::GetMaxStateSize();
+  // Open the pov and its repo and prepare the data context, once for all the closures.
+  auto pov = server->GetDurableManager()->Open<TPov>(pov_id);
+  if (!pov) {
+    DEFINE_ERROR(error_t, runtime_error, "unknown pov_id");
+    THROW_ERROR(error_t) << pov_id;
+  }
+  AddPov(pov);
+  auto repo = pov->GetRepo(server);
+  Indy::TContext context(repo, &my_arena);
+  Rt::TOpt<Base::TUuid> user_id;
+  if (UserId) {
+    user_id = UserId->GetRaw();
+  }
+  Base::TUuid session_id = GetId().GetRaw();
+  auto package = server->GetPackageManager().Get(Package::TName{fq_name});
+  /* The closures all read the pov as it was when we opened the context; they don't see each other's writes.  The one
+     exception is a non-final effect (such as an increment), which builds on the value an earlier closure in the batch
+     wrote to its key, if any, rather than on what the context sees. */
+  map<Indy::TIndexKey, Var::TVar> written;
+  /* If atomic, every closure's effects fold into this one update, pushed once after the last closure has run.
+     Otherwise, each closure's effects go through it and out again before the next closure runs. */
+  TUpdateBatch batch;
+  for (size_t i = 0; i < num_closures; ++i) {
+    const TClosure &closure = closures[i];
+    Base::TTimer timer;
+    Base::TTimer call_timer;
+    bool had_effects = false;
+    TOpt<TTracker> tracker = TOpt<TTracker>();
     // Convert the args to vars.
     Spa::TArgs::TOrlyArg prog_args;
-    void *state_alloc_1 = alloca(Sabot::State::GetMaxStateSize() * 2);
-    void *state_alloc_2 = reinterpret_cast<uint8_t *>(state_alloc_1) + Sabot::State::GetMaxStateSize();
     auto arena = closure.GetArena().get();
     for (const auto &item: closure.GetCoreByName()) {
       prog_args.insert(make_pair(item.first, Indy::TKey(item.second, arena)));
     }
-    // Open the pov and its repo and prepare the data and package contexts.
-    auto pov = server->GetDurableManager()->Open<TPov>(pov_id);
-    if (!pov) {
-      DEFINE_ERROR(error_t, runtime_error, "unknown pov_id");
-      THROW_ERROR(error_t) << pov_id;
-    }
-    AddPov(pov);
-    auto repo = pov->GetRepo(server);
-    Indy::TContext context(repo, &my_arena);
-    Rt::TOpt<Base::TUuid> user_id;
-    if (UserId) {
-      user_id = UserId->GetRaw();
-    }
-    Base::TUuid session_id = GetId().GetRaw();
     Indy::TIndyContext indy_context(user_id, session_id, context, &my_arena, server->GetScheduler(),
       Rt::TOpt<Base::Chrono::TTimePnt>(), Rt::TOpt<uint32_t>());
     // Func it.
-    auto func = server->GetPackageManager().Get(Package::TName{fq_name})->GetFunctionInfo(AsPiece(closure.GetMethodName()));
+    auto func = package->GetFunctionInfo(AsPiece(closure.GetMethodName()));
     Package::TContext::TEffects effects;
     call_timer.Start();
-    result_core = func->Call(indy_context, prog_args);
+    TCore result_core = func->Call(indy_context, prog_args);
     call_timer.Stop();
     effects = indy_context.MoveEffects();
     if (!effects.empty()) {
       had_effects = true;
-      auto transaction = server->GetRepoManager()->NewTransaction();
       Indy::TUpdate::TOpByKey op_by_key;
       for (const auto &item: effects) {
         auto key = item.first;
         Var::TVar val;
         if (!item.second->IsDelete()) {
           if (!item.second->IsFinal()) {
-            val = Var::ToVar(*Sabot::State::TAny::TWrapper(context[key].GetState(state_alloc_1)));
+            auto iter = written.find(key);
+            val = (iter != written.end()) ? iter->second : Var::ToVar(*Sabot::State::TAny::TWrapper(context[key].GetState(state_alloc_1)));
           }
           item.second->Apply(val);
           op_by_key[key] =
@@ -200,6 +283,9 @@ TMethodResult TSession::Try(TServer *server, const TUuid &pov_id, const vector<s
           op_by_key[key] =
               Indy::TKey(Native::TTombstone::Tombstone, &my_arena, state_alloc_2);
         }
+        if (num_closures > 1UL) {
+          written[key] = val;
+        }
       }
       TUuid update_id(TUuid::Twister);
       tracker = TTracker(update_id, seconds(0));
@@ -221,20 +307,22 @@ TMethodResult TSession::Try(TServer *server, const TUuid &pov_id, const vector<s
         run_time = indy_context.GetOptNow().GetVal();
       }
 
-      TMetaRecord meta_record(
-          update_id,
+      TMetaRecord::TEntry::TKeysByIndexId read_keys, read_patterns;
+      TMetaRecord::TEntry::TRangesByIndexId read_ranges;
+      TMetaRecord::TEntry::TSnapshot snapshot;
+      GetReads(context, indy_context, read_keys, read_patterns, read_ranges, snapshot);
+
+      batch.Add(
+          op_by_key, update_id,
           TMetaRecord::TEntry(
               GetId(), GetUserId(), fq_name, closure.GetMethodName(),
               TMetaRecord::TEntry::TArgByName(meta_args_by_name.begin(), meta_args_by_name.end()),
               TMetaRecord::TEntry::TExpectedPredicateResults(predicate_results.begin(), predicate_results.end()),
-              run_time, random_seed)
-      );
-      auto update = Indy::TUpdate::NewUpdate(op_by_key, Indy::TKey(meta_record, &my_arena, state_alloc_1), Indy::TKey(update_id, &my_arena, state_alloc_2));
-      transaction->Push(repo, update);
-      transaction->Prepare();
-      transaction->CommitAction();
+              run_time, random_seed, move(read_keys), move(read_patterns), move(read_ranges), move(snapshot)));
+      if (!atomic) {
+        batch.Commit(server->GetRepoManager(), repo);
+      }
     }
-    walker_count = context.GetWalkerCount();
     timer.Stop();
     /* Acquire TryTime lock */ {
       std::lock_guard<std::mutex> lock(TServer::TryTimeLock);
@@ -245,13 +333,15 @@ TMethodResult TSession::Try(TServer *server, const TUuid &pov_id, const vector<s
         TServer::TryReadTimeCalc.Push(ToSecondsDouble(timer.GetTotal()));
         TServer::TryReadCallTimerCalc.Push(ToSecondsDouble(call_timer.GetTotal()));
       }
-      TServer::TryWalkerCountCalc.Push(walker_count);
+      TServer::TryWalkerCountCalc.Push(context.GetWalkerCount());
+      TServer::TryMemoHitCountCalc.Push(indy_context.GetMemoHitCount());
+      TServer::TryMemoMissCountCalc.Push(indy_context.GetMemoMissCount());
       TServer::TryWalkerConsTimerCalc.Push(ToSecondsDouble(context.GetPresentWalkConsTimer().GetTotal()));
     }
-    return TMethodResult(indy_context.GetArena(), result_core, tracker);
-  } catch (const exception &ex) {
-    syslog(LOG_ERR, "Error in Session::Try : [%s]", ex.what());
-    throw;
+    out.push_back(TMethodResult(indy_context.GetArena(), result_core, tracker));
+  }
+  if (!batch.IsEmpty()) {
+    batch.Commit(server->GetRepoManager(), repo);
   }
 }
 
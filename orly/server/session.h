@@ -80,6 +80,8 @@ namespace Orly {
         static Base::TSigmaCalc TryWriteCallTimerCalc;
         static Base::TSigmaCalc TryFetchCountCalc;
         static Base::TSigmaCalc TryHashHitCountCalc;
+        static Base::TSigmaCalc TryMemoHitCountCalc;
+        static Base::TSigmaCalc TryMemoMissCountCalc;
 
         static Base::TSigmaCalc TryWriteSyncHitCalc;
         static Base::TSigmaCalc TryWriteSyncTimeCalc;
@@ -91,7 +93,11 @@ namespace Orly {
         protected:
 
         /* TODO */
-        TServer(size_t num_runners) : RunnerCons(num_runners), SlowAssignmentCounter(0UL), FastAssignmentCounter(0UL) {}
+        TServer(size_t num_runners)
+            : RunnerCons(num_runners),
+              SlowStealGroup(new Indy::Fiber::TRunner::TStealGroup()),
+              SlowAssignmentCounter(0UL),
+              FastAssignmentCounter(0UL) {}
 
         /* TODO */
         void InitalizeFramePoolManager(size_t num_frames, size_t frame_stack_size, Indy::Fiber::TRunner *runner) {
@@ -101,6 +107,7 @@ namespace Orly {
 
         /* TODO */
         Indy::Fiber::TRunner::TRunnerCons RunnerCons;
+        std::unique_ptr<Indy::Fiber::TRunner::TStealGroup> SlowStealGroup;
         std::vector<std::unique_ptr<Indy::Fiber::TRunner>> SlowRunnerVec;
         std::vector<std::unique_ptr<std::thread>> SlowRunnerThreadVec;
         std::atomic<size_t> SlowAssignmentCounter;
@@ -184,6 +191,11 @@ namespace Orly {
       /* See <orly/protocol.h>. */
       TMethodResult Try(TServer *server, const Base::TUuid &pov_id, const std::vector<std::string> &fq_name, const TClosure &closure);
 
+      /* See <orly/protocol.h>. */
+      std::vector<TMethodResult> TryBatch(
+          TServer *server, const Base::TUuid &pov_id, const std::vector<std::string> &fq_name, const std::vector<TClosure> &closures,
+          bool atomic);
+
       /* See <orly/protocol.h>. */
       bool RunTestSuite(TServer *server, const std::vector<std::string> &package_name, uint64_t package_version, bool verbose);
 
@@ -228,6 +240,14 @@ namespace Orly {
       /* Stream out. */
       virtual void Write(Io::TBinaryOutputStream &strm) const override;
 
+      /* Run the given closures in order, on one fast runner, against one view of the given pov, and append their
+         results to out.  Every closure reads the pov as it was before the first one ran; only a non-final effect
+         builds on what an earlier closure wrote.  If atomic, their effects commit as one update after the last one
+         has run, or not at all if any of them throws.  Otherwise, each one's effects commit as soon as it has run. */
+      void RunClosures(
+          TServer *server, const Base::TUuid &pov_id, const std::vector<std::string> &fq_name, const TClosure *closures,
+          size_t num_closures, bool atomic, std::vector<TMethodResult> &out);
+
       /* TODO */
       void Cleanup();
 
@@ -65,6 +65,8 @@ Base::TSigmaCalc TSession::TServer::TryWriteCallTimerCalc;
 Base::TSigmaCalc TSession::TServer::TryWalkerConsTimerCalc;
 Base::TSigmaCalc TSession::TServer::TryFetchCountCalc;
 Base::TSigmaCalc TSession::TServer::TryHashHitCountCalc;
+Base::TSigmaCalc TSession::TServer::TryMemoHitCountCalc;
+Base::TSigmaCalc TSession::TServer::TryMemoMissCountCalc;
 Base::TSigmaCalc TSession::TServer::TryWriteSyncHitCalc;
 Base::TSigmaCalc TSession::TServer::TryWriteSyncTimeCalc;
 Base::TSigmaCalc TSession::TServer::TryReadSyncHitCalc;
@@ -0,0 +1,123 @@
+/* <orly/server/session.test.manual.cc>
+
+   Benchmarks saving and re-opening a durable <orly/server/session.h>, counting heap allocations along the way.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/server/session.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include <base/timer.h>
+#include <orly/durable/test_manager.h>
+#include <orly/notification/all.h>
+#include <orly/notification/system_shutdown.h>
+#include <test/kit.h>
+
+using namespace std;
+using namespace Base;
+using namespace chrono;
+using namespace Orly::Durable;
+using namespace Orly::Notification;
+using namespace Orly::Server;
+using namespace Orly::Indy;
+using namespace Orly::Indy::Util;
+
+const Orly::Indy::TMasterContext::TProtocol Orly::Indy::TMasterContext::TProtocol::Protocol;
+const Orly::Indy::TSlaveContext::TProtocol Orly::Indy::TSlaveContext::TProtocol::Protocol;
+
+static const size_t BlockSize = 4096UL * 16;
+
+TPool TUpdate::Pool(sizeof(TUpdate), "Update", 1000000UL);
+TPool TUpdate::TEntry::Pool(sizeof(TUpdate::TEntry), "Entry", 2000000UL);
+Disk::TBufBlock::TPool Disk::TBufBlock::Pool(BlockSize, 20000);
+
+std::mutex       TSession::TServer::TryTimeLock;
+
+Base::TSigmaCalc TSession::TServer::TryReadTimeCalc;
+Base::TSigmaCalc TSession::TServer::TryReadCPUTimeCalc;
+Base::TSigmaCalc TSession::TServer::TryWriteTimeCalc;
+Base::TSigmaCalc TSession::TServer::TryWriteCPUTimeCalc;
+Base::TSigmaCalc TSession::TServer::TryWalkerCountCalc;
+Base::TSigmaCalc TSession::TServer::TryCallCPUTimerCalc;
+Base::TSigmaCalc TSession::TServer::TryReadCallTimerCalc;
+Base::TSigmaCalc TSession::TServer::TryWriteCallTimerCalc;
+Base::TSigmaCalc TSession::TServer::TryWalkerConsTimerCalc;
+Base::TSigmaCalc TSession::TServer::TryFetchCountCalc;
+Base::TSigmaCalc TSession::TServer::TryHashHitCountCalc;
+Base::TSigmaCalc TSession::TServer::TryMemoHitCountCalc;
+Base::TSigmaCalc TSession::TServer::TryMemoMissCountCalc;
+Base::TSigmaCalc TSession::TServer::TryWriteSyncHitCalc;
+Base::TSigmaCalc TSession::TServer::TryWriteSyncTimeCalc;
+Base::TSigmaCalc TSession::TServer::TryReadSyncHitCalc;
+Base::TSigmaCalc TSession::TServer::TryReadSyncTimeCalc;
+
+static const size_t NumOpens = 10000UL;
+
+/* Every heap allocation made by this program. */
+static atomic_size_t NumAllocs(0UL);
+
+void *operator new(size_t size) {
+  ++NumAllocs;
+  void *ptr = malloc(size ? size : 1UL);
+  if (!ptr) {
+    throw bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  free(ptr);
+}
+
+/* Make a session holding the given number of notifications, then re-open and close it NumOpens times.  With no cache,
+   every open loads the session's blob from the manager and every close serializes it again. */
+static void BenchOpen(size_t num_notifications) {
+  auto manager = make_shared<TTestManager>(0);
+  TId id;
+  /* extra */ {
+    auto session = manager->New<TSession>(TUuid::Twister, seconds(60));
+    for (size_t i = 0; i < num_notifications; ++i) {
+      session->InsertNotification(TSystemShutdown::New(seconds(i)));
+    }
+    id = session->GetId();
+  }
+  TTimer timer;
+  const size_t num_allocs_before = NumAllocs;
+  timer.Start();
+  for (size_t i = 0; i < NumOpens; ++i) {
+    auto session = manager->Open<TSession>(id);
+    EXPECT_TRUE(session);
+  }
+  timer.Stop();
+  const size_t num_allocs = NumAllocs - num_allocs_before;
+  cout << "notifications = " << num_notifications
+       << ", open + close = " << (duration_cast<duration<double, micro>>(timer.GetTotal()).count() / NumOpens) << " us"
+       << ", allocs = " << (static_cast<double>(num_allocs) / NumOpens) << endl;
+}
+
+FIXTURE(OpenSession) {
+  cout << endl;
+  for (size_t num_notifications : { 0UL, 10UL, 100UL, 1000UL }) {
+    BenchOpen(num_notifications);
+  }
+}
@@ -0,0 +1,55 @@
+/* <orly/server/update_batch.cc>
+
+   Implements <orly/server/update_batch.h>.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <orly/server/update_batch.h>
+
+#include <alloca.h>
+
+using namespace std;
+using namespace Base;
+using namespace Orly;
+using namespace Orly::Server;
+
+void TUpdateBatch::Add(const Indy::TUpdate::TOpByKey &op_by_key, const TUuid &update_id, TMetaRecord::TEntry &&entry) {
+  assert(this);
+  assert(&op_by_key);
+  for (const auto &item: op_by_key) {
+    OpByKey[item.first] = item.second;
+  }
+  MetaRecord.AddEntry(update_id, move(entry));
+  if (!UpdateId) {
+    UpdateId = update_id;
+  }
+}
+
+void TUpdateBatch::Commit(Indy::L1::TManager *manager, const Indy::L0::TManager::TPtr<Indy::TRepo> &repo) {
+  assert(this);
+  assert(manager);
+  assert(!IsEmpty());
+  void *state_alloc_1 = alloca(Sabot::State::GetMaxStateSize() * 2);
+  void *state_alloc_2 = reinterpret_cast<uint8_t *>(state_alloc_1) + Sabot::State::GetMaxStateSize();
+  Atom::TSuprena arena;
+  auto update = Indy::TUpdate::NewUpdate(OpByKey, Indy::TKey(MetaRecord, &arena, state_alloc_1), Indy::TKey(*UpdateId, &arena, state_alloc_2));
+  auto transaction = manager->NewTransaction();
+  transaction->Push(repo, update);
+  transaction->Prepare();
+  transaction->CommitAction();
+  OpByKey.clear();
+  MetaRecord = TMetaRecord();
+  UpdateId.Reset();
+}
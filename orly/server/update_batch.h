@@ -0,0 +1,75 @@
+/* <orly/server/update_batch.h>
+
+   The effects of several method calls, folded into one update.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#pragma once
+
+#include <cassert>
+
+#include <base/class_traits.h>
+#include <base/opt.h>
+#include <base/uuid.h>
+#include <orly/atom/suprena.h>
+#include <orly/indy/transaction_base.h>
+#include <orly/indy/update.h>
+#include <orly/server/meta_record.h>
+
+namespace Orly {
+
+  namespace Server {
+
+    /* The effects of several method calls against one repo, folded into one update so that they commit with a single
+       push.  A transaction takes at most one push per repo, so this is how an atomic batch of calls commits.
+       Each call keeps its own update id in the meta record, so tetris re-tests each call's assertions on its own and
+       each call's tracker hears about its progress. */
+    class TUpdateBatch {
+      NO_COPY(TUpdateBatch);
+      public:
+
+      /* Start out empty. */
+      TUpdateBatch() {}
+
+      /* Fold in one call's ops and meta record entry.  Where an earlier call wrote the same key, this call's op
+         replaces it.  The ops must stay valid until Commit(). */
+      void Add(const Indy::TUpdate::TOpByKey &op_by_key, const Base::TUuid &update_id, TMetaRecord::TEntry &&entry);
+
+      /* Push everything folded in so far to the given repo in a single update, and commit it.  The update takes the
+         first call's id.  This empties the batch.  The batch must not be empty. */
+      void Commit(Indy::L1::TManager *manager, const Indy::L0::TManager::TPtr<Indy::TRepo> &repo);
+
+      /* True iff. nothing has been added since we were constructed or last committed. */
+      bool IsEmpty() const {
+        assert(this);
+        return !UpdateId;
+      }
+
+      private:
+
+      /* The ops of all the calls, the later ones winning. */
+      Indy::TUpdate::TOpByKey OpByKey;
+
+      /* An entry for each call, by the call's update id. */
+      TMetaRecord MetaRecord;
+
+      /* The first call's update id, or unknown if we're empty. */
+      Base::TOpt<Base::TUuid> UpdateId;
+
+    };  // TUpdateBatch
+
+  }  // Server
+
+}  // Orly
@@ -18,7 +18,14 @@
 
 #include <rpc/rpc.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <limits.h>
 #include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <base/debug_log.h>
 #include <base/no_default_case.h>
@@ -31,14 +38,70 @@ using namespace Io;
 using namespace Rpc;
 using namespace Util;
 
+/* Write everything described by the given vector, however many calls it takes.  The vector is consumed. */
+static void WriteIoVecs(int fd, iovec *iov, size_t count) {
+  assert(iov || !count);
+  while (count) {
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    /* Use sendmsg() where we can, to suppress SIGPIPE. */
+    ssize_t size = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (size < 0 && errno == ENOTSOCK) {
+      size = writev(fd, iov, count);
+    }
+    size_t left = IfLt0(size);
+    while (count && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+}
+
 TContext::TUnexpectedResult::TUnexpectedResult()
     : runtime_error("unexpected result") {}
 
 TContext::TSyntaxError::TSyntaxError()
     : runtime_error("syntax error") {}
 
+TContext::TBrokenConnection::TBrokenConnection()
+    : runtime_error("broken connection") {}
+
 TContext::~TContext() {}
 
+TContext::TContext(const TProtocol &protocol, int fd, size_t slot_count)
+    : TContext(protocol) {
+  assert(fd >= 0);
+  assert(slot_count);
+  size_t capacity = 1;
+  while (capacity < slot_count) {
+    capacity *= 2;
+  }
+  if (capacity > UINT32_MAX / 2) {
+    DEFINE_ERROR(error_t, invalid_argument, "rpc; too many slots");
+    THROW_ERROR(error_t) << slot_count;
+  }
+  Slots.reset(new TSlot[capacity]);
+  for (size_t i = 0; i < capacity; ++i) {
+    Slots[i].RequestId = NoRequestId;
+  }
+  SlotMask = capacity - 1;
+  Fd = fd;
+  /* A message buffer for each slot, so a full table of requests can be in flight at once.  Replies borrow from the
+     same buffers. */
+  OutMsgs.reserve(capacity);
+  for (size_t i = 0; i < capacity; ++i) {
+    OutMsgs.emplace_back(new TOutMsg(i));
+    ReleaseOutMsg(OutMsgs.back().get());
+  }
+}
+
 shared_ptr<const TAnyRequest> TContext::Read() {
   assert(this);
   TBinaryIoStream &strm = GetBinaryIoStream();
@@ -74,6 +137,31 @@ shared_ptr<const TAnyRequest> TContext::Read() {
 
 void TContext::FailAllFutures(const string &error_msg) {
   assert(this);
+  if (Slots) {
+    for (size_t i = 0; i <= SlotMask; ++i) {
+      TSlot &slot = Slots[i];
+      for (;;) {
+        TRequestId request_id = slot.RequestId.load();
+        if (request_id == NoRequestId) {
+          break;
+        }
+        /* Another thread is filling or emptying the slot.  It won't be long. */
+        if (request_id == BusyRequestId) {
+          this_thread::yield();
+          continue;
+        }
+        if (slot.RequestId.compare_exchange_weak(request_id, BusyRequestId)) {
+          auto future = move(slot.Future);
+          slot.RequestId = NoRequestId;
+          --PendingCount;
+          string my_error = error_msg;
+          future->SetErrorResult(my_error);
+          break;
+        }
+      }
+    }
+    return;
+  }
   lock_guard<mutex> lock(FutureByRequestIdMutex);
   for (const auto &iter: FutureByRequestId) {
     string my_error = error_msg;
@@ -81,8 +169,192 @@ void TContext::FailAllFutures(const string &error_msg) {
   }
 }
 
+TContext::TOutMsg::TOutMsg(uint32_t idx)
+    : Idx(idx), ChunkList(make_shared<TChunkList>()), Strm(ChunkList, make_shared<TPool>(TPool::TArgs(4096))), Next(0) {}
+
+void TContext::TChunkList::ConsumeOutput(const shared_ptr<const TChunk> &chunk) {
+  assert(this);
+  assert(chunk);
+  Chunks.push_back(chunk);
+}
+
+TRequestId TContext::ClaimSlot(const shared_ptr<TAnyFuture> &future) {
+  assert(this);
+  assert(Slots);
+  assert(future);
+  for (size_t miss_count = 0; ; ++miss_count) {
+    if (IsBroken) {
+      throw TBrokenConnection();
+    }
+    TRequestId request_id = NextRequestId++;
+    if (request_id == NoRequestId || request_id == BusyRequestId) {
+      continue;
+    }
+    /* Ids come around to the same slot once per lap of the table.  A slot still occupied from the last lap holds a
+       slow request, so just take the next id. */
+    TSlot &slot = Slots[request_id & SlotMask];
+    TRequestId expected = NoRequestId;
+    if (slot.RequestId.compare_exchange_strong(expected, BusyRequestId)) {
+      slot.Future = future;
+      ++PendingCount;
+      slot.RequestId = request_id;
+      return request_id;
+    }
+    /* We've been all the way around without finding a free slot, so wait for results to come in. */
+    if (miss_count > SlotMask) {
+      this_thread::yield();
+      miss_count = 0;
+    }
+  }
+}
+
+void TContext::ReleaseSlot(TRequestId request_id) {
+  assert(this);
+  try {
+    PopFuture(request_id);
+  } catch (const TUnexpectedResult &) {
+    /* FailAllFutures() got there first. */
+  }
+}
+
+TContext::TOutMsg *TContext::AcquireOutMsg() {
+  assert(this);
+  for (;;) {
+    if (IsBroken) {
+      throw TBrokenConnection();
+    }
+    uint64_t top = FreeOutMsgs.load();
+    uint32_t idx = static_cast<uint32_t>(top);
+    if (idx) {
+      TOutMsg *out_msg = OutMsgs[idx - 1].get();
+      uint64_t next = ((top >> 32) + 1) << 32 | out_msg->Next.load(memory_order_relaxed);
+      if (FreeOutMsgs.compare_exchange_weak(top, next)) {
+        return out_msg;
+      }
+      continue;
+    }
+    /* Every buffer is queued or being written.  Help write them, or at least let the writer run. */
+    WriteQueuedOutMsgs();
+    this_thread::yield();
+  }
+}
+
+void TContext::QueueOutMsg(TOutMsg *out_msg) {
+  assert(this);
+  assert(out_msg);
+  uint32_t top = QueuedOutMsgs.load();
+  do {
+    out_msg->Next.store(top, memory_order_relaxed);
+  } while (!QueuedOutMsgs.compare_exchange_weak(top, out_msg->Idx + 1));
+}
+
+void TContext::ReleaseOutMsg(TOutMsg *out_msg) {
+  assert(this);
+  assert(out_msg);
+  assert(out_msg->ChunkList->Chunks.empty());
+  uint64_t top = FreeOutMsgs.load();
+  uint64_t next;
+  do {
+    out_msg->Next.store(static_cast<uint32_t>(top), memory_order_relaxed);
+    next = ((top >> 32) + 1) << 32 | (out_msg->Idx + 1);
+  } while (!FreeOutMsgs.compare_exchange_weak(top, next));
+}
+
+void TContext::DropQueuedOutMsgs() {
+  assert(this);
+  for (uint32_t idx = QueuedOutMsgs.exchange(0); idx; ) {
+    TOutMsg *out_msg = OutMsgs[idx - 1].get();
+    idx = out_msg->Next.load(memory_order_relaxed);
+    out_msg->ChunkList->Chunks.clear();
+    ReleaseOutMsg(out_msg);
+  }
+}
+
+void TContext::WriteQueuedOutMsgs() {
+  assert(this);
+  /* If another thread is writing, it checks the queue again after it stops, so our messages won't be stranded. */
+  while (!IsWriting.exchange(true)) {
+    if (IsBroken) {
+      DropQueuedOutMsgs();
+      IsWriting = false;
+      throw TBrokenConnection();
+    }
+    try {
+      for (;;) {
+        uint32_t top = QueuedOutMsgs.exchange(0);
+        if (!top) {
+          break;
+        }
+        /* The most recently queued message is on top, so reverse the stack to write in the order queued. */
+        for (uint32_t idx = top; idx; idx = OutMsgs[idx - 1]->Next.load(memory_order_relaxed)) {
+          WriteBatch.push_back(OutMsgs[idx - 1].get());
+        }
+        reverse(WriteBatch.begin(), WriteBatch.end());
+        for (TOutMsg *out_msg: WriteBatch) {
+          for (const auto &chunk: out_msg->ChunkList->Chunks) {
+            const char *start, *limit;
+            chunk->GetData(start, limit);
+            IoVecs.push_back({ const_cast<char *>(start), static_cast<size_t>(limit - start) });
+            if (IoVecs.size() == IOV_MAX) {
+              WriteIoVecs(Fd, IoVecs.data(), IoVecs.size());
+              IoVecs.clear();
+            }
+          }
+        }
+        WriteIoVecs(Fd, IoVecs.data(), IoVecs.size());
+        IoVecs.clear();
+        for (TOutMsg *out_msg: WriteBatch) {
+          out_msg->ChunkList->Chunks.clear();
+          ReleaseOutMsg(out_msg);
+        }
+        WriteBatch.clear();
+      }
+    } catch (...) {
+      /* The connection is broken, so drop what we were writing and whatever else is queued.  Mark it broken first, so
+         any writer still claiming a slot either gives up or has its future failed below. */
+      IsBroken = true;
+      IoVecs.clear();
+      for (TOutMsg *out_msg: WriteBatch) {
+        out_msg->ChunkList->Chunks.clear();
+        ReleaseOutMsg(out_msg);
+      }
+      WriteBatch.clear();
+      DropQueuedOutMsgs();
+      IsWriting = false;
+      FailAllFutures(TBrokenConnection().what());
+      throw;
+    }
+    IsWriting = false;
+    if (!QueuedOutMsgs.load()) {
+      break;
+    }
+  }
+}
+
 shared_ptr<TAnyFuture> TContext::PopFuture(TRequestId request_id) {
   assert(this);
+  if (Slots) {
+    if (request_id == NoRequestId || request_id == BusyRequestId) {
+      throw TUnexpectedResult();
+    }
+    TSlot &slot = Slots[request_id & SlotMask];
+    for (;;) {
+      TRequestId expected = request_id;
+      if (slot.RequestId.compare_exchange_weak(expected, BusyRequestId)) {
+        break;
+      }
+      /* FailAllFutures() is looking at this slot. */
+      if (expected == BusyRequestId) {
+        this_thread::yield();
+      } else if (expected != request_id) {
+        throw TUnexpectedResult();
+      }
+    }
+    auto future = move(slot.Future);
+    slot.RequestId = NoRequestId;
+    --PendingCount;
+    return future;
+  }
   lock_guard<mutex> lock(FutureByRequestIdMutex);
   auto iter = FutureByRequestId.find(request_id);
   if (iter == FutureByRequestId.end()) {
@@ -145,6 +417,22 @@ void TAnyFuture::SetErrorResult(string &error_msg) {
   SetResultStatus(ErrorResult);
 }
 
+void TAnyFuture::Reset() {
+  assert(this);
+  /* Drain the eventfd, unless Sync() already has. */
+  pollfd temp;
+  temp.fd = EventFd;
+  temp.events = POLLIN;
+  temp.revents = 0;
+  IfLt0(poll(&temp, 1, 0));
+  if (temp.revents & POLLIN) {
+    eventfd_t dummy;
+    IfLt0(eventfd_read(EventFd, &dummy));
+  }
+  ErrorMsg.clear();
+  ResultStatus.store(NoResult, std::memory_order_relaxed);
+}
+
 void TAnyFuture::SetResultStatus(TResultStatus result_status) {
   assert(this);
   assert(result_status != NoResult);
@@ -159,7 +447,6 @@ void TAnyRequest::WriteError(TBinaryOutputStream &strm, TRequestId request_id, c
   assert(&strm);
   assert(&ex);
   strm << ErrorResultIntroducer << request_id << ex.what();
-  strm.Flush();
 }
 
 TAnyEntry::~TAnyEntry() {}
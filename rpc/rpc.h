@@ -15,6 +15,7 @@
       * keeps its binary I/O stream alive (shared pointer)
       * keeps pending futures alive (shared pointers)
       * is kept alive by pending requests (shared pointers)
+      * optionally runs in high-throughput mode (see below)
 
    Future (base class with final template; shared reference types)
       * a value to be computed remotely
@@ -40,6 +41,15 @@
       * maps unique numbers to entries
       * to be constructed as a constant in the data segment
 
+   HIGH-THROUGHPUT MODE
+
+      A context constructed with an fd and a slot count trades a little memory for fewer locks and syscalls when
+      many threads write requests at once:
+      * pending futures live in a fixed-capacity table, indexed by request id and claimed with compare-and-swap
+      * futures are recycled through a per-thread pool, so a request doesn't cost a new eventfd
+      * outbound messages are serialized in the writing thread, queued without locks, and whichever thread finds
+        the connection idle writes everything queued with a single writev()
+
    EXAMPLE
 
       class TMathService
@@ -100,14 +110,18 @@
 #include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
+#include <vector>
 
 #include <sys/eventfd.h>
+#include <sys/uio.h>
 
 #include <base/class_traits.h>
 #include <base/fd.h>
 #include <io/binary_io_stream.h>
+#include <io/binary_output_only_stream.h>
 #include <rpc/unpack.h>
 
 namespace Rpc {
@@ -117,6 +131,8 @@ namespace Rpc {
   class TAnyFuture;
   template <typename TVar>
   class TFuture;
+  template <typename TVal>
+  class TFuturePool;
   class TAnyRequest;
   template <typename TSomeContext, typename TRet, typename... TArgs>
   class TRequest;
@@ -168,6 +184,16 @@ namespace Rpc {
 
     };  // TSyntaxError
 
+    /* Thrown in high-throughput mode when we try to write after a write to our partner has failed. */
+    class TBrokenConnection
+        : public std::runtime_error {
+      public:
+
+      /* Do-little. */
+      TBrokenConnection();
+
+    };  // TBrokenConnection
+
     /* Do-little. */
     virtual ~TContext();
 
@@ -184,9 +210,18 @@ namespace Rpc {
       return Protocol;
     }
 
+    /* True iff. we were constructed in high-throughput mode. */
+    bool IsHighThroughput() const {
+      assert(this);
+      return Slots != nullptr;
+    }
+
     /* True iff. all requests returned by Read() have been handled and we are not waiting for any replies. */
     bool IsIdle() {
       assert(this);
+      if (Slots) {
+        return PendingCount == 0 && UnhandledRequestCount == 0;
+      }
       std::lock_guard<std::mutex> lock(FutureByRequestIdMutex);
       return FutureByRequestId.empty() && UnhandledRequestCount == 0;
     }
@@ -207,9 +242,16 @@ namespace Rpc {
     /* Cache the reference to our protocol and the shared pointer to our connection.
        The connection pointer may be null. */
     TContext(const TProtocol &protocol)
-        : Protocol(protocol), NextRequestId(1), UnhandledRequestCount(0) {}
+        : Protocol(protocol), NextRequestId(1), UnhandledRequestCount(0), SlotMask(0), PendingCount(0), Fd(-1),
+          QueuedOutMsgs(0), FreeOutMsgs(0), IsWriting(false), IsBroken(false) {}
+
+    /* Construct in high-throughput mode.  We write directly to the given fd, which must be the one underneath our
+       binary I/O stream and must stay open as long as we do.  At most slot_count requests may await results at
+       once; a writer finding no free slot waits for one.  The slot count is rounded up to a power of two. */
+    TContext(const TProtocol &protocol, int fd, size_t slot_count);
 
-    /* TODO */
+    /* Set an error result in each future still awaiting a result.
+       In high-throughput mode, this also frees their slots, so a result arriving for one of them later is unexpected. */
     void FailAllFutures(const std::string &error_msg);
 
     /* See accessor. */
@@ -217,6 +259,92 @@ namespace Rpc {
 
     private:
 
+    /* A place in the high-throughput table of pending requests. */
+    struct TSlot {
+
+      /* The id of the pending request, NoRequestId if the slot is free, or BusyRequestId while a thread is filling
+         or emptying it. */
+      std::atomic<TRequestId> RequestId;
+
+      /* The future which will accept the result.  Only the thread which set RequestId to BusyRequestId may touch this. */
+      std::shared_ptr<TAnyFuture> Future;
+
+    };  // TSlot
+
+    /* Collects the chunks of a message serialized in high-throughput mode, as its stream fills them. */
+    class TChunkList
+        : public Io::TOutputConsumer {
+      NO_COPY(TChunkList);
+      public:
+
+      /* Do-little. */
+      TChunkList() {}
+
+      /* See base class. */
+      virtual void ConsumeOutput(const std::shared_ptr<const Io::TChunk> &chunk) override;
+
+      /* The chunks we have been given, in order. */
+      std::vector<std::shared_ptr<const Io::TChunk>> Chunks;
+
+    };  // TChunkList
+
+    /* A buffer for one outbound message in high-throughput mode.
+       A message is only ever held by one thread at a time: the one serializing into it, or the one writing it. */
+    class TOutMsg {
+      NO_COPY(TOutMsg);
+      public:
+
+      /* Make an empty message with its own pool of chunks. */
+      explicit TOutMsg(uint32_t idx);
+
+      /* Our index in TContext::OutMsgs. */
+      const uint32_t Idx;
+
+      /* The chunks serialized so far. */
+      std::shared_ptr<TChunkList> ChunkList;
+
+      /* Serializes into ChunkList. */
+      Io::TBinaryOutputOnlyStream Strm;
+
+      /* One more than the index of the next message in whichever list we're on, or zero at the end of the list. */
+      std::atomic<uint32_t> Next;
+
+    };  // TOutMsg
+
+    /* Request ids which never go over the wire.  See TSlot. */
+    static const TRequestId NoRequestId = 0, BusyRequestId = UINT32_MAX;
+
+    /* Serialize a message with the given writer and send it to our partner. */
+    template <typename TWriter>
+    void WriteMessage(const TWriter &writer);
+
+    /* Find a free slot in the high-throughput table, park the future in it and return the request id.
+       Throw TBrokenConnection if the connection breaks, whether before or while we wait for a slot. */
+    TRequestId ClaimSlot(const std::shared_ptr<TAnyFuture> &future);
+
+    /* Give up the slot claimed for the given request, if FailAllFutures() hasn't already emptied it. */
+    void ReleaseSlot(TRequestId request_id);
+
+    /* Take a message buffer from the free list, waiting for one if necessary.
+       Throw TBrokenConnection if the connection breaks, whether before or while we wait for a buffer. */
+    TOutMsg *AcquireOutMsg();
+
+    /* Put a message buffer on the queue to be written. */
+    void QueueOutMsg(TOutMsg *out_msg);
+
+    /* Put a message buffer back on the free list.  Its chunks have already been dropped. */
+    void ReleaseOutMsg(TOutMsg *out_msg);
+
+    /* Put every queued message buffer back on the free list without writing it.  Only the thread which set
+       IsWriting may call this. */
+    void DropQueuedOutMsgs();
+
+    /* If no other thread is writing to our fd, write everything queued, and keep writing until the queue is empty.
+       If another thread is already writing, it will pick up whatever we queued, so return right away.
+       If a write fails, mark the connection broken, drop everything queued, fail every pending future, and throw.
+       Once the connection is broken, drop whatever is queued and throw TBrokenConnection. */
+    void WriteQueuedOutMsgs();
+
     /* Find the future associated with the request id, erase it from our map, and return it.
        If there is no such future, throw TUnexpectedResult. */
     std::shared_ptr<TAnyFuture> PopFuture(TRequestId request_id);
@@ -224,11 +352,11 @@ namespace Rpc {
     /* See accessor. */
     const TProtocol &Protocol;
 
-    /* Covers NextRequestId and FutureByRequestId. */
+    /* Covers FutureByRequestId. */
     std::mutex FutureByRequestIdMutex;
 
     /* The id we will use the next time we write a request to our partner. */
-    TRequestId NextRequestId;
+    std::atomic<TRequestId> NextRequestId;
 
     /* Each id in this map is a request for which we expect to receive a result.
        The associated future will accept that result when it arrives. */
@@ -240,7 +368,42 @@ namespace Rpc {
     /* A lock to prevent multiple writers to the outstream. */
     std::recursive_mutex WriteLock;
 
-    /* For access to WriteLock. */
+    /* The high-throughput table of pending requests, indexed by request id masked with SlotMask.  Null unless we're
+       in high-throughput mode. */
+    std::unique_ptr<TSlot[]> Slots;
+
+    /* One less than the number of slots. */
+    TRequestId SlotMask;
+
+    /* The number of occupied slots. */
+    std::atomic_size_t PendingCount;
+
+    /* The fd we write to in high-throughput mode. */
+    int Fd;
+
+    /* The message buffers used in high-throughput mode.  These are threaded onto the two lists below. */
+    std::vector<std::unique_ptr<TOutMsg>> OutMsgs;
+
+    /* A stack of messages waiting to be written, as one more than the index of the most recently queued, or zero if
+       the stack is empty.  The writer takes the whole stack at once and reverses it. */
+    std::atomic<uint32_t> QueuedOutMsgs;
+
+    /* A stack of free message buffers.  The low 32 bits are one more than the index of the top buffer, or zero if the
+       stack is empty.  The high 32 bits count changes to the stack, so a thread which pops after a stale read fails
+       its compare-and-swap. */
+    std::atomic<uint64_t> FreeOutMsgs;
+
+    /* True while a thread is writing queued messages to our fd. */
+    std::atomic_bool IsWriting;
+
+    /* True once a write to our fd has failed.  After that, nothing more goes out. */
+    std::atomic_bool IsBroken;
+
+    /* Scratch space for WriteQueuedOutMsgs().  Only the thread which set IsWriting may touch these. */
+    std::vector<TOutMsg *> WriteBatch;
+    std::vector<iovec> IoVecs;
+
+    /* For access to WriteMessage(). */
     friend class TAnyRequest;
 
   };  // TContext
@@ -312,6 +475,9 @@ namespace Rpc {
        If is an error to call this function if ResultStatus != NoResult. */
     void SetResultStatus(TResultStatus result_status);
 
+    /* Go back to having no result, so TFuturePool<> can hand us out again. */
+    virtual void Reset();
+
     private:
 
     /* See accessor. */
@@ -366,9 +532,19 @@ namespace Rpc {
       SetResultStatus(NormalResult);
     }
 
+    /* See base class.  Also drops the old value. */
+    virtual void Reset() override {
+      assert(this);
+      TAnyFuture::Reset();
+      Val = TVal();
+    }
+
     /* See Get(). */
     TVal Val;
 
+    /* For Reset(). */
+    friend class TFuturePool<TVal>;
+
   };  // TFuture<TVal>
 
   /* Explicit specialization to handle void returns.
@@ -390,12 +566,133 @@ namespace Rpc {
       SetResultStatus(NormalResult);
     }
 
+    /* For Reset(). */
+    friend class TFuturePool<void>;
+
   };  // TFuture<void>
 
+  /* A per-thread cache of idle futures of one type, used by contexts in high-throughput mode.
+     A future we hand out comes back to the pool of whichever thread lets go of it last. */
+  template <typename TVal>
+  class TFuturePool {
+    NO_COPY(TFuturePool);
+    public:
+
+    /* Return a future awaiting its result, recycled if possible. */
+    static std::shared_ptr<TFuture<TVal>> New() {
+      TFuture<TVal> *future = nullptr;
+      if (IsAlive) {
+        auto &futures = GetPool().Futures;
+        if (!futures.empty()) {
+          future = futures.back();
+          futures.pop_back();
+        }
+      }
+      if (!future) {
+        future = new TFuture<TVal>();
+      }
+      try {
+        return std::shared_ptr<TFuture<TVal>>(future, OnRelease);
+      } catch (...) {
+        delete future;
+        throw;
+      }
+    }
+
+    /* The most futures a thread will keep idle. */
+    static const size_t MaxSize = 256;
+
+    private:
+
+    /* Do-little. */
+    TFuturePool() {}
+
+    /* Deletes the idle futures. */
+    ~TFuturePool() {
+      assert(this);
+      IsAlive = false;
+      for (auto *future: Futures) {
+        delete future;
+      }
+    }
+
+    /* Called when the last shared pointer to one of our futures goes away.
+       Keep the future for reuse if this thread's pool still exists and has room. */
+    static void OnRelease(TFuture<TVal> *future) {
+      assert(future);
+      if (IsAlive) {
+        auto &futures = GetPool().Futures;
+        if (futures.size() < MaxSize) {
+          try {
+            future->Reset();
+            futures.push_back(future);
+            return;
+          } catch (...) {}
+        }
+      }
+      delete future;
+    }
+
+    /* This thread's pool. */
+    static TFuturePool &GetPool() {
+      static thread_local TFuturePool pool;
+      return pool;
+    }
+
+    /* False once this thread's pool has been destroyed. */
+    static thread_local bool IsAlive;
+
+    /* Idle futures, ready to be handed out. */
+    std::vector<TFuture<TVal> *> Futures;
+
+  };  // TFuturePool<TVal>
+
+  /* See declaration. */
+  template <typename TVal>
+  thread_local bool TFuturePool<TVal>::IsAlive = true;
+
+  /* See declaration. */
+  template <typename TWriter>
+  void TContext::WriteMessage(const TWriter &writer) {
+    assert(this);
+    assert(&writer);
+    if (!Slots) {
+      std::lock_guard<std::recursive_mutex> lock(WriteLock);
+      Io::TBinaryIoStream &strm = GetBinaryIoStream();
+      writer(strm);
+      strm.Flush();
+      return;
+    }
+    TOutMsg *out_msg = AcquireOutMsg();
+    try {
+      writer(out_msg->Strm);
+      out_msg->Strm.Flush();
+    } catch (...) {
+      out_msg->ChunkList->Chunks.clear();
+      ReleaseOutMsg(out_msg);
+      throw;
+    }
+    QueueOutMsg(out_msg);
+    WriteQueuedOutMsgs();
+  }
+
   /* See declaration. */
   template <typename TRet, typename... TArgs>
   std::shared_ptr<TFuture<TRet>> TContext::Write(TEntryId entry_id, TArgs &&... args) {
     assert(this);
+    if (Slots) {
+      auto future = TFuturePool<TRet>::New();
+      TRequestId request_id = ClaimSlot(future);
+      try {
+        WriteMessage([&](Io::TBinaryOutputStream &strm) {
+          strm << RequestIntroducer << request_id << entry_id << std::forward_as_tuple(args...);
+        });
+      } catch (...) {
+        ReleaseSlot(request_id);
+        throw;
+      }
+      return future;
+    }
     Io::TBinaryIoStream &strm = GetBinaryIoStream();
     std::pair<TRequestId, std::shared_ptr<TFuture<TRet>>> item;
     item.second = std::make_shared<TFuture<TRet>>();
@@ -444,51 +741,52 @@ namespace Rpc {
     TAnyRequest(TRequestId id)
         : Id(id) {}
 
-    /* Write an error reply to the given stream such that it can be parsed by TMessageHandler::ReadMessage(). */
+    /* Write an error reply to the given stream such that it can be parsed by TMessageHandler::ReadMessage().
+       The caller flushes. */
     static void WriteError(Io::TBinaryOutputStream &strm, TRequestId request_id, const std::exception &ex);
 
-    /* Write a non-void, non-error reply to the given stream such that it can be parsed by TMessageHandler::ReadMessage(). */
+    /* Write a non-void, non-error reply to the context's partner such that it can be parsed by TMessageHandler::ReadMessage(). */
     template <typename TSomeContext, typename TRet, typename... TArgs>
     static void WriteReply(
-        Io::TBinaryOutputStream &strm, TRequestId request_id, TSomeContext *context,
+        TRequestId request_id, TSomeContext *context,
         TRet (TSomeContext::*handler)(typename Pass<TArgs>::type...), const std::tuple<TArgs...> &args) {
-      assert(&strm);
       assert(context);
       assert(&args);
       TRet ret;
       try {
         ret = Unpack(handler, context, args);
       } catch (const std::exception &ex) {
-        std::lock_guard<std::recursive_mutex> lock(context->WriteLock);
-        WriteError(strm, request_id, ex);
+        context->WriteMessage([&](Io::TBinaryOutputStream &strm) {
+          WriteError(strm, request_id, ex);
+        });
         --(context->UnhandledRequestCount);
         return;
       }
-      std::lock_guard<std::recursive_mutex> lock(context->WriteLock);
-      strm << NormalResultIntroducer << request_id << ret;
-      strm.Flush();
+      context->WriteMessage([&](Io::TBinaryOutputStream &strm) {
+        strm << NormalResultIntroducer << request_id << ret;
+      });
       --(context->UnhandledRequestCount);
     }
 
-    /* Write a void, non-error reply to the given stream such that it can be parsed by TMessageHandler::ReadMessage(). */
+    /* Write a void, non-error reply to the context's partner such that it can be parsed by TMessageHandler::ReadMessage(). */
     template <typename TSomeContext, typename... TArgs>
     static void WriteReply(
-        Io::TBinaryOutputStream &strm, TRequestId request_id, TSomeContext *context,
+        TRequestId request_id, TSomeContext *context,
         void (TSomeContext::*handler)(typename Pass<TArgs>::type...), const std::tuple<TArgs...> &args) {
-      assert(&strm);
       assert(context);
       assert(&args);
       try {
         Unpack(handler, context, args);
       } catch (const std::exception &ex) {
-        std::lock_guard<std::recursive_mutex> lock(context->WriteLock);
-        WriteError(strm, request_id, ex);
+        context->WriteMessage([&](Io::TBinaryOutputStream &strm) {
+          WriteError(strm, request_id, ex);
+        });
         --(context->UnhandledRequestCount);
         return;
       }
-      std::lock_guard<std::recursive_mutex> lock(context->WriteLock);
-      strm << NormalResultIntroducer << request_id;
-      strm.Flush();
+      context->WriteMessage([&](Io::TBinaryOutputStream &strm) {
+        strm << NormalResultIntroducer << request_id;
+      });
       --(context->UnhandledRequestCount);
     }
 
@@ -520,7 +818,7 @@ namespace Rpc {
     /* See base class. */
     virtual void operator()() const {
       assert(this);
-      WriteReply(Context->GetBinaryIoStream(), GetId(), Context.get(), Handler, Args);
+      WriteReply(GetId(), Context.get(), Handler, Args);
     }
 
     private:
@@ -106,10 +106,19 @@ class TMathContext
     BinaryIoStream = make_shared<TBinaryIoStream>(Device);
   }
 
+  TMathContext(Base::TFd &&fd, size_t slot_count)
+      : TContext(TProtocol::Protocol, fd, slot_count), Device(make_shared<TDevice>(move(fd))) {
+    BinaryIoStream = make_shared<TBinaryIoStream>(Device);
+  }
+
   void Shutdown() {
     IfLt0(shutdown(Device->GetFd(), SHUT_WR));
   }
 
+  void Hangup() {
+    IfLt0(shutdown(Device->GetFd(), SHUT_RDWR));
+  }
+
   private:
 
   int Add(int a, int b) {
@@ -155,11 +164,16 @@ class TMathContext
 
 const TMathContext::TProtocol TMathContext::TProtocol::Protocol;
 
-static void MakeMathContexts(shared_ptr<TMathContext> &a, shared_ptr<TMathContext> &b) {
+static void MakeMathContexts(shared_ptr<TMathContext> &a, shared_ptr<TMathContext> &b, size_t slot_count = 0) {
   TFd fd_a, fd_b;
   TFd::SocketPair(fd_a, fd_b, AF_UNIX, SOCK_STREAM, 0);
-  a = make_shared<TMathContext>(move(fd_a));
-  b = make_shared<TMathContext>(move(fd_b));
+  if (slot_count) {
+    a = make_shared<TMathContext>(move(fd_a), slot_count);
+    b = make_shared<TMathContext>(move(fd_b), slot_count);
+  } else {
+    a = make_shared<TMathContext>(move(fd_a));
+    b = make_shared<TMathContext>(move(fd_b));
+  }
 }
 
 FIXTURE(Typical) {
@@ -277,4 +291,108 @@ FIXTURE(LargeReturn) {
   svr->Shutdown();
   bg_cli.join();
   bg_svr.join();
-}
\ No newline at end of file
+}
+
+FIXTURE(HighThroughput) {
+  shared_ptr<TMathContext> a, b;
+  MakeMathContexts(a, b, 4);
+  EXPECT_TRUE(a->IsHighThroughput());
+  EXPECT_TRUE(a->IsIdle());
+  /* More round trips than slots, so slots and pooled futures get reused. */
+  for (int i = 0; i < 10; ++i) {
+    auto future = a->Write<int>(TMathContext::AddId, i, 2);
+    EXPECT_FALSE(*future);
+    EXPECT_FALSE(a->IsIdle());
+    auto request = b->Read();
+    EXPECT_TRUE(request);
+    (*request)();
+    EXPECT_TRUE(b->IsIdle());
+    a->Read();
+    EXPECT_TRUE(*future);
+    EXPECT_EQ(**future, i + 2);
+    EXPECT_TRUE(a->IsIdle());
+  }
+  /* A recycled future must not remember an old error. */
+  for (int i = 0; i < 2; ++i) {
+    auto future = a->Write<double>(TMathContext::DivId, 10.0, i ? 2.0 : 0.0);
+    (*b->Read())();
+    a->Read();
+    bool caught;
+    try {
+      EXPECT_EQ(**future, 5.0);
+      caught = false;
+    } catch (const TAnyFuture::TRemoteError &) {
+      caught = true;
+    }
+    EXPECT_EQ(caught, !i);
+  }
+}
+
+FIXTURE(HighThroughputConcurrent) {
+  static const int NumThreads = 8, NumCalls = 1000;
+  shared_ptr<TMathContext> cli, svr;
+  /* Fewer slots than threads, so writers have to wait for slots to free up. */
+  MakeMathContexts(cli, svr, 4);
+  thread bg_svr(bind(Run, svr)), bg_cli(Run, cli);
+  atomic_int num_wrong(0);
+  vector<thread> writers;
+  for (int i = 0; i < NumThreads; ++i) {
+    writers.emplace_back([&cli, &num_wrong, i] {
+      for (int j = 0; j < NumCalls; ++j) {
+        if (**(cli->Write<int>(TMathContext::AddId, i, j)) != i + j) {
+          ++num_wrong;
+        }
+      }
+    });
+  }
+  for (auto &writer: writers) {
+    writer.join();
+  }
+  EXPECT_EQ(num_wrong, 0);
+  EXPECT_TRUE(**(cli->Write<TSequence>(TMathContext::ConsId, 1UL, 200000UL)) == TSequence(1UL, 200000UL));
+  EXPECT_TRUE(cli->IsIdle());
+  cli->Shutdown();
+  svr->Shutdown();
+  bg_cli.join();
+  bg_svr.join();
+}
+
+FIXTURE(HighThroughputHangup) {
+  static const int NumThreads = 8;
+  shared_ptr<TMathContext> cli, svr;
+  MakeMathContexts(cli, svr, 64);
+  thread bg_svr(bind(Run, svr)), bg_cli(Run, cli);
+  atomic_int num_calls(0);
+  vector<thread> writers;
+  for (int i = 0; i < NumThreads; ++i) {
+    writers.emplace_back([&cli, &num_calls, i] {
+      /* Keep calling until the connection breaks under us, one way or another. */
+      try {
+        for (int j = 0; ; ++j) {
+          **(cli->Write<int>(TMathContext::AddId, i, j));
+          ++num_calls;
+        }
+      } catch (...) {}
+    });
+  }
+  while (num_calls < 100) {
+    this_thread::yield();
+  }
+  svr->Hangup();
+  /* Every writer may be waiting on a result which will never come, so make sure something hits the broken
+     connection.  This either throws or hands its message to the thread which does. */
+  try {
+    cli->Write<int>(TMathContext::AddId, 1, 2);
+  } catch (...) {}
+  for (auto &writer: writers) {
+    writer.join();
+  }
+  bg_cli.join();
+  bg_svr.join();
+  /* No slot was left behind, and nothing more goes out. */
+  EXPECT_TRUE(cli->IsIdle());
+  auto write = [&cli] {
+    cli->Write<int>(TMathContext::AddId, 1, 2);
+  };
+  EXPECT_THROW_FUNC(TContext::TBrokenConnection, write);
+}
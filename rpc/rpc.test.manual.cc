@@ -0,0 +1,154 @@
+/* <rpc/rpc.test.manual.cc>
+
+   Compares the throughput of a locked context and a high-throughput one, with many threads writing requests over a
+   socketpair at once.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include <rpc/rpc.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <io/device.h>
+#include <test/kit.h>
+
+using namespace std;
+using namespace chrono;
+using namespace Base;
+using namespace Io;
+using namespace Rpc;
+using namespace Util;
+
+static constexpr size_t NumCalls = 200000UL;
+static constexpr size_t MaxInFlight = 16UL;
+static constexpr size_t SlotCount = 1024UL;
+
+class TAddContext
+    : public TContext {
+  NO_COPY(TAddContext);
+  public:
+
+  static const Rpc::TEntryId AddId = 1001;
+
+  TAddContext(TFd &&fd)
+      : TContext(TProtocol::Protocol), Device(make_shared<TDevice>(move(fd))) {
+    BinaryIoStream = make_shared<TBinaryIoStream>(Device);
+  }
+
+  TAddContext(TFd &&fd, size_t slot_count)
+      : TContext(TProtocol::Protocol, fd, slot_count), Device(make_shared<TDevice>(move(fd))) {
+    BinaryIoStream = make_shared<TBinaryIoStream>(Device);
+  }
+
+  void Shutdown() {
+    IfLt0(shutdown(Device->GetFd(), SHUT_WR));
+  }
+
+  private:
+
+  int Add(int a, int b) {
+    return a + b;
+  }
+
+  class TProtocol
+      : public Rpc::TProtocol {
+    NO_COPY(TProtocol);
+    public:
+
+    static const TProtocol Protocol;
+
+    private:
+
+    TProtocol() {
+      Register<TAddContext, int, int, int>(AddId, &TAddContext::Add);
+    }
+
+  };  // TProtocol
+
+  shared_ptr<TDevice> Device;
+
+};  // TAddContext
+
+const TAddContext::TProtocol TAddContext::TProtocol::Protocol;
+
+static void Run(shared_ptr<TContext> context) {
+  try {
+    for (;;) {
+      auto request = context->Read();
+      if (request) {
+        (*request)();
+      }
+    }
+  } catch (...) {}
+}
+
+/* Make NumCalls calls spread over the given number of threads, each keeping up to MaxInFlight requests outstanding,
+   and return the calls per second. */
+static double Bench(size_t num_threads, size_t slot_count) {
+  TFd fd_a, fd_b;
+  TFd::SocketPair(fd_a, fd_b, AF_UNIX, SOCK_STREAM, 0);
+  shared_ptr<TAddContext> cli, svr;
+  if (slot_count) {
+    cli = make_shared<TAddContext>(move(fd_a), slot_count);
+    svr = make_shared<TAddContext>(move(fd_b), slot_count);
+  } else {
+    cli = make_shared<TAddContext>(move(fd_a));
+    svr = make_shared<TAddContext>(move(fd_b));
+  }
+  thread bg_svr(bind(Run, svr)), bg_cli(Run, cli);
+  const size_t calls_per_thread = NumCalls / num_threads;
+  auto start = steady_clock::now();
+  vector<thread> writers;
+  for (size_t i = 0; i < num_threads; ++i) {
+    writers.emplace_back([&cli, calls_per_thread] {
+      deque<shared_ptr<TFuture<int>>> in_flight;
+      for (size_t j = 0; j < calls_per_thread; ++j) {
+        if (in_flight.size() == MaxInFlight) {
+          in_flight.front()->Sync();
+          in_flight.pop_front();
+        }
+        in_flight.push_back(cli->Write<int>(TAddContext::AddId, 1, 2));
+      }
+      for (const auto &future: in_flight) {
+        future->Sync();
+      }
+    });
+  }
+  for (auto &writer: writers) {
+    writer.join();
+  }
+  auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+  cli->Shutdown();
+  svr->Shutdown();
+  bg_cli.join();
+  bg_svr.join();
+  return (calls_per_thread * num_threads) / elapsed;
+}
+
+FIXTURE(ConcurrentWriters) {
+  cout << setw(8) << "threads" << setw(16) << "locked / s" << setw(16) << "fast / s" << endl;
+  for (size_t num_threads: { 1UL, 4UL, 16UL, 64UL }) {
+    cout
+        << setw(8) << num_threads << fixed << setprecision(0)
+        << setw(16) << Bench(num_threads, 0)
+        << setw(16) << Bench(num_threads, SlotCount) << endl;
+  }
+}
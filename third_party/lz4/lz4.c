@@ -0,0 +1,214 @@
+/* <third_party/lz4/lz4.c>
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#include "lz4.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/* A block is a run of sequences.  Each sequence is a token byte (literal length in the high nibble, match length - 4 in
+   the low one), more literal length bytes if the nibble is 15, the literals, a 2 byte little-endian offset back into
+   what's already been written, and more match length bytes if that nibble is 15.  The last sequence is literals only.
+   The format requires the last 5 bytes to be literals and the last match to start at least 12 bytes from the end. */
+#define MIN_MATCH 4
+#define LAST_LITERALS 5
+#define MF_LIMIT 12
+#define MAX_OFFSET 65535
+#define RUN_MASK 15
+#define ML_MASK 15
+
+/* The hash table maps 4 byte sequences to where we last saw them, as offsets from the start of the input. */
+#define HASH_LOG 12
+#define HASH_SIZE (1 << HASH_LOG)
+
+/* Kept per thread rather than on the stack, since we may be running on a small fiber stack.  Compression never yields,
+   so a fiber can't be moved to another thread partway through. */
+static __thread uint32_t HashTable[HASH_SIZE];
+
+static uint32_t Read32(const unsigned char *p) {
+  uint32_t val;
+  memcpy(&val, p, sizeof(val));
+  return val;
+}
+
+static uint32_t Hash(uint32_t seq) {
+  return (seq * 2654435761U) >> (32 - HASH_LOG);
+}
+
+/* Write the extra length bytes for a length whose nibble was saturated. */
+static unsigned char *WriteLength(unsigned char *op, size_t len) {
+  for (; len >= 255; len -= 255) {
+    *op++ = 255;
+  }
+  *op++ = (unsigned char)len;
+  return op;
+}
+
+/* Write one sequence: the literals from anchor up to anchor + lit_len, then (if match_len) a match. */
+static unsigned char *WriteSequence(unsigned char *op, const unsigned char *anchor, size_t lit_len, size_t offset, size_t match_len) {
+  unsigned char *token = op++;
+  *token = (unsigned char)((lit_len >= RUN_MASK ? RUN_MASK : lit_len) << 4);
+  if (lit_len >= RUN_MASK) {
+    op = WriteLength(op, lit_len - RUN_MASK);
+  }
+  memcpy(op, anchor, lit_len);
+  op += lit_len;
+  if (match_len) {
+    *op++ = (unsigned char)(offset & 0xFF);
+    *op++ = (unsigned char)(offset >> 8);
+    match_len -= MIN_MATCH;
+    *token |= (unsigned char)(match_len >= ML_MASK ? ML_MASK : match_len);
+    if (match_len >= ML_MASK) {
+      op = WriteLength(op, match_len - ML_MASK);
+    }
+  }
+  return op;
+}
+
+/* The most bytes a sequence with these lengths can take. */
+static size_t GetMaxSequenceSize(size_t lit_len, size_t match_len) {
+  return 1 + (lit_len / 255 + 1) + lit_len + 2 + (match_len / 255 + 1);
+}
+
+int LZ4_compressBound(int inputSize) {
+  return LZ4_COMPRESSBOUND(inputSize);
+}
+
+int LZ4_compress_default(const char *src, char *dst, int srcSize, int dstCapacity) {
+  if (srcSize < 0 || srcSize > LZ4_MAX_INPUT_SIZE || dstCapacity <= 0) {
+    return 0;
+  }
+  const unsigned char *const base = (const unsigned char *)src;
+  const unsigned char *const iend = base + srcSize;
+  const unsigned char *ip = base;
+  const unsigned char *anchor = base;
+  unsigned char *op = (unsigned char *)dst;
+  unsigned char *const oend = op + dstCapacity;
+  if (srcSize >= MF_LIMIT + 1) {
+    const unsigned char *const mf_limit = iend - MF_LIMIT;
+    const unsigned char *const match_limit = iend - LAST_LITERALS;
+    memset(HashTable, 0, sizeof(HashTable));
+    /* the further we go without finding a match, the bigger the steps we take looking for one */
+    unsigned misses = 0;
+    ++ip;
+    while (ip <= mf_limit) {
+      const uint32_t seq = Read32(ip);
+      const uint32_t h = Hash(seq);
+      const unsigned char *ref = base + HashTable[h];
+      HashTable[h] = (uint32_t)(ip - base);
+      if (ref >= ip || ip - ref > MAX_OFFSET || Read32(ref) != seq) {
+        ip += 1 + (misses++ >> 6);
+        continue;
+      }
+      misses = 0;
+      /* stretch the match back over any literals which also match... */
+      while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+        --ip;
+        --ref;
+      }
+      /* ...and forward as far as the format lets us */
+      size_t match_len = MIN_MATCH;
+      while (ip + match_len < match_limit && ip[match_len] == ref[match_len]) {
+        ++match_len;
+      }
+      const size_t lit_len = (size_t)(ip - anchor);
+      if ((size_t)(oend - op) < GetMaxSequenceSize(lit_len, match_len)) {
+        return 0;
+      }
+      op = WriteSequence(op, anchor, lit_len, (size_t)(ip - ref), match_len);
+      ip += match_len;
+      anchor = ip;
+      if (ip <= mf_limit) {
+        /* remember the position just before the next one, so runs get picked up */
+        HashTable[Hash(Read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+      }
+    }
+  }
+  const size_t lit_len = (size_t)(iend - anchor);
+  if ((size_t)(oend - op) < GetMaxSequenceSize(lit_len, 0)) {
+    return 0;
+  }
+  op = WriteSequence(op, anchor, lit_len, 0, 0);
+  return (int)(op - (unsigned char *)dst);
+}
+
+int LZ4_decompress_safe(const char *src, char *dst, int compressedSize, int dstCapacity) {
+  if (compressedSize <= 0 || dstCapacity < 0) {
+    return -1;
+  }
+  const unsigned char *ip = (const unsigned char *)src;
+  const unsigned char *const iend = ip + compressedSize;
+  unsigned char *const obase = (unsigned char *)dst;
+  unsigned char *op = obase;
+  unsigned char *const oend = op + dstCapacity;
+  for (;;) {
+    if (ip >= iend) {
+      return -1;
+    }
+    const unsigned token = *ip++;
+    size_t lit_len = token >> 4;
+    if (lit_len == RUN_MASK) {
+      unsigned s;
+      do {
+        if (ip >= iend) {
+          return -1;
+        }
+        s = *ip++;
+        lit_len += s;
+      } while (s == 255);
+    }
+    if (lit_len > (size_t)(iend - ip) || lit_len > (size_t)(oend - op)) {
+      return -1;
+    }
+    memcpy(op, ip, lit_len);
+    ip += lit_len;
+    op += lit_len;
+    if (ip == iend) {
+      /* the last sequence has no match */
+      break;
+    }
+    if (iend - ip < 2) {
+      return -1;
+    }
+    const size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > (size_t)(op - obase)) {
+      return -1;
+    }
+    size_t match_len = token & ML_MASK;
+    if (match_len == ML_MASK) {
+      unsigned s;
+      do {
+        if (ip >= iend) {
+          return -1;
+        }
+        s = *ip++;
+        match_len += s;
+      } while (s == 255);
+    }
+    match_len += MIN_MATCH;
+    if (match_len > (size_t)(oend - op)) {
+      return -1;
+    }
+    /* the match may overlap what it's writing, so copy a byte at a time */
+    const unsigned char *ref = op - offset;
+    for (size_t i = 0; i < match_len; ++i) {
+      op[i] = ref[i];
+    }
+    op += match_len;
+  }
+  return (int)(op - obase);
+}
@@ -0,0 +1,53 @@
+/* <third_party/lz4/lz4.h>
+
+   A compact implementation of the LZ4 block format, as described in lz4_Block_format.md of the reference LZ4
+   distribution (https://github.com/lz4/lz4).  Blocks written here can be read by the reference LZ4_decompress_safe(), and
+   blocks written by the reference LZ4_compress_default() can be read here.  The functions keep the names and signatures
+   of the reference library, so this header can be swapped for the reference lz4.h without touching the callers.
+
+   Only single blocks are supported: there are no frames, dictionaries, streaming or high compression modes.
+
+   Copyright 2010-2014 OrlyAtomics, Inc.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License. */
+
+#ifndef ORLY_THIRD_PARTY_LZ4_H
+#define ORLY_THIRD_PARTY_LZ4_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The largest input we'll compress. */
+#define LZ4_MAX_INPUT_SIZE 0x7E000000
+
+/* The most bytes compressing the given number of bytes can produce, or 0 if that's more than LZ4_MAX_INPUT_SIZE. */
+#define LZ4_COMPRESSBOUND(isize) ((unsigned)(isize) > (unsigned)LZ4_MAX_INPUT_SIZE ? 0 : (isize) + ((isize) / 255) + 16)
+
+/* See LZ4_COMPRESSBOUND(). */
+int LZ4_compressBound(int inputSize);
+
+/* Compress srcSize bytes from src into dst, which holds dstCapacity bytes.  Returns the number of bytes written, or 0 if
+   they didn't fit.  They always fit if dstCapacity >= LZ4_compressBound(srcSize).  Thread-safe. */
+int LZ4_compress_default(const char *src, char *dst, int srcSize, int dstCapacity);
+
+/* Uncompress a block of compressedSize bytes from src into dst, which holds dstCapacity bytes.  Returns the number of
+   bytes written, or a negative number if the block is malformed or won't fit.  Never reads or writes out of bounds, even
+   for malformed blocks. */
+int LZ4_decompress_safe(const char *src, char *dst, int compressedSize, int dstCapacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+"""Inline every quoted #include of a zstd source file, once each, to make a single translation unit.
+
+usage: python3 combine.py <zstd>/lib zstd.c zstd-in.c
+
+zstd.h and zstd_errors.h are left as includes, since we ship them alongside.  This does what
+build/single_file_libs/combine.sh does in the zstd distribution.
+"""
+import os, re, sys
+root = sys.argv[1]  # zstd/lib
+out_path = sys.argv[2]
+keep = {os.path.join(root, 'zstd.h'): 'zstd.h', os.path.join(root, 'zstd_errors.h'): 'zstd_errors.h'}
+seen = set()
+inc_re = re.compile(r'^\s*#\s*include\s+"([^"]+)"(.*)$')
+out = []
+def inline(path):
+    path = os.path.normpath(path)
+    if path in keep:
+        out.append('#include "%s"\n' % keep[path])
+        return
+    if path in seen:
+        return
+    seen.add(path)
+    out.append('/**** start inlining %s ****/\n' % os.path.relpath(path, root))
+    with open(path) as f:
+        for line in f:
+            m = inc_re.match(line)
+            if m:
+                target = os.path.join(os.path.dirname(path), m.group(1))
+                if os.path.exists(target):
+                    inline(target)
+                    continue
+                # not found: e.g. optional headers behind #if; leave as is
+            out.append(line)
+    out.append('/**** ended inlining %s ****/\n' % os.path.relpath(path, root))
+with open(sys.argv[3]) as f:
+    for line in f:
+        m = inc_re.match(line)
+        if m:
+            inline(os.path.join(root, m.group(1)))
+        else:
+            out.append(line)
+open(out_path, 'w').write(''.join(out))